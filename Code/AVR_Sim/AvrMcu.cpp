@@ -0,0 +1,531 @@
+/*
+ * AvrMcu.cpp
+ */
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "AvrMcu.h"
+
+#include "include/avr/io.h"
+#include "include/compat/twi.h"
+
+
+// interrupt vectors, defined by the firmware with ISR()
+extern "C" void avrsim_TIMER1_COMPA_vect(void) __attribute__((weak));
+extern "C" void avrsim_TWI_vect(void) __attribute__((weak));
+
+
+AvrMcu* AvrMcu::instance = 0;
+
+
+static std::string functionName(void* function)
+{
+	Dl_info info;
+	if (!dladdr(function, &info) || !info.dli_sname)
+	{
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%p", function);
+		return buffer;
+	}
+
+	int status;
+	char* demangled = abi::__cxa_demangle(info.dli_sname, 0, 0, &status);
+	std::string name = demangled ? demangled : info.dli_sname;
+	free(demangled);
+
+	// the firmware is C, the parameter list only adds noise
+	size_t paren = name.find('(');
+	if (paren != std::string::npos)
+	{
+		name.erase(paren);
+	}
+	return name;
+}
+
+
+AvrMcu::AvrMcu() : now(0), end(UINT64_MAX), interruptsEnabled(false), inInterrupt(false),
+				   twiDevice(0), twiState(TWI_IDLE), twiDone(0),
+				   twiSelected(false), twiInterrupt(false), twiStopping(false), spiDevice(0), spiDone(0),
+				   spiReceived(0xFF), spiFlag(false), uartOutput(0), uartDone(0), uartCount(0), timerStart(0),
+				   timerBase(0), compareMatch(UINT64_MAX)
+{
+	memset(phases, 0, sizeof(phases));
+	memset(regs, 0, sizeof(regs));
+	regs[REG_TWSR] = TW_NO_INFO;
+	instance = this;
+}
+
+
+bool AvrMcu::run(int (*firmwareMain)(), uint64_t endCycles)
+{
+	instance = this;
+	end = endCycles;
+	if (setjmp(stop) == 0)
+	{
+		firmwareMain();
+		return false;
+	}
+	// the functions on the stack never return
+	callStack.clear();
+	inInterrupt = false;
+	return true;
+}
+
+std::vector<AvrFunctionStats> AvrMcu::functionStats() const
+{
+	std::vector<AvrFunctionStats> result;
+	for (std::map<void*, AvrFunctionStats>::const_iterator it = functions.begin(); it != functions.end(); ++it)
+	{
+		result.push_back(it->second);
+		result.back().name = functionName(it->first);
+	}
+	std::sort(result.begin(), result.end(),
+			  [](const AvrFunctionStats &a, const AvrFunctionStats &b) { return a.cycles > b.cycles; });
+	return result;
+}
+
+
+void AvrMcu::advance(uint64_t count, AvrPhase phase)
+{
+	now += count;
+	phases[inInterrupt ? PHASE_ISR : phase] += count;
+	if (now >= end)
+	{
+		longjmp(stop, 1);
+	}
+}
+
+bool AvrMcu::timerInterruptEnabled() const
+{
+	return avrsim_TIMER1_COMPA_vect && (regs[REG_TIMSK1] & _BV(OCIE1A));
+}
+
+bool AvrMcu::twiInterruptEnabled() const
+{
+	return avrsim_TWI_vect && (regs[REG_TWCR] & _BV(TWIE));
+}
+
+uint64_t AvrMcu::nextInterrupt() const
+{
+	if (!interruptsEnabled || inInterrupt)
+	{
+		return UINT64_MAX;
+	}
+	uint64_t next = UINT64_MAX;
+	if (timerInterruptEnabled())
+	{
+		next = regs[REG_TIFR1] & _BV(OCF1A) ? now : compareMatch;
+	}
+	if (twiInterruptEnabled() && twiInterrupt && twiDone < next)
+	{
+		next = twiDone;
+	}
+	return next;
+}
+
+void AvrMcu::serviceInterrupts()
+{
+	updateTimer();
+	if (nextInterrupt() > now)
+	{
+		return;
+	}
+	// the vector with the lower address has priority
+	if (timerInterruptEnabled() && (regs[REG_TIFR1] & _BV(OCF1A)))
+	{
+		regs[REG_TIFR1] &= ~_BV(OCF1A);
+		callVector(avrsim_TIMER1_COMPA_vect);
+	}
+	else if (twiInterruptEnabled() && twiInterrupt && now >= twiDone)
+	{
+		callVector(avrsim_TWI_vect);
+	}
+}
+
+void AvrMcu::callVector(void (*vector)())
+{
+	// the I flag is cleared while the handler runs and set again by reti
+	inInterrupt = true;
+	interruptsEnabled = false;
+	advance(AVRSIM_INTERRUPT_CYCLES, PHASE_ISR);
+	vector();
+	interruptsEnabled = true;
+	inInterrupt = false;
+}
+
+AvrPhase AvrMcu::busyPhase(uint8_t reg) const
+{
+	switch (reg)
+	{
+		case REG_TWCR:
+		case REG_TWSR:
+		case REG_TWDR:
+			return now < twiDone ? PHASE_TWI : PHASE_CPU;
+		case REG_SPSR:
+		case REG_SPDR:
+			return now < spiDone ? PHASE_SPI : PHASE_CPU;
+		case REG_UCSR1A:
+		case REG_UDR1:
+			return now + uartByteCycles() < uartDone ? PHASE_UART : PHASE_CPU;
+		default:
+			return PHASE_CPU;
+	}
+}
+
+
+uint32_t AvrMcu::twiBitCycles() const
+{
+	// SCL frequency = CPU clock / (16 + 2 * TWBR * 4^TWPS)
+	return 16 + 2 * regs[REG_TWBR] * (1 << (2 * (regs[REG_TWSR] & 0x03)));
+}
+
+uint32_t AvrMcu::spiByteCycles() const
+{
+	static const uint32_t divider[4] = { 4, 16, 64, 128 };
+	uint32_t div = divider[regs[REG_SPCR] & 0x03];
+	if (regs[REG_SPSR] & _BV(SPI2X))
+	{
+		div /= 2;
+	}
+	return 8 * div;
+}
+
+uint32_t AvrMcu::uartByteCycles() const
+{
+	// 8N1: start bit, 8 data bits, stop bit
+	uint32_t bitCycles = (regs[REG_UCSR1A] & _BV(U2X1) ? 8 : 16) * (regs[REG_UBRR1] + 1);
+	return 10 * bitCycles;
+}
+
+uint32_t AvrMcu::timerDivider() const
+{
+	// CS12:0, external clock sources are not supported
+	static const uint32_t prescaler[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+	return prescaler[regs[REG_TCCR1B] & 0x07];
+}
+
+bool AvrMcu::timerClearOnCompare() const
+{
+	// WGM13:0 = 4, the other modes count like normal mode
+	return (regs[REG_TCCR1A] & (_BV(WGM11) | _BV(WGM10))) == 0 &&
+		   (regs[REG_TCCR1B] & (_BV(WGM13) | _BV(WGM12))) == _BV(WGM12);
+}
+
+uint16_t AvrMcu::timerCount() const
+{
+	uint32_t div = timerDivider();
+	if (!div)
+	{
+		return timerBase;
+	}
+	uint64_t count = timerBase + (now - timerStart) / div;
+	uint16_t top = regs[REG_OCR1A];
+	if (timerClearOnCompare() && timerBase <= top && count > top)
+	{
+		return (count - top - 1) % ((uint32_t)top + 1);
+	}
+	return (uint16_t)count;
+}
+
+void AvrMcu::restartTimer()
+{
+	// called after TCNT1 or the timer configuration changed
+	timerStart = now;
+	uint32_t div = timerDivider();
+	if (!div)
+	{
+		compareMatch = UINT64_MAX;
+		return;
+	}
+	uint16_t top = regs[REG_OCR1A];
+	uint32_t ticks = timerBase <= top ? top - timerBase : 0x10000 - timerBase + top;
+	compareMatch = now + (uint64_t)ticks * div;
+}
+
+void AvrMcu::updateTimer()
+{
+	if (now < compareMatch)
+	{
+		return;
+	}
+	regs[REG_TIFR1] |= _BV(OCF1A);
+	uint64_t period = (uint64_t)timerDivider() * (timerClearOnCompare() ? regs[REG_OCR1A] + 1UL : 0x10000UL);
+	compareMatch += ((now - compareMatch) / period + 1) * period;
+}
+
+
+uint16_t AvrMcu::read(uint8_t reg)
+{
+	serviceInterrupts();
+	advance(reg == REG_TCNT1 || reg == REG_UBRR1 || reg == REG_OCR1A ? 2 * AVRSIM_ACCESS_CYCLES : AVRSIM_ACCESS_CYCLES,
+			busyPhase(reg));
+
+	switch (reg)
+	{
+		case REG_TWCR:
+		{
+			uint8_t value = regs[REG_TWCR];
+			if (twiStopping && now < twiDone)
+			{
+				value |= _BV(TWSTO);
+			}
+			if (twiInterrupt && now >= twiDone)
+			{
+				value |= _BV(TWINT);
+			}
+			return value;
+		}
+		case REG_TWSR:
+			return now < twiDone ? TW_NO_INFO | (regs[REG_TWSR] & 0x03) : regs[REG_TWSR];
+		case REG_SPSR:
+			return spiFlag && now >= spiDone ? regs[REG_SPSR] | _BV(SPIF) : regs[REG_SPSR];
+		case REG_SPDR:
+			spiFlag = false;
+			return spiReceived;
+		case REG_UCSR1A:
+		{
+			uint8_t value = regs[REG_UCSR1A];
+			if (now + uartByteCycles() >= uartDone)
+			{
+				value |= _BV(UDRE1);
+			}
+			if (now >= uartDone)
+			{
+				value |= _BV(TXC1);
+			}
+			return value;
+		}
+		case REG_UDR1:
+			return 0;
+		case REG_TCNT1:
+			return timerCount();
+		case REG_TIFR1:
+			updateTimer();
+			return regs[reg];
+		default:
+			return regs[reg];
+	}
+}
+
+void AvrMcu::write(uint8_t reg, uint16_t value)
+{
+	serviceInterrupts();
+	advance(reg == REG_TCNT1 || reg == REG_UBRR1 || reg == REG_OCR1A ? 2 * AVRSIM_ACCESS_CYCLES : AVRSIM_ACCESS_CYCLES,
+			busyPhase(reg));
+
+	switch (reg)
+	{
+		case REG_PINB:
+		case REG_PINC:
+		case REG_PIND:
+		case REG_PINE:
+		case REG_PINF:
+			// writing a one to PINx toggles the port bit
+			write(reg + 2, regs[reg + 2] ^ value);
+			break;
+		case REG_PORTB:
+			regs[reg] = value;
+			if (spiDevice)
+			{
+				spiDevice->spiPins(value);
+			}
+			break;
+		case REG_TWCR:
+			writeTwiControl(value);
+			break;
+		case REG_TWSR:
+			regs[reg] = (regs[reg] & 0xF8) | (value & 0x03);
+			break;
+		case REG_SPSR:
+			regs[reg] = value & _BV(SPI2X);
+			break;
+		case REG_SPDR:
+			writeSpiData(value);
+			break;
+		case REG_UCSR1A:
+			regs[reg] = value & (_BV(U2X1) | _BV(MPCM1));
+			break;
+		case REG_UDR1:
+			writeUartData(value);
+			break;
+		case REG_TCCR1A:
+		case REG_TCCR1B:
+		case REG_OCR1A:
+			// keep the count when the clock source or the mode changes
+			timerBase = timerCount();
+			regs[reg] = value;
+			restartTimer();
+			break;
+		case REG_TCNT1:
+			timerBase = value;
+			restartTimer();
+			break;
+		case REG_TIFR1:
+			// writing a one clears a flag
+			updateTimer();
+			regs[reg] &= ~value;
+			break;
+		default:
+			regs[reg] = value;
+			break;
+	}
+}
+
+void AvrMcu::delay(uint32_t count)
+{
+	// the delay loops count instructions, interrupts make them take longer
+	serviceInterrupts();
+	while (count > 0)
+	{
+		uint64_t next = nextInterrupt();
+		uint32_t step = next > now && next - now < count ? next - now : count;
+		advance(step, PHASE_DELAY);
+		count -= step;
+		serviceInterrupts();
+	}
+}
+
+
+void AvrMcu::writeTwiControl(uint8_t value)
+{
+	regs[REG_TWCR] = value & ~(_BV(TWINT) | _BV(TWSTO) | _BV(TWSTA));
+	if (!(value & _BV(TWEN)))
+	{
+		twiState = TWI_IDLE;
+		twiInterrupt = false;
+		return;
+	}
+	// writing a one to TWINT clears the flag and starts the next operation
+	if (!(value & _BV(TWINT)))
+	{
+		return;
+	}
+
+	uint32_t bit = twiBitCycles();
+	uint8_t status;
+
+	if (value & _BV(TWSTA))
+	{
+		status = twiState == TWI_IDLE ? TW_START : TW_REP_START;
+		twiState = TWI_STARTED;
+		twiDone = now + bit;
+		twiInterrupt = true;
+	}
+	else if (value & _BV(TWSTO))
+	{
+		if (twiDevice && twiSelected)
+		{
+			twiDevice->twiStop();
+		}
+		status = TW_NO_INFO;
+		twiState = TWI_IDLE;
+		twiSelected = false;
+		twiDone = now + bit;
+		twiStopping = true;
+		twiInterrupt = false;
+	}
+	else
+	{
+		switch (twiState)
+		{
+			case TWI_STARTED:
+			{
+				uint8_t address = regs[REG_TWDR];
+				bool reading = address & TW_READ;
+				twiSelected = twiDevice && twiDevice->twiSelect(address >> 1, reading);
+				if (reading)
+				{
+					status = twiSelected ? TW_MR_SLA_ACK : TW_MR_SLA_NACK;
+					twiState = TWI_RECEIVE;
+				}
+				else
+				{
+					status = twiSelected ? TW_MT_SLA_ACK : TW_MT_SLA_NACK;
+					twiState = TWI_TRANSMIT;
+				}
+				break;
+			}
+			case TWI_TRANSMIT:
+				status = twiSelected && twiDevice->twiWrite(regs[REG_TWDR]) ? TW_MT_DATA_ACK : TW_MT_DATA_NACK;
+				break;
+			case TWI_RECEIVE:
+			{
+				bool ack = value & _BV(TWEA);
+				regs[REG_TWDR] = twiSelected ? twiDevice->twiRead(ack) : 0xFF;
+				status = ack ? TW_MR_DATA_ACK : TW_MR_DATA_NACK;
+				break;
+			}
+			default:
+				status = TW_BUS_ERROR;
+				break;
+		}
+		// eight data bits and the acknowledge
+		twiDone = now + 9 * bit;
+		twiInterrupt = true;
+		twiStopping = false;
+	}
+
+	regs[REG_TWSR] = status | (regs[REG_TWSR] & 0x03);
+}
+
+void AvrMcu::writeSpiData(uint8_t value)
+{
+	spiReceived = spiDevice ? spiDevice->spiTransfer(value) : 0xFF;
+	spiDone = now + spiByteCycles();
+	spiFlag = true;
+}
+
+void AvrMcu::writeUartData(uint8_t value)
+{
+	// one byte in the shift register, the next one waits in UDR1
+	uartDone = (uartDone > now ? uartDone : now) + uartByteCycles();
+	++uartCount;
+	if (uartOutput)
+	{
+		fputc(value, uartOutput);
+	}
+}
+
+
+void AvrMcu::enterFunction(void* function)
+{
+	Frame frame;
+	frame.function = function;
+	frame.start = now;
+	memcpy(frame.phases, phases, sizeof(phases));
+	callStack.push_back(frame);
+
+	advance(AVRSIM_CALL_CYCLES, PHASE_CPU);
+}
+
+void AvrMcu::exitFunction(void* function)
+{
+	while (!callStack.empty())
+	{
+		Frame frame = callStack.back();
+		callStack.pop_back();
+		if (frame.function != function)
+		{
+			continue;
+		}
+
+		uint64_t cycles = now - frame.start;
+		AvrFunctionStats &stats = functions[function];
+		++stats.calls;
+		stats.cycles += cycles;
+		if (cycles > stats.maxCycles)
+		{
+			stats.maxCycles = cycles;
+		}
+		for (int i = 0; i < PHASE_COUNT; ++i)
+		{
+			stats.phaseCycles[i] += phases[i] - frame.phases[i];
+		}
+		break;
+	}
+}
@@ -0,0 +1,197 @@
+/*
+ * AvrMcu.h
+ *
+ * Simulated ATmega32U4 behind the register shim of AvrSim.h.
+ *
+ * Time is counted in CPU cycles. Register accesses and function calls cost a
+ * fixed number of cycles (AVRSIM_ACCESS_CYCLES, AVRSIM_CALL_CYCLES), _delay_us()
+ * and _delay_ms() the cycles avr-libc would spend. The peripherals run in
+ * parallel to the CPU:
+ *  - TWI: start/stop take one SCL period, every byte nine, SCL from TWBR and TWPS
+ *  - SPI: eight SCK periods per byte, SCK from SPR1:0 and SPI2X
+ *  - USART1: ten bit times per byte, baud rate from UBRR1 and U2X1
+ *  - Timer1: normal or CTC mode (WGM12), counts with the CS12:0 prescaler,
+ *    compare match A sets OCF1A
+ * The firmware polls the completion flags, every poll is charged to the phase
+ * of the busy peripheral. Interrupts (TIMER1_COMPA_vect, TWI_vect) are taken
+ * between register accesses and during delays, if the firmware defines the
+ * ISR, the handlers are charged to the ISR phase. The cycles spent in each
+ * phase are counted globally and per firmware function (built with
+ * -finstrument-functions).
+ */
+
+
+#ifndef AVRMCU_H_
+#define AVRMCU_H_
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "AvrSim.h"
+
+
+enum AvrPhase
+{
+	PHASE_CPU,			// register accesses and calls while no peripheral is busy
+	PHASE_DELAY,		// _delay_us(), _delay_ms()
+	PHASE_TWI,			// waiting for the TWI
+	PHASE_SPI,			// waiting for the SPI
+	PHASE_UART,			// waiting for USART1
+	PHASE_ISR,			// interrupt handlers
+	PHASE_COUNT
+};
+
+
+// device on the TWI bus, address without the R/W bit
+class AvrTwiDevice
+{
+public:
+	virtual ~AvrTwiDevice() {}
+	virtual bool twiSelect(uint8_t address, bool read) = 0;	// returns ACK
+	virtual bool twiWrite(uint8_t data) = 0;				// returns ACK
+	virtual uint8_t twiRead(bool ack) = 0;
+	virtual void twiStop() = 0;
+};
+
+// device on the SPI bus, port B carries its chip select and enable lines
+class AvrSpiDevice
+{
+public:
+	virtual ~AvrSpiDevice() {}
+	virtual void spiPins(uint8_t portB) = 0;
+	virtual uint8_t spiTransfer(uint8_t data) = 0;
+};
+
+
+struct AvrFunctionStats
+{
+	std::string name;
+	uint64_t calls;
+	uint64_t cycles;					// inclusive
+	uint64_t maxCycles;
+	uint64_t phaseCycles[PHASE_COUNT];
+};
+
+
+class AvrMcu
+{
+public:
+	AvrMcu();
+
+	// the MCU the register shim talks to, there is only one
+	static AvrMcu* current() { return instance; }
+
+	void attachTwi(AvrTwiDevice* device) { twiDevice = device; }
+	void attachSpi(AvrSpiDevice* device) { spiDevice = device; }
+	// bytes written to UDR1 are appended to this file (if any)
+	void setUartOutput(FILE* file) { uartOutput = file; }
+
+	// Runs the firmware main() until the simulated time reaches endCycles.
+	// Returns false if main() returned before.
+	bool run(int (*firmwareMain)(), uint64_t endCycles);
+
+	uint64_t cycles() const { return now; }
+	double timeUs() const { return now * 1e6 / AVRSIM_CLOCK; }
+	uint8_t port(uint8_t reg) const { return regs[reg]; }
+
+	const uint64_t* phaseCycles() const { return phases; }
+	uint64_t uartBytes() const { return uartCount; }
+	// functions that returned at least once, by inclusive cycles
+	std::vector<AvrFunctionStats> functionStats() const;
+
+	// register shim
+	uint16_t read(uint8_t reg);
+	void write(uint8_t reg, uint16_t value);
+	void delay(uint32_t count);
+	void setInterruptsEnabled(bool enabled) { interruptsEnabled = enabled; }
+
+	// -finstrument-functions hooks
+	void enterFunction(void* function);
+	void exitFunction(void* function);
+
+private:
+	enum TwiState
+	{
+		TWI_IDLE,
+		TWI_STARTED,		// start condition sent, SLA+R/W expected
+		TWI_TRANSMIT,
+		TWI_RECEIVE
+	};
+
+	struct Frame
+	{
+		void* function;
+		uint64_t start;
+		uint64_t phases[PHASE_COUNT];
+	};
+
+	static AvrMcu* instance;
+
+	uint64_t now;
+	uint64_t end;
+	jmp_buf stop;
+	uint64_t phases[PHASE_COUNT];
+	bool interruptsEnabled;		// I flag in SREG
+	bool inInterrupt;
+
+	uint16_t regs[REG_COUNT];
+
+	// TWI
+	AvrTwiDevice* twiDevice;
+	TwiState twiState;
+	uint64_t twiDone;
+	bool twiSelected;			// the addressed device acknowledged
+	bool twiInterrupt;			// TWINT is set when the operation is done
+	bool twiStopping;
+
+	// SPI
+	AvrSpiDevice* spiDevice;
+	uint64_t spiDone;
+	uint8_t spiReceived;
+	bool spiFlag;
+
+	// USART1
+	FILE* uartOutput;
+	uint64_t uartDone;
+	uint64_t uartCount;
+
+	// Timer1
+	uint64_t timerStart;		// cycle TCNT1 was last written
+	uint16_t timerBase;
+	uint64_t compareMatch;		// cycle of the next compare match A (UINT64_MAX = timer stopped)
+
+	std::vector<Frame> callStack;
+	std::map<void*, AvrFunctionStats> functions;
+
+	void advance(uint64_t count, AvrPhase phase);
+	uint64_t nextInterrupt() const;
+	void serviceInterrupts();
+	bool timerInterruptEnabled() const;
+	bool twiInterruptEnabled() const;
+	void callVector(void (*vector)());
+	AvrPhase busyPhase(uint8_t reg) const;
+
+	uint32_t twiBitCycles() const;
+	uint32_t spiByteCycles() const;
+	uint32_t uartByteCycles() const;
+	uint32_t timerDivider() const;
+	bool timerClearOnCompare() const;
+	uint16_t timerCount() const;
+	void restartTimer();
+	void updateTimer();
+
+	void writeTwiControl(uint8_t value);
+	void writeSpiData(uint8_t value);
+	void writeUartData(uint8_t value);
+
+	AvrMcu(const AvrMcu&);
+	AvrMcu& operator=(const AvrMcu&);
+};
+
+
+#endif /* AVRMCU_H_ */
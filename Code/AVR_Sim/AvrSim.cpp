@@ -0,0 +1,67 @@
+/*
+ * AvrSim.cpp
+ *
+ * Register objects of the shim and the hooks into the simulated MCU.
+ */
+
+#include "AvrMcu.h"
+
+#include "include/avr/io.h"
+
+
+AvrReg8 PINB(REG_PINB), DDRB(REG_DDRB), PORTB(REG_PORTB);
+AvrReg8 PINC(REG_PINC), DDRC(REG_DDRC), PORTC(REG_PORTC);
+AvrReg8 PIND(REG_PIND), DDRD(REG_DDRD), PORTD(REG_PORTD);
+AvrReg8 PINE(REG_PINE), DDRE(REG_DDRE), PORTE(REG_PORTE);
+AvrReg8 PINF(REG_PINF), DDRF(REG_DDRF), PORTF(REG_PORTF);
+
+AvrReg8 EIFR(REG_EIFR), EIMSK(REG_EIMSK), EICRA(REG_EICRA), EICRB(REG_EICRB);
+
+AvrReg8 SPCR(REG_SPCR), SPSR(REG_SPSR), SPDR(REG_SPDR);
+
+AvrReg8 TCCR1A(REG_TCCR1A), TCCR1B(REG_TCCR1B), TCCR1C(REG_TCCR1C), TIMSK1(REG_TIMSK1), TIFR1(REG_TIFR1);
+AvrReg16 TCNT1(REG_TCNT1), OCR1A(REG_OCR1A), OCR1B(REG_OCR1B), ICR1(REG_ICR1);
+
+AvrReg8 TWBR(REG_TWBR), TWSR(REG_TWSR), TWAR(REG_TWAR), TWDR(REG_TWDR), TWCR(REG_TWCR);
+
+AvrReg8 UCSR1A(REG_UCSR1A), UCSR1B(REG_UCSR1B), UCSR1C(REG_UCSR1C), UDR1(REG_UDR1);
+AvrReg16 UBRR1(REG_UBRR1);
+
+
+uint16_t avrsim_read(uint8_t reg)
+{
+	return AvrMcu::current()->read(reg);
+}
+
+void avrsim_write(uint8_t reg, uint16_t value)
+{
+	AvrMcu::current()->write(reg, value);
+}
+
+void avrsim_delayCycles(uint32_t cycles)
+{
+	AvrMcu::current()->delay(cycles);
+}
+
+void avrsim_setInterruptsEnabled(bool enabled)
+{
+	AvrMcu::current()->setInterruptsEnabled(enabled);
+}
+
+
+// called for every function of the firmware, it is built with -finstrument-functions
+extern "C" void __cyg_profile_func_enter(void* function, void*)
+{
+	if (AvrMcu::current())
+	{
+		AvrMcu::current()->enterFunction(function);
+	}
+}
+
+extern "C" void __cyg_profile_func_exit(void* function, void*)
+{
+	if (AvrMcu::current())
+	{
+		AvrMcu::current()->exitFunction(function);
+	}
+}
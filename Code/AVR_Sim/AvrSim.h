@@ -0,0 +1,99 @@
+/*
+ * AvrSim.h
+ *
+ * Register shim for compiling the ATmega32U4 firmware (Node, Glove, Glove v2)
+ * on the host. The firmware sources are compiled unchanged as C++ against the
+ * headers in include/, which map every register they touch to an AvrReg8 or
+ * AvrReg16 object. Each access goes to the simulated MCU (AvrMcu.h), which
+ * advances the simulated clock and models the TWI, SPI, USART and Timer1.
+ */
+
+
+#ifndef AVRSIM_H_
+#define AVRSIM_H_
+
+#include <stdint.h>
+
+
+// the clock the MCU runs with, independent of the F_CPU a source file was compiled with
+#define AVRSIM_CLOCK				8000000UL
+
+// cost model: every register access (lds/sts plus the instructions around it) and
+// every function call (call/ret, prologue/epilogue) take a fixed number of cycles,
+// an interrupt additionally the vector jump, saving SREG and reti
+#define AVRSIM_ACCESS_CYCLES		4
+#define AVRSIM_CALL_CYCLES			8
+#define AVRSIM_INTERRUPT_CYCLES		20
+
+// the shim is compiled into the firmware, it must not show up in the function statistics
+#define AVRSIM_NO_PROFILE			__attribute__((no_instrument_function))
+
+
+enum AvrRegisterId
+{
+	REG_PINB, REG_DDRB, REG_PORTB,
+	REG_PINC, REG_DDRC, REG_PORTC,
+	REG_PIND, REG_DDRD, REG_PORTD,
+	REG_PINE, REG_DDRE, REG_PORTE,
+	REG_PINF, REG_DDRF, REG_PORTF,
+	REG_EIFR, REG_EIMSK, REG_EICRA, REG_EICRB,
+	REG_SPCR, REG_SPSR, REG_SPDR,
+	REG_TCCR1A, REG_TCCR1B, REG_TCCR1C, REG_TIMSK1, REG_TIFR1,
+	REG_TCNT1, REG_OCR1A, REG_OCR1B, REG_ICR1,
+	REG_TWBR, REG_TWSR, REG_TWAR, REG_TWDR, REG_TWCR,
+	REG_UCSR1A, REG_UCSR1B, REG_UCSR1C, REG_UBRR1, REG_UDR1,
+	REG_COUNT
+};
+
+
+uint16_t avrsim_read(uint8_t reg);
+void avrsim_write(uint8_t reg, uint16_t value);
+
+void avrsim_delayCycles(uint32_t cycles);
+void avrsim_setInterruptsEnabled(bool enabled);
+
+
+class AvrReg8
+{
+public:
+	AVRSIM_NO_PROFILE explicit AvrReg8(uint8_t reg) : reg(reg) {}
+
+	AVRSIM_NO_PROFILE operator uint8_t() const { return (uint8_t)avrsim_read(reg); }
+
+	// int like in C, where ~_BV(bit) is truncated silently
+	AVRSIM_NO_PROFILE AvrReg8& operator=(int value) { avrsim_write(reg, (uint8_t)value); return *this; }
+	AVRSIM_NO_PROFILE AvrReg8& operator=(const AvrReg8 &other) { return *this = (uint8_t)other; }
+
+	// read-modify-write, like the lds/ori/sts sequence the compiler generates
+	AVRSIM_NO_PROFILE AvrReg8& operator|=(int value) { return *this = *this | value; }
+	AVRSIM_NO_PROFILE AvrReg8& operator&=(int value) { return *this = *this & value; }
+	AVRSIM_NO_PROFILE AvrReg8& operator^=(int value) { return *this = *this ^ value; }
+
+private:
+	uint8_t reg;
+
+	AvrReg8(const AvrReg8&);
+};
+
+class AvrReg16
+{
+public:
+	AVRSIM_NO_PROFILE explicit AvrReg16(uint8_t reg) : reg(reg) {}
+
+	AVRSIM_NO_PROFILE operator uint16_t() const { return avrsim_read(reg); }
+
+	AVRSIM_NO_PROFILE AvrReg16& operator=(long value) { avrsim_write(reg, (uint16_t)value); return *this; }
+	AVRSIM_NO_PROFILE AvrReg16& operator=(const AvrReg16 &other) { return *this = (uint16_t)other; }
+
+	AVRSIM_NO_PROFILE AvrReg16& operator|=(long value) { return *this = *this | value; }
+	AVRSIM_NO_PROFILE AvrReg16& operator&=(long value) { return *this = *this & value; }
+	AVRSIM_NO_PROFILE AvrReg16& operator+=(long value) { return *this = *this + value; }
+
+private:
+	uint8_t reg;
+
+	AvrReg16(const AvrReg16&);
+};
+
+
+#endif /* AVRSIM_H_ */
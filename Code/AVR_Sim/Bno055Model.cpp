@@ -0,0 +1,161 @@
+/*
+ * Bno055Model.cpp
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "Bno055Model.h"
+
+
+// page 0 registers used by the firmware
+#define REG_CHIP_ID			0x00
+#define REG_ACCEL_DATA		0x08
+#define REG_QUATERNION_DATA	0x20
+#define REG_LINEAR_ACCEL	0x28
+#define REG_GRAVITY_DATA	0x2E
+#define REG_OPR_MODE		0x3D
+#define REG_SYS_TRIGGER		0x3F
+#define REG_AXIS_MAP_CONFIG	0x41
+#define REG_AXIS_MAP_SIGN	0x42
+
+#define SYS_TRIGGER_RST_SYS	0x20
+#define OPR_MODE_CONFIG		0x00
+#define OPR_MODE_FUSION		0x08		// modes 0x08 to 0x0C
+
+
+static void putInt16(uint8_t* regs, int16_t value)
+{
+	regs[0] = value & 0xFF;
+	regs[1] = (uint16_t)value >> 8;
+}
+
+
+Bno055Model::Bno055Model(AvrMcu &mcu, uint8_t channelMask) : mcu(mcu), channelMask(channelMask), selected(0), channel(0),
+															 pointer(0), pointerSet(false), readCount(0)
+{
+	for (int i = 0; i < BNO055_MUX_CHANNELS; ++i)
+	{
+		reset(sensors[i]);
+		sensors[i].bootDone = 0;
+	}
+}
+
+
+bool Bno055Model::twiSelect(uint8_t address, bool read)
+{
+	channel = muxChannel();
+	Sensor &sensor = sensors[channel];
+	if (address != BNO055_I2C_ADDRESS || !(channelMask & (1 << channel)) || mcu.cycles() < sensor.bootDone)
+	{
+		selected = 0;
+		return false;
+	}
+
+	selected = &sensor;
+	pointerSet = read;
+	if (read)
+	{
+		// the burst read returns one consistent sample
+		updateData(sensor, channel);
+	}
+	return true;
+}
+
+bool Bno055Model::twiWrite(uint8_t data)
+{
+	if (!selected)
+	{
+		return false;
+	}
+	if (!pointerSet)
+	{
+		pointer = data & 0x7F;
+		pointerSet = true;
+		return true;
+	}
+
+	switch (pointer)
+	{
+		case REG_SYS_TRIGGER:
+			if (data & SYS_TRIGGER_RST_SYS)
+			{
+				reset(*selected);
+				selected->bootDone = mcu.cycles() + (uint64_t)BNO055_RESET_US * (AVRSIM_CLOCK / 1000000);
+			}
+			break;
+		case REG_OPR_MODE:
+		case REG_AXIS_MAP_CONFIG:
+		case REG_AXIS_MAP_SIGN:
+			selected->regs[pointer] = data;
+			break;
+		default:
+			// read-only or not modelled
+			break;
+	}
+	pointer = (pointer + 1) & 0x7F;
+	return true;
+}
+
+uint8_t Bno055Model::twiRead(bool)
+{
+	if (!selected)
+	{
+		return 0xFF;
+	}
+	++readCount;
+	uint8_t data = selected->regs[pointer];
+	pointer = (pointer + 1) & 0x7F;
+	return data;
+}
+
+void Bno055Model::twiStop()
+{
+	selected = 0;
+}
+
+
+uint8_t Bno055Model::muxChannel() const
+{
+	uint8_t portD = mcu.port(REG_PORTD);
+	return ((portD >> BNO055_MUX_S0) & 1) | ((portD >> BNO055_MUX_S1) & 1) << 1 | ((portD >> BNO055_MUX_S2) & 1) << 2;
+}
+
+void Bno055Model::reset(Sensor &sensor)
+{
+	memset(sensor.regs, 0, sizeof(sensor.regs));
+	sensor.regs[REG_CHIP_ID] = 0xA0;
+	sensor.regs[REG_CHIP_ID + 1] = 0xFB;		// accelerometer
+	sensor.regs[REG_CHIP_ID + 2] = 0x32;		// magnetometer
+	sensor.regs[REG_CHIP_ID + 3] = 0x0F;		// gyroscope
+	sensor.regs[REG_OPR_MODE] = OPR_MODE_CONFIG;
+	sensor.regs[REG_AXIS_MAP_CONFIG] = 0x24;
+}
+
+void Bno055Model::updateData(Sensor &sensor, uint8_t channel)
+{
+	if (sensor.regs[REG_OPR_MODE] < OPR_MODE_FUSION)
+	{
+		memset(sensor.regs + REG_ACCEL_DATA, 0, REG_GRAVITY_DATA + 6 - REG_ACCEL_DATA);
+		return;
+	}
+
+	// rotation about a tilted axis, 1 LSB = 2^-14 for the quaternion, 1 m/s^2 = 100 LSB
+	double t = mcu.timeUs() / 1e6;
+	double angle = 2 * M_PI * (0.2 + 0.05 * channel) * t;
+	double axisAngle = 0.3 * t + channel;
+	double ax = sin(axisAngle);
+	double ay = cos(axisAngle);
+	double az = 0.5;
+	double s = sin(angle / 2) / sqrt(ax * ax + ay * ay + az * az);
+
+	putInt16(sensor.regs + REG_QUATERNION_DATA, (int16_t)lrint(cos(angle / 2) * 16384));
+	putInt16(sensor.regs + REG_QUATERNION_DATA + 2, (int16_t)lrint(ax * s * 16384));
+	putInt16(sensor.regs + REG_QUATERNION_DATA + 4, (int16_t)lrint(ay * s * 16384));
+	putInt16(sensor.regs + REG_QUATERNION_DATA + 6, (int16_t)lrint(az * s * 16384));
+
+	double phase = 2 * M_PI * 1.3 * t + channel;
+	putInt16(sensor.regs + REG_LINEAR_ACCEL, (int16_t)lrint(300 * sin(phase)));
+	putInt16(sensor.regs + REG_LINEAR_ACCEL + 2, (int16_t)lrint(200 * cos(phase)));
+	putInt16(sensor.regs + REG_LINEAR_ACCEL + 4, (int16_t)lrint(100 * sin(2 * phase)));
+}
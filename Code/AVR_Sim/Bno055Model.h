@@ -0,0 +1,70 @@
+/*
+ * Bno055Model.h
+ *
+ * BNO055 IMUs behind the analog multiplexer of the gloves. The multiplexer
+ * channel is taken from the select pins on port D (MUX_S0..2 in BNO055.h), the
+ * single node has no multiplexer and always talks to channel 0.
+ *
+ * Each BNO055 answers on address 0x28 with a register file (page 0): chip IDs,
+ * OPR_MODE, SYS_TRIGGER, axis remap and the data registers. In a fusion mode
+ * quaternion and linear acceleration follow a slow rotation that differs per
+ * channel, in CONFIG mode the data registers read 0. A reset (SYS_TRIGGER)
+ * makes the sensor NACK for BNO055_RESET_US, like the real boot time.
+ */
+
+
+#ifndef BNO055MODEL_H_
+#define BNO055MODEL_H_
+
+#include <stdint.h>
+
+#include "AvrMcu.h"
+
+
+#define BNO055_MUX_CHANNELS			8
+#define BNO055_MUX_S0				4		// port D pins
+#define BNO055_MUX_S1				6
+#define BNO055_MUX_S2				7
+
+#define BNO055_I2C_ADDRESS			0x28
+#define BNO055_RESET_US				650000
+
+
+class Bno055Model : public AvrTwiDevice
+{
+public:
+	// channelMask: multiplexer channels with a sensor
+	Bno055Model(AvrMcu &mcu, uint8_t channelMask);
+
+	// AvrTwiDevice
+	bool twiSelect(uint8_t address, bool read);
+	bool twiWrite(uint8_t data);
+	uint8_t twiRead(bool ack);
+	void twiStop();
+
+	uint64_t bytesRead() const { return readCount; }
+
+private:
+	struct Sensor
+	{
+		uint8_t regs[0x80];
+		uint64_t bootDone;			// cycle the sensor answers again after a reset
+	};
+
+	AvrMcu &mcu;
+	uint8_t channelMask;
+	Sensor sensors[BNO055_MUX_CHANNELS];
+
+	Sensor* selected;
+	uint8_t channel;
+	uint8_t pointer;				// register address
+	bool pointerSet;				// first byte of a write sets the address
+	uint64_t readCount;
+
+	uint8_t muxChannel() const;
+	void reset(Sensor &sensor);
+	void updateData(Sensor &sensor, uint8_t channel);
+};
+
+
+#endif /* BNO055MODEL_H_ */
@@ -0,0 +1,345 @@
+/*
+ * Nrf24Model.cpp
+ */
+
+#include <string.h>
+
+#include "Nrf24Model.h"
+
+
+// registers
+#define NRF_CONFIG			0x00
+#define NRF_EN_AA			0x01
+#define NRF_EN_RXADDR		0x02
+#define NRF_SETUP_AW		0x03
+#define NRF_SETUP_RETR		0x04
+#define NRF_RF_CH			0x05
+#define NRF_RF_SETUP		0x06
+#define NRF_STATUS			0x07
+#define NRF_RX_ADDR_P0		0x0A
+#define NRF_RX_ADDR_P1		0x0B
+#define NRF_RX_ADDR_P2		0x0C
+#define NRF_TX_ADDR			0x10
+#define NRF_FIFO_STATUS		0x17
+#define NRF_DYNPD			0x1C
+#define NRF_FEATURE			0x1D
+
+// bits
+#define NRF_PRIM_RX			0
+#define NRF_PWR_UP			1
+#define NRF_MAX_RT			4
+#define NRF_TX_DS			5
+#define NRF_RX_DR			6
+#define NRF_EN_ACK_PAY		1
+
+// commands
+#define NRF_R_REGISTER		0x00
+#define NRF_W_REGISTER		0x20
+#define NRF_R_RX_PL_WID		0x60
+#define NRF_R_RX_PAYLOAD	0x61
+#define NRF_W_TX_PAYLOAD	0xA0
+#define NRF_W_ACK_PAYLOAD	0xA8
+#define NRF_W_TX_PAYLOAD_NOACK	0xB0
+#define NRF_FLUSH_TX		0xE1
+#define NRF_FLUSH_RX		0xE2
+#define NRF_REUSE_TX_PL		0xE3
+#define NRF_NOP				0xFF
+
+#define US_TO_CYCLES(us)	((uint64_t)(us) * (AVRSIM_CLOCK / 1000000))
+
+
+static bool isAddressRegister(uint8_t reg)
+{
+	return reg == NRF_RX_ADDR_P0 || reg == NRF_RX_ADDR_P1 || reg == NRF_TX_ADDR;
+}
+
+
+Nrf24Model::Nrf24Model(AvrMcu &mcu, uint32_t pollPeriod, FILE* output) : mcu(mcu), pollCycles(US_TO_CYCLES(pollPeriod)),
+																		  output(output), star(false), modeAckPending(false), csn(true), ce(false), command(NRF_NOP),
+																		  byteIndex(0), nextPoll(0), txDone(0)
+{
+	memset(poll, 0, sizeof(poll));
+	memset(&nrfStats, 0, sizeof(nrfStats));
+	memset(&writing, 0, sizeof(writing));
+
+	// reset values
+	memset(regs, 0, sizeof(regs));
+	regs[NRF_CONFIG][0] = 0x08;
+	regs[NRF_EN_AA][0] = 0x3F;
+	regs[NRF_EN_RXADDR][0] = 0x03;
+	regs[NRF_SETUP_AW][0] = 0x03;
+	regs[NRF_SETUP_RETR][0] = 0x03;
+	regs[NRF_RF_CH][0] = 0x02;
+	regs[NRF_RF_SETUP][0] = 0x0E;
+	memset(regs[NRF_RX_ADDR_P0], 0xE7, 5);
+	memset(regs[NRF_RX_ADDR_P1], 0xC2, 5);
+	memset(regs[NRF_TX_ADDR], 0xE7, 5);
+	for (uint8_t i = 0; i < 4; ++i)
+	{
+		regs[NRF_RX_ADDR_P2 + i][0] = 0xC3 + i;
+	}
+}
+
+void Nrf24Model::setPoll(uint8_t mode, uint8_t nodeId, uint8_t sessionId)
+{
+	poll[0] = mode;
+	poll[1] = nodeId;
+	poll[2] = sessionId;
+	modeAckPending = true;
+}
+
+void Nrf24Model::setStar(bool enable)
+{
+	star = enable;
+}
+
+
+void Nrf24Model::spiPins(uint8_t portB)
+{
+	update();
+
+	bool newCsn = portB & (1 << NRF24_CSN_PIN);
+	bool newCe = portB & (1 << NRF24_CE_PIN);
+
+	if (csn && !newCsn)
+	{
+		byteIndex = 0;
+	}
+	else if (!csn && newCsn)
+	{
+		endCommand();
+	}
+
+	csn = newCsn;
+	ce = newCe;
+
+	// a CE pulse starts the transmission of the first TX payload in PTX mode
+	startTransmission();
+}
+
+uint8_t Nrf24Model::spiTransfer(uint8_t data)
+{
+	if (csn)
+	{
+		return 0xFF;
+	}
+	update();
+
+	uint8_t index = byteIndex++;
+	if (index == 0)
+	{
+		command = data;
+		if (command == NRF_FLUSH_TX)
+		{
+			txFifo.clear();
+		}
+		else if (command == NRF_FLUSH_RX)
+		{
+			rxFifo.clear();
+		}
+		else if (command == NRF_W_TX_PAYLOAD || command == NRF_W_TX_PAYLOAD_NOACK ||
+				 (command & 0xF8) == NRF_W_ACK_PAYLOAD)
+		{
+			writing.pipe = (command & 0xF8) == NRF_W_ACK_PAYLOAD ? command & 0x07 : 0;
+			writing.length = 0;
+		}
+		return status();
+	}
+
+	uint8_t dataIndex = index - 1;
+	if (command < NRF_W_REGISTER)
+	{
+		return readRegister(command & 0x1F, dataIndex);
+	}
+	if (command < NRF_R_RX_PL_WID)
+	{
+		writeRegister(command & 0x1F, dataIndex, data);
+		return 0;
+	}
+
+	switch (command)
+	{
+		case NRF_R_RX_PL_WID:
+			return rxFifo.empty() ? 0 : rxFifo.front().length;
+		case NRF_R_RX_PAYLOAD:
+			return rxFifo.empty() || dataIndex >= rxFifo.front().length ? 0 : rxFifo.front().data[dataIndex];
+		default:
+			if (command == NRF_W_TX_PAYLOAD || command == NRF_W_TX_PAYLOAD_NOACK || (command & 0xF8) == NRF_W_ACK_PAYLOAD)
+			{
+				if (writing.length < NRF24_PAYLOAD_MAX_LEN)
+				{
+					writing.data[writing.length++] = data;
+				}
+			}
+			return 0;
+	}
+}
+
+
+void Nrf24Model::update()
+{
+	uint64_t now = mcu.cycles();
+
+	if (txDone && now >= txDone)
+	{
+		forward(txFifo.front());
+		txFifo.pop_front();
+		regs[NRF_STATUS][0] |= 1 << NRF_TX_DS;
+		txDone = 0;
+
+		bool ackPayload = regs[NRF_FEATURE][0] & (1 << NRF_EN_ACK_PAY);
+		if (star && modeAckPending && ackPayload && rxFifo.size() < NRF24_FIFO_LEN)
+		{
+			Payload ack;
+			ack.pipe = 0;
+			ack.length = 1;
+			ack.data[0] = poll[0];
+			rxFifo.push_back(ack);
+			regs[NRF_STATUS][0] |= 1 << NRF_RX_DR;
+			modeAckPending = false;
+		}
+
+		// with CE still high the next payload follows
+		startTransmission();
+	}
+
+	while (!star && nextPoll <= now)
+	{
+		receivePoll();
+	}
+}
+
+void Nrf24Model::startTransmission()
+{
+	bool primaryTx = !(regs[NRF_CONFIG][0] & (1 << NRF_PRIM_RX));
+	if (ce && primaryTx && !txFifo.empty() && txDone == 0)
+	{
+		// 130 us settling, preamble, address, control field and CRC around the payload
+		txDone = mcu.cycles() + US_TO_CYCLES(130 + (txFifo.front().length + 9) * 8);
+	}
+}
+
+void Nrf24Model::receivePoll()
+{
+	++nrfStats.polls;
+
+	uint8_t config = regs[NRF_CONFIG][0];
+	bool listening = ce && (config & (1 << NRF_PWR_UP)) && (config & (1 << NRF_PRIM_RX));
+	if (!listening || rxFifo.size() >= NRF24_FIFO_LEN)
+	{
+		++nrfStats.lostPolls;
+		nextPoll += pollCycles;
+		return;
+	}
+
+	Payload payload;
+	payload.pipe = 0;
+	payload.length = sizeof(poll);
+	memcpy(payload.data, poll, sizeof(poll));
+	rxFifo.push_back(payload);
+	regs[NRF_STATUS][0] |= 1 << NRF_RX_DR;
+
+	bool ackPayload = regs[NRF_FEATURE][0] & (1 << NRF_EN_ACK_PAY);
+	if (!ackPayload || txFifo.empty() || txFifo.front().pipe != 0)
+	{
+		++nrfStats.emptyAcks;
+		nextPoll += pollCycles;
+		return;
+	}
+
+	const Payload &ack = txFifo.front();
+	nextPoll += US_TO_CYCLES(NRF24_POLL_US + ack.length * NRF24_BYTE_US);
+	forward(ack);
+	txFifo.pop_front();
+	regs[NRF_STATUS][0] |= 1 << NRF_TX_DS;
+}
+
+void Nrf24Model::forward(const Payload &payload)
+{
+	// queuePayload() of the base station: receive time after the data descriptor of packet 1
+	uint8_t data[NRF24_PAYLOAD_MAX_LEN + 4];
+	uint8_t length = 0;
+	bool stamp = payload.length >= 4 && payload.data[0] == 0xAB && payload.data[1] == 0xCD && !(payload.data[3] & 0x10);
+	uint32_t rxTime = (uint32_t)(mcu.cycles() / (AVRSIM_CLOCK / 1000000));
+	for (uint8_t i = 0; i < payload.length; ++i)
+	{
+		data[length++] = payload.data[i];
+		if (stamp && i == 3)
+		{
+			data[3] |= 0x10;
+			for (uint8_t k = 0; k < 4; ++k)
+			{
+				data[length++] = (uint8_t)(rxTime >> (8 * k));
+			}
+		}
+	}
+
+	++nrfStats.payloads;
+	nrfStats.bytes += length;
+	if (output)
+	{
+		fwrite(data, 1, length, output);
+	}
+}
+
+
+uint8_t Nrf24Model::status() const
+{
+	uint8_t pipe = rxFifo.empty() ? 0x07 : rxFifo.front().pipe;
+	return (regs[NRF_STATUS][0] & 0x70) | pipe << 1 | (txFifo.size() >= NRF24_FIFO_LEN ? 0x01 : 0);
+}
+
+uint8_t Nrf24Model::fifoStatus() const
+{
+	uint8_t value = 0;
+	value |= txFifo.size() >= NRF24_FIFO_LEN ? 0x20 : 0;
+	value |= txFifo.empty() ? 0x10 : 0;
+	value |= rxFifo.size() >= NRF24_FIFO_LEN ? 0x02 : 0;
+	value |= rxFifo.empty() ? 0x01 : 0;
+	return value;
+}
+
+uint8_t Nrf24Model::readRegister(uint8_t reg, uint8_t index) const
+{
+	if (reg == NRF_STATUS)
+	{
+		return status();
+	}
+	if (reg == NRF_FIFO_STATUS)
+	{
+		return fifoStatus();
+	}
+	return index < (isAddressRegister(reg) ? 5 : 1) ? regs[reg][index] : 0;
+}
+
+void Nrf24Model::writeRegister(uint8_t reg, uint8_t index, uint8_t data)
+{
+	if (reg == NRF_STATUS)
+	{
+		// writing a one clears an IRQ flag
+		regs[reg][0] &= ~(data & 0x70);
+		return;
+	}
+	if (reg == NRF_FIFO_STATUS || index >= (isAddressRegister(reg) ? 5 : 1))
+	{
+		return;
+	}
+	regs[reg][index] = data;
+}
+
+void Nrf24Model::endCommand()
+{
+	if (byteIndex == 0)
+	{
+		return;
+	}
+	if (command == NRF_R_RX_PAYLOAD && byteIndex > 1 && !rxFifo.empty())
+	{
+		rxFifo.pop_front();
+	}
+	else if ((command == NRF_W_TX_PAYLOAD || command == NRF_W_TX_PAYLOAD_NOACK || (command & 0xF8) == NRF_W_ACK_PAYLOAD) &&
+			 writing.length > 0 && txFifo.size() < NRF24_FIFO_LEN)
+	{
+		txFifo.push_back(writing);
+	}
+}
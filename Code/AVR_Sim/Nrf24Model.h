@@ -0,0 +1,120 @@
+/*
+ * Nrf24Model.h
+ *
+ * nRF24L01+ on the SPI bus (CSN on PB0, CE on PB5, see SPI.h of the firmware)
+ * and the base station polling it.
+ *
+ * The SPI commands, the register file, the 3 entry RX and TX FIFOs and the IRQ
+ * flags in STATUS are modelled, the radio itself only as far as the firmware
+ * sees it: while the nRF listens (PWR_UP, PRIM_RX, CE high), the base station
+ * sends it a poll [mode, node ID, session ID] every pollPeriod. The poll goes to
+ * the RX FIFO (RX_DR) and is answered with the first ack payload of the TX FIFO
+ * (TX_DS), which the base station forwards to its serial port, i.e. the output
+ * file, packet 1 of a sample (sync bytes) with the receive time inserted
+ * (RX_TIME_STAMPS of the base station, the simulated time in us). After a
+ * payload the base station polls again right away, like
+ * Code/BaseStation/main.cpp. A full RX FIFO means no acknowledge, the poll is
+ * lost. Payloads sent as PTX (nrf_writeTXData) are forwarded as well.
+ *
+ * In star mode (RADIO_STAR of the firmware) the base station does not poll, it
+ * listens on all pipes: while the nRF is PTX with CE high it sends its TX FIFO
+ * one payload after the other, and the acknowledge of the first payload after
+ * setPoll() carries the mode as ack payload (RX_DR). Every transmission reaches
+ * the base station, retransmissions and MAX_RT are not modelled.
+ */
+
+
+#ifndef NRF24MODEL_H_
+#define NRF24MODEL_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <deque>
+
+#include "AvrMcu.h"
+
+
+#define NRF24_CSN_PIN			0		// port B
+#define NRF24_CE_PIN			5
+
+#define NRF24_FIFO_LEN			3
+#define NRF24_PAYLOAD_MAX_LEN	32
+
+// air time of a poll with an empty ack at 1 Mbps and per byte of ack payload
+#define NRF24_POLL_US			250
+#define NRF24_BYTE_US			12
+
+
+struct Nrf24Stats
+{
+	uint64_t polls;
+	uint64_t lostPolls;			// not listening or RX FIFO full
+	uint64_t emptyAcks;
+	uint64_t payloads;			// ack payloads and PTX payloads received by the base station
+	uint64_t bytes;
+};
+
+
+class Nrf24Model : public AvrSpiDevice
+{
+public:
+	// pollPeriod in us, output receives the payloads (may be 0)
+	Nrf24Model(AvrMcu &mcu, uint32_t pollPeriod, FILE* output);
+
+	// contents of the polls, mode is changed like with the user button of the base station
+	void setPoll(uint8_t mode, uint8_t nodeId, uint8_t sessionId);
+
+	// star topology instead of polls
+	void setStar(bool enable);
+
+	// AvrSpiDevice
+	void spiPins(uint8_t portB);
+	uint8_t spiTransfer(uint8_t data);
+
+	const Nrf24Stats& stats() const { return nrfStats; }
+
+private:
+	struct Payload
+	{
+		uint8_t pipe;
+		uint8_t length;
+		uint8_t data[NRF24_PAYLOAD_MAX_LEN];
+	};
+
+	AvrMcu &mcu;
+	uint64_t pollCycles;
+	FILE* output;
+	uint8_t poll[3];
+	bool star;
+	bool modeAckPending;		// star mode: the next acknowledge carries the mode
+
+	uint8_t regs[0x20][5];
+	std::deque<Payload> rxFifo;
+	std::deque<Payload> txFifo;
+
+	bool csn;
+	bool ce;
+	uint8_t command;
+	uint8_t byteIndex;			// of the current SPI transaction, 0 = command
+	Payload writing;			// W_TX_PAYLOAD, W_ACK_PAYLOAD
+
+	uint64_t nextPoll;
+	uint64_t txDone;			// PTX transmission in progress until then (0 = none)
+
+	Nrf24Stats nrfStats;
+
+	void update();
+	void startTransmission();
+	void receivePoll();
+	void forward(const Payload &payload);
+
+	uint8_t status() const;
+	uint8_t fifoStatus() const;
+	uint8_t readRegister(uint8_t reg, uint8_t index) const;
+	void writeRegister(uint8_t reg, uint8_t index, uint8_t data);
+	void endCommand();
+};
+
+
+#endif /* NRF24MODEL_H_ */
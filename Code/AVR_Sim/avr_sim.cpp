@@ -0,0 +1,193 @@
+/*
+ * avr_sim.cpp
+ *
+ * Runs a firmware (Node, Glove or Glove v2, see build.sh) on the simulated
+ * ATmega32U4 with BNO055s on the TWI and an nRF24L01+ polled by a base station,
+ * then reports where the cycles went: per phase (CPU, delays, waiting for TWI,
+ * SPI and USART, interrupt handlers) and per firmware function, relative to
+ * the sample period budget of the main loop (while (TCNT1 < 10000)).
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "AvrMcu.h"
+#include "Bno055Model.h"
+#include "Nrf24Model.h"
+
+
+// main() of the firmware, renamed by build.sh
+int avrsim_firmware_main();
+
+
+static const char* phaseNames[PHASE_COUNT] = { "cpu", "delay", "twi", "spi", "uart", "isr" };
+
+
+static double cyclesToUs(uint64_t cycles)
+{
+	return cycles * 1e6 / AVRSIM_CLOCK;
+}
+
+static void printReport(const AvrMcu &mcu, const Nrf24Model &nrf, const Bno055Model &bno, double budget, bool all)
+{
+	uint64_t total = mcu.cycles();
+	printf("simulated %.3f s, %llu cycles\n\n", cyclesToUs(total) / 1e6, (unsigned long long)total);
+
+	printf("phase          cycles   share\n");
+	for (int i = 0; i < PHASE_COUNT; ++i)
+	{
+		uint64_t cycles = mcu.phaseCycles()[i];
+		printf("%-6s %14llu  %5.1f %%\n", phaseNames[i], (unsigned long long)cycles, total ? 100.0 * cycles / total : 0.0);
+	}
+
+	const Nrf24Stats &stats = nrf.stats();
+	printf("\nbase station: %llu polls, %llu lost, %llu empty acks, %llu payloads, %llu bytes\n",
+		   (unsigned long long)stats.polls, (unsigned long long)stats.lostPolls, (unsigned long long)stats.emptyAcks,
+		   (unsigned long long)stats.payloads, (unsigned long long)stats.bytes);
+	printf("BNO055: %llu bytes read, USART1: %llu bytes written\n\n", (unsigned long long)bno.bytesRead(),
+		   (unsigned long long)mcu.uartBytes());
+
+	printf("%-40s %9s %10s %10s %8s %6s", "function", "calls", "avg us", "max us", "budget", "over");
+	for (int i = 0; i < PHASE_COUNT; ++i)
+	{
+		printf(" %6s", phaseNames[i]);
+	}
+	printf("\n");
+
+	std::vector<AvrFunctionStats> functions = mcu.functionStats();
+	for (size_t i = 0; i < functions.size() && (all || i < 25); ++i)
+	{
+		const AvrFunctionStats &f = functions[i];
+		double avg = cyclesToUs(f.cycles) / f.calls;
+		// calls that alone took longer than the budget are counted when their maximum does
+		printf("%-40.40s %9llu %10.1f %10.1f %7.1f%% %6s", f.name.c_str(), (unsigned long long)f.calls, avg,
+			   cyclesToUs(f.maxCycles), 100 * avg / budget, cyclesToUs(f.maxCycles) > budget ? "yes" : "");
+		for (int p = 0; p < PHASE_COUNT; ++p)
+		{
+			printf(" %5.1f%%", f.cycles ? 100.0 * f.phaseCycles[p] / f.cycles : 0.0);
+		}
+		printf("\n");
+	}
+}
+
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [-t seconds] [-m mode] [-n node] [-p period] [-c channels] [-b budget] [-o file] [-u file] [-S] [-a]\n", name);
+	fprintf(stderr, "  -t seconds    simulated time (default 10)\n");
+	fprintf(stderr, "  -m mode       mode requested by the base station, 0 quaternion, 1 quaternion + lin. acc.,\n");
+	fprintf(stderr, "                2 / 3 smallest three 10 / 12 bit, 4 smallest three 10 bit + lin. acc.,\n");
+	fprintf(stderr, "                5 quaternion residuals (delta) (default 0)\n");
+	fprintf(stderr, "  -n node       node ID assigned by the base station (default 0)\n");
+	fprintf(stderr, "  -p period     poll period of the base station in us (default 500)\n");
+	fprintf(stderr, "  -c channels   multiplexer channels with a BNO055, bit mask (default 0xff)\n");
+	fprintf(stderr, "  -b budget     sample period budget in us for the report (default 10000)\n");
+	fprintf(stderr, "  -o file       write the payloads received by the base station to a file\n");
+	fprintf(stderr, "  -u file       write the bytes sent on USART1 to a file\n");
+	fprintf(stderr, "  -S            star topology, no polls (firmware built with -DRADIO_STAR=1)\n");
+	fprintf(stderr, "  -a            report all functions, not only the 25 slowest\n");
+}
+
+int main(int argc, char** argv)
+{
+	double duration = 10;
+	unsigned int mode = 0;
+	unsigned int nodeId = 0;
+	unsigned int pollPeriod = 500;
+	unsigned int channels = 0xFF;
+	double budget = 10000;
+	const char* outPath = 0;
+	const char* uartPath = 0;
+	bool star = false;
+	bool all = false;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "t:m:n:p:c:b:o:u:Sa")) != -1)
+	{
+		switch (opt)
+		{
+			case 't':
+				duration = atof(optarg);
+				break;
+			case 'm':
+				mode = atoi(optarg);
+				break;
+			case 'n':
+				nodeId = atoi(optarg);
+				break;
+			case 'p':
+				pollPeriod = atoi(optarg);
+				break;
+			case 'c':
+				channels = strtoul(optarg, 0, 0);
+				break;
+			case 'b':
+				budget = atof(optarg);
+				break;
+			case 'o':
+				outPath = optarg;
+				break;
+			case 'u':
+				uartPath = optarg;
+				break;
+			case 'S':
+				star = true;
+				break;
+			case 'a':
+				all = true;
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind != argc || duration <= 0 || pollPeriod == 0 || budget <= 0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	FILE* out = 0;
+	FILE* uart = 0;
+	if (outPath && !(out = fopen(outPath, "wb")))
+	{
+		perror(outPath);
+		return 1;
+	}
+	if (uartPath && !(uart = fopen(uartPath, "wb")))
+	{
+		perror(uartPath);
+		return 1;
+	}
+
+	AvrMcu mcu;
+	Bno055Model bno(mcu, channels);
+	Nrf24Model nrf(mcu, pollPeriod, out);
+	nrf.setPoll(mode, nodeId, 0);
+	nrf.setStar(star);
+	mcu.attachTwi(&bno);
+	mcu.attachSpi(&nrf);
+	mcu.setUartOutput(uart);
+
+	if (!mcu.run(avrsim_firmware_main, (uint64_t)(duration * AVRSIM_CLOCK)))
+	{
+		fprintf(stderr, "firmware main() returned after %.3f s\n", mcu.timeUs() / 1e6);
+	}
+
+	printReport(mcu, nrf, bno, budget, all);
+
+	if (out)
+	{
+		fclose(out);
+	}
+	if (uart)
+	{
+		fclose(uart);
+	}
+	return 0;
+}
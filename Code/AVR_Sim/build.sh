@@ -0,0 +1,53 @@
+#!/bin/sh
+#
+# Builds the firmware for the host: avr_sim_node, avr_sim_glove and
+# avr_sim_glove_v2 in ./build. The firmware sources are compiled unchanged as
+# C++ against the register shim in include/ and instrumented for the per
+# function cycle counts. Extra flags for the firmware (e.g. -DF_CPU=8000000UL)
+# can be passed in FIRMWARE_FLAGS.
+#
+# usage: ./build.sh [node] [glove] [glove_v2]
+
+set -e
+cd "$(dirname "$0")"
+
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2 -g}
+BUILD=build
+
+# 'try' is a variable in twimaster.c (the C++ headers must not use it, hence
+# -fno-exceptions), main() is called by avr_sim.cpp
+FIRMWARE_CXXFLAGS="-x c++ -std=c++17 -Iinclude -Dtry=avrsim_try -Dmain=avrsim_firmware_main \
+	-fno-exceptions -finstrument-functions -Wno-write-strings -Wno-cpp $FIRMWARE_FLAGS"
+
+mkdir -p "$BUILD/sim"
+for src in AvrMcu AvrSim Bno055Model Nrf24Model avr_sim
+do
+	$CXX -std=c++17 $CXXFLAGS -Iinclude -c -o "$BUILD/sim/$src.o" "$src.cpp"
+done
+
+build()
+{
+	name=$1
+	dir=$2
+	mkdir -p "$BUILD/$name"
+	for src in "$dir"/*.c
+	do
+		obj=$(basename "$src" .c)
+		$CXX $CXXFLAGS $FIRMWARE_CXXFLAGS -c -o "$BUILD/$name/$obj.o" "$src"
+	done
+	# C merges tentative definitions in headers (TWI_data in the Node's BNO055.h), C++ does not
+	$CXX -rdynamic -Wl,--allow-multiple-definition -o "$BUILD/avr_sim_$name" "$BUILD"/sim/*.o "$BUILD/$name"/*.o -ldl
+	echo "$BUILD/avr_sim_$name"
+}
+
+targets=${*:-node glove glove_v2}
+for target in $targets
+do
+	case $target in
+		node)		build node ../Node/Node ;;
+		glove)		build glove ../Glove/Glove ;;
+		glove_v2)	build glove_v2 "../Glove v2/Glove" ;;
+		*)			echo "unknown target $target" >&2; exit 1 ;;
+	esac
+done
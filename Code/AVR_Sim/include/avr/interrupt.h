@@ -0,0 +1,20 @@
+/*
+ * avr/interrupt.h
+ *
+ * ISR(vector) defines a plain function avrsim_<vector>, the simulated MCU
+ * calls it when the interrupt is enabled and pending.
+ */
+
+
+#ifndef AVRSIM_AVR_INTERRUPT_H_
+#define AVRSIM_AVR_INTERRUPT_H_
+
+#include "../../AvrSim.h"
+
+
+#define sei()		avrsim_setInterruptsEnabled(true)
+#define cli()		avrsim_setInterruptsEnabled(false)
+
+#define ISR(vector, ...)	extern "C" void avrsim_##vector(void); extern "C" void avrsim_##vector(void)
+
+#endif /* AVRSIM_AVR_INTERRUPT_H_ */
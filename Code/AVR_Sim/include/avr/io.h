@@ -0,0 +1,128 @@
+/*
+ * avr/io.h
+ *
+ * Host replacement of the ATmega32U4 register definitions, see AvrSim.h.
+ * Only the registers used by the firmware are available.
+ */
+
+
+#ifndef AVRSIM_AVR_IO_H_
+#define AVRSIM_AVR_IO_H_
+
+#include <stdint.h>
+
+#include <avr/sfr_defs.h>
+
+#include "../../AvrSim.h"
+
+
+extern AvrReg8 PINB, DDRB, PORTB;
+extern AvrReg8 PINC, DDRC, PORTC;
+extern AvrReg8 PIND, DDRD, PORTD;
+extern AvrReg8 PINE, DDRE, PORTE;
+extern AvrReg8 PINF, DDRF, PORTF;
+
+extern AvrReg8 EIFR, EIMSK, EICRA, EICRB;
+
+extern AvrReg8 SPCR, SPSR, SPDR;
+
+extern AvrReg8 TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+extern AvrReg16 TCNT1, OCR1A, OCR1B, ICR1;
+
+extern AvrReg8 TWBR, TWSR, TWAR, TWDR, TWCR;
+
+extern AvrReg8 UCSR1A, UCSR1B, UCSR1C, UDR1;
+extern AvrReg16 UBRR1;
+
+
+// EIMSK, EIFR
+#define INT0	0
+#define INT1	1
+#define INT2	2
+#define INT3	3
+#define INT6	6
+#define INTF6	6
+
+// EICRB
+#define ISC60	4
+#define ISC61	5
+
+// SPCR
+#define SPR0	0
+#define SPR1	1
+#define CPHA	2
+#define CPOL	3
+#define MSTR	4
+#define DORD	5
+#define SPE		6
+#define SPIE	7
+
+// SPSR
+#define SPI2X	0
+#define WCOL	6
+#define SPIF	7
+
+// TCCR1A
+#define WGM10	0
+#define WGM11	1
+#define COM1A0	6
+#define COM1A1	7
+
+// TCCR1B
+#define CS10	0
+#define CS11	1
+#define CS12	2
+#define WGM12	3
+#define WGM13	4
+
+// TIMSK1, TIFR1
+#define TOIE1	0
+#define OCIE1A	1
+#define OCIE1B	2
+#define TOV1	0
+#define OCF1A	1
+#define OCF1B	2
+
+// TWSR
+#define TWPS0	0
+#define TWPS1	1
+
+// TWCR
+#define TWIE	0
+#define TWEN	2
+#define TWWC	3
+#define TWSTO	4
+#define TWSTA	5
+#define TWEA	6
+#define TWINT	7
+
+// UCSR1A
+#define MPCM1	0
+#define U2X1	1
+#define UPE1	2
+#define DOR1	3
+#define FE1		4
+#define UDRE1	5
+#define TXC1	6
+#define RXC1	7
+
+// UCSR1B
+#define TXB81	0
+#define RXB81	1
+#define UCSZ12	2
+#define TXEN1	3
+#define RXEN1	4
+#define UDRIE1	5
+#define TXCIE1	6
+#define RXCIE1	7
+
+// UCSR1C
+#define UCPOL1	0
+#define UCSZ10	1
+#define UCSZ11	2
+#define USBS1	3
+#define UPM10	4
+#define UPM11	5
+
+
+#endif /* AVRSIM_AVR_IO_H_ */
@@ -0,0 +1,25 @@
+/*
+ * avr/power.h
+ *
+ * The simulated MCU always runs at AVRSIM_CLOCK, the prescaler is ignored.
+ */
+
+
+#ifndef AVRSIM_AVR_POWER_H_
+#define AVRSIM_AVR_POWER_H_
+
+#include "../../AvrSim.h"
+
+typedef enum
+{
+	clock_div_1 = 0,
+	clock_div_2 = 1,
+	clock_div_4 = 2,
+	clock_div_8 = 3
+} clock_div_t;
+
+AVRSIM_NO_PROFILE static inline void clock_prescale_set(clock_div_t)
+{
+}
+
+#endif /* AVRSIM_AVR_POWER_H_ */
@@ -0,0 +1,17 @@
+/*
+ * avr/sfr_defs.h
+ */
+
+
+#ifndef AVRSIM_AVR_SFR_DEFS_H_
+#define AVRSIM_AVR_SFR_DEFS_H_
+
+#define _BV(bit)						(1 << (bit))
+
+#define bit_is_set(sfr, bit)			((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit)			(!((sfr) & _BV(bit)))
+
+#define loop_until_bit_is_set(sfr, bit)		do { } while (bit_is_clear(sfr, bit))
+#define loop_until_bit_is_clear(sfr, bit)	do { } while (bit_is_set(sfr, bit))
+
+#endif /* AVRSIM_AVR_SFR_DEFS_H_ */
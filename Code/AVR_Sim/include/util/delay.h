@@ -0,0 +1,33 @@
+/*
+ * util/delay.h
+ *
+ * Busy waits of avr-libc: the delay is converted to cycles with the F_CPU of the
+ * source file (like __builtin_avr_delay_cycles) and the simulated clock advances
+ * by that many cycles.
+ */
+
+
+#ifndef AVRSIM_UTIL_DELAY_H_
+#define AVRSIM_UTIL_DELAY_H_
+
+#include <math.h>
+
+#include "../../AvrSim.h"
+
+#ifndef F_CPU
+# warning "F_CPU not defined for <util/delay.h>"
+# define F_CPU 1000000UL
+#endif
+
+
+AVRSIM_NO_PROFILE static inline void _delay_us(double us)
+{
+	avrsim_delayCycles((uint32_t)ceil(us * (F_CPU / 1e6)));
+}
+
+AVRSIM_NO_PROFILE static inline void _delay_ms(double ms)
+{
+	avrsim_delayCycles((uint32_t)ceil(ms * (F_CPU / 1e3)));
+}
+
+#endif /* AVRSIM_UTIL_DELAY_H_ */
@@ -0,0 +1,21 @@
+/*
+ * util/setbaud.h
+ */
+
+
+#ifndef AVRSIM_UTIL_SETBAUD_H_
+#define AVRSIM_UTIL_SETBAUD_H_
+
+#ifndef F_CPU
+# error "setbaud.h requires F_CPU to be defined"
+#endif
+#ifndef BAUD
+# error "setbaud.h requires BAUD to be defined"
+#endif
+
+#define UBRR_VALUE		(((F_CPU) + 8UL * (BAUD)) / (16UL * (BAUD)) - 1UL)
+#define UBRRL_VALUE		(UBRR_VALUE & 0xff)
+#define UBRRH_VALUE		(UBRR_VALUE >> 8)
+#define USE_2X			0
+
+#endif /* AVRSIM_UTIL_SETBAUD_H_ */
@@ -0,0 +1,80 @@
+#include "LinkTelemetry.h"
+
+#include <string.h>
+
+
+
+static inline void count(uint16_t &counter, uint32_t n = 1)
+{
+	counter = counter + n < 0xFFFF ? counter + n : 0xFFFF;
+}
+
+static inline uint8_t* writeUInt16(uint8_t* data, uint16_t value)
+{
+	data[0] = value & 0xFF;
+	data[1] = value >> 8;
+	return data + 2;
+}
+
+
+LinkTelemetry::LinkTelemetry(uint8_t numNodes)
+	: numNodes(numNodes < TELEMETRY_MAX_NODES ? numNodes : TELEMETRY_MAX_NODES), frameCount(0)
+{
+	memset(counters, 0, sizeof(counters));
+}
+
+
+void LinkTelemetry::pollDone(uint8_t node, bool ack, uint8_t rxLen, uint32_t rtt_us)
+{
+	if (node >= numNodes)
+	{
+		return;
+	}
+	LinkCounters &c = counters[node];
+
+	count(c.polls);
+	if (!ack)
+	{
+		count(c.maxTry);
+	}
+	else if (rxLen > 0)
+	{
+		count(c.payloads);
+	}
+
+	uint32_t bin = rtt_us / TELEMETRY_RTT_BIN_US;
+	count(c.rtt[bin < TELEMETRY_RTT_BINS ? bin : TELEMETRY_RTT_BINS - 1]);
+	if (rtt_us > c.rttMax)
+	{
+		c.rttMax = rtt_us < 0xFFFF ? rtt_us : 0xFFFF;
+	}
+}
+
+void LinkTelemetry::writeFrame(uint8_t node, uint8_t deviceId, uint16_t period_ms, uint8_t* out)
+{
+	LinkCounters &c = counters[node < numNodes ? node : 0];
+
+	out[0] = 0xAB;
+	out[1] = 0xCD;
+	out[2] = node << 4 | (deviceId & 0x07);
+	out[3] = TELEMETRY_MODE << 5 | (frameCount & 0x03) << 2 | 0x01;
+	++frameCount;
+
+	uint8_t* data = out + 4;
+	data = writeUInt16(data, period_ms);
+	data = writeUInt16(data, c.polls);
+	data = writeUInt16(data, c.payloads);
+	data = writeUInt16(data, c.maxTry);
+	for (uint8_t i = 0; i < TELEMETRY_RTT_BINS; ++i)
+	{
+		data = writeUInt16(data, c.rtt[i]);
+	}
+	writeUInt16(data, c.rttMax);
+
+	memset(&c, 0, sizeof(c));
+}
+
+const LinkCounters& LinkTelemetry::getCounters(uint8_t node) const
+{
+	return counters[node < numNodes ? node : 0];
+}
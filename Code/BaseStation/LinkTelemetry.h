@@ -0,0 +1,58 @@
+#ifndef __LINK_TELEMETRY_H__
+#define __LINK_TELEMETRY_H__
+
+#include <stdint.h>
+
+
+// Telemetry frame of a node, sent between the data packets with the reserved mode 7
+// of the data descriptor (see GLOVE_MODE_TELEMETRY in Code/Cpp_Reader/GloveProtocol.h):
+// sync bytes, descriptor (node = index in NRF_address, its device, sample ID counting the
+// frames, packet ID 1), then TELEMETRY_LEN bytes, 16 bit little endian each:
+//   period (ms), polls, ack payloads, maxTry (polls without ack),
+//   poll round trips in TELEMETRY_RTT_BINS bins of TELEMETRY_RTT_BIN_US (the last one open),
+//   longest round trip (us)
+// The counts cover the period since the previous frame of the node and saturate at 65535.
+// There is no retry count: the polls go out without auto retransmit (setRetries(500, 0)) and
+// the slot scheduler does not repeat a missed poll.
+#define TELEMETRY_MODE			7
+#define TELEMETRY_RTT_BINS		8
+#define TELEMETRY_RTT_BIN_US	128
+#define TELEMETRY_LEN			(2 * (5 + TELEMETRY_RTT_BINS))
+#define TELEMETRY_FRAME_LEN		(4 + TELEMETRY_LEN)
+
+#define TELEMETRY_MAX_NODES		6
+
+
+struct LinkCounters
+{
+	uint16_t polls;
+	uint16_t payloads;
+	uint16_t maxTry;
+	uint16_t rtt[TELEMETRY_RTT_BINS];
+	uint16_t rttMax;
+};
+
+
+// Link quality counters of the poll loop, one set per node, written to the serial
+// stream as telemetry frames.
+class LinkTelemetry
+{
+public:
+	LinkTelemetry(uint8_t numNodes);
+
+	// a poll of the node ended: acknowledged or maxTry, length of the ack payload,
+	// time from submitTXData() to the end in us
+	void pollDone(uint8_t node, bool ack, uint8_t rxLen, uint32_t rtt_us);
+
+	// writes the frame of the node (TELEMETRY_FRAME_LEN bytes) and starts its next period
+	void writeFrame(uint8_t node, uint8_t deviceId, uint16_t period_ms, uint8_t* out);
+
+	const LinkCounters& getCounters(uint8_t node) const;
+
+private:
+	uint8_t numNodes;
+	uint8_t frameCount;
+	LinkCounters counters[TELEMETRY_MAX_NODES];
+};
+
+#endif /* __LINK_TELEMETRY_H__ */
@@ -1,9 +1,12 @@
 #include "Nrf24l01p.h"
 
+#include <string.h>
+
 
 
 Nrf24l01p::Nrf24l01p(PinName mosi, PinName miso, PinName sck, PinName ncsn, PinName nce)
-					: spi(mosi, miso, sck), csn(ncsn), ce(nce)
+					: spi(mosi, miso, sck), csn(ncsn), ce(nce), txState(TX_IDLE), txTime(0), txRXBuffer(NULL),
+			  txRXLen(0), txCallback(NULL), txContext(NULL), bulkTransfers(true)
 {
     SPI_Init();
 }
@@ -91,10 +94,23 @@ void Nrf24l01p::setModeTX(void)
 }
 
 void Nrf24l01p::writeTXData(uint8_t* data, uint8_t len, bool getAck)
+{
+    submitTXData(data, len, getAck);
+    
+    while (pollTX() < TX_DONE);
+}
+
+void Nrf24l01p::submitTXData(uint8_t* data, uint8_t len, bool getAck, uint8_t* rxBuffer, TXCallback callback, void* context)
 {
     flushTX();
     resetIRQFlags();
     
+    if (rxBuffer)
+    {
+    	// the ack payload of this transmission will be the only RX payload
+    	flushRX();
+    }
+    
     if (getAck)
     {
 	    //Transmit payload with ACK enabled
@@ -105,10 +121,65 @@ void Nrf24l01p::writeTXData(uint8_t* data, uint8_t len, bool getAck)
 		SPI_Write_Bytes(W_TX_PAYLOAD_NOACK, data, len);
 	}
     
-    // TODO: do not send data directly, call this outside the writeData method
-    startSending();
+    txRXBuffer = rxBuffer;
+    txRXLen = 0;
+    txCallback = callback;
+    txContext = context;
+    
+    // pollTX() sends like startSending()
+    txTime = us_ticker_read();
+    txState = TX_QUEUED;
+}
+
+Nrf24l01p::TXState Nrf24l01p::pollTX(void)
+{
+    if (txState == TX_QUEUED)
+    {
+    	//Need at least 10us before sending
+    	if (us_ticker_read() - txTime < 10)
+    	{
+    		return txState;
+    	}
+    	ce = 1;             //CE high
+    	txTime = us_ticker_read();
+    	txState = TX_STARTING;
+    }
+    
+    if (txState == TX_STARTING)
+    {
+    	//Hold CE high for at least 10us and not longer than 4ms
+    	if (us_ticker_read() - txTime < 11)
+    	{
+    		return txState;
+    	}
+    	ce = 0;             //CE low
+    	txState = TX_SENDING;
+    }
+    
+    if (txState != TX_SENDING)
+    {
+    	return txState;
+    }
+    
+    uint8_t status = getStatus();
+    if (!(status & ((1 << TX_DS) | (1 << MAX_RT))))
+    {
+    	return txState;
+    }
+    
+    txState = status & (1 << TX_DS) ? TX_DONE : TX_MAX_RETRIES;
+    
+    if (txRXBuffer && (status & (1 << RX_DR)))
+    {
+    	uint8_t pipe;
+    	readRXData(txRXBuffer, txRXLen, pipe);
+    }
     
-    while (isSending());
+    if (txCallback)
+    {
+    	txCallback(txState, txRXLen, txContext);
+    }
+    return txState;
 }
 
 void Nrf24l01p::writeAckData(uint8_t pipe, uint8_t* data, uint8_t len)
@@ -134,14 +205,17 @@ void Nrf24l01p::startSending(void)
 
 void Nrf24l01p::readRXData(uint8_t* data, uint8_t &len, uint8_t &pipe)
 {
-    if (RXFifoEmpty())
+    // STATUS (pipe number) and FIFO_STATUS in one transaction
+    uint8_t fifoStatus;
+    uint8_t status = SPI_Transfer(R_REGISTER + FIFO_STATUS, NULL, &fifoStatus, 1);
+    if (fifoStatus & (1 << RX_EMPTY))
     {
     	len = 0;
     	pipe = 0;
     	return;
     }
     
-    pipe = getRXPipeNumber();
+    pipe = (status >> RX_P_NO) & 0x07;
     
     if (hasDynamicPayloadLength(pipe))
     {
@@ -152,19 +226,26 @@ void Nrf24l01p::readRXData(uint8_t* data, uint8_t &len, uint8_t &pipe)
 		len = getPayloadLength(pipe);
 	}
     
-    //Pull down chip select
-    csn = 0;
-    
-    //Send command to read RX payload
-    spi.write(R_RX_PAYLOAD);
-    
-    for (uint8_t i = 0; i < len; ++i)
+    if (len > NRF_MAX_PAYLOAD_LEN)
     {
-    	data[i] = spi.write(0x00);
+    	// corrupted payload, the datasheet requires to flush it
+    	flushRX();
+    	len = 0;
+    	return;
     }
     
-    csn = 1;
-    wait_us(1);
+    readRXPayload(data, len);
+}
+
+void Nrf24l01p::readRXPayload(uint8_t* data, uint8_t len)
+{
+    //Send command to read RX payload
+    SPI_Transfer(R_RX_PAYLOAD, NULL, data, len);
+}
+
+void Nrf24l01p::setBulkTransfers(bool enabled)
+{
+    bulkTransfers = enabled;
 }
 
 uint8_t Nrf24l01p::getStatus(void)
@@ -443,19 +524,13 @@ void Nrf24l01p::closeRXPipe(uint8_t pipe)
 
 void Nrf24l01p::setTXAddress(const uint8_t* address, uint8_t addrLen)
 {
-    uint8_t i;
-    csn = 0;
-    
-    //Setup p0 pipe address for receiving
-    spi.write(W_REGISTER + TX_ADDR);
-    
     // write address, LSB first
-    for (i = addrLen; i > 0; --i)
+    uint8_t lsbFirst[5];
+    for (uint8_t i = 0; i < addrLen && i < 5; ++i)
     {
-        spi.write(address[i-1]);
+        lsbFirst[i] = address[addrLen - 1 - i];
     }
-    csn = 1;
-    wait_us(1);
+    SPI_Transfer(W_REGISTER + TX_ADDR, lsbFirst, NULL, addrLen < 5 ? addrLen : 5);
 }
 
 void Nrf24l01p::setRXAddress(uint8_t pipe, const uint8_t* address, uint8_t addrLen)
@@ -463,19 +538,14 @@ void Nrf24l01p::setRXAddress(uint8_t pipe, const uint8_t* address, uint8_t addrL
     // only pipes 0 and 1 are allowed full addresses, other pipes only have different LSB address
     if (pipe < 2)
     {
-	    uint8_t i;
-	    csn = 0;
-	    
-	    //Setup pipe address for receiving
-	    spi.write(W_REGISTER + RX_ADDR_P0 + pipe);
-	    
 	    // write address, LSB first
-	    for (i = addrLen; i > 0; --i)
+	    uint8_t lsbFirst[5];
+	    for (uint8_t i = 0; i < addrLen && i < 5; ++i)
 	    {
-	        spi.write(address[i-1]);
+	        lsbFirst[i] = address[addrLen - 1 - i];
 	    }
-	    csn = 1;
-    	wait_us(1);
+	    //Setup pipe address for receiving
+	    SPI_Transfer(W_REGISTER + RX_ADDR_P0 + pipe, lsbFirst, NULL, addrLen < 5 ? addrLen : 5);
     }
     else if (pipe < 6)
     {
@@ -729,51 +799,61 @@ void Nrf24l01p::SPI_Init(void)
 
 void Nrf24l01p::SPI_Write_Byte(uint8_t reg, uint8_t data)
 {
-    //wait_us(10);
-    csn = 0;            //CSN low
-    //wait_us(10);
-    spi.write(W_REGISTER + reg);
-    //wait_us(10);
-    spi.write(data);
-    //wait_us(10);
-    csn = 1;            //CSN high
-    wait_us(1);
+    SPI_Transfer(W_REGISTER + reg, &data, NULL, 1);
 }
 
 void Nrf24l01p::SPI_Write_Bytes(uint8_t reg, uint8_t* data, uint8_t len)
 {
-    //wait_us(10);
-    csn = 0;            //CSN low
-    //wait_us(10);
-    spi.write(reg);
-    //wait_us(10);
-    writePayload(data, len);
-    //wait_us(10);
-    csn = 1;            //CSN high
-    wait_us(1);
+    SPI_Transfer(reg, data, NULL, len);
 }
 
 uint8_t Nrf24l01p::SPI_Read_Byte(uint8_t reg)
 {
-    //wait_us(10);
-    csn = 0;            //CSN low
-    //wait_us(10);
-    spi.write(R_REGISTER + reg);
-    //wait_us(10);
-    reg = spi.write(NOP);
-    //wait_us(10);
-    csn = 1;            //CSN high
-    wait_us(1);
+    SPI_Transfer(R_REGISTER + reg, NULL, &reg, 1);
     return reg;
 }
 
-void Nrf24l01p::writePayload(uint8_t* data, uint8_t len)
+uint8_t Nrf24l01p::SPI_Transfer(uint8_t command, const uint8_t* tx, uint8_t* rx, uint8_t len)
 {
-    uint8_t i;
-    for (i = 0; i < len; i++)
+    char txBuffer[1 + NRF_MAX_PAYLOAD_LEN];
+    char rxBuffer[1 + NRF_MAX_PAYLOAD_LEN];
+    
+    if (len > NRF_MAX_PAYLOAD_LEN)
+    {
+    	len = NRF_MAX_PAYLOAD_LEN;
+    }
+    
+    txBuffer[0] = command;
+    if (tx)
+    {
+    	memcpy(txBuffer + 1, tx, len);
+    }
+    else
+    {
+    	memset(txBuffer + 1, NOP, len);
+    }
+    
+    csn = 0;            //CSN low
+    if (bulkTransfers)
+    {
+    	// one call for the whole transaction, the HAL keeps the SPI busy without per byte overhead
+    	spi.write(txBuffer, len + 1, rxBuffer, len + 1);
+    }
+    else
+    {
+    	for (uint8_t i = 0; i <= len; ++i)
+    	{
+    		rxBuffer[i] = spi.write(txBuffer[i]);
+    	}
+    }
+    csn = 1;            //CSN high
+    wait_us(1);
+    
+    if (rx)
     {
-    	spi.write(data[i]);
+    	memcpy(rx, rxBuffer + 1, len);
     }
+    return rxBuffer[0];
 }
 
 
@@ -5,8 +5,24 @@
 #include "mbed.h"
 #include "nrf.h"
 
+#define NRF_MAX_PAYLOAD_LEN     32
+
 class Nrf24l01p  {
 public:
+    // state of an asynchronous transmission (submitTXData), in this order
+    enum TXState
+    {
+        TX_IDLE,
+        TX_QUEUED,          // payload written, CE is set 10 us later
+        TX_STARTING,        // CE pulse in progress
+        TX_SENDING,         // waiting for TX_DS or MAX_RT
+        TX_DONE,            // sent (acknowledged if requested)
+        TX_MAX_RETRIES      // no acknowledge
+    };
+    
+    // called by pollTX() when a transmission ended: TX_DONE or TX_MAX_RETRIES, length of the ack payload read
+    typedef void (*TXCallback)(TXState state, uint8_t rxLen, void* context);
+    
     Nrf24l01p(PinName mosi, PinName miso, PinName sck, PinName ncsn, PinName nce);
     ~Nrf24l01p();
     
@@ -26,11 +42,26 @@ public:
     // TODO: maybe implement fast write method (just writing to the TX FIFO without sending directly)
     // bool writeTXDataFast(uint8_t* data, uint8_t len, bool getAck = true);
     
+    // Asynchronous variant of writeTXData: writes the payload and starts sending, pollTX() advances the
+    // transmission without blocking. If rxBuffer is set, the ack payload is read into it when done
+    // (at most 32 bytes). The IRQ flags are left set for getIRQStatus() like with writeTXData.
+    void submitTXData(uint8_t* data, uint8_t len, bool getAck = true, uint8_t* rxBuffer = NULL,
+                      TXCallback callback = NULL, void* context = NULL);
+    TXState pollTX(void);
+    TXState getTXState(void) const { return txState; }
+    // length of the ack payload read into rxBuffer (0 = none)
+    uint8_t getRXLength(void) const { return txRXLen; }
+    
     void writeAckData(uint8_t pipe, uint8_t* data, uint8_t len);
     
     void startSending(void);
     
     void readRXData(uint8_t* data, uint8_t &len, uint8_t &pipe);
+    // R_RX_PAYLOAD only, the caller knows the length (e.g. benchmark)
+    void readRXPayload(uint8_t* data, uint8_t len);
+    
+    // payloads and multi-byte registers in one SPI block transfer (default) or byte by byte
+    void setBulkTransfers(bool enabled);
     
     uint8_t getStatus(void);
     
@@ -121,13 +152,23 @@ private:
     DigitalOut  csn;
     DigitalOut  ce;
     
+    // asynchronous transmission
+    TXState     txState;
+    uint32_t    txTime;         // us ticker when the payload was written or CE was set
+    uint8_t*    txRXBuffer;
+    uint8_t     txRXLen;
+    TXCallback  txCallback;
+    void*       txContext;
+    
+    bool        bulkTransfers;
+    
     void SPI_Init(void);
     
     void SPI_Write_Byte(uint8_t reg, uint8_t data);
     void SPI_Write_Bytes(uint8_t reg, uint8_t* data, uint8_t len);
     uint8_t SPI_Read_Byte(uint8_t reg);
-
-    void writePayload(uint8_t* data, uint8_t len);
+    // command plus len data bytes (NOPs if tx is NULL) in one transaction, returns STATUS
+    uint8_t SPI_Transfer(uint8_t command, const uint8_t* tx, uint8_t* rx, uint8_t len);
 };
 
 #endif /* __NRF24L01P_H__ */
@@ -0,0 +1,82 @@
+#include "SerialQueue.h"
+
+#include <string.h>
+
+
+
+SerialQueue::SerialQueue()
+	: head(0), tail(0), length(0), committed(0)
+{
+	resetStats();
+}
+
+
+bool SerialQueue::push(const uint8_t* data, uint8_t len)
+{
+	if (len > SERIAL_QUEUE_SIZE - length)
+	{
+		stats.droppedBytes += len;
+		return false;
+	}
+
+	uint16_t first = SERIAL_QUEUE_SIZE - head;
+	if (first > len)
+	{
+		first = len;
+	}
+	memcpy(buffer + head, data, first);
+	memcpy(buffer, data + first, len - first);
+
+	head = (head + len) % SERIAL_QUEUE_SIZE;
+	length += len;
+	if (length > stats.highWater)
+	{
+		stats.highWater = length;
+	}
+	return true;
+}
+
+void SerialQueue::commit(void)
+{
+	committed = length;
+}
+
+
+uint16_t SerialQueue::peek(const uint8_t* &data) const
+{
+	data = buffer + tail;
+	uint16_t len = SERIAL_QUEUE_SIZE - tail;
+	return committed < len ? committed : len;
+}
+
+void SerialQueue::release(uint16_t len)
+{
+	if (len > committed)
+	{
+		len = committed;
+	}
+	tail = (tail + len) % SERIAL_QUEUE_SIZE;
+	length -= len;
+	committed -= len;
+
+	++stats.transfers;
+	stats.bytes += len;
+}
+
+
+uint16_t SerialQueue::getLength(void) const
+{
+	return length;
+}
+
+
+const SerialQueueStats& SerialQueue::getStats(void) const
+{
+	return stats;
+}
+
+void SerialQueue::resetStats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+	stats.highWater = length;
+}
@@ -0,0 +1,61 @@
+#ifndef __SERIAL_QUEUE_H__
+#define __SERIAL_QUEUE_H__
+
+#include <stdint.h>
+
+
+// A frame of the slot schedule returns at most 6 nodes * 4 slots * (32 + 4) = 864
+// bytes (32 byte payloads, 4 bytes receive time per packet 1, see RX_TIME_STAMPS in
+// main.cpp), once a second 6 * TELEMETRY_FRAME_LEN = 180 bytes of telemetry come on
+// top. The queue holds two such frames: one being sent and the next one. If the
+// serial port falls further behind, push() drops the payloads that don't fit and
+// counts them, the radio polling never stalls.
+#define SERIAL_QUEUE_SIZE		2560
+
+
+struct SerialQueueStats
+{
+	uint32_t transfers;			// serial writes started
+	uint32_t bytes;				// bytes sent
+	uint32_t droppedBytes;		// payloads that did not fit, the serial port fell behind
+	uint16_t highWater;			// most bytes queued at once
+};
+
+
+// Byte ring buffer between the radio and the serial port of the base station.
+// The ack payloads of a poll round are pushed as they arrive and committed at
+// the end of the round, then sent with one serial write (two if the committed
+// bytes wrap around the end of the buffer). A payload is never split: if it
+// does not fit, it is dropped and counted, the radio polling never waits for
+// the serial port.
+class SerialQueue
+{
+public:
+	SerialQueue();
+
+	// false if the payload was dropped
+	bool push(const uint8_t* data, uint8_t len);
+	// the bytes pushed so far may be sent
+	void commit(void);
+
+	// contiguous committed bytes at the start of the queue, 0 if none
+	uint16_t peek(const uint8_t* &data) const;
+	// len bytes returned by peek() were sent
+	void release(uint16_t len);
+
+	uint16_t getLength(void) const;
+
+	const SerialQueueStats& getStats(void) const;
+	void resetStats(void);
+
+private:
+	uint8_t buffer[SERIAL_QUEUE_SIZE];
+	uint16_t head;				// next byte to write
+	uint16_t tail;				// next byte to send
+	uint16_t length;			// bytes queued, including the ones being sent
+	uint16_t committed;			// bytes from tail that may be sent
+
+	SerialQueueStats stats;
+};
+
+#endif /* __SERIAL_QUEUE_H__ */
@@ -0,0 +1,144 @@
+#include "SlotScheduler.h"
+
+#include <string.h>
+
+
+
+SlotScheduler::SlotScheduler(uint8_t numNodes)
+	: numNodes(numNodes > SLOT_MAX_NODES ? SLOT_MAX_NODES : numNodes), frameLength(0), slotIndex(0)
+{
+	memset(slots, 1, sizeof(slots));
+	memset(failedFrames, 0, sizeof(failedFrames));
+	memset(skipFrames, 0, sizeof(skipFrames));
+	memset(acked, 0, sizeof(acked));
+	resetStats();
+}
+
+
+void SlotScheduler::setSlots(uint8_t node, uint8_t count)
+{
+	if (node < numNodes)
+	{
+		slots[node] = count > 4 ? 4 : count;
+	}
+}
+
+uint8_t SlotScheduler::getSlots(uint8_t node) const
+{
+	return node < numNodes ? slots[node] : 0;
+}
+
+
+uint32_t SlotScheduler::startFrame(void)
+{
+	endFrame();
+
+	// interleave the nodes (A B A B A ...) so the slots of one node are spread over the frame,
+	// which gives it time to write its next ack payload
+	frameLength = 0;
+	for (uint8_t round = 0; round < 4; ++round)
+	{
+		for (uint8_t node = 0; node < numNodes; ++node)
+		{
+			if (skipFrames[node] == 0 && round < slots[node])
+			{
+				frame[frameLength++] = node;
+			}
+		}
+	}
+
+	for (uint8_t node = 0; node < numNodes; ++node)
+	{
+		if (skipFrames[node] > 0)
+		{
+			--skipFrames[node];
+			++stats[node].skippedFrames;
+		}
+	}
+
+	// all nodes backed off: one idle slot
+	slotIndex = 0;
+	return frameLength > 0 ? (uint32_t)frameLength * SLOT_US : SLOT_US;
+}
+
+bool SlotScheduler::nextSlot(uint8_t &node, uint32_t &start_us)
+{
+	if (slotIndex >= frameLength)
+	{
+		return false;
+	}
+	node = frame[slotIndex];
+	start_us = (uint32_t)slotIndex * SLOT_US;
+	return true;
+}
+
+void SlotScheduler::slotDone(bool ack, bool payload)
+{
+	if (slotIndex >= frameLength)
+	{
+		return;
+	}
+	uint8_t node = frame[slotIndex++];
+
+	++stats[node].slots;
+	if (payload)
+	{
+		++stats[node].hits;
+	}
+	if (ack)
+	{
+		acked[node] = true;
+	}
+	else
+	{
+		++stats[node].noAck;
+	}
+}
+
+void SlotScheduler::endFrame(void)
+{
+	// nodes that were polled in the last frame and never acknowledged are skipped for 2^n - 1 frames
+	bool polled[SLOT_MAX_NODES] = {};
+	for (uint8_t i = 0; i < slotIndex; ++i)
+	{
+		polled[frame[i]] = true;
+	}
+
+	for (uint8_t node = 0; node < numNodes; ++node)
+	{
+		if (!polled[node])
+		{
+			continue;
+		}
+		if (acked[node])
+		{
+			failedFrames[node] = 0;
+		}
+		else
+		{
+			if (failedFrames[node] < SLOT_MAX_BACKOFF)
+			{
+				++failedFrames[node];
+			}
+			skipFrames[node] = (1 << failedFrames[node]) - 1;
+		}
+		acked[node] = false;
+	}
+}
+
+
+const SlotStats& SlotScheduler::getStats(uint8_t node) const
+{
+	return stats[node < numNodes ? node : 0];
+}
+
+uint8_t SlotScheduler::getHitRate(uint8_t node) const
+{
+	const SlotStats &s = getStats(node);
+	return s.slots ? (uint8_t)(100 * (uint64_t)s.hits / s.slots) : 0;
+}
+
+void SlotScheduler::resetStats(void)
+{
+	memset(stats, 0, sizeof(stats));
+}
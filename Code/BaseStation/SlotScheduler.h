@@ -0,0 +1,75 @@
+#ifndef __SLOT_SCHEDULER_H__
+#define __SLOT_SCHEDULER_H__
+
+#include <stdint.h>
+
+
+// One slot is one poll without retransmission: 130 us TX settling, the poll,
+// 130 us turnaround and an ack with up to 32 bytes payload at 1 Mbps, plus SPI
+// and serial overhead. An unanswered poll ends with MAX_RT within the slot as
+// long as the retransmit delay is 500 us and the retry count 0.
+#define SLOT_US					800
+
+// a node that did not acknowledge any of its slots is skipped for 1, 3, 7, ...
+// frames, at most 2^SLOT_MAX_BACKOFF - 1
+#define SLOT_MAX_BACKOFF		4
+
+#define SLOT_MAX_NODES			6
+
+
+struct SlotStats
+{
+	uint32_t slots;				// slots given to the node
+	uint32_t hits;				// slots that returned an ack payload
+	uint32_t noAck;				// slots without acknowledge (MAX_RT)
+	uint32_t skippedFrames;		// frames the node was backed off
+};
+
+
+// Deterministic TDMA poll schedule of the base station. A frame consists of
+// consecutive slots of SLOT_US, each node gets as many slots as ack payloads it
+// sends per sample. A missed slot is not repeated, the node simply gets its
+// next slot. Nodes that do not acknowledge a whole frame are backed off.
+class SlotScheduler
+{
+public:
+	SlotScheduler(uint8_t numNodes);
+
+	// ack payloads the node sends per sample (0 = do not poll)
+	void setSlots(uint8_t node, uint8_t slots);
+	uint8_t getSlots(uint8_t node) const;
+
+	// start the next frame, returns its length in us (at least one slot)
+	uint32_t startFrame(void);
+
+	// node and start time (us since startFrame()) of the next slot, false at the end of the frame
+	bool nextSlot(uint8_t &node, uint32_t &start_us);
+
+	// result of the slot returned by nextSlot()
+	void slotDone(bool ack, bool payload);
+
+	const SlotStats& getStats(uint8_t node) const;
+	// payloads per slot in percent
+	uint8_t getHitRate(uint8_t node) const;
+	void resetStats(void);
+
+private:
+	uint8_t numNodes;
+	uint8_t slots[SLOT_MAX_NODES];
+
+	// backoff
+	uint8_t failedFrames[SLOT_MAX_NODES];		// consecutive frames without acknowledge
+	uint8_t skipFrames[SLOT_MAX_NODES];			// frames left to skip
+	bool acked[SLOT_MAX_NODES];					// in the current frame
+
+	// current frame: nodes in slot order
+	uint8_t frame[SLOT_MAX_NODES * 4];
+	uint8_t frameLength;
+	uint8_t slotIndex;
+
+	SlotStats stats[SLOT_MAX_NODES];
+
+	void endFrame(void);
+};
+
+#endif /* __SLOT_SCHEDULER_H__ */
@@ -1,4 +1,28 @@
 #include "Nrf24l01p.h"
+#include "SlotScheduler.h"
+#include "SerialQueue.h"
+#include "LinkTelemetry.h"
+
+/* Host link: 0 = UART through the ST-Link virtual COM port (500000 baud, about 50 kB/s),
+ * 1 = native USB CDC of the STM32F411 (full speed, 64 byte bulk packets). USB needs the
+ * USBDevice library (USBDevice.lib, `mbed deploy` puts it into USBDevice/ where the Keil
+ * project expects it) and a USB connector on PA11 (D-) and PA12 (D+), the host finds the
+ * base station by HOST_USB_VID/HOST_USB_PID (see Code/Cpp_Reader/SerialPort.h). */
+#define HOST_LINK_USB		0
+#define HOST_USB_VID		0x1f00
+#define HOST_USB_PID		0x2012
+#define HOST_USB_PACKET_LEN	64
+
+#if HOST_LINK_USB
+#include "USBSerial.h"
+#endif
+
+/* Radio topology: 0 = the base station polls the nodes one after another (PTX, TDMA slots, the
+ * data comes back as ack payloads), 1 = star: every node sends on its own schedule (PTX) to its own
+ * RX pipe of the base station (PRX), which only drains its RX FIFO and tags each payload with the
+ * pipe it arrived on. Saves the poll round trip per packet. The nodes need RADIO_STAR in their
+ * config.h (Code/Node, Code/Glove v2) as well, their pipe is NODE_ID - 1. */
+#define RADIO_STAR			0
 
 #define PAYLOAD_MAX_LEN		32
 #define PAYLOAD_LEN 		10
@@ -10,19 +34,56 @@
 /* Change it new Nodes or Sub-nodes are made. */
 #define TOTAL_NODES_AND_SUBNODES 2
 
-uint8_t BS_payload_TX[PAYLOAD_LEN] = {0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+/* Device types, see DEVICE_ID in config.h of the node firmware */
+#define DEVICE_NODE			0x00
+#define DEVICE_GLOVE_V1		0x01
+#define DEVICE_GLOVE_V2		0x02
+
+/* Modes, sent as the poll payload (nodes that do not support a mode keep their current one) */
+#define MODE_QUAT			0x00	// quaternion
+#define MODE_QUAT_LINACC	0x01	// quaternion + linear acceleration
+#define MODE_QUAT_S3		0x02	// smallest three quaternion, 10 bit (gloves only)
+#define MODE_QUAT_S3_FINE	0x03	// smallest three quaternion, 12 bit (gloves only)
+#define MODE_QUAT_LINACC_S3	0x04	// smallest three quaternion, 10 bit + linear acceleration (gloves only)
+#define MODE_QUAT_DELTA		0x05	// quaternion as prediction residuals of variable length (gloves only)
+#define MODE_COUNT			6
+
+/* Receive time: packet 1 of a sample (it starts with the sync bytes) is forwarded with the time the base
+ * station received it, us_ticker_read() in us as 4 bytes LSB first after the data descriptor, flagged by
+ * bit 4 of the descriptor's second byte. The host relates it to the tick of the node and to its own clock
+ * (see Code/Cpp_Reader/GloveClock.h). 0 = forward the payloads unchanged */
+#define RX_TIME_STAMPS		1
+#define RX_TIME_LEN			4
+
+/* Send a telemetry frame per node every n ms in the poll loop: polls, ack payloads, maxTry and the
+ * poll round trips (see LinkTelemetry.h), decoded by the host next to the samples. 0 = off */
+#define TELEMETRY_PERIOD_MS	1000
+
+/* Print the slot hit rates every n frames instead of streaming data (debugging only, 0 = off) */
+#define SLOT_REPORT_FRAMES	0
+
+/* Print the time of a 32 byte payload read, byte by byte and as one SPI block, n reads each (debugging only, 0 = off) */
+#define NRF_SPI_BENCHMARK	0
+
+uint8_t BS_payload_TX[PAYLOAD_LEN] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x00, 0x00, 0x00, 0x00};
 
-uint8_t RX_buffer_1[PAYLOAD_MAX_LEN];
-uint8_t RX_buffer_2[PAYLOAD_MAX_LEN];
+/* The ack payload is read into RX_buffer and queued for the serial port, one write per poll round */
+uint8_t RX_buffer[PAYLOAD_MAX_LEN];
+SerialQueue serialQueue;
+uint16_t serialSending = 0;				// bytes of the queue the running serial write (USB: bulk packet) sends
+volatile bool serialTXDone = false;
 
 uint8_t Serial_RX_buffer[10] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 volatile uint8_t RX_done = 0;
 
 /* add more address for nRF_Nodes and NRF_address  if more than 6 device available.
  * make sure change value for TOTAL_NODES_AND_SUBNODES, to connect to the max number of devices.
+ * nRF_Node_Device needs an entry per node too: the device assumed until the node's first payload
+ * tells it (see updateNodeDevice()), it sets the node's slots per frame (packetsPerSample()).
 */
 
 uint8_t nRF_Nodes[NRF_TOTAL_NODES] = {0x01,0x02,0x03,0x04,0x05,0x06};   // Address of the Main Nodes connected to the Base station
+uint8_t nRF_Node_Device[NRF_TOTAL_NODES] = {DEVICE_GLOVE_V1, DEVICE_GLOVE_V1, DEVICE_GLOVE_V1, DEVICE_GLOVE_V1, DEVICE_GLOVE_V1, DEVICE_GLOVE_V1};
 uint8_t NRF_address[NRF_TOTAL_NODES][NRF_ADDR_LEN] = {   				// Address of Sub Nodes connected to the Main Nodes
     												 {0x11, 0x12, 0x13, 0x14, 0x15},
     												 {0x21, 0x22, 0x23, 0x24, 0x25},
@@ -32,13 +93,20 @@ uint8_t NRF_address[NRF_TOTAL_NODES][NRF_ADDR_LEN] = {   				// Address of Sub N
     												 {0x61, 0x62, 0x63, 0x64, 0x65}
     												 };
 
+/* Star topology: address of RX pipe 0, pipe n adds n to the last byte (pipes 2 - 5 share the
+ * first four bytes with pipe 1). Must match BS_star_address of the node firmware. */
+uint8_t STAR_address[NRF_ADDR_LEN] = {0xBA, 0x5E, 0x57, 0xA2, 0xC1};
+
 
 Nrf24l01p nrf(D11, D12, D13, D4, D5); 	// Create an object for the NRF24L01Plus class
 Serial pc(SERIAL_TX, SERIAL_RX);		// Serial connection
+#if HOST_LINK_USB
+USBSerial usb(HOST_USB_VID, HOST_USB_PID, 0x0001, false);	// do not wait for the host in the constructor
+#endif
 
 // Ticker flipper; 						// Ticker for mode transmission to other node if no packet received
 InterruptIn nrf_irq(D6);				// Pin in Nrf24l01p for Interrupt
-volatile uint8_t mode = 0; 					// 0 - Quaternion; 1 - Quaternion + linear acceleration
+volatile uint8_t mode = 0; 					// MODE_QUAT ... MODE_QUAT_DELTA, the user button switches to the next
 volatile uint8_t nRF_Node; 				// Node number
 volatile uint8_t serialrun = 1;
 volatile uint8_t serial_rx_Payload_cnt = 0;
@@ -48,6 +116,12 @@ InterruptIn button(USER_BUTTON);
 
 Timer t;
 
+// TDMA poll schedule: every node gets one slot per ack payload it sends per sample
+SlotScheduler scheduler(TOTAL_NODES_AND_SUBNODES);
+
+// link quality counters of the poll loop
+LinkTelemetry telemetry(TOTAL_NODES_AND_SUBNODES);
+
 
 
 /************************************************************************************
@@ -106,22 +180,245 @@ void onSerialRXDone()
 
 void onSerialTXDone(int event)
 {
+	serialTXDone = true;
+}
+
+event_callback_t serialCallbackTX = &onSerialTXDone;
+
+// send the committed ack payloads via serial port without waiting for it
+void serviceSerial()
+{
+#if HOST_LINK_USB
+	// one bulk packet at a time without waiting for it, the bytes stay in the queue until the
+	// host has taken them. While nobody reads the endpoint (no terminal on the host, DTR) the
+	// polling goes on and the queue drops instead
+	if (serialSending)
+	{
+		if (usb.endpointWriteResult(EPBULK_IN) == EP_PENDING && usb.connected())
+		{
+			return;
+		}
+		// sent, or the host went away and the packet never completes
+		serialQueue.release(serialSending);
+		serialSending = 0;
+	}
+
+	const uint8_t* data;
+	uint16_t len = serialQueue.peek(data);
+	if (len > 0 && usb.connected())
+	{
+		if (len > HOST_USB_PACKET_LEN)
+		{
+			len = HOST_USB_PACKET_LEN;
+		}
+		if (usb.writeNB(EPBULK_IN, (uint8_t*)data, len, MAX_PACKET_SIZE_EPBULK))
+		{
+			serialSending = len;
+		}
+	}
+#else
+	if (serialSending)
+	{
+		if (!serialTXDone)
+		{
+			return;
+		}
+		serialQueue.release(serialSending);
+		serialSending = 0;
+	}
+	
+	const uint8_t* data;
+	uint16_t len = serialQueue.peek(data);
+	if (len > 0)
+	{
+		serialTXDone = false;
+		if (pc.write(data, len, serialCallbackTX) == 0)
+		{
+			serialSending = len;
+		}
+	}
+#endif
 }
 
 void Button_Interrupt() 
 {
     wait_ms(50);    //Delay for switch debounce
     //button.disable_irq();
-    if (mode == 0)
+    if (mode + 1 < MODE_COUNT)
     {
-    	mode = 1;
+    	mode = mode + 1;
     }
     else
     {
-    	mode = 0;
+    	mode = MODE_QUAT;
     }
 }
 
+// ack payloads a node sends per sample, i.e. slots it needs per frame
+uint8_t packetsPerSample(uint8_t device, uint8_t mode)
+{
+	// quaternions: 2 packets, quaternions + linear acceleration: 3 packets; smallest three
+	// (process_quat_s3() of the Glove v2 firmware, 6 or 7 IMUs): 10 bit 1 packet, 12 bit 2 packets,
+	// 10 bit + linear acceleration 3 packets; delta (process_quat_delta()): at most 2 packets
+	static const uint8_t glovePackets[MODE_COUNT] = {2, 3, 1, 2, 3, 2};
+	
+	switch (device)
+	{
+		case DEVICE_GLOVE_V1:
+		case DEVICE_GLOVE_V2:
+			return mode < MODE_COUNT ? glovePackets[mode] : 3;
+		default:
+			return 1;
+	}
+}
+
+#if NRF_SPI_BENCHMARK
+void benchmarkSPI()
+{
+	uint8_t payload[PAYLOAD_MAX_LEN];
+	Timer bench;
+	
+	for (uint8_t bulk = 0; bulk < 2; ++bulk)
+	{
+		nrf.setBulkTransfers(bulk);
+		bench.reset();
+		bench.start();
+		for (uint32_t i = 0; i < NRF_SPI_BENCHMARK; ++i)
+		{
+			// the RX FIFO is empty, the nRF clocks out zeros, the SPI timing is the same
+			nrf.readRXPayload(payload, PAYLOAD_MAX_LEN);
+		}
+		bench.stop();
+		pc.printf("nRF SPI %s: %lu us per 32 byte read\n", bulk ? "block" : "byte by byte",
+				  (uint32_t)(bench.read_us() / NRF_SPI_BENCHMARK));
+	}
+	nrf.setBulkTransfers(true);
+}
+#endif
+
+// offset of the data descriptor in a payload: packet 1 starts with the sync bytes
+uint8_t descriptorOffset(const uint8_t* data, uint8_t len)
+{
+	return len >= 4 && data[0] == 0xAB && data[1] == 0xCD ? 2 : 0;
+}
+
+// Device of a node from its payloads: packet 1 of a glove (and of a single node in the star topology)
+// carries it in the data descriptor after the sync bytes, the payload of a single node in the poll
+// loop is [NODE_ID, 0x01, sample] (Code/Node), packets 2 and 3 of a glove have packet ID 2 or 3 there.
+// Its slots follow from the next frame on.
+void updateNodeDevice(uint8_t node, const uint8_t* data, uint8_t len)
+{
+	if (descriptorOffset(data, len) == 2)
+	{
+		if ((data[2] & 0x07) <= DEVICE_GLOVE_V2)
+		{
+			nRF_Node_Device[node] = data[2] & 0x07;
+		}
+	}
+	else if (len >= 2 && data[1] == 0x01)
+	{
+		nRF_Node_Device[node] = DEVICE_NODE;
+	}
+}
+
+// queues a payload of RX_buffer for the serial port, packet 1 with its receive time (see RX_TIME_STAMPS)
+void queuePayload(uint8_t len, uint32_t rxTime)
+{
+#if RX_TIME_STAMPS
+	if (descriptorOffset(RX_buffer, len) == 2 && !(RX_buffer[3] & 0x10))
+	{
+		uint8_t stamped[PAYLOAD_MAX_LEN + RX_TIME_LEN];
+		for (uint8_t i = 0; i < 4; ++i)
+		{
+			stamped[i] = RX_buffer[i];
+		}
+		stamped[3] |= 0x10;
+		for (uint8_t i = 0; i < RX_TIME_LEN; ++i)
+		{
+			stamped[4 + i] = (uint8_t)(rxTime >> (8 * i));
+		}
+		for (uint8_t i = 4; i < len; ++i)
+		{
+			stamped[RX_TIME_LEN + i] = RX_buffer[i];
+		}
+		// dropped if the serial port fell behind, counted in the queue statistics
+		serialQueue.push(stamped, len + RX_TIME_LEN);
+		return;
+	}
+#endif
+	serialQueue.push(RX_buffer, len);
+}
+
+#if RADIO_STAR
+// Star topology: the nodes send on their own, the base station only drains its RX FIFO. Mode
+// changes go back with the acks: a pipe whose last packet had another mode gets an ack payload
+// [mode], which the node receives with the ack of its next packet.
+void runStar()
+{
+	uint8_t address[NRF_ADDR_LEN];
+	for (uint8_t pipe = 0; pipe < NRF_TOTAL_NODES; ++pipe)
+	{
+		for (uint8_t i = 0; i < NRF_ADDR_LEN; ++i)
+		{
+			address[i] = STAR_address[i];
+		}
+		address[NRF_ADDR_LEN - 1] += pipe;
+		nrf.openDynamicRXPipe(pipe, address, true, false);
+	}
+	
+	nrf.setModeRX();
+	nrf.flushRX();
+	nrf.flushTX();
+	nrf.resetIRQFlags();
+	nrf.startListening();
+	
+	uint8_t ackMode = mode;
+	uint8_t ackQueued = 0;				// pipes with an ack payload in the TX FIFO (bit = pipe)
+	uint8_t rxLen;
+	uint8_t pipe;
+	
+	while (1)
+	{
+		if (ackMode != mode)
+		{
+			// entries of nodes that stopped sending would block the 3 entry TX FIFO, start over
+			ackMode = mode;
+			ackQueued = 0;
+			nrf.flushTX();
+		}
+		
+		nrf.readRXData(RX_buffer, rxLen, pipe);
+		uint32_t rxTime = us_ticker_read();
+		if (rxLen == 0)
+		{
+			// RX FIFO drained, the payloads so far go out with one serial write
+			serialQueue.commit();
+			serviceSerial();
+			continue;
+		}
+		
+		// the ack of this payload carried the ack payload queued for its pipe (if any)
+		ackQueued &= ~(1 << pipe);
+		
+		// the pipe identifies the node, it replaces the node ID of the data descriptor
+		uint8_t offset = descriptorOffset(RX_buffer, rxLen);
+		if (rxLen >= offset + 2)
+		{
+			RX_buffer[offset] = (pipe << 4) | (RX_buffer[offset] & 0x0F);
+			
+			// nodes that do not support a mode keep theirs and get it again with every packet
+			if ((RX_buffer[offset + 1] >> 5) != ackMode && !(ackQueued & (1 << pipe)) && !nrf.TXFifoFull())
+			{
+				nrf.writeAckData(pipe, BS_payload_TX + ackMode, 1);
+				ackQueued |= 1 << pipe;
+			}
+		}
+		
+		queuePayload(rxLen, rxTime);
+	}
+}
+#endif
+
 /**************************************************************
 **                       MAIN
 ***************************************************************/
@@ -135,11 +432,12 @@ int main()
 	//pc.attach(&onSerialRXDone, Serial::RxIrq);
 	//pc.enable_input();
 	
-	mode = 0;							// default: Quaternion only mode
+	mode = MODE_QUAT;					// default: Quaternion only mode
     nRF_Node = 0; 						// Initialize the node number
     
 	nrf.init(0x69, DR_1M, NRF_ADDR_LEN, 1);
-	nrf.setRetries(500, 1);
+	// no retransmission, a missed slot is not repeated (see SlotScheduler.h)
+	nrf.setRetries(500, 0);
 	
 	//nrf.openTXPipe(NRF_address[nRF_Node], PAYLOAD_QUAT_LEN, true, false);
 	nrf.openDynamicTXPipe(NRF_address[nRF_Node], true, false);
@@ -155,6 +453,10 @@ int main()
     nrf.flushTX();
     nrf.resetIRQFlags();
 	
+#if NRF_SPI_BENCHMARK
+	benchmarkSPI();
+#endif
+	
     //nrf_irq.fall(&onDataReceived);    	// Attach the address of the nRF IRQ Interrupt function to the falling edge
     
     
@@ -162,15 +464,15 @@ int main()
     button.fall(&Button_Interrupt); 
     button.enable_irq();
     
+#if RADIO_STAR
+    runStar();
+#endif
+    
     
-    bool rx, txDone, maxTry;
     uint8_t numRetries = 0;
     
     uint8_t rxLen = 0;
     
-    uint8_t* currentBuffer = RX_buffer_1;
-    
-    event_callback_t serialCallbackTX = &onSerialTXDone;
     //event_callback_t serialCallbackRX = &onSerialRXDone;
     
     // prevent mbed from going into deep sleep
@@ -180,7 +482,14 @@ int main()
 	uint8_t buffer[10];
 	uint8_t serialRXLen = 0;
 	
-	//t.start();
+	uint32_t frames = 0;
+	uint32_t frameEnd;
+	uint32_t slotStart;
+	uint8_t slotNode;
+	
+	frameEnd = scheduler.startFrame();
+	t.start();
+	uint32_t telemetryStart = us_ticker_read();
 	
     while (1)
     {
@@ -218,85 +527,98 @@ int main()
         continue;
         */
         
-        // TODO: set request data, replace BS_payload_TX (only 1 byte should be sufficient)
-        
-        nrf.writeTXData(BS_payload_TX + mode, 1);
-        
-        // get status and reset interrupt flags
-        nrf.getIRQStatus(rx, txDone, maxTry);
-    	nrf.resetIRQFlags();
+        // next slot, a new frame starts when all slots are done
+        if (!scheduler.nextSlot(slotNode, slotStart))
+        {
+        	for (uint8_t i = 0; i < TOTAL_NODES_AND_SUBNODES; ++i)
+        	{
+        		scheduler.setSlots(i, packetsPerSample(nRF_Node_Device[i], mode));
+        	}
+        	
+        	++frames;
+#if SLOT_REPORT_FRAMES
+        	if (frames % SLOT_REPORT_FRAMES == 0)
+        	{
+        		for (uint8_t i = 0; i < TOTAL_NODES_AND_SUBNODES; ++i)
+        		{
+        			const SlotStats &stats = scheduler.getStats(i);
+        			pc.printf("node %i: slots %lu, hit %i %%, no ack %lu, skipped frames %lu\n", i, stats.slots,
+        					  scheduler.getHitRate(i), stats.noAck, stats.skippedFrames);
+        		}
+        		const SerialQueueStats &serialStats = serialQueue.getStats();
+        		pc.printf("serial: %lu writes, %lu bytes, high water %u of %u bytes, dropped %lu bytes\n",
+        				  serialStats.transfers, serialStats.bytes, serialStats.highWater, SERIAL_QUEUE_SIZE,
+        				  serialStats.droppedBytes);
+        	}
+#endif
+#if TELEMETRY_PERIOD_MS
+        	uint32_t telemetryTime = us_ticker_read() - telemetryStart;
+        	if (telemetryTime >= TELEMETRY_PERIOD_MS * 1000UL)
+        	{
+        		telemetryStart += telemetryTime;
+        		uint8_t frame[TELEMETRY_FRAME_LEN];
+        		for (uint8_t i = 0; i < TOTAL_NODES_AND_SUBNODES; ++i)
+        		{
+        			telemetry.writeFrame(i, nRF_Node_Device[i], telemetryTime / 1000, frame);
+        			serialQueue.push(frame, TELEMETRY_FRAME_LEN);
+        		}
+        	}
+#endif
+        	// the payloads of the round go out with one serial write
+        	serialQueue.commit();
+        	serviceSerial();
+        	
+        	// wait for the end of the last slot
+        	while (t.read_us() < (int)frameEnd)
+        	{
+        		serviceSerial();
+        	}
+        	frameEnd = scheduler.startFrame();
+        	t.reset();
+        	continue;
+        }
         
-        rxLen = 0;
+        // slots start at fixed times, a poll that ended early leaves the rest of its slot unused
+        while (t.read_us() < (int)slotStart)
+        {
+        	serviceSerial();
+        }
         
-        if (rx)
+        if (slotNode != nRF_Node)
         {
-        	uint8_t pipe;
-			
-			while (nrf.dataAvailable())
-			{
-				nrf.readRXData(currentBuffer, rxLen, pipe);
-				
-	        	//pc.printf("recv, rt: %i, len: %i, t_d: %i, t: %i, id: %i\n", numRetries, rxLen, currentBuffer[0], time, currentBuffer[1]);
-	        	
-	        	if (rxLen > 0)
-	        	{
-		        	while (pc.write(currentBuffer, rxLen, serialCallbackTX))
-		        	{
-		        		wait_us(1);
-		        	}
-		        	
-		        	// change buffer to not accidentially ovwerwrite data while sending via serial port in parallel
-		        	if (currentBuffer == RX_buffer_1)
-		        	{
-		        		currentBuffer = RX_buffer_2;
-		        	}
-		        	else
-		        	{
-		        		currentBuffer = RX_buffer_1;
-		        	}
-				}
-			}
-		}
-		
-		if ((txDone && rxLen == 0) || maxTry)
-		{
-			/*
-			if (maxTry)
-			{
-        		numRetries = nrf.getRetryCount();
-        		pc.printf("mrt, rt: %i\n", numRetries);
-			}
-			*/
-			// debug
-        	// uncomment for debugging
-        	/*
-        	int time = t.read_ms();
-        	t.stop();
-        	t.reset();
-            t.start();
-        	
-			if (maxTry)
-			{
-        		numRetries = nrf.getRetryCount();
-        		pc.printf("mrt, rt: %i, t: %i\n", numRetries, time);
-			}
-			else
-			{
-				pc.printf("done in %i\n", time);
-			}
-			*/
-			
-			// select next node
-        	nRF_Node++;
-	    	if (nRF_Node >= TOTAL_NODES_AND_SUBNODES)
-	    	{
-	    		nRF_Node = 0;
-	        }
-	    	// select the node to talk
+        	// select the node to talk
+        	nRF_Node = slotNode;
 	    	nrf.setTXAddress(NRF_address[nRF_Node], NRF_ADDR_LEN);
 	    	nrf.setRXAddress(0, NRF_address[nRF_Node], NRF_ADDR_LEN);
-	    	continue;
-		}
+        }
+        
+        // TODO: set request data, replace BS_payload_TX (only 1 byte should be sufficient)
+        
+        // the poll is sent in the background, meanwhile the previous payloads go to the serial port
+        int pollStart = t.read_us();
+        nrf.submitTXData(BS_payload_TX + mode, 1, true, RX_buffer);
+        
+        Nrf24l01p::TXState state;
+        while ((state = nrf.pollTX()) < Nrf24l01p::TX_DONE)
+        {
+        	serviceSerial();
+        }
+        uint32_t rxTime = us_ticker_read();
+        int pollEnd = t.read_us();
+        nrf.resetIRQFlags();
+        
+        rxLen = nrf.getRXLength();
+#if TELEMETRY_PERIOD_MS
+        telemetry.pollDone(nRF_Node, state == Nrf24l01p::TX_DONE, rxLen, pollEnd - pollStart);
+#endif
+        if (rxLen > 0)
+        {
+        	updateNodeDevice(nRF_Node, RX_buffer, rxLen);
+        	queuePayload(rxLen, rxTime);
+        }
+        
+		// a miss (empty ack or no ack) is not retried, the node gets its next slot
+		scheduler.slotDone(state == Nrf24l01p::TX_DONE, rxLen > 0);
     }
 }
 
@@ -0,0 +1,202 @@
+/*
+ * GloveClock.cpp
+ */
+
+#include <math.h>
+
+#include "GloveClock.h"
+
+
+// a tick or receive time this far off the expected time means the node or base station restarted
+#define CLOCK_JUMP_US		100000
+
+#define TICK_WRAP_US		((uint64_t)GLOVE_TICK_US << 16)
+
+
+GloveClockFit::GloveClockFit(size_t window) : local(window > 1 ? window : 2), reference(local.size())
+{
+	reset();
+}
+
+void GloveClockFit::reset()
+{
+	next = 0;
+	count = 0;
+	originLocal = 0;
+	originReference = 0;
+	offset = 0;
+	slope = 1;
+	referenceStalled = false;
+}
+
+void GloveClockFit::add(uint64_t local, uint64_t reference)
+{
+	this->local[next] = local;
+	this->reference[next] = reference;
+	next = (next + 1) % this->local.size();
+	if (count < this->local.size())
+	{
+		++count;
+	}
+	fit();
+}
+
+uint64_t GloveClockFit::map(uint64_t local) const
+{
+	if (count == 0)
+	{
+		return local;
+	}
+	double dx = (double)(int64_t)(local - originLocal);
+	return originReference + (int64_t)llround(offset + slope * dx);
+}
+
+void GloveClockFit::fit()
+{
+	// relative to the newest point, the differences within the window fit a double exactly
+	size_t size = local.size();
+	size_t newest = (next + size - 1) % size;
+	size_t oldest = count < size ? 0 : next;
+	uint64_t previous = map(local[newest]);
+	bool hadFit = count > 1;
+	originLocal = local[newest];
+	originReference = reference[newest];
+
+	// the reference advancing at less than half the local rate is not a clock for these points:
+	// continue the last estimate at the local rate
+	int64_t localSpan = (int64_t)(local[newest] - local[oldest]);
+	int64_t referenceSpan = (int64_t)(reference[newest] - reference[oldest]);
+	referenceStalled = hadFit && localSpan > 0 && referenceSpan < localSpan / 2;
+	if (referenceStalled)
+	{
+		slope = 1;
+		offset = (double)(int64_t)(previous - originReference);
+		return;
+	}
+
+	slope = 1;
+	if (count >= GLOVE_CLOCK_MIN_POINTS)
+	{
+		double meanX = 0;
+		double meanY = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			meanX += (double)(int64_t)(local[i] - originLocal);
+			meanY += (double)(int64_t)(reference[i] - originReference);
+		}
+		meanX /= count;
+		meanY /= count;
+
+		double sxx = 0;
+		double sxy = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			double dx = (double)(int64_t)(local[i] - originLocal) - meanX;
+			double dy = (double)(int64_t)(reference[i] - originReference) - meanY;
+			sxx += dx * dx;
+			sxy += dx * dy;
+		}
+		if (sxx > 0 && fabs(sxy / sxx - 1) <= GLOVE_CLOCK_MAX_DRIFT)
+		{
+			slope = sxy / sxx;
+		}
+	}
+
+	// the least delayed point: smallest reference time relative to the line
+	offset = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		double residual = (double)(int64_t)(reference[i] - originReference) - slope * (double)(int64_t)(local[i] - originLocal);
+		if (i == 0 || residual < offset)
+		{
+			offset = residual;
+		}
+	}
+}
+
+
+GloveClock::GloveClock()
+{
+	reset();
+}
+
+void GloveClock::reset()
+{
+	base.reset();
+	rxTime = 0;
+	rxValid = false;
+	for (uint8_t i = 0; i < 16; ++i)
+	{
+		nodes[i].fit.reset();
+		nodes[i].time = 0;
+		nodes[i].reference = 0;
+	}
+	clockStats = GloveClockStats();
+}
+
+uint64_t GloveClock::update(const GloveDescriptor &desc, uint64_t hostTime)
+{
+	// arrival: receive time of the base station, mapped to host time
+	uint64_t arrival = hostTime;
+	if (desc.time & GLOVE_TIME_RX)
+	{
+		++clockStats.rxTimes;
+		uint64_t time = desc.rxTime;
+		if (rxValid)
+		{
+			// 32 bit us wrap after 71 minutes, a reordered packet was received a little before the last one
+			time = rxTime + (int64_t)(int32_t)(desc.rxTime - (uint32_t)rxTime);
+			int64_t deviation = (int64_t)(time - rxTime) - (int64_t)(hostTime - base.map(rxTime));
+			if (!base.stalled() && (deviation > CLOCK_JUMP_US * 10 || deviation < -CLOCK_JUMP_US * 10))
+			{
+				// base station restarted
+				base.reset();
+			}
+		}
+		rxTime = time;
+		rxValid = true;
+		base.add(rxTime, hostTime);
+		arrival = base.map(rxTime);
+	}
+
+	if (!(desc.time & GLOVE_TIME_TICK))
+	{
+		return arrival;
+	}
+
+	++clockStats.ticks;
+	NodeClock &node = nodes[desc.nodeId & 0x0F];
+	uint64_t tickTime = (uint64_t)desc.tick * GLOVE_TICK_US;
+	uint64_t time = tickTime;
+	if (node.fit.valid())
+	{
+		// the tick wraps every 655 ms: take the wrap count that matches the time since the last sample
+		int64_t elapsed = (int64_t)(arrival - node.reference);
+		uint64_t delta = (tickTime + TICK_WRAP_US - node.time % TICK_WRAP_US) % TICK_WRAP_US;
+		int64_t signedDelta = (int64_t)delta;
+		if (elapsed > (int64_t)delta)
+		{
+			signedDelta += (int64_t)((uint64_t)(elapsed - delta + TICK_WRAP_US / 2) / TICK_WRAP_US * TICK_WRAP_US);
+		}
+		else if (delta > TICK_WRAP_US / 2 && elapsed < (int64_t)(delta - TICK_WRAP_US / 2))
+		{
+			// a sample before the last one, overtaken on the way
+			signedDelta -= (int64_t)TICK_WRAP_US;
+		}
+		int64_t deviation = signedDelta - elapsed;
+		if (!node.fit.stalled() && (deviation > CLOCK_JUMP_US || deviation < -CLOCK_JUMP_US))
+		{
+			// node restarted (or stalled), its clock starts over
+			++clockStats.tickJumps;
+			node.fit.reset();
+		}
+		else
+		{
+			time = node.time + signedDelta;
+		}
+	}
+	node.time = time;
+	node.reference = arrival;
+	node.fit.add(time, arrival);
+	return node.fit.map(time);
+}
@@ -0,0 +1,115 @@
+/*
+ * GloveClock.h
+ *
+ * Host time of the samples from the time stamps in the stream (see
+ * GLOVE_TIME_TICK in GloveProtocol.h) instead of the time their bytes were
+ * read, which varies with the poll order, the serial port and the host.
+ *
+ * Two kinds of linear models (offset + drift) are fitted over the last
+ * packets: the base station clock to the host clock (receive time vs. the
+ * time the bytes were read), and per node its sample clock to the host clock
+ * (via the base station clock where the packet carries a receive time). The
+ * drift is the least squares slope, the offset follows the earliest arrival
+ * relative to it: transfer delays only add, so the least delayed packets
+ * tell the offset best. Where the host time does not advance with the
+ * stream (a recorded stream read at once) the stream's own times are used.
+ */
+
+
+#ifndef GLOVECLOCK_H_
+#define GLOVECLOCK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "GloveProtocol.h"
+
+
+#define GLOVE_CLOCK_WINDOW			512		// points per fit, about 5 s of samples at 100 Hz
+#define GLOVE_CLOCK_MIN_POINTS		16		// below this the drift is assumed 0
+#define GLOVE_CLOCK_MAX_DRIFT		1e-3	// crystals are within 100 ppm, a larger drift is assumed 0
+
+
+// Maps a local clock to a reference clock from pairs of times of the same events, the
+// reference time being later by a transfer delay >= 0. Times in us.
+class GloveClockFit
+{
+public:
+	explicit GloveClockFit(size_t window = GLOVE_CLOCK_WINDOW);
+
+	void reset();
+	void add(uint64_t local, uint64_t reference);
+
+	bool valid() const { return count > 0; }
+	size_t points() const { return count; }
+
+	// reference time of local for the least transfer delay seen, local if not valid
+	uint64_t map(uint64_t local) const;
+
+	// reference us per local us - 1
+	double drift() const { return slope - 1; }
+
+	// the reference times do not advance with the local times (a recorded stream read at
+	// once): map() follows the local clock on from its last estimate
+	bool stalled() const { return referenceStalled; }
+
+private:
+	std::vector<uint64_t> local;
+	std::vector<uint64_t> reference;
+	size_t next;
+	size_t count;
+
+	// map(x) = originReference + offset + slope * (x - originLocal)
+	uint64_t originLocal;
+	uint64_t originReference;
+	double offset;
+	double slope;
+	bool referenceStalled;
+
+	void fit();
+};
+
+
+struct GloveClockStats
+{
+	uint64_t ticks;				// packets with the node's tick
+	uint64_t rxTimes;			// packets with the base station's receive time
+	uint64_t tickJumps;			// ticks that did not follow the previous one of the node, its model restarted
+};
+
+
+class GloveClock
+{
+public:
+	GloveClock();
+
+	void reset();
+
+	// Packet 1 of a sample arrived (its bytes were read at hostTime). Returns the host time of
+	// the sample: from the node's tick if it has one, else from the receive time, else hostTime.
+	uint64_t update(const GloveDescriptor &desc, uint64_t hostTime);
+
+	const GloveClockFit& baseFit() const { return base; }
+	const GloveClockFit& nodeFit(uint8_t nodeId) const { return nodes[nodeId & 0x0F].fit; }
+	const GloveClockStats& stats() const { return clockStats; }
+
+private:
+	struct NodeClock
+	{
+		GloveClockFit fit;
+		uint64_t time;			// unwrapped tick of the last sample in us
+		uint64_t reference;		// its host time estimate from the arrival
+	};
+
+	GloveClockFit base;
+	uint64_t rxTime;			// unwrapped receive time of the last packet in us
+	bool rxValid;
+	NodeClock nodes[16];
+
+	GloveClockStats clockStats;
+};
+
+
+#endif /* GLOVECLOCK_H_ */
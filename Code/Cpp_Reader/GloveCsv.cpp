@@ -0,0 +1,148 @@
+/*
+ * GloveCsv.cpp
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <charconv>
+
+#include "GloveCsv.h"
+#include "QuatKernel.h"
+
+
+const char* const glove_csvSensorNames[GLOVE_CSV_SENSOR_COUNT] = { "wrist", "palm", "thumb", "index", "mid", "ring", "pinky" };
+
+
+// formats like Python's repr(float), which is what csv.writer writes
+static void writeDouble(FILE* file, double value)
+{
+	char text[32];
+	if (isnan(value))
+	{
+		fputs(",nan", file);
+		return;
+	}
+	std::to_chars_result res = std::to_chars(text, text + sizeof(text) - 3, value);
+	*res.ptr = '\0';
+	if (!strpbrk(text, ".en"))
+	{
+		strcat(text, ".0");
+	}
+	fputc(',', file);
+	fputs(text, file);
+}
+
+
+void glove_writeCsvHeader(FILE* file, uint8_t mode)
+{
+	for (unsigned int i = 0; i < GLOVE_CSV_SENSOR_COUNT; ++i)
+	{
+		if (!glove_modeHasLinAcc(mode))
+		{
+			fprintf(file, "Sensor,%u,4,%s,Orientation\n", i, glove_csvSensorNames[i]);
+		}
+		else
+		{
+			fprintf(file, "Sensor,%u,7,%s,OrientationAcceleration\n", i, glove_csvSensorNames[i]);
+		}
+	}
+}
+
+
+GloveCsvWriter::GloveCsvWriter(FILE* file) : file(file), headerDone(false), originSet(false), timeOrigin(0),
+											 batchFlags(0), batchLen(0), ids(GLOVE_CSV_BATCH_LEN), times(GLOVE_CSV_BATCH_LEN),
+											 raw(GLOVE_CSV_BATCH_LEN * 7), rows(GLOVE_CSV_BATCH_LEN * 7)
+{
+}
+
+GloveCsvWriter::~GloveCsvWriter()
+{
+	finish();
+}
+
+
+void GloveCsvWriter::setTimeOrigin(uint64_t hostTime)
+{
+	timeOrigin = hostTime;
+	originSet = true;
+}
+
+void GloveCsvWriter::write(const GloveSample &sample)
+{
+	if (!headerDone)
+	{
+		glove_writeCsvHeader(file, sample.mode);
+		if (!originSet)
+		{
+			setTimeOrigin(sample.sampleTime);
+		}
+		headerDone = true;
+	}
+
+	// a split sample with missing lin. acc. still gets lin. acc. columns (zero)
+	uint8_t flags = sample.flags & GLOVE_SAMPLE_HAS_W;
+	if (glove_modeHasLinAcc(sample.mode))
+	{
+		flags |= GLOVE_SAMPLE_HAS_LINACC;
+	}
+	if (batchLen > 0 && flags != batchFlags)
+	{
+		writeBatch();
+	}
+	batchFlags = flags;
+
+	size_t i = batchLen++;
+	ids[i] = glove_sampleCsvId(sample);
+	times[i] = sample.sampleTime;
+
+	int16_t* dest = &raw[i * glove_kernelSampleLen(flags)];
+	if (flags & GLOVE_SAMPLE_HAS_W)
+	{
+		*dest++ = sample.quat[0];
+	}
+	dest[0] = sample.quat[1];
+	dest[1] = sample.quat[2];
+	dest[2] = sample.quat[3];
+	if (flags & GLOVE_SAMPLE_HAS_LINACC)
+	{
+		dest[3] = sample.linAcc[0];
+		dest[4] = sample.linAcc[1];
+		dest[5] = sample.linAcc[2];
+	}
+
+	if (batchLen == GLOVE_CSV_BATCH_LEN)
+	{
+		writeBatch();
+	}
+}
+
+void GloveCsvWriter::finish()
+{
+	if (batchLen > 0)
+	{
+		writeBatch();
+	}
+	fflush(file);
+}
+
+
+void GloveCsvWriter::writeBatch()
+{
+	glove_dequantize(raw.data(), batchLen, batchFlags, rows.data());
+
+	size_t rowLen = glove_kernelRowLen(batchFlags);
+	const double* row = rows.data();
+	for (size_t i = 0; i < batchLen; ++i, row += rowLen)
+	{
+		// host times before the time origin are written as 0
+		uint64_t time = times[i] > timeOrigin ? times[i] - timeOrigin : 0;
+		fprintf(file, "%u,%llu", ids[i], (unsigned long long)(time / 1000));
+		for (size_t j = 0; j < rowLen; ++j)
+		{
+			writeDouble(file, row[j]);
+		}
+		fputc('\n', file);
+	}
+	batchLen = 0;
+}
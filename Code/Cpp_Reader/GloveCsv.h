@@ -0,0 +1,66 @@
+/*
+ * GloveCsv.h
+ *
+ * log.csv layout of read_glove.py: one header line per sensor
+ * ("Sensor,i,4,name,Orientation" or "Sensor,i,7,name,OrientationAcceleration"),
+ * then one row per sample: ID, time stamp in ms, qx, -qz, qy, qw [, -linAccX, linAccZ, -linAccY].
+ */
+
+
+#ifndef GLOVECSV_H_
+#define GLOVECSV_H_
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "GloveDecoder.h"
+
+
+#define GLOVE_CSV_SENSOR_COUNT	7
+#define GLOVE_CSV_BATCH_LEN		1024
+
+extern const char* const glove_csvSensorNames[GLOVE_CSV_SENSOR_COUNT];
+
+// writes the sensor header lines for the given mode
+void glove_writeCsvHeader(FILE* file, uint8_t mode);
+
+
+// Collects samples and converts them in batches with glove_dequantize(). The
+// header is written with the first sample, time stamps are relative to the
+// time origin (sample time of the first sample unless set).
+class GloveCsvWriter
+{
+public:
+	GloveCsvWriter(FILE* file);
+	~GloveCsvWriter();
+
+	void setTimeOrigin(uint64_t hostTime);
+
+	void write(const GloveSample &sample);
+
+	// converts and writes the samples still batched and flushes the file
+	void finish();
+
+private:
+	FILE* file;
+	bool headerDone;
+	bool originSet;
+	uint64_t timeOrigin;
+
+	// samples waiting for conversion, all with the same kernel flags
+	uint8_t batchFlags;
+	size_t batchLen;
+	std::vector<uint8_t> ids;
+	std::vector<uint64_t> times;
+	std::vector<int16_t> raw;
+	std::vector<double> rows;
+
+	GloveCsvWriter(const GloveCsvWriter&);
+	GloveCsvWriter& operator=(const GloveCsvWriter&);
+
+	void writeBatch();
+};
+
+
+#endif /* GLOVECSV_H_ */
@@ -0,0 +1,440 @@
+/*
+ * GloveCsvImport.cpp
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <charconv>
+
+#include "GloveCsvImport.h"
+#include "GloveEncoder.h"
+
+
+// unsigned decimal like strtoull, false if there is no digit
+static bool parseUInt(const char* &pos, const char* end, uint64_t &value)
+{
+	std::from_chars_result res = std::from_chars(pos, end, value);
+	if (res.ec != std::errc() || res.ptr == pos)
+	{
+		return false;
+	}
+	pos = res.ptr;
+	return true;
+}
+
+static const double powersOf10[23] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Decimal like strtod. The values of glove_decode and read_glove.py mostly have less than 16
+// significant digits: mantissa and power of ten are exact doubles then and a single multiplication
+// or division rounds correctly (Clinger's fast path). Everything else goes to std::from_chars, the
+// result is the same either way.
+static bool parseDouble(const char* &pos, const char* end, double &value)
+{
+	const char* p = pos;
+	bool negative = p < end && *p == '-';
+	p += negative;
+
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	const char* start = p;
+	while (p < end && (unsigned)(*p - '0') <= 9)
+	{
+		mantissa = mantissa * 10 + (*p++ - '0');
+		digits += mantissa != 0;
+	}
+	bool hasDigits = p > start;
+	if (p < end && *p == '.')
+	{
+		const char* fraction = ++p;
+		while (p < end && (unsigned)(*p - '0') <= 9)
+		{
+			mantissa = mantissa * 10 + (*p++ - '0');
+			digits += mantissa != 0;
+		}
+		exponent = -(int)(p - fraction);
+		hasDigits |= p > fraction;
+	}
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* e = p + 1;
+		bool negativeExp = e < end && *e == '-';
+		e += e < end && (*e == '-' || *e == '+');
+		int exp10 = 0;
+		const char* expStart = e;
+		while (e < end && (unsigned)(*e - '0') <= 9 && exp10 < 10000)
+		{
+			exp10 = exp10 * 10 + (*e++ - '0');
+		}
+		if (e > expStart)
+		{
+			exponent += negativeExp ? -exp10 : exp10;
+			p = e;
+		}
+	}
+
+	if (hasDigits && digits <= 19 && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+	{
+		double v = (double)mantissa;
+		v = exponent < 0 ? v / powersOf10[-exponent] : v * powersOf10[exponent];
+		value = negative ? -v : v;
+		pos = p;
+		return true;
+	}
+
+	std::from_chars_result res = std::from_chars(pos, end, value);
+	if (res.ptr == pos || (res.ec != std::errc() && res.ec != std::errc::result_out_of_range))
+	{
+		return false;
+	}
+	if (res.ec == std::errc::result_out_of_range)
+	{
+		// value is left as it was, strtod gives +-HUGE_VAL or +-0
+		value = digits + exponent > 0 ? HUGE_VAL : 0.0;
+		value = negative ? -value : value;
+	}
+	pos = res.ptr;
+	return true;
+}
+
+bool glove_parseCsvRow(const char* line, const char* end, GloveCsvRow &row)
+{
+	uint64_t id;
+	if (!parseUInt(line, end, id) || line == end || *line != ',' || id > 0xFF)
+	{
+		return false;
+	}
+	row.id = id;
+	++line;
+
+	if (!parseUInt(line, end, row.time))
+	{
+		return false;
+	}
+
+	row.columns = 0;
+	while (line < end && *line == ',' && row.columns < 7)
+	{
+		++line;
+		if (!parseDouble(line, end, row.values[row.columns++]))
+		{
+			return false;
+		}
+	}
+	return (line == end || *line == '\r') && (row.columns == 4 || row.columns == 7);
+}
+
+
+void glove_parseCsvChunk(const char* begin, const char* end, GloveCsvChunk &chunk)
+{
+	chunk.rows.clear();
+	chunk.columns = 0;
+	memset(chunk.maxSensor, 0, sizeof(chunk.maxSensor));
+	chunk.lines = 0;
+	chunk.rowLines = 0;
+	chunk.malformedRows = 0;
+	chunk.malformedLines.clear();
+
+	// about 50 bytes per row
+	chunk.rows.reserve((end - begin) / 48);
+
+	const char* line = begin;
+	while (line < end)
+	{
+		const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+		if (!lineEnd)
+		{
+			lineEnd = end;
+		}
+
+		if (lineEnd - line >= 7 && memcmp(line, "Sensor,", 7) == 0)
+		{
+			// Sensor,i,4|7,name,Orientation[Acceleration]
+			const char* count = (const char*)memchr(line + 7, ',', lineEnd - line - 7);
+			if (count)
+			{
+				chunk.columns = atoi(count + 1);
+			}
+		}
+		else
+		{
+			++chunk.rowLines;
+			GloveCsvRow row;
+			if (glove_parseCsvRow(line, lineEnd, row))
+			{
+				uint8_t node = row.id >> 4;
+				uint8_t sensor = row.id & 0x0F;
+				if (sensor > chunk.maxSensor[node])
+				{
+					chunk.maxSensor[node] = sensor;
+				}
+				chunk.rows.push_back(row);
+			}
+			else
+			{
+				if (chunk.malformedRows++ < GLOVE_CSV_REPORT_LINES)
+				{
+					chunk.malformedLines.push_back(chunk.lines);
+				}
+			}
+		}
+		++chunk.lines;
+		line = lineEnd + 1;
+	}
+}
+
+std::vector<size_t> glove_splitCsv(const char* data, size_t size, size_t chunkSize)
+{
+	std::vector<size_t> offsets(1, 0);
+	size_t pos = 0;
+	while (size - pos > chunkSize)
+	{
+		const char* lineEnd = (const char*)memchr(data + pos + chunkSize, '\n', size - pos - chunkSize);
+		if (!lineEnd || lineEnd + 1 == data + size)
+		{
+			break;
+		}
+		pos = lineEnd + 1 - data;
+		offsets.push_back(pos);
+	}
+	offsets.push_back(size);
+	return offsets;
+}
+
+
+GloveCsvFile::GloveCsvFile() : map(0), length(0)
+{
+}
+
+GloveCsvFile::~GloveCsvFile()
+{
+	close();
+}
+
+bool GloveCsvFile::open(const char* path)
+{
+	close();
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		int error = errno;
+		::close(fd);
+		errno = error;
+		return false;
+	}
+
+	length = st.st_size;
+	if (length > 0)
+	{
+		void* data = mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			int error = errno;
+			::close(fd);
+			length = 0;
+			errno = error;
+			return false;
+		}
+		madvise(data, length, MADV_SEQUENTIAL);
+		map = (const char*)data;
+	}
+	else
+	{
+		map = "";
+	}
+	::close(fd);
+	return true;
+}
+
+void GloveCsvFile::close()
+{
+	if (map && length > 0)
+	{
+		munmap((void*)map, length);
+	}
+	map = 0;
+	length = 0;
+}
+
+
+uint8_t glove_csvNodeDevice(int deviceId, uint8_t maxSensor)
+{
+	if (deviceId >= 0)
+	{
+		return deviceId;
+	}
+	return maxSensor == 0 ? DEVICE_SINGLE_NODE : maxSensor <= 5 ? DEVICE_GLOVE_V1 : DEVICE_GLOVE_V2;
+}
+
+static int16_t toRaw(double value, double scale)
+{
+	double raw = rint(value * scale);
+	if (isnan(raw))
+	{
+		return 0;
+	}
+	if (raw < -32768.0)
+	{
+		return -32768;
+	}
+	return raw > 32767.0 ? 32767 : (int16_t)raw;
+}
+
+void glove_csvRowToSample(const GloveCsvRow &row, GloveSample &sample)
+{
+	// q and -q are the same rotation
+	double sign = row.values[3] < 0 ? -1.0 : 1.0;
+	sample.quat[0] = toRaw(sign * row.values[3], GLOVE_QUAT_SCALE);
+	sample.quat[1] = toRaw(sign * row.values[0], GLOVE_QUAT_SCALE);
+	sample.quat[2] = toRaw(sign * row.values[2], GLOVE_QUAT_SCALE);
+	sample.quat[3] = toRaw(-sign * row.values[1], GLOVE_QUAT_SCALE);
+	if (row.columns == 7)
+	{
+		sample.linAcc[0] = toRaw(-row.values[4], GLOVE_LINACC_SCALE);
+		sample.linAcc[1] = toRaw(-row.values[6], GLOVE_LINACC_SCALE);
+		sample.linAcc[2] = toRaw(row.values[5], GLOVE_LINACC_SCALE);
+	}
+}
+
+
+GloveCsvImporter::GloveCsvImporter(GloveRecordingWriter &writer, int columns, const uint8_t* maxSensor, int deviceId)
+								   : writer(writer), columns(columns)
+{
+	mode = columns == 4 ? MODE_QUAT : MODE_QUAT_LINACC;
+	memset(sweeps, 0, sizeof(sweeps));
+	for (int node = 0; node < 16; ++node)
+	{
+		sweeps[node].deviceId = glove_csvNodeDevice(deviceId, maxSensor[node]);
+	}
+	memset(&importStats, 0, sizeof(importStats));
+}
+
+void GloveCsvImporter::add(const GloveCsvRow &row)
+{
+	uint8_t nodeId = row.id >> 4;
+	uint8_t sensor = row.id & 0x0F;
+	NodeSweep &sweep = sweeps[nodeId];
+	uint8_t sensorCount = glove_getSensorCount(mode, sweep.deviceId);
+
+	if (sensor >= sensorCount || row.columns != columns)
+	{
+		++importStats.ignoredRows;
+		return;
+	}
+	if (sweep.sensorMask & (1 << sensor))
+	{
+		writeSweep(nodeId, sweep);
+	}
+	if (sweep.sensorMask == 0)
+	{
+		sweep.time = row.time * 1000;
+	}
+
+	glove_csvRowToSample(row, sweep.sensors[sensor]);
+	sweep.sensorMask |= 1 << sensor;
+
+	if (sweep.sensorMask == (1 << sensorCount) - 1)
+	{
+		writeSweep(nodeId, sweep);
+	}
+}
+
+void GloveCsvImporter::finish()
+{
+	for (int node = 0; node < 16; ++node)
+	{
+		writeSweep(node, sweeps[node]);
+	}
+}
+
+void GloveCsvImporter::writeSweep(uint8_t nodeId, NodeSweep &sweep)
+{
+	if (sweep.sensorMask == 0)
+	{
+		return;
+	}
+
+	GloveDescriptor desc;
+	desc.nodeId = nodeId;
+	desc.deviceId = sweep.deviceId;
+	desc.mode = mode;
+	desc.sampleId = sweep.sampleId;
+	desc.time = 0;
+
+	uint8_t sensorCount = glove_getSensorCount(mode, sweep.deviceId);
+	uint8_t packetCount = glove_getPacketCount(mode, sweep.deviceId);
+	uint8_t packetMasks[4];		// sensors of packet ID 1 to 3
+	for (uint8_t packetId = 1; packetId <= packetCount; ++packetId)
+	{
+		packetMasks[packetId] = 0;
+		for (uint8_t sensor = 0; sensor < sensorCount; ++sensor)
+		{
+			if (glove_packetHasSensors(mode, sweep.deviceId, packetId, 1 << sensor))
+			{
+				packetMasks[packetId] |= 1 << sensor;
+			}
+		}
+	}
+
+	// Packets with only some of their rows can't be written without making up the others, they are
+	// left out. So is the other half of a split sensor (glove v2 mode 1) whose second packet is left
+	// out, and the whole sample without its packet 1: the decoder places packets 2 and 3 by the
+	// time stamp of their packet 1, and their layout follows from its tick.
+	uint8_t dropMask = ~sweep.sensorMask;
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (uint8_t packetId = 1; packetId <= packetCount; ++packetId)
+		{
+			if ((packetMasks[packetId] & dropMask) && (packetMasks[packetId] & ~dropMask))
+			{
+				dropMask |= packetId == 1 ? 0xFF : packetMasks[packetId];
+				changed = true;
+			}
+		}
+	}
+	importStats.droppedRows += __builtin_popcount(sweep.sensorMask & dropMask);
+
+	for (desc.packetId = 1; desc.packetId <= packetCount; ++desc.packetId)
+	{
+		if (packetMasks[desc.packetId] & dropMask)
+		{
+			continue;
+		}
+
+		uint8_t data[GLOVE_DESCRIPTOR_LEN + GLOVE_PAYLOAD_MAX_LEN];
+		GloveFrame frame;
+		frame.hostTime = sweep.time;
+		frame.flags = desc.packetId == 1 ? GLOVE_FRAME_SYNC : 0;
+		frame.length = glove_encodePacket(desc, sweep.sensors, data);
+		frame.data = data;
+		writer.write(frame);
+		++importStats.frames;
+	}
+
+	// a sweep without any packet keeps its sample ID: the next one written after four empty sweeps
+	// would take the decoder's slot of an identical earlier sample and be skipped as a copy of it
+	if (sweep.sensorMask & ~dropMask)
+	{
+		sweep.sampleId = (sweep.sampleId + 1) & 0x03;
+	}
+	memset(sweep.sensors, 0, sizeof(sweep.sensors));
+	sweep.sensorMask = 0;
+}
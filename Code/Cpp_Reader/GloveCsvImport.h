@@ -0,0 +1,140 @@
+/*
+ * GloveCsvImport.h
+ *
+ * Import of read_glove.py's log.csv into session files. Parsing works on
+ * line-aligned chunks of a mapped file (std::from_chars, no locale, no
+ * copies), so the chunks of one file can be parsed in parallel and their rows
+ * fed to GloveCsvImporter in order afterwards.
+ *
+ * GloveCsvImporter groups the rows per node into samples (a sample ends when
+ * a sensor index repeats or all sensors were seen) and packs them into
+ * packets again. The device of a node is derived from its highest sensor
+ * index unless given. Quaternions and lin. acc. are rounded back to their raw
+ * values, for files written by read_glove.py or glove_decode this is lossless.
+ */
+
+
+#ifndef GLOVECSVIMPORT_H_
+#define GLOVECSVIMPORT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "GloveRecording.h"
+
+
+#define GLOVE_CSV_CHUNK_SIZE		(8 << 20)	// bytes of a file parsed as one piece
+#define GLOVE_CSV_REPORT_LINES		20			// malformed lines listed per file
+
+
+struct GloveCsvRow
+{
+	uint8_t id;
+	uint64_t time;				// ms
+	uint8_t columns;
+	double values[7];
+};
+
+// "ID,time,v0,...,v3|v6" (line without the line break), false if it does not parse
+bool glove_parseCsvRow(const char* line, const char* end, GloveCsvRow &row);
+
+
+// rows of a line-aligned piece of a file
+struct GloveCsvChunk
+{
+	std::vector<GloveCsvRow> rows;
+	int columns;				// value columns of the last "Sensor,..." header line, 0 if none
+	uint8_t maxSensor[16];		// highest sensor index per node
+	uint64_t lines;
+	uint64_t rowLines;			// lines that are not header lines
+	uint64_t malformedRows;
+	std::vector<uint64_t> malformedLines;	// line index in the chunk, the first GLOVE_CSV_REPORT_LINES
+};
+
+// parses [begin, end), which starts at the beginning of a line and ends after a line break (or
+// at the end of the file)
+void glove_parseCsvChunk(const char* begin, const char* end, GloveCsvChunk &chunk);
+
+// splits [data, data + size) into pieces of about chunkSize bytes that end after a line break,
+// returns the offsets of their starts and the end
+std::vector<size_t> glove_splitCsv(const char* data, size_t size, size_t chunkSize = GLOVE_CSV_CHUNK_SIZE);
+
+
+// a log.csv file mapped into memory
+class GloveCsvFile
+{
+public:
+	GloveCsvFile();
+	~GloveCsvFile();
+
+	// false (errno set) if it can't be mapped
+	bool open(const char* path);
+	void close();
+
+	const char* data() const { return map; }
+	size_t size() const { return length; }
+
+private:
+	const char* map;
+	size_t length;
+
+	GloveCsvFile(const GloveCsvFile&);
+	GloveCsvFile& operator=(const GloveCsvFile&);
+};
+
+
+struct GloveCsvImportStats
+{
+	uint64_t rows;
+	uint64_t malformedRows;
+	uint64_t ignoredRows;		// sensor index not sent by the node's device
+	uint64_t frames;
+	uint64_t droppedRows;		// rows of packets with a sensor missing in the file, not written
+};
+
+// device of a node: deviceId if given (>= 0), else derived from its highest sensor index
+uint8_t glove_csvNodeDevice(int deviceId, uint8_t maxSensor);
+
+// inverse of the axis remap: qx, -qz, qy, qw [, -linAccX, linAccZ, -linAccY], negated if W < 0 (like
+// the BNO055, the modes without W rebuild it as the positive root)
+void glove_csvRowToSample(const GloveCsvRow &row, GloveSample &sample);
+
+
+class GloveCsvImporter
+{
+public:
+	// columns: 4 or 7 (mode 0 or 1), maxSensor: highest sensor index per node over the whole file
+	GloveCsvImporter(GloveRecordingWriter &writer, int columns, const uint8_t* maxSensor, int deviceId = -1);
+
+	// rows in file order
+	void add(const GloveCsvRow &row);
+	// writes the samples still being collected
+	void finish();
+
+	// rows and malformedRows are left to the parser
+	const GloveCsvImportStats& stats() const { return importStats; }
+
+private:
+	// samples of one node being collected from consecutive rows
+	struct NodeSweep
+	{
+		uint8_t deviceId;
+		uint8_t sampleId;
+		uint8_t sensorMask;
+		uint64_t time;
+		GloveSample sensors[GLOVE_MAX_SENSORS];
+	};
+
+	GloveRecordingWriter &writer;
+	int columns;
+	uint8_t mode;
+	NodeSweep sweeps[16];
+	GloveCsvImportStats importStats;
+
+	void writeSweep(uint8_t nodeId, NodeSweep &sweep);
+};
+
+
+#endif /* GLOVECSVIMPORT_H_ */
@@ -0,0 +1,931 @@
+/*
+ * GloveDecoder.cpp
+ *
+ * Framing follows the receive loop of read_glove.py: synchronize on 0xAB 0xCD,
+ * then read descriptor + data packet by packet. A sync sequence must be
+ * followed by packet 1, invalid descriptors force a new search for sync bytes.
+ * Telemetry frames of the base station (mode 7) are framed like a packet 1.
+ *
+ * While searching, a packet 2 or 3 that an open sample set of its node still
+ * misses is accepted without sync bytes if the next packet follows right after
+ * it, so a broken packet costs that packet only, not the rest of the poll round.
+ */
+
+#include <string.h>
+
+#include "GloveDecoder.h"
+#include "QuatKernel.h"
+
+
+static inline int16_t readInt16(const uint8_t* data)
+{
+	// little endian, as sent by the BNO055 and forwarded unchanged
+	return (int16_t)(data[0] | (data[1] << 8));
+}
+
+
+uint32_t glove_rttPercentile(const GloveLinkStats &stats, double fraction)
+{
+	uint64_t total = 0;
+	for (uint8_t i = 0; i < GLOVE_TELEMETRY_RTT_BINS; ++i)
+	{
+		total += stats.rtt[i];
+	}
+	if (total == 0)
+	{
+		return 0;
+	}
+
+	uint64_t count = 0;
+	for (uint8_t i = 0; i < GLOVE_TELEMETRY_RTT_BINS - 1; ++i)
+	{
+		count += stats.rtt[i];
+		if (count >= fraction * total)
+		{
+			uint32_t upper = (i + 1) * GLOVE_TELEMETRY_RTT_BIN_US;
+			return upper < stats.rttMax ? upper : stats.rttMax;
+		}
+	}
+	return stats.rttMax;
+}
+
+static inline uint8_t countBits(uint8_t bits)
+{
+	uint8_t count = 0;
+	for (; bits; bits &= bits - 1)
+	{
+		++count;
+	}
+	return count;
+}
+
+
+GloveDecoder::GloveDecoder(SampleCallback callback, void* context, size_t bufferSize)
+					: callback(callback), context(context), frameCallback(0), frameContext(0),
+					  telemetryCallback(0), telemetryContext(0), setCallback(0), setContext(0)
+{
+	// ring buffer size must be a power of two and hold at least two max. length packets
+	size_t minSize = 2 * (GLOVE_SYNC_LEN + GLOVE_DESCRIPTOR_LEN + GLOVE_TIME_MAX_LEN + GLOVE_PAYLOAD_MAX_LEN);
+	size_t size = 1;
+	while (size < bufferSize || size < minSize)
+	{
+		size <<= 1;
+	}
+	buffer = new uint8_t[size];
+	bufferMask = size - 1;
+
+	reset();
+}
+
+GloveDecoder::~GloveDecoder()
+{
+	delete[] buffer;
+}
+
+
+void GloveDecoder::setFrameCallback(FrameCallback callback, void* context)
+{
+	frameCallback = callback;
+	frameContext = context;
+}
+
+void GloveDecoder::setTelemetryCallback(TelemetryCallback callback, void* context)
+{
+	telemetryCallback = callback;
+	telemetryContext = context;
+}
+
+void GloveDecoder::setSampleSetCallback(SampleSetCallback callback, void* context)
+{
+	setCallback = callback;
+	setContext = context;
+}
+
+
+uint8_t* GloveDecoder::writePointer(size_t &maxLen)
+{
+	size_t size = bufferMask + 1;
+	size_t pos = head & bufferMask;
+
+	// contiguous free space up to the end of the buffer or up to unparsed data
+	size_t free = size - (size_t)(head - tail);
+	maxLen = size - pos;
+	if (maxLen > free)
+	{
+		maxLen = free;
+	}
+	return buffer + pos;
+}
+
+void GloveDecoder::commit(size_t len, uint64_t hostTime)
+{
+	this->hostTime = hostTime;
+	head += len;
+	decoderStats.bytesReceived += len;
+	process();
+}
+
+void GloveDecoder::feed(const uint8_t* data, size_t len, uint64_t hostTime)
+{
+	while (len > 0)
+	{
+		size_t maxLen;
+		uint8_t* dest = writePointer(maxLen);
+		if (maxLen > len)
+		{
+			maxLen = len;
+		}
+		memcpy(dest, data, maxLen);
+		commit(maxLen, hostTime);
+
+		data += maxLen;
+		len -= maxLen;
+	}
+}
+
+void GloveDecoder::flush()
+{
+	// nothing follows the last frame
+	endOfStream = true;
+	process();
+	endOfStream = false;
+
+	for (uint8_t nodeId = 0; nodeId < 16; ++nodeId)
+	{
+		flushPending(nodeId);
+		closeSets(nodeId, true);
+	}
+
+	// incomplete packet at the end of the stream
+	if (frameCallback)
+	{
+		if (state != STATE_SEARCH_SYNC && afterSync)
+		{
+			emitRawSync();
+		}
+		if (state == STATE_DELTA_HEADER || state == STATE_PAYLOAD)
+		{
+			// the time stamps are still in the ring buffer
+			GloveFrame frame = { hostTime, GLOVE_FRAME_RAW, GLOVE_DESCRIPTOR_LEN, header };
+			frameCallback(frame, frameContext);
+		}
+		emitRaw(tail, head);
+	}
+	decoderStats.bytesSkipped += head - tail;
+	tail = head;
+	state = STATE_SEARCH_SYNC;
+	afterSync = false;
+	frameComplete = false;
+}
+
+void GloveDecoder::reset()
+{
+	head = 0;
+	tail = 0;
+	hostTime = 0;
+	state = STATE_SEARCH_SYNC;
+	afterSync = false;
+	endOfStream = false;
+	frameComplete = false;
+	memset(pendingValid, 0, sizeof(pendingValid));
+	memset(deltaState, 0, sizeof(deltaState));
+	memset(sampleTimeValid, 0, sizeof(sampleTimeValid));
+	memset(sampleTicks, 0, sizeof(sampleTicks));
+	sampleClock.reset();
+	memset(&decoderStats, 0, sizeof(decoderStats));
+	memset(link, 0, sizeof(link));
+	memset(assembly, 0, sizeof(assembly));
+	memset(lastSampleId, 0, sizeof(lastSampleId));
+	memset(nodeSeen, 0, sizeof(nodeSeen));
+	memset(sequence, 0, sizeof(sequence));
+}
+
+
+void GloveDecoder::process()
+{
+	// a frame that arrived with an earlier commit() takes frameTime for its iteration
+	uint64_t feedTime = hostTime;
+	while (1)
+	{
+		uint64_t available = head - tail;
+		hostTime = feedTime;
+
+		if (state == STATE_SEARCH_SYNC)
+		{
+			uint64_t skipBegin = tail;
+			bool boundary = false;
+			bool wait = false;
+			while (available >= GLOVE_SYNC_LEN)
+			{
+				if (byteAt(tail) == GLOVE_SYNC_BYTE_1 && byteAt(tail + 1) == GLOVE_SYNC_BYTE_2)
+				{
+					break;
+				}
+				boundary = findPacketBoundary(tail, wait);
+				if (boundary || wait)
+				{
+					break;
+				}
+				++tail;
+				--available;
+				++decoderStats.bytesSkipped;
+			}
+			if (frameCallback && tail != skipBegin)
+			{
+				emitRaw(skipBegin, tail);
+			}
+			if (boundary)
+			{
+				++decoderStats.packetResyncs;
+				afterSync = false;
+				state = STATE_HEADER;
+				continue;
+			}
+			if (wait || available < GLOVE_SYNC_LEN)
+			{
+				return;
+			}
+			tail += GLOVE_SYNC_LEN;
+			afterSync = true;
+			state = STATE_HEADER;
+		}
+		else if (state == STATE_HEADER)
+		{
+			if (available < GLOVE_DESCRIPTOR_LEN)
+			{
+				return;
+			}
+
+			header[0] = byteAt(tail);
+			header[1] = byteAt(tail + 1);
+
+			// header might be sync bytes
+			if (glove_isSync(header))
+			{
+				if (frameCallback && afterSync)
+				{
+					// repeated sync bytes, the first ones start no frame
+					emitRawSync();
+				}
+				tail += GLOVE_SYNC_LEN;
+				afterSync = true;
+				continue;
+			}
+
+			// header always has packetId = 1 after sync, the layout of packets 2 and 3 follows
+			// from the tick in their packet 1
+			bool valid = glove_parseDescriptor(header, desc) && glove_isDescriptorPlausible(desc);
+			bool tick = desc.packetId == 1 ? (desc.time & GLOVE_TIME_TICK) != 0 : sampleTicks[desc.nodeId];
+			bool telemetry = desc.mode == GLOVE_MODE_TELEMETRY;
+			if (telemetry)
+			{
+				// always right after sync bytes, fixed length
+				valid = valid && afterSync;
+				layout.length = GLOVE_TELEMETRY_LEN;
+			}
+			if (!valid ||
+				(afterSync && desc.packetId != 1) ||
+				(!telemetry && !glove_getPacketLayout(desc.mode, desc.deviceId, desc.packetId, layout, tick)))
+			{
+				// skip to next sync point
+				if (frameCallback && afterSync)
+				{
+					emitRawSync();
+				}
+				++decoderStats.syncLosses;
+				state = STATE_SEARCH_SYNC;
+				continue;
+			}
+
+			tail += GLOVE_DESCRIPTOR_LEN;
+			timeLen = glove_timeLen(desc);
+			if (telemetry)
+			{
+				state = STATE_PAYLOAD;
+				continue;
+			}
+			sampleTicks[desc.nodeId] = tick;
+			state = glove_isDeltaMode(desc.mode) ? STATE_DELTA_HEADER : STATE_PAYLOAD;
+		}
+		else if (state == STATE_DELTA_HEADER)
+		{
+			if (available < timeLen)
+			{
+				return;
+			}
+			available -= timeLen;
+
+			uint8_t start[GLOVE_PAYLOAD_MAX_LEN];
+			uint8_t len = available < sizeof(start) ? (uint8_t)available : sizeof(start);
+			for (uint8_t i = 0; i < len; ++i)
+			{
+				start[i] = byteAt(tail + timeLen + i);
+			}
+
+			int length = glove_getDeltaPacketLength(desc.deviceId, desc.packetId, start, len, desc.time & GLOVE_TIME_TICK);
+			if (length == 0)
+			{
+				return;
+			}
+			if (length < 0)
+			{
+				// the descriptor is consumed already, report it as skipped
+				if (frameCallback)
+				{
+					if (afterSync)
+					{
+						emitRawSync();
+					}
+					GloveFrame frame = { hostTime, GLOVE_FRAME_RAW, GLOVE_DESCRIPTOR_LEN, header };
+					frameCallback(frame, frameContext);
+				}
+				decoderStats.bytesSkipped += GLOVE_DESCRIPTOR_LEN;
+				++decoderStats.syncLosses;
+				afterSync = false;
+				state = STATE_SEARCH_SYNC;
+				continue;
+			}
+			layout.length = length;
+			state = STATE_PAYLOAD;
+		}
+		else
+		{
+			// ensure we already received the whole packet, otherwise wait until it arrives
+			size_t length = timeLen + layout.length;
+			if (available < length)
+			{
+				return;
+			}
+
+			// and the next frame starts right after it
+			if (available < length + GLOVE_DESCRIPTOR_LEN && !(endOfStream && available == length))
+			{
+				if (!frameComplete)
+				{
+					frameComplete = true;
+					frameTime = hostTime;
+				}
+				return;
+			}
+			if (frameComplete)
+			{
+				hostTime = frameTime;
+				frameComplete = false;
+			}
+			if (available > length)
+			{
+				uint8_t next[GLOVE_DESCRIPTOR_LEN] = { byteAt(tail + length), byteAt(tail + length + 1) };
+				if (!glove_canFollowFrame(next))
+				{
+					// cut short or false sync bytes, the descriptor is consumed already
+					if (frameCallback)
+					{
+						if (afterSync)
+						{
+							emitRawSync();
+						}
+						GloveFrame frame = { hostTime, GLOVE_FRAME_RAW, GLOVE_DESCRIPTOR_LEN, header };
+						frameCallback(frame, frameContext);
+					}
+					decoderStats.bytesSkipped += GLOVE_DESCRIPTOR_LEN;
+					++decoderStats.syncLosses;
+					afterSync = false;
+					state = STATE_SEARCH_SYNC;
+					continue;
+				}
+			}
+
+			const uint8_t* data;
+			uint8_t packet[GLOVE_TIME_MAX_LEN + GLOVE_PAYLOAD_MAX_LEN];
+			size_t pos = tail & bufferMask;
+			if (pos + length <= bufferMask + 1)
+			{
+				data = buffer + pos;
+			}
+			else
+			{
+				// packet wraps around the end of the ring buffer
+				size_t firstPart = bufferMask + 1 - pos;
+				memcpy(packet, buffer + pos, firstPart);
+				memcpy(packet + firstPart, buffer, length - firstPart);
+				data = packet;
+			}
+
+			if (frameCallback)
+			{
+				emitFrame(data);
+			}
+
+			if (desc.mode == GLOVE_MODE_TELEMETRY)
+			{
+				decodeTelemetry(data);
+				tail += length;
+				++decoderStats.telemetryFrames;
+				afterSync = false;
+				state = STATE_HEADER;
+				continue;
+			}
+
+			if (!checkSequence(data, length))
+			{
+				// a copy of a packet that arrived already, skip just this one
+				tail += length;
+				afterSync = false;
+				state = STATE_HEADER;
+				continue;
+			}
+
+			// packets 2 and 3 take the time of their sample's packet 1
+			glove_parseTime(data, desc);
+			if (desc.packetId == 1)
+			{
+				packetTime = sampleClock.update(desc, hostTime);
+				sampleTimes[desc.nodeId] = packetTime;
+				sampleTimeIds[desc.nodeId] = desc.sampleId;
+				sampleTimeValid[desc.nodeId] = true;
+			}
+			else if (sampleTimeValid[desc.nodeId] && sampleTimeIds[desc.nodeId] == desc.sampleId)
+			{
+				packetTime = sampleTimes[desc.nodeId];
+			}
+			else
+			{
+				packetTime = hostTime;
+			}
+
+			if (glove_isDeltaMode(desc.mode))
+			{
+				decodeDeltaPacket(data + timeLen);
+			}
+			else
+			{
+				decodePacket(data + timeLen);
+			}
+			closeSets(desc.nodeId, false);
+
+			tail += length;
+			++decoderStats.packets;
+			afterSync = false;
+			state = STATE_HEADER;
+		}
+	}
+}
+
+bool GloveDecoder::findPacketBoundary(uint64_t pos, bool &wait)
+{
+	// a packet 2 or 3 that the open sample set of its node still misses
+	uint8_t candidate[GLOVE_DESCRIPTOR_LEN] = { byteAt(pos), byteAt(pos + 1) };
+	GloveDescriptor d;
+	if (!glove_parseDescriptor(candidate, d) || d.packetId < 2 || d.mode == GLOVE_MODE_TELEMETRY)
+	{
+		return false;
+	}
+	const Assembly &slot = assembly[d.nodeId][d.sampleId & 1];
+	if (!slot.open || slot.set.sampleId != d.sampleId || slot.set.mode != d.mode || slot.set.deviceId != d.deviceId ||
+		(slot.packets & (1 << d.packetId)))
+	{
+		return false;
+	}
+
+	uint64_t available = head - pos - GLOVE_DESCRIPTOR_LEN;
+	size_t length;
+	if (glove_isDeltaMode(d.mode))
+	{
+		uint8_t start[GLOVE_PAYLOAD_MAX_LEN];
+		uint8_t len = available < sizeof(start) ? (uint8_t)available : sizeof(start);
+		for (uint8_t i = 0; i < len; ++i)
+		{
+			start[i] = byteAt(pos + GLOVE_DESCRIPTOR_LEN + i);
+		}
+		int deltaLength = glove_getDeltaPacketLength(d.deviceId, d.packetId, start, len);
+		if (deltaLength <= 0)
+		{
+			wait = deltaLength == 0;
+			return false;
+		}
+		length = deltaLength;
+	}
+	else
+	{
+		GlovePacketLayout candidateLayout;
+		if (!glove_getPacketLayout(d.mode, d.deviceId, d.packetId, candidateLayout, sampleTicks[d.nodeId]))
+		{
+			return false;
+		}
+		length = candidateLayout.length;
+	}
+
+	// confirmed by what follows: sync bytes or the descriptor of another packet 2 or 3
+	if (available < length + GLOVE_DESCRIPTOR_LEN)
+	{
+		wait = true;
+		return false;
+	}
+	uint8_t next[GLOVE_DESCRIPTOR_LEN] = { byteAt(pos + GLOVE_DESCRIPTOR_LEN + length),
+										   byteAt(pos + GLOVE_DESCRIPTOR_LEN + length + 1) };
+	if (glove_isSync(next))
+	{
+		return true;
+	}
+	GlovePacketLayout nextLayout;
+	return glove_parseDescriptor(next, d) && d.packetId > 1 && d.mode != GLOVE_MODE_TELEMETRY &&
+		   glove_getPacketLayout(d.mode, d.deviceId, d.packetId, nextLayout, sampleTicks[d.nodeId]);
+}
+
+bool GloveDecoder::checkSequence(const uint8_t* data, size_t length)
+{
+	uint8_t nodeId = desc.nodeId;
+	Assembly &slot = assembly[nodeId][desc.sampleId & 1];
+	GloveSequenceStats &stats = sequence[nodeId];
+
+	// FNV-1a over the packet without the receive time, which differs between copies
+	uint32_t hash = 2166136261u;
+	for (size_t i = desc.time & GLOVE_TIME_RX ? GLOVE_RX_TIME_LEN : 0; i < length; ++i)
+	{
+		hash = (hash ^ data[i]) * 16777619u;
+	}
+
+	bool sameSample = (slot.open || slot.done) && slot.set.sampleId == desc.sampleId &&
+					  slot.set.mode == desc.mode && slot.set.deviceId == desc.deviceId;
+	if (sameSample && (slot.packets & (1 << desc.packetId)))
+	{
+		if (slot.hashes[desc.packetId] == hash)
+		{
+			++stats.duplicates;
+			return false;
+		}
+		// same IDs, other data: the node went on by a multiple of 4 samples (or does not count them)
+		sameSample = false;
+	}
+
+	if (sameSample && slot.open)
+	{
+		// a packet of the previous sample or one that was overtaken by a later packet of its sample
+		if (desc.sampleId != lastSampleId[nodeId] || (slot.packets >> (desc.packetId + 1)))
+		{
+			++stats.reordered;
+		}
+	}
+	else
+	{
+		// a new sample: it takes the slot of the sample two back, the previous sample stays open
+		if (nodeSeen[nodeId])
+		{
+			uint8_t gap = (desc.sampleId - lastSampleId[nodeId]) & 0x03;
+			stats.lostSamples += gap > 1 ? gap - 1 : 0;
+		}
+		if (pendingValid[nodeId] && pending[nodeId].sampleId != desc.sampleId)
+		{
+			flushPending(nodeId);
+		}
+		Assembly &other = assembly[nodeId][(desc.sampleId & 1) ^ 1];
+		if (other.open && other.set.sampleId != ((desc.sampleId - 1) & 0x03))
+		{
+			closeSet(other);
+		}
+		closeSet(slot);
+
+		// the counts usually stay from the sample two back
+		if (slot.set.sensorCount == 0 || slot.set.mode != desc.mode || slot.set.deviceId != desc.deviceId)
+		{
+			slot.packetCount = glove_isDeltaMode(desc.mode) ? 0 : glove_getPacketCount(desc.mode, desc.deviceId);
+			slot.set.sensorCount = glove_getSensorCount(desc.mode, desc.deviceId);
+		}
+		slot.open = true;
+		slot.done = false;
+		slot.packets = 0;
+		slot.set.nodeId = nodeId;
+		slot.set.deviceId = desc.deviceId;
+		slot.set.mode = desc.mode;
+		slot.set.sampleId = desc.sampleId;
+		slot.set.sensorMask = 0;
+		slot.set.missingMask = 0;
+		lastSampleId[nodeId] = desc.sampleId;
+		nodeSeen[nodeId] = true;
+	}
+
+	slot.packets |= 1 << desc.packetId;
+	slot.hashes[desc.packetId] = hash;
+	return true;
+}
+
+void GloveDecoder::closeSets(uint8_t nodeId, bool all)
+{
+	// a complete latest set closes the previous one first, the sets are handed on in order
+	Assembly &latest = assembly[nodeId][lastSampleId[nodeId] & 1];
+	Assembly &previous = assembly[nodeId][(lastSampleId[nodeId] & 1) ^ 1];
+	if (all || latest.complete())
+	{
+		closeSet(previous);
+		closeSet(latest);
+	}
+	else if (previous.complete())
+	{
+		closeSet(previous);
+	}
+}
+
+void GloveDecoder::closeSet(Assembly &slot)
+{
+	if (!slot.open)
+	{
+		return;
+	}
+	slot.open = false;
+	slot.done = true;
+
+	GloveSampleSet &set = slot.set;
+	GloveSequenceStats &stats = sequence[set.nodeId];
+	set.missingMask = ((1 << set.sensorCount) - 1) & ~set.sensorMask;
+	++stats.sets;
+	if (set.missingMask)
+	{
+		++stats.partialSets;
+		stats.missingSensors += countBits(set.missingMask);
+	}
+	if (slot.packetCount)
+	{
+		stats.lostPackets += countBits(slot.packetMask() & ~slot.packets);
+	}
+
+	if (setCallback)
+	{
+		setCallback(set, setContext);
+	}
+}
+
+void GloveDecoder::decodeTelemetry(const uint8_t* data)
+{
+	GloveTelemetry telemetry;
+	glove_parseTelemetry(desc, data, telemetry);
+
+	GloveLinkStats &stats = link[desc.nodeId];
+	++stats.frames;
+	stats.time += telemetry.period;
+	stats.polls += telemetry.polls;
+	stats.payloads += telemetry.payloads;
+	stats.maxTry += telemetry.maxTry;
+	for (uint8_t i = 0; i < GLOVE_TELEMETRY_RTT_BINS; ++i)
+	{
+		stats.rtt[i] += telemetry.rtt[i];
+	}
+	stats.rttMax = telemetry.rttMax > stats.rttMax ? telemetry.rttMax : stats.rttMax;
+	stats.last = telemetry;
+
+	if (telemetryCallback)
+	{
+		telemetryCallback(telemetry, telemetryContext);
+	}
+}
+
+void GloveDecoder::decodePacket(const uint8_t* data)
+{
+	GloveSample sample;
+	sample.hostTime = hostTime;
+	sample.sampleTime = packetTime;
+	sample.nodeId = desc.nodeId;
+	sample.deviceId = desc.deviceId;
+	sample.mode = desc.mode;
+	sample.sampleId = desc.sampleId;
+
+	// lin. acc. of the sample split across packets 2 and 3
+	if (layout.splitLinAcc)
+	{
+		GloveSample &split = pending[desc.nodeId];
+		if (pendingValid[desc.nodeId] && split.sampleId == desc.sampleId)
+		{
+			split.linAcc[0] = readInt16(data);
+			split.linAcc[1] = readInt16(data + 2);
+			split.linAcc[2] = readInt16(data + 4);
+			split.flags |= GLOVE_SAMPLE_HAS_LINACC;
+			split.hostTime = hostTime;
+			pendingValid[desc.nodeId] = false;
+			emit(split);
+		}
+		else
+		{
+			// packet 2 went missing, the lin. acc. alone is of no use
+			flushPending(desc.nodeId);
+		}
+		data += GLOVE_LINACC_LEN;
+	}
+	else
+	{
+		flushPending(desc.nodeId);
+	}
+
+	// smallest three quaternions of the whole packet in one batch
+	uint8_t s3Bits = glove_modeS3Bits(desc.mode);
+	int16_t s3Quats[GLOVE_PAYLOAD_MAX_LEN / GLOVE_S3_LEN][4];
+	if (s3Bits)
+	{
+		glove_decodeS3(data, layout.sampleLen, layout.numSamples, s3Bits, &s3Quats[0][0]);
+	}
+
+	for (uint8_t i = 0; i < layout.numSamples; ++i)
+	{
+		sample.sensorId = layout.firstSensor + i;
+
+		if (s3Bits)
+		{
+			sample.flags = GLOVE_SAMPLE_HAS_W;
+			memcpy(sample.quat, s3Quats[i], sizeof(sample.quat));
+			data += glove_s3Len(s3Bits);
+		}
+		else if (desc.deviceId == DEVICE_SINGLE_NODE)
+		{
+			sample.flags = GLOVE_SAMPLE_HAS_W;
+			sample.quat[0] = readInt16(data);
+			sample.quat[1] = readInt16(data + 2);
+			sample.quat[2] = readInt16(data + 4);
+			sample.quat[3] = readInt16(data + 6);
+			data += GLOVE_QUAT_LEN;
+		}
+		else
+		{
+			sample.flags = 0;
+			sample.quat[0] = 0;
+			sample.quat[1] = readInt16(data);
+			sample.quat[2] = readInt16(data + 2);
+			sample.quat[3] = readInt16(data + 4);
+			data += GLOVE_QUAT_COMPRESSED_LEN;
+		}
+
+		if (glove_modeHasLinAcc(desc.mode))
+		{
+			sample.flags |= GLOVE_SAMPLE_HAS_LINACC;
+			sample.linAcc[0] = readInt16(data);
+			sample.linAcc[1] = readInt16(data + 2);
+			sample.linAcc[2] = readInt16(data + 4);
+			data += GLOVE_LINACC_LEN;
+		}
+		else
+		{
+			sample.linAcc[0] = 0;
+			sample.linAcc[1] = 0;
+			sample.linAcc[2] = 0;
+		}
+
+		emit(sample);
+	}
+
+	// quaternion of the sample split across packets 2 and 3, emitted once its lin. acc. arrives
+	if (layout.splitQuat)
+	{
+		GloveSample &split = pending[desc.nodeId];
+		split = sample;
+		split.sensorId = layout.firstSensor + layout.numSamples;
+		split.flags = GLOVE_SAMPLE_SPLIT;
+		split.quat[0] = 0;
+		split.quat[1] = readInt16(data);
+		split.quat[2] = readInt16(data + 2);
+		split.quat[3] = readInt16(data + 4);
+		split.linAcc[0] = 0;
+		split.linAcc[1] = 0;
+		split.linAcc[2] = 0;
+		pendingValid[desc.nodeId] = true;
+	}
+}
+
+void GloveDecoder::decodeDeltaPacket(const uint8_t* data)
+{
+	flushPending(desc.nodeId);
+
+	GloveSample sample;
+	sample.hostTime = hostTime;
+	sample.sampleTime = packetTime;
+	sample.nodeId = desc.nodeId;
+	sample.deviceId = desc.deviceId;
+	sample.mode = desc.mode;
+	sample.sampleId = desc.sampleId;
+	sample.flags = 0;
+	sample.quat[0] = 0;
+	sample.linAcc[0] = 0;
+	sample.linAcc[1] = 0;
+	sample.linAcc[2] = 0;
+
+	uint16_t number = ((data[0] << 2) | desc.sampleId) & GLOVE_DELTA_NUMBER_MASK;
+	uint8_t first = data[1] & 0x07;
+	uint8_t count = (data[1] >> 3) & 0x07;
+	const uint8_t* bits = data + GLOVE_DELTA_HEADER_LEN;
+	uint32_t pos = 0;
+
+	for (uint8_t i = 0; i < count; ++i)
+	{
+		DeltaState &state = deltaState[desc.nodeId][first + i];
+		uint8_t code = glove_readBits(bits, pos, GLOVE_DELTA_CODE_BITS);
+		uint8_t width = glove_deltaWidth(code);
+		pos += GLOVE_DELTA_CODE_BITS;
+
+		int32_t values[3];
+		for (uint8_t k = 0; k < 3; ++k, pos += width)
+		{
+			// sign extend
+			uint32_t raw = glove_readBits(bits, pos, width);
+			values[k] = width > 0 && (raw >> (width - 1)) ? (int32_t)raw - (1 << width) : (int32_t)raw;
+		}
+
+		if (code == GLOVE_DELTA_ABSOLUTE)
+		{
+			state.depth = 1;
+		}
+		else if (state.depth > 0 && state.number == ((number - 1) & GLOVE_DELTA_NUMBER_MASK))
+		{
+			for (uint8_t k = 0; k < 3; ++k)
+			{
+				int32_t prediction = state.depth > 1 ? 2 * state.prev[k] - state.prev2[k] : state.prev[k];
+				values[k] += prediction;
+			}
+			state.depth = 2;
+		}
+		else
+		{
+			// reference sample lost, wait for the next absolute value of this sensor
+			state.depth = 0;
+			++decoderStats.deltaUnresolved;
+			continue;
+		}
+
+		for (uint8_t k = 0; k < 3; ++k)
+		{
+			state.prev2[k] = state.prev[k];
+			state.prev[k] = (int16_t)values[k];
+			sample.quat[k + 1] = (int16_t)values[k];
+		}
+		state.number = number;
+
+		sample.sensorId = first + i;
+		emit(sample);
+	}
+}
+
+void GloveDecoder::emit(const GloveSample &sample)
+{
+	++decoderStats.samples;
+	callback(sample, context);
+
+	Assembly &slot = assembly[sample.nodeId][sample.sampleId & 1];
+	if (slot.open && slot.set.sampleId == sample.sampleId && sample.sensorId < GLOVE_MAX_SENSORS)
+	{
+		if (slot.set.sensorMask == 0)
+		{
+			slot.set.sampleTime = sample.sampleTime;
+		}
+		if (setCallback)
+		{
+			slot.set.samples[sample.sensorId] = sample;
+		}
+		slot.set.sensorMask |= 1 << sample.sensorId;
+	}
+}
+
+void GloveDecoder::emitFrame(const uint8_t* data)
+{
+	// time stamps included, the frames reproduce the stream
+	uint8_t frameData[GLOVE_DESCRIPTOR_LEN + GLOVE_TIME_MAX_LEN + GLOVE_PAYLOAD_MAX_LEN];
+	memcpy(frameData, header, GLOVE_DESCRIPTOR_LEN);
+	memcpy(frameData + GLOVE_DESCRIPTOR_LEN, data, timeLen + layout.length);
+
+	GloveFrame frame = { hostTime, (uint8_t)(afterSync ? GLOVE_FRAME_SYNC : 0),
+						 (uint8_t)(GLOVE_DESCRIPTOR_LEN + timeLen + layout.length), frameData };
+	frameCallback(frame, frameContext);
+}
+
+void GloveDecoder::emitRaw(uint64_t begin, uint64_t end)
+{
+	// in pieces of at most 255 bytes, copied out where they wrap around the ring buffer
+	uint8_t piece[255];
+	while (begin < end)
+	{
+		size_t len = end - begin < sizeof(piece) ? (size_t)(end - begin) : sizeof(piece);
+		size_t pos = begin & bufferMask;
+		GloveFrame frame = { hostTime, GLOVE_FRAME_RAW, (uint8_t)len, buffer + pos };
+		if (pos + len > bufferMask + 1)
+		{
+			size_t firstPart = bufferMask + 1 - pos;
+			memcpy(piece, buffer + pos, firstPart);
+			memcpy(piece + firstPart, buffer, len - firstPart);
+			frame.data = piece;
+		}
+		frameCallback(frame, frameContext);
+		begin += len;
+	}
+}
+
+void GloveDecoder::emitRawSync()
+{
+	static const uint8_t sync[GLOVE_SYNC_LEN] = { GLOVE_SYNC_BYTE_1, GLOVE_SYNC_BYTE_2 };
+	GloveFrame frame = { hostTime, GLOVE_FRAME_RAW, GLOVE_SYNC_LEN, sync };
+	frameCallback(frame, frameContext);
+}
+
+void GloveDecoder::flushPending(uint8_t nodeId)
+{
+	if (pendingValid[nodeId])
+	{
+		// keep the quaternion, lin. acc. stays zero (same as read_glove.py)
+		pendingValid[nodeId] = false;
+		++decoderStats.splitIncomplete;
+		emit(pending[nodeId]);
+	}
+}
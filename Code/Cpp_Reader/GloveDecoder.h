@@ -0,0 +1,278 @@
+/*
+ * GloveDecoder.h
+ *
+ * Streaming decoder for the byte stream the base station writes to the serial
+ * port. Bytes are written into a fixed ring buffer (either directly via
+ * writePointer()/commit() or copied via feed()) and every decoded IMU sample is
+ * handed to a callback, with its host time from the time stamps in the
+ * stream (GloveClock).
+ *
+ * Per node the packets are reassembled into samples of all sensors by their
+ * sample ID (GloveSampleSet): a set is complete once all packets arrived, else
+ * it is handed on with the missing sensors marked when its node has moved on
+ * by two samples (one reordered packet is tolerated) or at flush(). Packets
+ * that arrive twice are dropped. After a broken packet the decoder resumes at
+ * the next packet boundary it can verify instead of waiting for sync bytes.
+ * A frame is only decoded once the bytes after it show that it ended there
+ * (glove_canFollowFrame()), which holds it back until the next frame starts.
+ */
+
+
+#ifndef GLOVEDECODER_H_
+#define GLOVEDECODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "GloveClock.h"
+#include "GloveProtocol.h"
+
+
+// sample flags
+#define GLOVE_SAMPLE_HAS_W			0x01	// quat[0] holds W (single node, smallest three modes), else W is dropped
+#define GLOVE_SAMPLE_HAS_LINACC		0x02	// linAcc is valid
+#define GLOVE_SAMPLE_SPLIT			0x04	// sample was split across two packets (glove v2, sensor 5)
+
+// frame flags
+#define GLOVE_FRAME_SYNC			0x01	// the frame was preceded by the sync bytes
+#define GLOVE_FRAME_RAW				0x02	// bytes that are not part of a valid frame (skipped while synchronizing)
+
+
+struct GloveSample
+{
+	uint64_t hostTime;		// time passed to commit()/feed() for the bytes that completed this sample
+	uint64_t sampleTime;	// host time of the sample from the time stamps of its packet 1, see GloveClock (else hostTime)
+	uint8_t nodeId;
+	uint8_t deviceId;
+	uint8_t mode;
+	uint8_t sampleId;
+	uint8_t sensorId;		// IMU index on its device, 0 = wrist, 1 = palm, 2 = thumb, ...
+	uint8_t flags;
+	int16_t quat[4];		// raw Q14 W, X, Y, Z (W only valid with GLOVE_SAMPLE_HAS_W)
+	int16_t linAcc[3];		// raw X, Y, Z, 1 m/s^2 = 100 LSB
+};
+
+// read_glove.py's sample ID column: node ID in the upper nibble, sensor index in the lower
+inline uint8_t glove_sampleCsvId(const GloveSample &sample)
+{
+	return (sample.nodeId << 4) + sample.sensorId;
+}
+
+// all sensors of one sample of a node, assembled from its packets
+struct GloveSampleSet
+{
+	uint64_t sampleTime;		// of the first sensor that arrived
+	uint8_t nodeId;
+	uint8_t deviceId;
+	uint8_t mode;
+	uint8_t sampleId;
+	uint8_t sensorCount;		// sensors of the device in this mode
+	uint8_t sensorMask;			// bit i: samples[i] is valid
+	uint8_t missingMask;		// sensors of the device that did not arrive (lost packets, unresolved deltas)
+	GloveSample samples[GLOVE_MAX_SENSORS];
+};
+
+
+// One packet as it was received: descriptor + data (without sync bytes), or a run of
+// skipped bytes. Writing the sync bytes (if flagged) and data of all frames in order
+// reproduces the received byte stream.
+struct GloveFrame
+{
+	uint64_t hostTime;
+	uint8_t flags;
+	uint8_t length;
+	const uint8_t* data;
+};
+
+
+// telemetry frames of the base station summed up per node
+struct GloveLinkStats
+{
+	uint64_t frames;
+	uint64_t time;				// ms covered by the frames
+	uint64_t polls;
+	uint64_t payloads;
+	uint64_t maxTry;
+	uint64_t rtt[GLOVE_TELEMETRY_RTT_BINS];
+	uint16_t rttMax;			// us, over all frames
+	GloveTelemetry last;		// the node's latest frame
+};
+
+// upper end of the round trip bin that the given fraction (0..1) of the polls falls into, in us
+// (the last, open bin reports rttMax)
+uint32_t glove_rttPercentile(const GloveLinkStats &stats, double fraction);
+
+
+// packet sequence of a node, from the sample and packet IDs
+struct GloveSequenceStats
+{
+	uint64_t sets;				// sample sets handed on
+	uint64_t partialSets;		// ... with sensors missing
+	uint64_t missingSensors;	// sensors missing in them
+	uint64_t lostPackets;		// packets of those sets that never arrived (not counted in delta mode)
+	uint64_t lostSamples;		// samples without any packet, from the gaps in the sample IDs (at most 2 per gap)
+	uint64_t duplicates;		// packets received twice, dropped
+	uint64_t reordered;			// packets that arrived after a later one of their node
+};
+
+
+struct GloveDecoderStats
+{
+	uint64_t bytesReceived;
+	uint64_t bytesSkipped;		// bytes thrown away while searching for sync bytes
+	uint64_t packets;
+	uint64_t samples;
+	uint64_t syncLosses;		// invalid descriptors or frames that did not end at the next one, forced a resync
+	uint64_t packetResyncs;		// resyncs at a verified packet boundary instead of sync bytes
+	uint64_t splitIncomplete;	// split samples emitted without their lin. acc. part
+	uint64_t deltaUnresolved;	// delta mode residuals dropped because their reference sample was lost
+	uint64_t telemetryFrames;	// base station telemetry (not counted as packets)
+};
+
+
+class GloveDecoder
+{
+public:
+	typedef void (*SampleCallback)(const GloveSample &sample, void* context);
+	typedef void (*FrameCallback)(const GloveFrame &frame, void* context);
+	typedef void (*TelemetryCallback)(const GloveTelemetry &telemetry, void* context);
+	typedef void (*SampleSetCallback)(const GloveSampleSet &set, void* context);
+
+	// bufferSize is rounded up to the next power of two
+	GloveDecoder(SampleCallback callback, void* context, size_t bufferSize = 1 << 16);
+	~GloveDecoder();
+
+	// optional, receives every frame before its samples are decoded (e.g. for recording)
+	void setFrameCallback(FrameCallback callback, void* context);
+
+	// optional, receives the telemetry frames of the base station, see GLOVE_MODE_TELEMETRY
+	void setTelemetryCallback(TelemetryCallback callback, void* context);
+
+	// optional, receives the reassembled samples of all sensors of a node (after their single samples)
+	void setSampleSetCallback(SampleSetCallback callback, void* context);
+
+	// Zero-copy input: returns a pointer into the ring buffer where up to maxLen bytes
+	// can be written (e.g. by read()), followed by commit() with the number of bytes written.
+	uint8_t* writePointer(size_t &maxLen);
+	void commit(size_t len, uint64_t hostTime = 0);
+
+	// copying input for data that already lives in memory
+	void feed(const uint8_t* data, size_t len, uint64_t hostTime = 0);
+
+	// end of stream: emit split samples still waiting for their second half and the
+	// incomplete sample sets, drop an incomplete packet (reported as raw bytes to the
+	// frame callback)
+	void flush();
+
+	// drop all buffered data and wait for the next sync bytes
+	void reset();
+
+	const GloveDecoderStats& stats() const { return decoderStats; }
+	const GloveClock& clock() const { return sampleClock; }
+	const GloveLinkStats& linkStats(uint8_t nodeId) const { return link[nodeId & 0x0F]; }
+	const GloveSequenceStats& sequenceStats(uint8_t nodeId) const { return sequence[nodeId & 0x0F]; }
+
+private:
+	enum State
+	{
+		STATE_SEARCH_SYNC,
+		STATE_HEADER,
+		STATE_DELTA_HEADER,		// delta mode: waiting for the bytes that tell the packet length
+		STATE_PAYLOAD
+	};
+
+	// delta mode: last two values of a sensor
+	struct DeltaState
+	{
+		int16_t prev[3];
+		int16_t prev2[3];
+		uint16_t number;	// sample number of prev
+		uint8_t depth;		// reference samples: 0 (unresolved), 1 (prev) or 2 (prev, prev2)
+	};
+
+	// sample set being reassembled, two per node (by the parity of the sample ID)
+	struct Assembly
+	{
+		bool open;
+		bool done;					// handed on, kept to recognize duplicates
+		uint8_t packets;			// bit p: packet p arrived
+		uint8_t packetCount;		// 0 in delta mode (not fixed)
+		uint32_t hashes[4];			// of the packets that arrived, by packet ID
+		GloveSampleSet set;
+
+		uint8_t packetMask() const { return ((1 << (packetCount + 1)) - 1) & ~1; }
+		bool complete() const
+		{
+			return open && set.sensorMask == (1 << set.sensorCount) - 1 && (packetCount == 0 || packets == packetMask());
+		}
+	};
+
+	SampleCallback callback;
+	void* context;
+	FrameCallback frameCallback;
+	void* frameContext;
+	TelemetryCallback telemetryCallback;
+	void* telemetryContext;
+	SampleSetCallback setCallback;
+	void* setContext;
+
+	uint8_t* buffer;
+	size_t bufferMask;
+	uint64_t head;		// total bytes written
+	uint64_t tail;		// total bytes parsed
+	uint64_t hostTime;
+
+	State state;
+	bool afterSync;
+	uint8_t header[GLOVE_DESCRIPTOR_LEN];
+	GloveDescriptor desc;
+	uint8_t timeLen;	// time stamps between descriptor and data
+	GlovePacketLayout layout;
+	bool endOfStream;	// flush(): the frame may end at head
+	bool frameComplete;	// the frame arrived, waiting for the bytes after it
+	uint64_t frameTime;	// hostTime when it arrived, its samples keep it
+
+	// host time of the samples (GloveClock), kept per node for packets 2 and 3 of a sample
+	GloveClock sampleClock;
+	uint64_t packetTime;
+	uint64_t sampleTimes[16];
+	uint8_t sampleTimeIds[16];
+	bool sampleTimeValid[16];
+	bool sampleTicks[16];		// packet 1 of the node's last sample carried a tick
+
+	// glove v2 lin. acc. mode: 5th sensor's quaternion, waiting for its lin. acc. in packet 3
+	GloveSample pending[16];
+	bool pendingValid[16];
+
+	DeltaState deltaState[16][GLOVE_MAX_SENSORS];
+
+	Assembly assembly[16][2];
+	uint8_t lastSampleId[16];	// of the latest sample that started
+	bool nodeSeen[16];
+	GloveSequenceStats sequence[16];
+
+	GloveDecoderStats decoderStats;
+	GloveLinkStats link[16];
+
+	GloveDecoder(const GloveDecoder&);
+	GloveDecoder& operator=(const GloveDecoder&);
+
+	void process();
+	bool findPacketBoundary(uint64_t pos, bool &wait);
+	bool checkSequence(const uint8_t* data, size_t length);
+	void closeSets(uint8_t nodeId, bool all);
+	void closeSet(Assembly &slot);
+	void decodeTelemetry(const uint8_t* data);
+	void decodePacket(const uint8_t* data);
+	void decodeDeltaPacket(const uint8_t* data);
+	void emit(const GloveSample &sample);
+	void emitFrame(const uint8_t* data);
+	void emitRaw(uint64_t begin, uint64_t end);
+	void emitRawSync();
+	void flushPending(uint8_t nodeId);
+
+	uint8_t byteAt(uint64_t pos) const { return buffer[pos & bufferMask]; }
+};
+
+
+#endif /* GLOVEDECODER_H_ */
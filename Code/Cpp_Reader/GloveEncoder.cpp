@@ -0,0 +1,260 @@
+/*
+ * GloveEncoder.cpp
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "GloveEncoder.h"
+
+
+static inline uint8_t* writeInt16(uint8_t* data, int16_t value)
+{
+	data[0] = (uint8_t)value;
+	data[1] = (uint8_t)((uint16_t)value >> 8);
+	return data + 2;
+}
+
+static inline uint8_t* writeCompressedQuat(uint8_t* data, const GloveSample &sample)
+{
+	data = writeInt16(data, sample.quat[1]);
+	data = writeInt16(data, sample.quat[2]);
+	return writeInt16(data, sample.quat[3]);
+}
+
+// same integer math as BNO_Get_Quaternion_S3() of the Glove v2 firmware
+static uint8_t* writeS3Quat(uint8_t* data, const GloveSample &sample, uint8_t bits)
+{
+	uint8_t largest = 0;
+	for (uint8_t i = 1; i < 4; ++i)
+	{
+		if (abs(sample.quat[i]) > abs(sample.quat[largest]))
+		{
+			largest = i;
+		}
+	}
+	bool negate = sample.quat[largest] < 0;
+
+	int32_t maxValue = (1 << (bits - 1)) - 1;
+	int32_t scale = glove_s3Scale(bits);
+
+	// bit stream, LSB first
+	uint64_t bitBuffer = largest;
+	uint8_t bitCount = 2;
+	for (uint8_t i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+		{
+			continue;
+		}
+		int32_t value = negate ? -sample.quat[i] : sample.quat[i];
+		int32_t q = (value * scale + 0x8000) >> 16;
+		q = q > maxValue ? maxValue : q < -maxValue ? -maxValue : q;
+		bitBuffer |= (uint64_t)(q + maxValue) << bitCount;
+		bitCount += bits;
+	}
+
+	uint8_t len = glove_s3Len(bits);
+	for (uint8_t i = 0; i < len; ++i)
+	{
+		data[i] = (uint8_t)(bitBuffer >> (8 * i));
+	}
+	return data + len;
+}
+
+static inline uint8_t* writeLinAcc(uint8_t* data, const GloveSample &sample)
+{
+	data = writeInt16(data, sample.linAcc[0]);
+	data = writeInt16(data, sample.linAcc[1]);
+	return writeInt16(data, sample.linAcc[2]);
+}
+
+
+int glove_encodePacket(const GloveDescriptor &desc, const GloveSample* sensors, uint8_t* out)
+{
+	GlovePacketLayout layout;
+	bool tick = (desc.time & GLOVE_TIME_TICK) != 0;
+	if (glove_isDeltaMode(desc.mode) || !glove_getPacketLayout(desc.mode, desc.deviceId, desc.packetId, layout, tick))
+	{
+		return -1;
+	}
+
+	// the time stamps go into packet 1 only
+	GloveDescriptor packetDesc = desc;
+	packetDesc.time = desc.packetId == 1 ? desc.time & GLOVE_TIME_TICK : 0;
+	glove_writeDescriptor(out, packetDesc);
+	uint8_t* data = glove_writeTime(out + GLOVE_DESCRIPTOR_LEN, packetDesc);
+	uint8_t timeLen = glove_timeLen(packetDesc);
+
+	if (layout.splitLinAcc)
+	{
+		data = writeLinAcc(data, sensors[layout.firstSensor - 1]);
+	}
+
+	uint8_t s3Bits = glove_modeS3Bits(desc.mode);
+	for (uint8_t i = 0; i < layout.numSamples; ++i)
+	{
+		const GloveSample &sample = sensors[layout.firstSensor + i];
+
+		if (s3Bits)
+		{
+			data = writeS3Quat(data, sample, s3Bits);
+		}
+		else
+		{
+			if (desc.deviceId == DEVICE_SINGLE_NODE)
+			{
+				data = writeInt16(data, sample.quat[0]);
+			}
+			data = writeCompressedQuat(data, sample);
+		}
+
+		if (glove_modeHasLinAcc(desc.mode))
+		{
+			data = writeLinAcc(data, sample);
+		}
+	}
+
+	if (layout.splitQuat)
+	{
+		data = writeCompressedQuat(data, sensors[layout.firstSensor + layout.numSamples]);
+	}
+
+	return GLOVE_DESCRIPTOR_LEN + timeLen + layout.length;
+}
+
+bool glove_packetHasSensors(uint8_t mode, uint8_t deviceId, uint8_t packetId, uint8_t sensorMask)
+{
+	GlovePacketLayout layout;
+	if (glove_isDeltaMode(mode) || !glove_getPacketLayout(mode, deviceId, packetId, layout))
+	{
+		return false;
+	}
+
+	uint8_t first = layout.firstSensor - layout.splitLinAcc;
+	uint8_t count = layout.numSamples + layout.splitLinAcc + layout.splitQuat;
+	uint8_t packetMask = (uint8_t)(((1 << count) - 1) << first);
+	return (sensorMask & packetMask) != 0;
+}
+
+
+static void writeBits(uint8_t* data, uint32_t pos, uint32_t value, uint8_t bits)
+{
+	while (bits > 0)
+	{
+		uint8_t shift = pos & 7;
+		uint8_t n = 8 - shift < bits ? 8 - shift : bits;
+		if (shift == 0)
+		{
+			data[pos >> 3] = 0;
+		}
+		data[pos >> 3] |= (uint8_t)((value & ((1 << n) - 1)) << shift);
+		value >>= n;
+		pos += n;
+		bits -= n;
+	}
+}
+
+GloveDeltaEncoder::GloveDeltaEncoder() : number(0)
+{
+	reset();
+}
+
+void GloveDeltaEncoder::reset()
+{
+	memset(depth, 0, sizeof(depth));
+}
+
+int GloveDeltaEncoder::encode(const GloveDescriptor &desc, const GloveSample* sensors, uint8_t* out, uint8_t* lengths)
+{
+	uint8_t sensorCount = glove_getSensorCount(MODE_QUAT_DELTA, desc.deviceId);
+	if (sensorCount == 0)
+	{
+		return -1;
+	}
+
+	GloveDescriptor packetDesc = desc;
+	packetDesc.mode = MODE_QUAT_DELTA;
+	packetDesc.sampleId = number & 0x03;
+	packetDesc.packetId = 1;
+	packetDesc.time = desc.time & GLOVE_TIME_TICK;
+
+	uint8_t* packet = out;
+	uint8_t timeLen = glove_timeLen(packetDesc);
+	uint8_t* data = packet + GLOVE_DESCRIPTOR_LEN + timeLen;
+	uint32_t pos = 0;
+	uint32_t capacity = (GLOVE_PAYLOAD_MAX_LEN - GLOVE_SYNC_LEN - GLOVE_DESCRIPTOR_LEN - timeLen - GLOVE_DELTA_HEADER_LEN) * 8;
+	uint8_t first = 0;
+
+	for (uint8_t sensor = 0; sensor < sensorCount; ++sensor)
+	{
+		const int16_t* value = &sensors[sensor].quat[1];
+
+		// smallest width that holds the residuals, absolute at the staggered key frames
+		int32_t residual[3];
+		uint8_t code = GLOVE_DELTA_ABSOLUTE;
+		if (depth[sensor] > 0 && ((number + sensor) & (GLOVE_DELTA_KEYFRAME_INTERVAL - 1)) != 0)
+		{
+			int32_t maxResidual = 0;
+			for (uint8_t k = 0; k < 3; ++k)
+			{
+				int32_t prediction = depth[sensor] > 1 ? 2 * prev[sensor][k] - prev2[sensor][k] : prev[sensor][k];
+				residual[k] = value[k] - prediction;
+				int32_t magnitude = residual[k] < 0 ? -residual[k] - 1 : residual[k];
+				maxResidual = magnitude > maxResidual ? magnitude : maxResidual;
+			}
+			for (code = 0; code < GLOVE_DELTA_ABSOLUTE; ++code)
+			{
+				uint8_t width = glove_deltaWidth(code);
+				if (width == 0 ? (residual[0] | residual[1] | residual[2]) == 0 : maxResidual < (1 << (width - 1)))
+				{
+					break;
+				}
+			}
+		}
+		uint8_t width = glove_deltaWidth(code);
+
+		// next packet if this sensor does not fit anymore
+		if (pos + GLOVE_DELTA_CODE_BITS + 3 * width > capacity)
+		{
+			data[0] = (uint8_t)(number >> 2);
+			data[1] = first | ((sensor - first) << 3);
+			*lengths++ = GLOVE_DESCRIPTOR_LEN + timeLen + GLOVE_DELTA_HEADER_LEN + (pos + 7) / 8;
+			glove_writeDescriptor(packet, packetDesc);
+			glove_writeTime(packet + GLOVE_DESCRIPTOR_LEN, packetDesc);
+
+			packet += GLOVE_DESCRIPTOR_LEN + GLOVE_PAYLOAD_MAX_LEN;
+			data = packet + GLOVE_DESCRIPTOR_LEN;
+			++packetDesc.packetId;
+			packetDesc.time = 0;
+			timeLen = 0;
+			pos = 0;
+			capacity = (GLOVE_PAYLOAD_MAX_LEN - GLOVE_DESCRIPTOR_LEN - GLOVE_DELTA_HEADER_LEN) * 8;
+			first = sensor;
+		}
+
+		uint8_t* bits = data + GLOVE_DELTA_HEADER_LEN;
+		writeBits(bits, pos, code, GLOVE_DELTA_CODE_BITS);
+		pos += GLOVE_DELTA_CODE_BITS;
+		for (uint8_t k = 0; k < 3; ++k, pos += width)
+		{
+			writeBits(bits, pos, code == GLOVE_DELTA_ABSOLUTE ? (uint16_t)value[k] : (uint32_t)residual[k], width);
+		}
+
+		depth[sensor] = code == GLOVE_DELTA_ABSOLUTE ? 1 : 2;
+		for (uint8_t k = 0; k < 3; ++k)
+		{
+			prev2[sensor][k] = prev[sensor][k];
+			prev[sensor][k] = value[k];
+		}
+	}
+
+	data[0] = (uint8_t)(number >> 2);
+	data[1] = first | ((sensorCount - first) << 3);
+	*lengths = GLOVE_DESCRIPTOR_LEN + timeLen + GLOVE_DELTA_HEADER_LEN + (pos + 7) / 8;
+	glove_writeDescriptor(packet, packetDesc);
+	glove_writeTime(packet + GLOVE_DESCRIPTOR_LEN, packetDesc);
+
+	number = (number + 1) & GLOVE_DELTA_NUMBER_MASK;
+	return packetDesc.packetId;
+}
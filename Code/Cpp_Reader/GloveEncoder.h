@@ -0,0 +1,59 @@
+/*
+ * GloveEncoder.h
+ *
+ * Inverse of GloveDecoder: assembles packets from IMU samples the same way
+ * process_quat() / process_quat_linAcc() / process_quat_s3() / process_quat_delta()
+ * of the firmware do.
+ */
+
+
+#ifndef GLOVEENCODER_H_
+#define GLOVEENCODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "GloveDecoder.h"
+
+
+// Writes descriptor + data of one packet to out (at least GLOVE_DESCRIPTOR_LEN +
+// GLOVE_PAYLOAD_MAX_LEN bytes). sensors is indexed by sensor index and must hold
+// all sensors of the device, only quat and linAcc are used (quat[0] only for single nodes and
+// the smallest three modes). With GLOVE_TIME_TICK in desc.time packet 1 carries desc.tick,
+// the layouts of packets 2 and 3 depend on it too (pass the same desc.time for all packets).
+// Receive times are left to the base station, see glove_stampPacket().
+// Returns the number of bytes written, without sync bytes, or -1 if the combination is invalid.
+// Delta mode packets depend on the previous samples, see GloveDeltaEncoder.
+int glove_encodePacket(const GloveDescriptor &desc, const GloveSample* sensors, uint8_t* out);
+
+// true if one of the sensors packed into the given packet is set in sensorMask (bit = sensor index),
+// always false in delta mode
+bool glove_packetHasSensors(uint8_t mode, uint8_t deviceId, uint8_t packetId, uint8_t sensorMask);
+
+
+// Delta mode encoder, keeps the reference samples like process_quat_delta() of the firmware.
+class GloveDeltaEncoder
+{
+public:
+	GloveDeltaEncoder();
+
+	// the next sample sends absolute values for all sensors (mode change, dropped packets)
+	void reset();
+
+	// Writes descriptor + data of the packets of one sample to out, packet i at
+	// i * (GLOVE_DESCRIPTOR_LEN + GLOVE_PAYLOAD_MAX_LEN), and their lengths (without sync
+	// bytes) to lengths. sensors holds all sensors of the device, quat[1..3] are used.
+	// desc.sampleId is replaced by the encoder's sample number, desc.tick goes into packet 1
+	// with GLOVE_TIME_TICK like in glove_encodePacket(). Returns the number of
+	// packets (at most GLOVE_DELTA_MAX_PACKETS) or -1 if the device has no delta mode.
+	int encode(const GloveDescriptor &desc, const GloveSample* sensors, uint8_t* out, uint8_t* lengths);
+
+private:
+	int16_t prev[GLOVE_MAX_SENSORS][3];
+	int16_t prev2[GLOVE_MAX_SENSORS][3];
+	uint8_t depth[GLOVE_MAX_SENSORS];	// reference samples, 0 = send absolute
+	uint16_t number;					// sample number of the next sample
+};
+
+
+#endif /* GLOVEENCODER_H_ */
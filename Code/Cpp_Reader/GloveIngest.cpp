@@ -0,0 +1,211 @@
+/*
+ * GloveIngest.cpp
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include <chrono>
+
+#include "GloveIngest.h"
+
+
+#define GLOVE_INGEST_READ_TIMEOUT_MS	100
+
+
+static uint64_t monotonicUs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+GloveChunkRing::GloveChunkRing(size_t slotCount, size_t slotSize) : slotCount(slotCount < 2 ? 2 : slotCount),
+																	slotSize(slotSize), head(0), closed(false)
+{
+	slots = new Slot[this->slotCount];
+	data = new uint8_t[this->slotCount * slotSize];
+	for (size_t i = 0; i < this->slotCount; ++i)
+	{
+		slots[i].sequence.store(0, std::memory_order_relaxed);
+		slots[i].hostTime.store(0, std::memory_order_relaxed);
+		slots[i].length.store(0, std::memory_order_relaxed);
+	}
+}
+
+GloveChunkRing::~GloveChunkRing()
+{
+	delete[] slots;
+	delete[] data;
+}
+
+
+uint8_t* GloveChunkRing::writePointer(size_t &maxLen)
+{
+	uint64_t chunk = head.load(std::memory_order_relaxed);
+	size_t index = chunk % slotCount;
+
+	// readers still copying the chunk a ring back see the mark change
+	slots[index].sequence.store(2 * chunk + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	maxLen = slotSize;
+	return data + index * slotSize;
+}
+
+void GloveChunkRing::publish(size_t len, uint64_t hostTime)
+{
+	uint64_t chunk = head.load(std::memory_order_relaxed);
+	Slot &slot = slots[chunk % slotCount];
+	slot.hostTime.store(hostTime, std::memory_order_relaxed);
+	slot.length.store((uint32_t)(len < slotSize ? len : slotSize), std::memory_order_relaxed);
+	slot.sequence.store(2 * chunk + 2, std::memory_order_release);
+	head.store(chunk + 1, std::memory_order_release);
+
+	waitCondition.notify_all();
+}
+
+void GloveChunkRing::close()
+{
+	closed.store(true, std::memory_order_release);
+	std::lock_guard<std::mutex> lock(waitMutex);
+	waitCondition.notify_all();
+}
+
+
+void GloveChunkRing::attach(GloveChunkReader &reader) const
+{
+	reader.cursor = head.load(std::memory_order_acquire);
+	reader.offset = 0;
+	reader.bytes = 0;
+	reader.overruns = 0;
+}
+
+size_t GloveChunkRing::read(GloveChunkReader &reader, uint8_t* dest, size_t maxLen, uint64_t &hostTime)
+{
+	while (1)
+	{
+		uint64_t published = head.load(std::memory_order_acquire);
+		if (reader.cursor >= published || maxLen == 0)
+		{
+			return 0;
+		}
+		if (published - reader.cursor >= slotCount)
+		{
+			// the writer took the reader's slot already: continue half a ring behind it
+			uint64_t next = published - slotCount / 2;
+			reader.overruns += next - reader.cursor;
+			reader.cursor = next;
+			reader.offset = 0;
+		}
+
+		size_t index = reader.cursor % slotCount;
+		Slot &slot = slots[index];
+		uint64_t sequence = 2 * reader.cursor + 2;
+		if (slot.sequence.load(std::memory_order_acquire) == sequence)
+		{
+			size_t length = slot.length.load(std::memory_order_relaxed);
+			uint64_t time = slot.hostTime.load(std::memory_order_relaxed);
+			size_t len = length > reader.offset ? length - reader.offset : 0;
+			if (len > maxLen)
+			{
+				len = maxLen;
+			}
+			memcpy(dest, data + index * slotSize + reader.offset, len);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.sequence.load(std::memory_order_relaxed) == sequence)
+			{
+				reader.offset += len;
+				if (reader.offset >= length)
+				{
+					++reader.cursor;
+					reader.offset = 0;
+				}
+				reader.bytes += len;
+				hostTime = time;
+				return len;
+			}
+		}
+
+		// overwritten while it was copied, what dest got is garbage
+		++reader.overruns;
+		++reader.cursor;
+		reader.offset = 0;
+	}
+}
+
+bool GloveChunkRing::wait(const GloveChunkReader &reader, int timeout_ms)
+{
+	if (reader.cursor < chunks())
+	{
+		return true;
+	}
+	if (isClosed())
+	{
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lock(waitMutex);
+	waitCondition.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+						   [&] { return reader.cursor < chunks() || isClosed(); });
+	return reader.cursor < chunks();
+}
+
+
+GloveIngest::GloveIngest(GloveChunkRing &ring) : ring(ring), port(0), running(false)
+{
+	memset(&ingestStats, 0, sizeof(ingestStats));
+}
+
+GloveIngest::~GloveIngest()
+{
+	stop();
+}
+
+bool GloveIngest::start(SerialPort &port)
+{
+	if (thread.joinable() || !port.isOpen())
+	{
+		return false;
+	}
+	this->port = &port;
+	memset(&ingestStats, 0, sizeof(ingestStats));
+	running.store(true, std::memory_order_release);
+	thread = std::thread(&GloveIngest::run, this);
+	return true;
+}
+
+void GloveIngest::stop()
+{
+	running.store(false, std::memory_order_release);
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+}
+
+void GloveIngest::run()
+{
+	while (running.load(std::memory_order_acquire))
+	{
+		size_t maxLen;
+		uint8_t* dest = ring.writePointer(maxLen);
+		ssize_t n = port->read(dest, maxLen, GLOVE_INGEST_READ_TIMEOUT_MS);
+		if (n < 0)
+		{
+			ingestStats.error = errno;
+			break;
+		}
+		if (n > 0)
+		{
+			ring.publish(n, monotonicUs());
+			++ingestStats.reads;
+			ingestStats.bytes += n;
+		}
+	}
+	running.store(false, std::memory_order_release);
+	ring.close();
+}
@@ -0,0 +1,138 @@
+/*
+ * GloveIngest.h
+ *
+ * Capture runtime for live streams. A reader thread (GloveIngest) reads the
+ * serial port straight into a ring of raw chunks (GloveChunkRing), one chunk
+ * per read() with its host time, and never waits for anyone. Consumers
+ * (decoder, recorder, display) attach as readers with their own cursor and
+ * copy the chunks straight into their own buffers, e.g. the ring buffer of a
+ * GloveDecoder.
+ *
+ * The ring is a seqlock per slot: the writer marks a slot as being written
+ * before it reuses it, readers check the mark before and after copying. A
+ * reader that falls a whole ring behind loses the chunks it missed (counted
+ * as overruns) and continues half a ring behind the writer, the capture
+ * itself never stalls.
+ */
+
+
+#ifndef GLOVEINGEST_H_
+#define GLOVEINGEST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "SerialPort.h"
+
+
+#define GLOVE_RING_SLOTS			1024	// chunks, about 1 s of the native USB link
+#define GLOVE_RING_SLOT_SIZE		1024	// bytes per chunk (one read)
+
+
+// cursor of one consumer, used by one thread only
+struct GloveChunkReader
+{
+	uint64_t cursor;		// next chunk to read
+	size_t offset;			// bytes of it read already
+	uint64_t bytes;
+	uint64_t overruns;		// chunks lost because the writer overtook the reader
+};
+
+
+class GloveChunkRing
+{
+public:
+	explicit GloveChunkRing(size_t slotCount = GLOVE_RING_SLOTS, size_t slotSize = GLOVE_RING_SLOT_SIZE);
+	~GloveChunkRing();
+
+	// Writer, one thread: read into writePointer() (up to maxLen bytes), then publish().
+	// The slot is taken from readers still behind by a whole ring as soon as it is requested.
+	uint8_t* writePointer(size_t &maxLen);
+	void publish(size_t len, uint64_t hostTime);
+
+	// no chunks will follow, wakes up waiting readers
+	void close();
+	bool isClosed() const { return closed.load(std::memory_order_acquire); }
+
+	// reads from the next published chunk on
+	void attach(GloveChunkReader &reader) const;
+
+	// Copies up to maxLen bytes of the reader's next chunk to dest (a chunk longer than maxLen
+	// is continued with the next call). Returns the number of bytes, 0 if there is no new chunk.
+	size_t read(GloveChunkReader &reader, uint8_t* dest, size_t maxLen, uint64_t &hostTime);
+
+	// Waits up to timeout_ms for a chunk the reader has not read. Returns false on timeout and
+	// once the ring is closed and the reader has read everything.
+	bool wait(const GloveChunkReader &reader, int timeout_ms);
+
+	uint64_t chunks() const { return head.load(std::memory_order_acquire); }
+
+private:
+	struct Slot
+	{
+		std::atomic<uint64_t> sequence;		// 2 * chunk + 1 while it is written, 2 * chunk + 2 once published
+		std::atomic<uint64_t> hostTime;
+		std::atomic<uint32_t> length;
+	};
+
+	size_t slotCount;
+	size_t slotSize;
+	Slot* slots;
+	uint8_t* data;
+
+	std::atomic<uint64_t> head;		// published chunks
+	std::atomic<bool> closed;
+
+	// readers sleep here, the writer only notifies (a missed notification costs one timeout)
+	std::mutex waitMutex;
+	std::condition_variable waitCondition;
+
+	GloveChunkRing(const GloveChunkRing&);
+	GloveChunkRing& operator=(const GloveChunkRing&);
+};
+
+
+struct GloveIngestStats
+{
+	uint64_t reads;				// chunks published
+	uint64_t bytes;
+	int error;					// errno of the read that ended the capture, 0 if stopped
+};
+
+
+// reader thread: serial port -> ring
+class GloveIngest
+{
+public:
+	explicit GloveIngest(GloveChunkRing &ring);
+	~GloveIngest();
+
+	// starts reading the (open) port, the ring is closed when the thread ends
+	bool start(SerialPort &port);
+	// ends the thread (within one read timeout) and waits for it
+	void stop();
+	bool isRunning() const { return running.load(std::memory_order_acquire); }
+
+	// valid after stop()
+	const GloveIngestStats& stats() const { return ingestStats; }
+
+private:
+	GloveChunkRing &ring;
+	SerialPort* port;
+	std::thread thread;
+	std::atomic<bool> running;
+	GloveIngestStats ingestStats;
+
+	void run();
+
+	GloveIngest(const GloveIngest&);
+	GloveIngest& operator=(const GloveIngest&);
+};
+
+
+#endif /* GLOVEINGEST_H_ */
@@ -0,0 +1,641 @@
+/*
+ * GloveKinematics.cpp
+ *
+ * Frames are unpacked into float columns per block, converted column-wise and
+ * packed into pose rows, like QuatKernel.cpp. Each path normalizes the sensor
+ * quaternions (1 / sqrt of the squared norm), turns them by the mounts and
+ * multiplies them out with the operations of the scalar path in the same
+ * order. +, -, *, / and sqrt are exactly rounded in IEEE single precision on
+ * every path, fused multiply-add must not be used.
+ */
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNEL_X86
+#endif
+
+#include "GloveKinematics.h"
+
+
+#define BLOCK_LEN	64
+
+struct FrameColumns
+{
+	float q[GLOVE_HAND_SENSORS][4][BLOCK_LEN];
+};
+
+struct PoseColumns
+{
+	float joint[GLOVE_HAND_SENSORS][4][BLOCK_LEN];
+	float base[GLOVE_HAND_FINGERS][3][BLOCK_LEN];
+	float tip[GLOVE_HAND_FINGERS][3][BLOCK_LEN];
+};
+
+
+bool glove_axisRemapQuat(uint8_t config, uint8_t sign, float* quat)
+{
+	// v' = A v: remapped axis i is chip axis (config >> 2i) & 3, negated if its sign bit
+	// (X: bit 2, Y: bit 1, Z: bit 0) is set
+	int a[3][3] = { { 0 } };
+	int used = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		int axis = (config >> (2 * i)) & 0x03;
+		if (axis > 2 || (used & (1 << axis)))
+		{
+			return false;
+		}
+		used |= 1 << axis;
+		a[i][axis] = (sign & (0x04 >> i)) ? -1 : 1;
+	}
+	int det = a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1]) - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+			  + a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+	if (det != 1)
+	{
+		return false;
+	}
+
+	// the remapped axes in chip coordinates are the rows of A, so the mount's matrix is A^T
+	double m[3][3];
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			m[i][j] = a[j][i];
+		}
+	}
+	double w, x, y, z;
+	double trace = m[0][0] + m[1][1] + m[2][2];
+	if (trace > 0)
+	{
+		double s = sqrt(trace + 1.0) * 2.0;
+		w = s / 4.0;
+		x = (m[2][1] - m[1][2]) / s;
+		y = (m[0][2] - m[2][0]) / s;
+		z = (m[1][0] - m[0][1]) / s;
+	}
+	else if (m[0][0] >= m[1][1] && m[0][0] >= m[2][2])
+	{
+		double s = sqrt(1.0 + m[0][0] - m[1][1] - m[2][2]) * 2.0;
+		w = (m[2][1] - m[1][2]) / s;
+		x = s / 4.0;
+		y = (m[0][1] + m[1][0]) / s;
+		z = (m[0][2] + m[2][0]) / s;
+	}
+	else if (m[1][1] >= m[2][2])
+	{
+		double s = sqrt(1.0 + m[1][1] - m[0][0] - m[2][2]) * 2.0;
+		w = (m[0][2] - m[2][0]) / s;
+		x = (m[0][1] + m[1][0]) / s;
+		y = s / 4.0;
+		z = (m[1][2] + m[2][1]) / s;
+	}
+	else
+	{
+		double s = sqrt(1.0 + m[2][2] - m[0][0] - m[1][1]) * 2.0;
+		w = (m[1][0] - m[0][1]) / s;
+		x = (m[0][2] + m[2][0]) / s;
+		y = (m[1][2] + m[2][1]) / s;
+		z = s / 4.0;
+	}
+	quat[0] = w;
+	quat[1] = x;
+	quat[2] = y;
+	quat[3] = z;
+	return true;
+}
+
+void glove_defaultHandModel(uint8_t deviceId, GloveHandModel &model)
+{
+	static const float fingerBase[GLOVE_HAND_FINGERS][3] =
+	{
+		{ 0.025f, 0.030f, -0.015f },	// thumb CMC
+		{ 0.090f, 0.030f, 0.0f },
+		{ 0.095f, 0.008f, 0.0f },
+		{ 0.090f, -0.013f, 0.0f },
+		{ 0.082f, -0.032f, 0.0f }
+	};
+	static const float fingerLength[GLOVE_HAND_FINGERS] = { 0.100f, 0.095f, 0.105f, 0.098f, 0.080f };
+
+	memset(&model, 0, sizeof(model));
+	for (int s = 0; s < GLOVE_HAND_SENSORS; ++s)
+	{
+		model.mount[s][0] = 1.0f;
+	}
+	if (deviceId == DEVICE_GLOVE_V2)
+	{
+		// BNO_Init() leaves the pinky (sensor 6) in the chip's frame
+		glove_axisRemapQuat(0x21, 0x04, model.mount[HAND_PINKY]);
+	}
+	memcpy(model.fingerBase, fingerBase, sizeof(fingerBase));
+	memcpy(model.fingerLength, fingerLength, sizeof(fingerLength));
+}
+
+
+static void unpackFrames(const float* frames, size_t count, FrameColumns &cols)
+{
+	for (size_t i = 0; i < count; ++i, frames += GLOVE_HAND_FRAME_LEN)
+	{
+		for (int s = 0; s < GLOVE_HAND_SENSORS; ++s)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				cols.q[s][c][i] = frames[4 * s + c];
+			}
+		}
+	}
+}
+
+static void packPoses(const PoseColumns &cols, size_t count, float* poses)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		float* pose = poses + i * GLOVE_HAND_POSE_LEN;
+		for (int s = 0; s < GLOVE_HAND_SENSORS; ++s)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				*pose++ = cols.joint[s][c][i];
+			}
+		}
+		for (int f = 0; f < GLOVE_HAND_FINGERS; ++f)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				*pose++ = cols.base[f][c][i];
+			}
+		}
+		for (int f = 0; f < GLOVE_HAND_FINGERS; ++f)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				*pose++ = cols.tip[f][c][i];
+			}
+		}
+	}
+}
+
+
+// r = a * b
+static inline void quatMul(const float* a, const float* b, float* r)
+{
+	r[0] = ((a[0] * b[0] - a[1] * b[1]) - a[2] * b[2]) - a[3] * b[3];
+	r[1] = ((a[0] * b[1] + a[1] * b[0]) + a[2] * b[3]) - a[3] * b[2];
+	r[2] = ((a[0] * b[2] - a[1] * b[3]) + a[2] * b[0]) + a[3] * b[1];
+	r[3] = ((a[0] * b[3] + a[1] * b[2]) - a[2] * b[1]) + a[3] * b[0];
+}
+
+// r = a^-1 * b for unit quaternions
+static inline void quatMulConj(const float* a, const float* b, float* r)
+{
+	r[0] = ((a[0] * b[0] + a[1] * b[1]) + a[2] * b[2]) + a[3] * b[3];
+	r[1] = ((a[0] * b[1] - a[1] * b[0]) - a[2] * b[3]) + a[3] * b[2];
+	r[2] = ((a[0] * b[2] + a[1] * b[3]) - a[2] * b[0]) - a[3] * b[1];
+	r[3] = ((a[0] * b[3] - a[1] * b[2]) + a[2] * b[1]) - a[3] * b[0];
+}
+
+static void convertScalar(const GloveHandModel &model, const FrameColumns &cols, size_t begin, size_t count,
+						  PoseColumns &out)
+{
+	for (size_t i = begin; i < count; ++i)
+	{
+		// segment orientations
+		float seg[GLOVE_HAND_SENSORS][4];
+		for (int s = 0; s < GLOVE_HAND_SENSORS; ++s)
+		{
+			float q[4] = { cols.q[s][0][i], cols.q[s][1][i], cols.q[s][2][i], cols.q[s][3][i] };
+			float norm = ((q[0] * q[0] + q[1] * q[1]) + q[2] * q[2]) + q[3] * q[3];
+			float inv = 1.0f / sqrtf(norm);
+			for (int c = 0; c < 4; ++c)
+			{
+				q[c] = q[c] * inv;
+			}
+			quatMul(q, model.mount[s], seg[s]);
+		}
+
+		float joint[GLOVE_HAND_SENSORS][4];
+		memcpy(joint[HAND_WRIST], seg[HAND_WRIST], sizeof(joint[HAND_WRIST]));
+		quatMulConj(seg[HAND_WRIST], seg[HAND_PALM], joint[HAND_PALM]);
+		for (int s = HAND_THUMB; s < GLOVE_HAND_SENSORS; ++s)
+		{
+			quatMulConj(seg[HAND_PALM], seg[s], joint[s]);
+		}
+		for (int s = 0; s < GLOVE_HAND_SENSORS; ++s)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				out.joint[s][c][i] = joint[s][c];
+			}
+		}
+
+		// rotation matrix of the palm
+		const float* p = seg[HAND_PALM];
+		float xx = p[1] * p[1], yy = p[2] * p[2], zz = p[3] * p[3];
+		float xy = p[1] * p[2], xz = p[1] * p[3], yz = p[2] * p[3];
+		float wx = p[0] * p[1], wy = p[0] * p[2], wz = p[0] * p[3];
+		float r[3][3] =
+		{
+			{ 1.0f - 2.0f * (yy + zz), 2.0f * (xy - wz), 2.0f * (xz + wy) },
+			{ 2.0f * (xy + wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz - wx) },
+			{ 2.0f * (xz - wy), 2.0f * (yz + wx), 1.0f - 2.0f * (xx + yy) }
+		};
+
+		for (int f = 0; f < GLOVE_HAND_FINGERS; ++f)
+		{
+			const float* b = model.fingerBase[f];
+			const float* q = seg[HAND_THUMB + f];
+			float length = model.fingerLength[f];
+			// x axis of the finger segment
+			float axis[3] =
+			{
+				1.0f - 2.0f * (q[2] * q[2] + q[3] * q[3]),
+				2.0f * (q[1] * q[2] + q[0] * q[3]),
+				2.0f * (q[1] * q[3] - q[0] * q[2])
+			};
+			for (int c = 0; c < 3; ++c)
+			{
+				float base = (r[c][0] * b[0] + r[c][1] * b[1]) + r[c][2] * b[2];
+				out.base[f][c][i] = base;
+				out.tip[f][c][i] = base + length * axis[c];
+			}
+		}
+	}
+}
+
+
+#ifdef KERNEL_X86
+
+__attribute__((target("sse2")))
+static inline void quatMulSSE2(const __m128* a, const __m128* b, __m128* r)
+{
+	r[0] = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2])), _mm_mul_ps(a[3], b[3]));
+	r[1] = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[1]), _mm_mul_ps(a[1], b[0])), _mm_mul_ps(a[2], b[3])), _mm_mul_ps(a[3], b[2]));
+	r[2] = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(a[0], b[2]), _mm_mul_ps(a[1], b[3])), _mm_mul_ps(a[2], b[0])), _mm_mul_ps(a[3], b[1]));
+	r[3] = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(a[0], b[3]), _mm_mul_ps(a[1], b[2])), _mm_mul_ps(a[2], b[1])), _mm_mul_ps(a[3], b[0]));
+}
+
+__attribute__((target("sse2")))
+static inline void quatMulConjSSE2(const __m128* a, const __m128* b, __m128* r)
+{
+	r[0] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2])), _mm_mul_ps(a[3], b[3]));
+	r[1] = _mm_add_ps(_mm_sub_ps(_mm_sub_ps(_mm_mul_ps(a[0], b[1]), _mm_mul_ps(a[1], b[0])), _mm_mul_ps(a[2], b[3])), _mm_mul_ps(a[3], b[2]));
+	r[2] = _mm_sub_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(a[0], b[2]), _mm_mul_ps(a[1], b[3])), _mm_mul_ps(a[2], b[0])), _mm_mul_ps(a[3], b[1]));
+	r[3] = _mm_sub_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(a[0], b[3]), _mm_mul_ps(a[1], b[2])), _mm_mul_ps(a[2], b[1])), _mm_mul_ps(a[3], b[0]));
+}
+
+__attribute__((target("sse2")))
+static size_t convertSSE2(const GloveHandModel &model, const FrameColumns &cols, size_t count, PoseColumns &out)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 seg[GLOVE_HAND_SENSORS][4];
+		for (int s = 0; s < GLOVE_HAND_SENSORS; ++s)
+		{
+			__m128 q[4];
+			for (int c = 0; c < 4; ++c)
+			{
+				q[c] = _mm_loadu_ps(cols.q[s][c] + i);
+			}
+			__m128 norm = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(q[0], q[0]), _mm_mul_ps(q[1], q[1])), _mm_mul_ps(q[2], q[2])), _mm_mul_ps(q[3], q[3]));
+			__m128 inv = _mm_div_ps(one, _mm_sqrt_ps(norm));
+			__m128 mount[4];
+			for (int c = 0; c < 4; ++c)
+			{
+				q[c] = _mm_mul_ps(q[c], inv);
+				mount[c] = _mm_set1_ps(model.mount[s][c]);
+			}
+			quatMulSSE2(q, mount, seg[s]);
+		}
+
+		__m128 joint[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			_mm_storeu_ps(out.joint[HAND_WRIST][c] + i, seg[HAND_WRIST][c]);
+		}
+		quatMulConjSSE2(seg[HAND_WRIST], seg[HAND_PALM], joint);
+		for (int c = 0; c < 4; ++c)
+		{
+			_mm_storeu_ps(out.joint[HAND_PALM][c] + i, joint[c]);
+		}
+		for (int s = HAND_THUMB; s < GLOVE_HAND_SENSORS; ++s)
+		{
+			quatMulConjSSE2(seg[HAND_PALM], seg[s], joint);
+			for (int c = 0; c < 4; ++c)
+			{
+				_mm_storeu_ps(out.joint[s][c] + i, joint[c]);
+			}
+		}
+
+		const __m128* p = seg[HAND_PALM];
+		__m128 xx = _mm_mul_ps(p[1], p[1]), yy = _mm_mul_ps(p[2], p[2]), zz = _mm_mul_ps(p[3], p[3]);
+		__m128 xy = _mm_mul_ps(p[1], p[2]), xz = _mm_mul_ps(p[1], p[3]), yz = _mm_mul_ps(p[2], p[3]);
+		__m128 wx = _mm_mul_ps(p[0], p[1]), wy = _mm_mul_ps(p[0], p[2]), wz = _mm_mul_ps(p[0], p[3]);
+		__m128 r[3][3] =
+		{
+			{ _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), _mm_mul_ps(two, _mm_sub_ps(xy, wz)), _mm_mul_ps(two, _mm_add_ps(xz, wy)) },
+			{ _mm_mul_ps(two, _mm_add_ps(xy, wz)), _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), _mm_mul_ps(two, _mm_sub_ps(yz, wx)) },
+			{ _mm_mul_ps(two, _mm_sub_ps(xz, wy)), _mm_mul_ps(two, _mm_add_ps(yz, wx)), _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))) }
+		};
+
+		for (int f = 0; f < GLOVE_HAND_FINGERS; ++f)
+		{
+			const __m128* q = seg[HAND_THUMB + f];
+			__m128 b[3] = { _mm_set1_ps(model.fingerBase[f][0]), _mm_set1_ps(model.fingerBase[f][1]), _mm_set1_ps(model.fingerBase[f][2]) };
+			__m128 length = _mm_set1_ps(model.fingerLength[f]);
+			__m128 axis[3] =
+			{
+				_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(q[2], q[2]), _mm_mul_ps(q[3], q[3])))),
+				_mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(q[1], q[2]), _mm_mul_ps(q[0], q[3]))),
+				_mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(q[1], q[3]), _mm_mul_ps(q[0], q[2])))
+			};
+			for (int c = 0; c < 3; ++c)
+			{
+				__m128 base = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[c][0], b[0]), _mm_mul_ps(r[c][1], b[1])), _mm_mul_ps(r[c][2], b[2]));
+				_mm_storeu_ps(out.base[f][c] + i, base);
+				_mm_storeu_ps(out.tip[f][c] + i, _mm_add_ps(base, _mm_mul_ps(length, axis[c])));
+			}
+		}
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static inline void quatMulAVX2(const __m256* a, const __m256* b, __m256* r)
+{
+	r[0] = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_mul_ps(a[0], b[0]), _mm256_mul_ps(a[1], b[1])), _mm256_mul_ps(a[2], b[2])), _mm256_mul_ps(a[3], b[3]));
+	r[1] = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[0], b[1]), _mm256_mul_ps(a[1], b[0])), _mm256_mul_ps(a[2], b[3])), _mm256_mul_ps(a[3], b[2]));
+	r[2] = _mm256_add_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(a[0], b[2]), _mm256_mul_ps(a[1], b[3])), _mm256_mul_ps(a[2], b[0])), _mm256_mul_ps(a[3], b[1]));
+	r[3] = _mm256_add_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(a[0], b[3]), _mm256_mul_ps(a[1], b[2])), _mm256_mul_ps(a[2], b[1])), _mm256_mul_ps(a[3], b[0]));
+}
+
+__attribute__((target("avx2")))
+static inline void quatMulConjAVX2(const __m256* a, const __m256* b, __m256* r)
+{
+	r[0] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[0], b[0]), _mm256_mul_ps(a[1], b[1])), _mm256_mul_ps(a[2], b[2])), _mm256_mul_ps(a[3], b[3]));
+	r[1] = _mm256_add_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_mul_ps(a[0], b[1]), _mm256_mul_ps(a[1], b[0])), _mm256_mul_ps(a[2], b[3])), _mm256_mul_ps(a[3], b[2]));
+	r[2] = _mm256_sub_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(a[0], b[2]), _mm256_mul_ps(a[1], b[3])), _mm256_mul_ps(a[2], b[0])), _mm256_mul_ps(a[3], b[1]));
+	r[3] = _mm256_sub_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(a[0], b[3]), _mm256_mul_ps(a[1], b[2])), _mm256_mul_ps(a[2], b[1])), _mm256_mul_ps(a[3], b[0]));
+}
+
+__attribute__((target("avx2")))
+static size_t convertAVX2(const GloveHandModel &model, const FrameColumns &cols, size_t count, PoseColumns &out)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 seg[GLOVE_HAND_SENSORS][4];
+		for (int s = 0; s < GLOVE_HAND_SENSORS; ++s)
+		{
+			__m256 q[4];
+			for (int c = 0; c < 4; ++c)
+			{
+				q[c] = _mm256_loadu_ps(cols.q[s][c] + i);
+			}
+			__m256 norm = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(q[0], q[0]), _mm256_mul_ps(q[1], q[1])), _mm256_mul_ps(q[2], q[2])), _mm256_mul_ps(q[3], q[3]));
+			__m256 inv = _mm256_div_ps(one, _mm256_sqrt_ps(norm));
+			__m256 mount[4];
+			for (int c = 0; c < 4; ++c)
+			{
+				q[c] = _mm256_mul_ps(q[c], inv);
+				mount[c] = _mm256_set1_ps(model.mount[s][c]);
+			}
+			quatMulAVX2(q, mount, seg[s]);
+		}
+
+		__m256 joint[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			_mm256_storeu_ps(out.joint[HAND_WRIST][c] + i, seg[HAND_WRIST][c]);
+		}
+		quatMulConjAVX2(seg[HAND_WRIST], seg[HAND_PALM], joint);
+		for (int c = 0; c < 4; ++c)
+		{
+			_mm256_storeu_ps(out.joint[HAND_PALM][c] + i, joint[c]);
+		}
+		for (int s = HAND_THUMB; s < GLOVE_HAND_SENSORS; ++s)
+		{
+			quatMulConjAVX2(seg[HAND_PALM], seg[s], joint);
+			for (int c = 0; c < 4; ++c)
+			{
+				_mm256_storeu_ps(out.joint[s][c] + i, joint[c]);
+			}
+		}
+
+		const __m256* p = seg[HAND_PALM];
+		__m256 xx = _mm256_mul_ps(p[1], p[1]), yy = _mm256_mul_ps(p[2], p[2]), zz = _mm256_mul_ps(p[3], p[3]);
+		__m256 xy = _mm256_mul_ps(p[1], p[2]), xz = _mm256_mul_ps(p[1], p[3]), yz = _mm256_mul_ps(p[2], p[3]);
+		__m256 wx = _mm256_mul_ps(p[0], p[1]), wy = _mm256_mul_ps(p[0], p[2]), wz = _mm256_mul_ps(p[0], p[3]);
+		__m256 r[3][3] =
+		{
+			{ _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), _mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), _mm256_mul_ps(two, _mm256_add_ps(xz, wy)) },
+			{ _mm256_mul_ps(two, _mm256_add_ps(xy, wz)), _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), _mm256_mul_ps(two, _mm256_sub_ps(yz, wx)) },
+			{ _mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), _mm256_mul_ps(two, _mm256_add_ps(yz, wx)), _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))) }
+		};
+
+		for (int f = 0; f < GLOVE_HAND_FINGERS; ++f)
+		{
+			const __m256* q = seg[HAND_THUMB + f];
+			__m256 b[3] = { _mm256_set1_ps(model.fingerBase[f][0]), _mm256_set1_ps(model.fingerBase[f][1]), _mm256_set1_ps(model.fingerBase[f][2]) };
+			__m256 length = _mm256_set1_ps(model.fingerLength[f]);
+			__m256 axis[3] =
+			{
+				_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(_mm256_mul_ps(q[2], q[2]), _mm256_mul_ps(q[3], q[3])))),
+				_mm256_mul_ps(two, _mm256_add_ps(_mm256_mul_ps(q[1], q[2]), _mm256_mul_ps(q[0], q[3]))),
+				_mm256_mul_ps(two, _mm256_sub_ps(_mm256_mul_ps(q[1], q[3]), _mm256_mul_ps(q[0], q[2])))
+			};
+			for (int c = 0; c < 3; ++c)
+			{
+				__m256 base = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[c][0], b[0]), _mm256_mul_ps(r[c][1], b[1])), _mm256_mul_ps(r[c][2], b[2]));
+				_mm256_storeu_ps(out.base[f][c] + i, base);
+				_mm256_storeu_ps(out.tip[f][c] + i, _mm256_add_ps(base, _mm256_mul_ps(length, axis[c])));
+			}
+		}
+	}
+	return i;
+}
+
+#endif /* KERNEL_X86 */
+
+
+void glove_handKinematicsWith(GloveKernelPath path, const GloveHandModel &model, const float* frames, size_t count,
+							  float* poses)
+{
+	if (path > glove_kernelPath())
+	{
+		path = KERNEL_SCALAR;
+	}
+
+	FrameColumns cols;
+	PoseColumns out;
+
+	while (count > 0)
+	{
+		size_t n = count < BLOCK_LEN ? count : BLOCK_LEN;
+		unpackFrames(frames, n, cols);
+
+		size_t done = 0;
+#ifdef KERNEL_X86
+		if (path == KERNEL_AVX2)
+		{
+			done = convertAVX2(model, cols, n, out);
+		}
+		else if (path == KERNEL_SSE2)
+		{
+			done = convertSSE2(model, cols, n, out);
+		}
+#endif
+		// remainder (or everything on the scalar path)
+		convertScalar(model, cols, done, n, out);
+
+		packPoses(out, n, poses);
+
+		frames += n * GLOVE_HAND_FRAME_LEN;
+		poses += n * GLOVE_HAND_POSE_LEN;
+		count -= n;
+	}
+}
+
+void glove_handKinematics(const GloveHandModel &model, const float* frames, size_t count, float* poses)
+{
+	static const GloveKernelPath path = glove_kernelPath();
+	glove_handKinematicsWith(path, model, frames, count, poses);
+}
+
+
+GloveHandKinematics::GloveHandKinematics(PoseCallback callback, void* context) : callback(callback), context(context),
+																				 values(GLOVE_HAND_BATCH_LEN * GLOVE_HAND_POSE_LEN),
+																				 poseCount(0)
+{
+	for (int n = 0; n < 16; ++n)
+	{
+		nodes[n].modelSet = false;
+		nodes[n].count = 0;
+	}
+}
+
+void GloveHandKinematics::setModel(uint8_t nodeId, const GloveHandModel &model)
+{
+	NodeBatch &batch = nodes[nodeId & 0x0F];
+	convert(batch);
+	batch.model = model;
+	batch.modelSet = true;
+}
+
+void GloveHandKinematics::append(const GloveSampleSet &set)
+{
+	if (set.deviceId != DEVICE_GLOVE_V1 && set.deviceId != DEVICE_GLOVE_V2)
+	{
+		return;
+	}
+	NodeBatch &batch = nodes[set.nodeId & 0x0F];
+	if (!batch.modelSet)
+	{
+		glove_defaultHandModel(set.deviceId, batch.model);
+		batch.modelSet = true;
+	}
+	if (batch.frames.empty())
+	{
+		batch.frames.resize(GLOVE_HAND_BATCH_LEN * GLOVE_HAND_FRAME_LEN);
+		batch.poses.resize(GLOVE_HAND_BATCH_LEN);
+	}
+
+	size_t k = batch.count++;
+	GloveHandPose &pose = batch.poses[k];
+	pose.sampleTime = set.sampleTime;
+	pose.nodeId = set.nodeId;
+	pose.deviceId = set.deviceId;
+	pose.sensorMask = 0;
+
+	float* frame = &batch.frames[k * GLOVE_HAND_FRAME_LEN];
+	for (uint8_t s = 0; s < GLOVE_HAND_SENSORS; ++s, frame += 4)
+	{
+		// missing sensors stand still, their bit stays clear
+		frame[0] = 1.0f;
+		frame[1] = frame[2] = frame[3] = 0.0f;
+		if (s >= set.sensorCount || !(set.sensorMask & (1 << s)))
+		{
+			continue;
+		}
+
+		// Q14 values are exact in float
+		const GloveSample &sample = set.samples[s];
+		float x = sample.quat[1] * (1.0f / 16384.0f);
+		float y = sample.quat[2] * (1.0f / 16384.0f);
+		float z = sample.quat[3] * (1.0f / 16384.0f);
+		float w;
+		if (sample.flags & GLOVE_SAMPLE_HAS_W)
+		{
+			w = sample.quat[0] * (1.0f / 16384.0f);
+		}
+		else
+		{
+			float sumsq = (x * x + y * y) + z * z;
+			w = sumsq <= 1.0f ? sqrtf(1.0f - sumsq) : 0.0f;
+		}
+		if (w == 0.0f && x == 0.0f && y == 0.0f && z == 0.0f)
+		{
+			continue;
+		}
+		frame[0] = w;
+		frame[1] = x;
+		frame[2] = y;
+		frame[3] = z;
+		pose.sensorMask |= 1 << s;
+	}
+
+	if (batch.count == GLOVE_HAND_BATCH_LEN)
+	{
+		convert(batch);
+	}
+}
+
+void GloveHandKinematics::finish()
+{
+	for (int n = 0; n < 16; ++n)
+	{
+		convert(nodes[n]);
+	}
+}
+
+void GloveHandKinematics::convert(NodeBatch &batch)
+{
+	if (batch.count == 0)
+	{
+		return;
+	}
+	glove_handKinematics(batch.model, batch.frames.data(), batch.count, values.data());
+
+	const float* pose = values.data();
+	for (size_t k = 0; k < batch.count; ++k, pose += GLOVE_HAND_POSE_LEN)
+	{
+		GloveHandPose &out = batch.poses[k];
+		memcpy(out.joint, pose, sizeof(out.joint));
+		memcpy(out.base, pose + GLOVE_HAND_SENSORS * 4, sizeof(out.base));
+		memcpy(out.tip, pose + GLOVE_HAND_SENSORS * 4 + GLOVE_HAND_FINGERS * 3, sizeof(out.tip));
+		if (callback)
+		{
+			callback(out, context);
+		}
+	}
+	poseCount += batch.count;
+	batch.count = 0;
+}
+
+void GloveHandKinematics::sampleSetCallback(const GloveSampleSet &set, void* context)
+{
+	((GloveHandKinematics*)context)->append(set);
+}
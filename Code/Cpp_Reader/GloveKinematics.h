@@ -0,0 +1,139 @@
+/*
+ * GloveKinematics.h
+ *
+ * Forward kinematics of the hand from the IMUs of a glove: per sample set of
+ * a node (wrist, palm, thumb, index, mid, ring, pinky) the rotation of each
+ * joint (parent^-1 * child: palm relative to the wrist, fingers relative to
+ * the palm) and the positions of the finger base joints and fingertips.
+ *
+ * All quaternions are W, X, Y, Z in the frames the BNO055s report (the order
+ * of GloveSample::quat, not read_glove.py's remapped columns). Each sensor's
+ * segment frame is its reported frame turned by its mount rotation: x along
+ * the segment towards the fingertips, z out of the back of the hand. The
+ * firmware (BNO_Init() in Code/Glove v2/Glove/BNO055.c) sets the axis map
+ * 0x21 / sign 0x04 on sensors 1 to 5 only, so by default the glove v2 pinky
+ * gets that remap on the host and all other sensors none. There is one IMU
+ * per finger, so a finger is a rigid segment from its base joint to its tip.
+ * Positions are in m in the world frame of the sensors, with the wrist joint
+ * (the palm segment's origin) at 0.
+ *
+ * Frames are processed in blocks of columns (scalar, SSE2 or AVX2 over 1, 4
+ * or 8 frames at a time). All paths use the same float operations in the same
+ * order without fused multiply-add, their results are bit-identical.
+ */
+
+
+#ifndef GLOVEKINEMATICS_H_
+#define GLOVEKINEMATICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "GloveDecoder.h"
+#include "QuatKernel.h"
+
+
+#define GLOVE_HAND_SENSORS			7
+#define GLOVE_HAND_FINGERS			5
+#define GLOVE_HAND_BATCH_LEN		256		// frames per node converted at a time
+
+// floats per input frame (W, X, Y, Z of each sensor) and per pose (see GloveHandPose)
+#define GLOVE_HAND_FRAME_LEN		(GLOVE_HAND_SENSORS * 4)
+#define GLOVE_HAND_POSE_LEN			(GLOVE_HAND_SENSORS * 4 + 2 * GLOVE_HAND_FINGERS * 3)
+
+
+// sensor index on the glove, the finger of sensor s is s - HAND_THUMB
+enum GloveHandSensor
+{
+	HAND_WRIST,
+	HAND_PALM,
+	HAND_THUMB,
+	HAND_INDEX,
+	HAND_MID,
+	HAND_RING,
+	HAND_PINKY
+};
+
+
+struct GloveHandModel
+{
+	float mount[GLOVE_HAND_SENSORS][4];				// W, X, Y, Z: segment frame in the sensor's reported frame
+	float fingerBase[GLOVE_HAND_FINGERS][3];		// base joint (thumb CMC, finger MCP) in the palm frame, m
+	float fingerLength[GLOVE_HAND_FINGERS];			// base joint to fingertip, m
+};
+
+// Rotation of a BNO055 axis remap (AXIS_MAP_CONFIG and AXIS_MAP_SIGN register values) as mount
+// quaternion: the orientation of the remapped frame in the chip's frame. False if the registers
+// do not describe a rotation (an axis used twice, or a mirroring sign).
+bool glove_axisRemapQuat(uint8_t config, uint8_t sign, float* quat);
+
+// average adult right hand, mounts as set by the firmware of the device (see above)
+void glove_defaultHandModel(uint8_t deviceId, GloveHandModel &model);
+
+
+// frames: count x GLOVE_HAND_FRAME_LEN floats, quaternions need not be normalized (but not 0)
+// poses:  count x GLOVE_HAND_POSE_LEN floats, laid out like GloveHandPose::joint, base, tip
+void glove_handKinematics(const GloveHandModel &model, const float* frames, size_t count, float* poses);
+
+// same as glove_handKinematics() with an explicit path (falls back to scalar if not supported)
+void glove_handKinematicsWith(GloveKernelPath path, const GloveHandModel &model, const float* frames, size_t count,
+							  float* poses);
+
+
+struct GloveHandPose
+{
+	uint64_t sampleTime;
+	uint8_t nodeId;
+	uint8_t deviceId;
+	uint8_t sensorMask;		// bit s: sensor s was in the sample set, values depending on a missing one are invalid
+	float joint[GLOVE_HAND_SENSORS][4];		// W, X, Y, Z: [HAND_WRIST] wrist segment in the world frame,
+											// [HAND_PALM] palm relative to the wrist, [finger] finger relative to the palm
+	float base[GLOVE_HAND_FINGERS][3];		// m, world frame, wrist joint at 0
+	float tip[GLOVE_HAND_FINGERS][3];
+};
+
+
+// Collects the sample sets of the gloves (GloveDecoder::SampleSetCallback) per node and hands
+// out their poses in batches: after finish() or GLOVE_HAND_BATCH_LEN sets of a node.
+class GloveHandKinematics
+{
+public:
+	typedef void (*PoseCallback)(const GloveHandPose &pose, void* context);
+
+	GloveHandKinematics(PoseCallback callback, void* context);
+
+	// model of a node, default: glove_defaultHandModel() of its device
+	void setModel(uint8_t nodeId, const GloveHandModel &model);
+
+	// sets of single nodes are ignored
+	void append(const GloveSampleSet &set);
+	void finish();
+
+	uint64_t poses() const { return poseCount; }
+
+	// GloveDecoder::SampleSetCallback, context is the GloveHandKinematics
+	static void sampleSetCallback(const GloveSampleSet &set, void* context);
+
+private:
+	struct NodeBatch
+	{
+		bool modelSet;
+		GloveHandModel model;
+		size_t count;
+		std::vector<float> frames;
+		std::vector<GloveHandPose> poses;		// sample time, IDs and mask until converted
+	};
+
+	PoseCallback callback;
+	void* context;
+	NodeBatch nodes[16];
+	std::vector<float> values;
+	uint64_t poseCount;
+
+	void convert(NodeBatch &batch);
+};
+
+
+#endif /* GLOVEKINEMATICS_H_ */
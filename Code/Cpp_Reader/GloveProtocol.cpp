@@ -0,0 +1,199 @@
+/*
+ * GloveProtocol.cpp
+ *
+ * Packet length tables, mirroring getPacketLength() of read_glove.py and the
+ * payload assembly in process_quat() / process_quat_linAcc() of the firmware.
+ * The smallest three modes fill the packets like process_quat_s3(): samples
+ * are appended until the next one does not fit. Delta mode packets carry
+ * their length in their width codes.
+ */
+
+#include "GloveProtocol.h"
+
+
+// indexed by [mode][deviceId][packetId - 1], length 0 marks an invalid packet
+static const GlovePacketLayout packetLayouts[2][3][3] =
+{
+	// mode 0: quaternion only
+	{
+		// single node: full quaternion (W, X, Y, Z)
+		{ {  8, 1, 0,  8, 0, 0 }, {  0, 0, 0, 0, 0, 0 }, {  0, 0, 0, 0, 0, 0 } },
+		// glove v1: 6 compressed quaternions in 2 packets
+		{ { 18, 3, 0,  6, 0, 0 }, { 18, 3, 3, 6, 0, 0 }, {  0, 0, 0, 0, 0, 0 } },
+		// glove v2: 7 compressed quaternions in 2 packets
+		{ { 24, 4, 0,  6, 0, 0 }, { 18, 3, 4, 6, 0, 0 }, {  0, 0, 0, 0, 0, 0 } }
+	},
+	// mode 1: quaternion + linear acceleration
+	{
+		// single node: full quaternion + lin. acc.
+		{ { 14, 1, 0, 14, 0, 0 }, {  0, 0, 0, 0, 0, 0 }, {  0, 0, 0, 0, 0, 0 } },
+		// glove v1: 6 compressed quaternions + lin. acc. in 3 packets
+		{ { 24, 2, 0, 12, 0, 0 }, { 24, 2, 2, 12, 0, 0 }, { 24, 2, 4, 12, 0, 0 } },
+		// glove v2: 7 compressed quaternions + lin. acc. in 3 packets, 5th sensor split across packets 2 and 3
+		{ { 24, 2, 0, 12, 0, 0 }, { 30, 2, 2, 12, 1, 0 }, { 30, 2, 5, 12, 0, 1 } }
+	}
+};
+
+
+// number of IMUs of a glove
+static const uint8_t gloveSensorCount[3] = { 0, 6, 7 };
+
+static bool getS3PacketLayout(uint8_t mode, uint8_t deviceId, uint8_t packetId, bool tick, GlovePacketLayout &layout)
+{
+	uint8_t sampleLen = glove_s3Len(glove_modeS3Bits(mode)) + (glove_modeHasLinAcc(mode) ? GLOVE_LINACC_LEN : 0);
+	uint8_t sensors = gloveSensorCount[deviceId];
+	uint8_t first = 0;
+
+	for (uint8_t id = 1; id <= 3 && first < sensors; ++id)
+	{
+		// packet 1 carries the sync bytes and the tick
+		uint8_t capacity = GLOVE_PAYLOAD_MAX_LEN - GLOVE_DESCRIPTOR_LEN - (id == 1 ? GLOVE_SYNC_LEN + (tick ? GLOVE_TICK_LEN : 0) : 0);
+		uint8_t count = capacity / sampleLen;
+		if (count > sensors - first)
+		{
+			count = sensors - first;
+		}
+		if (id == packetId)
+		{
+			layout.length = count * sampleLen;
+			layout.numSamples = count;
+			layout.firstSensor = first;
+			layout.sampleLen = sampleLen;
+			layout.splitQuat = 0;
+			layout.splitLinAcc = 0;
+			return true;
+		}
+		first += count;
+	}
+	return false;
+}
+
+bool glove_getPacketLayout(uint8_t mode, uint8_t deviceId, uint8_t packetId, GlovePacketLayout &layout, bool tick)
+{
+	if (mode >= GLOVE_MODE_COUNT || deviceId > DEVICE_GLOVE_V2 || packetId == 0 || packetId > 3)
+	{
+		return false;
+	}
+	if (glove_modeS3Bits(mode))
+	{
+		// implemented by the Glove v2 firmware (built for either glove), single nodes keep their mode
+		return deviceId != DEVICE_SINGLE_NODE && getS3PacketLayout(mode, deviceId, packetId, tick, layout);
+	}
+	if (glove_isDeltaMode(mode))
+	{
+		if (deviceId == DEVICE_SINGLE_NODE || packetId > GLOVE_DELTA_MAX_PACKETS)
+		{
+			return false;
+		}
+		// header only, see glove_getDeltaPacketLength()
+		layout.length = GLOVE_DELTA_HEADER_LEN;
+		layout.numSamples = 0;
+		layout.firstSensor = 0;
+		layout.sampleLen = 0;
+		layout.splitQuat = 0;
+		layout.splitLinAcc = 0;
+		return true;
+	}
+	// the fixed layouts leave room for the tick in packet 1
+	layout = packetLayouts[mode][deviceId][packetId - 1];
+	return layout.length != 0;
+}
+
+int glove_getPacketLength(uint8_t mode, uint8_t deviceId, uint8_t packetId, uint8_t &numSamples)
+{
+	GlovePacketLayout layout;
+	if (!glove_getPacketLayout(mode, deviceId, packetId, layout))
+	{
+		// input was invalid
+		numSamples = 0;
+		return -1;
+	}
+	// like read_glove.py, a split sample is counted in both packets
+	numSamples = layout.numSamples + layout.splitQuat + layout.splitLinAcc;
+	return layout.length;
+}
+
+bool glove_isPacketValid(uint8_t mode, uint8_t deviceId, uint8_t packetId)
+{
+	GlovePacketLayout layout;
+	return glove_getPacketLayout(mode, deviceId, packetId, layout);
+}
+
+bool glove_isDescriptorPlausible(const GloveDescriptor &desc)
+{
+	if (desc.mode == GLOVE_MODE_TELEMETRY)
+	{
+		return desc.packetId == 1 && desc.time == 0 && desc.deviceId <= DEVICE_GLOVE_V2;
+	}
+	if ((desc.time & GLOVE_TIME_TICK) && (desc.deviceId == DEVICE_SINGLE_NODE || !glove_modeHasTick(desc.mode)))
+	{
+		return false;
+	}
+	return (desc.time == 0 || desc.packetId == 1) && glove_isPacketValid(desc.mode, desc.deviceId, desc.packetId);
+}
+
+bool glove_canFollowFrame(const uint8_t* data)
+{
+	GloveDescriptor desc;
+	return glove_isSync(data) || (glove_parseDescriptor(data, desc) && desc.packetId > 1 && glove_isDescriptorPlausible(desc));
+}
+
+uint8_t glove_getPacketCount(uint8_t mode, uint8_t deviceId)
+{
+	uint8_t count = 0;
+	while (count < 3 && glove_isPacketValid(mode, deviceId, count + 1))
+	{
+		++count;
+	}
+	return count;
+}
+
+uint8_t glove_getSensorCount(uint8_t mode, uint8_t deviceId)
+{
+	if (glove_isDeltaMode(mode))
+	{
+		return glove_isPacketValid(mode, deviceId, 1) ? gloveSensorCount[deviceId] : 0;
+	}
+
+	uint8_t count = 0;
+	GlovePacketLayout layout;
+	for (uint8_t packetId = 1; packetId <= 3; ++packetId)
+	{
+		if (glove_getPacketLayout(mode, deviceId, packetId, layout))
+		{
+			count += layout.numSamples + layout.splitQuat;
+		}
+	}
+	return count;
+}
+
+int glove_getDeltaPacketLength(uint8_t deviceId, uint8_t packetId, const uint8_t* data, uint8_t available, bool tick)
+{
+	if (available < GLOVE_DELTA_HEADER_LEN)
+	{
+		return 0;
+	}
+	uint8_t first = data[1] & 0x07;
+	uint8_t count = (data[1] >> 3) & 0x07;
+	if (deviceId > DEVICE_GLOVE_V2 || (data[1] & 0xC0) || count == 0 || first + count > gloveSensorCount[deviceId])
+	{
+		return -1;
+	}
+
+	const uint8_t* bits = data + GLOVE_DELTA_HEADER_LEN;
+	uint8_t bytes = available - GLOVE_DELTA_HEADER_LEN;
+	uint32_t pos = 0;
+	for (uint8_t i = 0; i < count; ++i)
+	{
+		if (pos + GLOVE_DELTA_CODE_BITS > bytes * 8u)
+		{
+			return 0;
+		}
+		uint8_t code = glove_readBits(bits, pos, GLOVE_DELTA_CODE_BITS);
+		pos += GLOVE_DELTA_CODE_BITS + 3 * glove_deltaWidth(code);
+	}
+
+	int length = GLOVE_DELTA_HEADER_LEN + (pos + 7) / 8;
+	int capacity = GLOVE_PAYLOAD_MAX_LEN - GLOVE_DESCRIPTOR_LEN - (packetId == 1 ? GLOVE_SYNC_LEN + (tick ? GLOVE_TICK_LEN : 0) : 0);
+	return length <= capacity ? length : -1;
+}
@@ -0,0 +1,402 @@
+/*
+ * GloveProtocol.h
+ *
+ * Packet layout shared by the nodes, the gloves and the base station, as
+ * written by initPackets() / process_quat() / process_quat_linAcc() in the
+ * firmware and forwarded unchanged by the base station over the serial port.
+ * The smallest three and delta modes of the Glove v2 firmware and the time
+ * stamps are described with their defines below.
+ */
+
+
+#ifndef GLOVEPROTOCOL_H_
+#define GLOVEPROTOCOL_H_
+
+#include <stdint.h>
+
+
+// Packet structure
+//******************************************************************************
+// packet 1:  2 sync bytes      2 data descriptor bytes    data
+//            0xAB 0xCD         0x.. 0x..                  0x.....................
+// packet 2:  no sync bytes     2 data descriptor bytes    data
+// packet 3:  no sync bytes     2 data descriptor bytes    data
+//******************************************************************************
+//
+// Data descriptor structure
+//******************************************************************************
+// byte 0:  Node ID (4 bit) | tick flag | Device ID (3 bit)
+// byte 1:  Mode (3 bit) | receive time flag | Sample ID (2 bit) | Packet ID (2 bit)
+//******************************************************************************
+//
+// The flags (former control bits, 0 in older streams) may only be set in packet 1,
+// the time stamps they announce follow the descriptor, see GLOVE_TIME_TICK.
+
+#define GLOVE_SYNC_BYTE_1		0xAB
+#define GLOVE_SYNC_BYTE_2		0xCD
+
+#define GLOVE_SYNC_LEN			2
+#define GLOVE_DESCRIPTOR_LEN	2
+#define GLOVE_PAYLOAD_MAX_LEN	32		// nRF24L01+ ack payload limit
+
+// size of a single compressed (W dropped) quaternion and a lin. acc. vector
+#define GLOVE_QUAT_COMPRESSED_LEN	6
+#define GLOVE_QUAT_LEN				8
+#define GLOVE_LINACC_LEN			6
+
+#define GLOVE_MAX_SENSORS		8		// sensor index is stored in the lower 3 bits of the CSV ID
+
+// Q14 fixed point scale of the BNO055 quaternion output and lin. acc. scale (1 m/s^2 = 100 LSB)
+#define GLOVE_QUAT_SCALE		16384
+#define GLOVE_LINACC_SCALE		100
+
+
+enum GloveDeviceId
+{
+	DEVICE_SINGLE_NODE	= 0x00,
+	DEVICE_GLOVE_V1		= 0x01,
+	DEVICE_GLOVE_V2		= 0x02
+};
+
+enum GloveMode
+{
+	MODE_QUAT			= 0,		// quaternion only
+	MODE_QUAT_LINACC	= 1,		// quaternion + linear acceleration
+	MODE_QUAT_S3		= 2,		// smallest three quaternion, 10 bit (gloves only)
+	MODE_QUAT_S3_FINE	= 3,		// smallest three quaternion, 12 bit (gloves only)
+	MODE_QUAT_LINACC_S3	= 4,		// smallest three quaternion, 10 bit + linear acceleration (gloves only)
+	MODE_QUAT_DELTA		= 5			// quaternion as prediction residuals of variable length (gloves only)
+};
+
+#define GLOVE_MODE_COUNT		6
+
+
+// Telemetry frame of the base station (LinkTelemetry.h of Code/BaseStation), sent once per
+// period for every node it polls: a packet 1 with the reserved mode 7, the node ID and device ID
+// of the node, the sample ID counting the frames, no time stamps, then GLOVE_TELEMETRY_LEN bytes
+// of 16 bit little endian values over the period since the node's previous frame (saturating):
+// period (ms), polls, ack payloads, maxTry (polls without ack), poll round trips in
+// GLOVE_TELEMETRY_RTT_BINS bins of GLOVE_TELEMETRY_RTT_BIN_US (the last one open), longest round
+// trip (us). The polls go out without retransmission, a missed one is not repeated.
+#define GLOVE_MODE_TELEMETRY		7
+#define GLOVE_TELEMETRY_RTT_BINS	8
+#define GLOVE_TELEMETRY_RTT_BIN_US	128
+#define GLOVE_TELEMETRY_LEN			(2 * (5 + GLOVE_TELEMETRY_RTT_BINS))
+
+struct GloveTelemetry
+{
+	uint8_t nodeId;
+	uint8_t deviceId;
+	uint16_t period;		// ms
+	uint16_t polls;
+	uint16_t payloads;
+	uint16_t maxTry;
+	uint16_t rtt[GLOVE_TELEMETRY_RTT_BINS];
+	uint16_t rttMax;		// us
+};
+
+
+// Smallest three quaternion (BNO_Get_Quaternion_S3() of the Glove v2 firmware): the
+// largest of W, X, Y, Z is dropped and made positive, the other three lie within
+// +-1/sqrt(2). Bits, LSB first in little endian bytes: index of the dropped component
+// (2 bit, 0 = W ... 3 = Z), then the other three in W, X, Y, Z order, each stored as
+// q + 2^(bits-1) - 1 with q = round(Q14 value * scale / 65536). Samples are never split
+// across packets.
+#define GLOVE_S3_BITS			10
+#define GLOVE_S3_LEN			4
+#define GLOVE_S3_SCALE			2891		// (2^9 - 1) * 65536 / (16384 / sqrt(2))
+#define GLOVE_S3_FINE_BITS		12
+#define GLOVE_S3_FINE_LEN		5
+#define GLOVE_S3_FINE_SCALE		11580		// (2^11 - 1) * 65536 / (16384 / sqrt(2))
+
+// bits per smallest three component, 0 for the modes with Q14 quaternions
+inline uint8_t glove_modeS3Bits(uint8_t mode)
+{
+	return mode == MODE_QUAT_S3_FINE ? GLOVE_S3_FINE_BITS : (mode == MODE_QUAT_S3 || mode == MODE_QUAT_LINACC_S3) ? GLOVE_S3_BITS : 0;
+}
+
+inline uint8_t glove_s3Len(uint8_t bits)
+{
+	return bits == GLOVE_S3_FINE_BITS ? GLOVE_S3_FINE_LEN : GLOVE_S3_LEN;
+}
+
+inline int32_t glove_s3Scale(uint8_t bits)
+{
+	return bits == GLOVE_S3_FINE_BITS ? GLOVE_S3_FINE_SCALE : GLOVE_S3_SCALE;
+}
+
+inline bool glove_modeHasLinAcc(uint8_t mode)
+{
+	return mode == MODE_QUAT_LINACC || mode == MODE_QUAT_LINACC_S3;
+}
+
+
+// Delta mode (process_quat_delta() of the Glove v2 firmware): the compressed quaternion
+// (X, Y, Z of mode 0) of each sensor is sent as the residual of a prediction from the
+// previous samples, or as absolute value. Packet data:
+//   byte 0:   sample number bits 2 - 9 (bits 0 - 1 are the descriptor's sample ID)
+//   byte 1:   first sensor (3 bit) | sensor count << 3 (3 bit) | 2 bit, must be 0
+//   then per sensor, bits LSB first in little endian bytes: width code (3 bit) and
+//   X, Y, Z of glove_deltaWidth(code) bits each, two's complement.
+// Code GLOVE_DELTA_ABSOLUTE carries the values themselves, the others the residual of
+// prev (one reference sample) or 2 * prev - prev2 (two reference samples) and may only be
+// applied if the sensor's previous value belongs to the previous sample number. Each
+// sensor is sent absolute at least every GLOVE_DELTA_KEYFRAME_INTERVAL samples (staggered
+// over the sensors), after a mode change and after the node dropped packets, so a
+// receiver resynchronizes after losses. The packet length follows from the width codes,
+// a sample takes 1 or 2 packets.
+#define GLOVE_DELTA_HEADER_LEN			2
+#define GLOVE_DELTA_CODE_BITS			3
+#define GLOVE_DELTA_ABSOLUTE			7
+#define GLOVE_DELTA_NUMBER_MASK			0x3FF	// 10 bit sample number
+// used by the encoders only, a power of two, the same as DELTA_KEYFRAME_INTERVAL in the
+// config.h of the Glove v2 firmware (CMake option GLOVE_DELTA_KEYFRAME_INTERVAL)
+#ifndef GLOVE_DELTA_KEYFRAME_INTERVAL
+#define GLOVE_DELTA_KEYFRAME_INTERVAL	8
+#endif
+#if GLOVE_DELTA_KEYFRAME_INTERVAL & (GLOVE_DELTA_KEYFRAME_INTERVAL - 1)
+#error GLOVE_DELTA_KEYFRAME_INTERVAL must be a power of two
+#endif
+#define GLOVE_DELTA_MAX_PACKETS			2
+
+inline bool glove_isDeltaMode(uint8_t mode)
+{
+	return mode == MODE_QUAT_DELTA;
+}
+
+// bits per component for a width code (16 = absolute)
+inline uint8_t glove_deltaWidth(uint8_t code)
+{
+	static const uint8_t widths[8] = { 0, 2, 3, 4, 6, 8, 11, 16 };
+	return widths[code & 0x07];
+}
+
+// bits at pos of a little endian, LSB first bit stream (at most 16)
+inline uint32_t glove_readBits(const uint8_t* data, uint32_t pos, uint8_t bits)
+{
+	uint32_t value = 0;
+	for (uint8_t done = 0; done < bits; )
+	{
+		uint8_t shift = pos & 7;
+		uint8_t n = 8 - shift < bits - done ? 8 - shift : bits - done;
+		value |= (uint32_t)((data[pos >> 3] >> shift) & ((1 << n) - 1)) << done;
+		pos += n;
+		done += n;
+	}
+	return value;
+}
+
+
+// Time stamps of packet 1, between the descriptor and the data, in this order:
+//   receive time: inserted by the base station, its clock in us when it received the
+//                 packet, 4 bytes little endian (flag: descriptor byte 1, bit 4)
+//   tick:         written by the node, its sample clock (Timer1 compare matches) at the
+//                 start of the sample in units of GLOVE_TICK_US, 2 bytes little endian
+//                 (flag: descriptor byte 0, bit 3)
+// Both wrap around, see GloveClock.h. The tick takes payload space: the smallest three
+// and delta modes fill packet 1 up to GLOVE_PAYLOAD_MAX_LEN including it.
+#define GLOVE_TIME_TICK			0x01	// GloveDescriptor::time flags
+#define GLOVE_TIME_RX			0x02
+#define GLOVE_TICK_LEN			2
+#define GLOVE_RX_TIME_LEN		4
+#define GLOVE_TIME_MAX_LEN		(GLOVE_RX_TIME_LEN + GLOVE_TICK_LEN)
+#define GLOVE_TICK_US			10
+
+
+struct GloveDescriptor
+{
+	uint8_t nodeId;
+	uint8_t deviceId;
+	uint8_t mode;
+	uint8_t sampleId;
+	uint8_t packetId;
+	uint8_t time;			// GLOVE_TIME_TICK, GLOVE_TIME_RX: time stamps following the descriptor
+	uint32_t rxTime;		// valid with GLOVE_TIME_RX
+	uint16_t tick;			// valid with GLOVE_TIME_TICK
+};
+
+
+// returns true if the two bytes at data are the 0xAB 0xCD sync sequence
+inline bool glove_isSync(const uint8_t* data)
+{
+	return data[0] == GLOVE_SYNC_BYTE_1 && data[1] == GLOVE_SYNC_BYTE_2;
+}
+
+// split a 2 byte data descriptor into its fields, the time stamps are read by glove_parseTime().
+// Returns false if time flags are set outside packet 1
+inline bool glove_parseDescriptor(const uint8_t* data, GloveDescriptor &desc)
+{
+	desc.nodeId = data[0] >> 4;
+	desc.deviceId = data[0] & 0x07;
+	desc.mode = data[1] >> 5;
+	desc.sampleId = (data[1] >> 2) & 0x03;
+	desc.packetId = data[1] & 0x03;
+	desc.time = (data[0] & 0x08 ? GLOVE_TIME_TICK : 0) | (data[1] & 0x10 ? GLOVE_TIME_RX : 0);
+	desc.rxTime = 0;
+	desc.tick = 0;
+	return desc.time == 0 || desc.packetId == 1;
+}
+
+inline void glove_writeDescriptor(uint8_t* data, const GloveDescriptor &desc)
+{
+	data[0] = (desc.nodeId << 4) | (desc.time & GLOVE_TIME_TICK ? 0x08 : 0) | (desc.deviceId & 0x07);
+	data[1] = (desc.mode << 5) | (desc.time & GLOVE_TIME_RX ? 0x10 : 0) | ((desc.sampleId & 0x03) << 2) | (desc.packetId & 0x03);
+}
+
+// bytes of time stamps following the descriptor
+inline uint8_t glove_timeLen(const GloveDescriptor &desc)
+{
+	return (desc.time & GLOVE_TIME_RX ? GLOVE_RX_TIME_LEN : 0) + (desc.time & GLOVE_TIME_TICK ? GLOVE_TICK_LEN : 0);
+}
+
+// reads the glove_timeLen() bytes of time stamps at data
+inline void glove_parseTime(const uint8_t* data, GloveDescriptor &desc)
+{
+	if (desc.time & GLOVE_TIME_RX)
+	{
+		desc.rxTime = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+		data += GLOVE_RX_TIME_LEN;
+	}
+	if (desc.time & GLOVE_TIME_TICK)
+	{
+		desc.tick = data[0] | (data[1] << 8);
+	}
+}
+
+// writes the time stamps announced by desc.time to data, returns the end
+inline uint8_t* glove_writeTime(uint8_t* data, const GloveDescriptor &desc)
+{
+	if (desc.time & GLOVE_TIME_RX)
+	{
+		for (uint8_t i = 0; i < GLOVE_RX_TIME_LEN; ++i)
+		{
+			*data++ = (uint8_t)(desc.rxTime >> (8 * i));
+		}
+	}
+	if (desc.time & GLOVE_TIME_TICK)
+	{
+		*data++ = (uint8_t)desc.tick;
+		*data++ = (uint8_t)(desc.tick >> 8);
+	}
+	return data;
+}
+
+// reads the GLOVE_TELEMETRY_LEN bytes of a telemetry frame at data
+inline void glove_parseTelemetry(const GloveDescriptor &desc, const uint8_t* data, GloveTelemetry &telemetry)
+{
+	uint16_t values[GLOVE_TELEMETRY_LEN / 2];
+	for (uint8_t i = 0; i < GLOVE_TELEMETRY_LEN / 2; ++i)
+	{
+		values[i] = data[2 * i] | (data[2 * i + 1] << 8);
+	}
+	telemetry.nodeId = desc.nodeId;
+	telemetry.deviceId = desc.deviceId;
+	telemetry.period = values[0];
+	telemetry.polls = values[1];
+	telemetry.payloads = values[2];
+	telemetry.maxTry = values[3];
+	for (uint8_t i = 0; i < GLOVE_TELEMETRY_RTT_BINS; ++i)
+	{
+		telemetry.rtt[i] = values[4 + i];
+	}
+	telemetry.rttMax = values[4 + GLOVE_TELEMETRY_RTT_BINS];
+}
+
+// writes the data of a telemetry frame (GLOVE_TELEMETRY_LEN bytes), returns the end
+inline uint8_t* glove_writeTelemetry(const GloveTelemetry &telemetry, uint8_t* data)
+{
+	uint16_t values[GLOVE_TELEMETRY_LEN / 2];
+	values[0] = telemetry.period;
+	values[1] = telemetry.polls;
+	values[2] = telemetry.payloads;
+	values[3] = telemetry.maxTry;
+	for (uint8_t i = 0; i < GLOVE_TELEMETRY_RTT_BINS; ++i)
+	{
+		values[4 + i] = telemetry.rtt[i];
+	}
+	values[4 + GLOVE_TELEMETRY_RTT_BINS] = telemetry.rttMax;
+	for (uint8_t i = 0; i < GLOVE_TELEMETRY_LEN / 2; ++i)
+	{
+		*data++ = (uint8_t)values[i];
+		*data++ = (uint8_t)(values[i] >> 8);
+	}
+	return data;
+}
+
+// the Glove v2 firmware sends its tick in every mode but MODE_QUAT_S3, which fits a glove
+// into a single packet only without it
+inline bool glove_modeHasTick(uint8_t mode)
+{
+	return mode != MODE_QUAT_S3;
+}
+
+// Receive time as inserted by the base station: copies the len bytes of a payload to out
+// (at least len + GLOVE_RX_TIME_LEN bytes) with rxTime after the descriptor if it is a packet 1
+// (sync bytes) without one. Returns the length written.
+inline uint8_t glove_stampPacket(const uint8_t* data, uint8_t len, uint32_t rxTime, uint8_t* out)
+{
+	uint8_t header = GLOVE_SYNC_LEN + GLOVE_DESCRIPTOR_LEN;
+	bool stamp = len >= header && glove_isSync(data) && !(data[GLOVE_SYNC_LEN + 1] & 0x10);
+	uint8_t pos = 0;
+	for (uint8_t i = 0; i < len; ++i)
+	{
+		out[pos++] = data[i];
+		if (stamp && pos == header)
+		{
+			out[GLOVE_SYNC_LEN + 1] |= 0x10;
+			for (uint8_t k = 0; k < GLOVE_RX_TIME_LEN; ++k)
+			{
+				out[pos++] = (uint8_t)(rxTime >> (8 * k));
+			}
+		}
+	}
+	return pos;
+}
+
+
+// Layout of one packet's data (without sync and descriptor bytes).
+// A glove v2 in lin. acc. mode splits its 5th sensor across packets 2 and 3:
+// the quaternion is appended to packet 2, its lin. acc. leads packet 3.
+struct GlovePacketLayout
+{
+	uint8_t length;			// data length in bytes, without sync and descriptor
+	uint8_t numSamples;		// number of complete samples in this packet
+	uint8_t firstSensor;	// sensor index of the first complete sample
+	uint8_t sampleLen;		// bytes per complete sample
+	uint8_t splitQuat;		// 1: a compressed quaternion of sensor firstSensor + numSamples trails the samples
+	uint8_t splitLinAcc;	// 1: the lin. acc. of sensor firstSensor - 1 precedes the samples
+};
+
+
+// returns packet data length in bytes (without header bytes) or -1 if the combination is invalid
+int glove_getPacketLength(uint8_t mode, uint8_t deviceId, uint8_t packetId, uint8_t &numSamples);
+
+// fills in the layout of the given packet, the data after the time stamps (tick: packet 1 carries
+// the node's tick, see GLOVE_TIME_TICK). Returns false if the combination is invalid
+bool glove_getPacketLayout(uint8_t mode, uint8_t deviceId, uint8_t packetId, GlovePacketLayout &layout, bool tick = false);
+
+bool glove_isPacketValid(uint8_t mode, uint8_t deviceId, uint8_t packetId);
+
+// Plausibility of a descriptor beyond glove_parseDescriptor(): a valid mode, device and packet ID
+// combination (telemetry: packet 1), a tick only from a glove in a mode that sends one
+// (glove_modeHasTick()) and the receive time only in packet 1. The time flags took over the two
+// control bits that had to be 0, a descriptor alone no longer tells false sync bytes apart.
+bool glove_isDescriptorPlausible(const GloveDescriptor &desc);
+
+// Frames carry no length or checksum: the two bytes after a frame have to be sync bytes or the
+// plausible descriptor of a packet 2 or 3 (packet 1 always follows sync bytes)
+bool glove_canFollowFrame(const uint8_t* data);
+
+// number of packets a device sends per sample in the given mode (0 if invalid, the maximum in delta mode)
+uint8_t glove_getPacketCount(uint8_t mode, uint8_t deviceId);
+
+// number of sensors a device reports per sample in the given mode (0 if invalid)
+uint8_t glove_getSensorCount(uint8_t mode, uint8_t deviceId);
+
+// Delta mode packets have no fixed length, glove_getPacketLayout() only covers their
+// header. Returns the data length once the first available bytes tell it, 0 if more bytes
+// are needed and -1 if the header or width codes are invalid.
+int glove_getDeltaPacketLength(uint8_t deviceId, uint8_t packetId, const uint8_t* data, uint8_t available, bool tick = false);
+
+
+#endif /* GLOVEPROTOCOL_H_ */
@@ -0,0 +1,460 @@
+/*
+ * GloveRecording.cpp
+ *
+ * The on-disk structures are written and read with memcpy, this assumes a
+ * little endian host (x86, ARM Linux).
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "GloveRecording.h"
+
+
+static_assert(sizeof(GloveRecordingHeader) == 16, "file header layout");
+static_assert(sizeof(GloveChunkHeader) == 48, "chunk header layout");
+static_assert(sizeof(GloveChunkIndex) == 56, "chunk index layout");
+static_assert(sizeof(GloveRecordingFooter) == 16, "footer layout");
+
+
+// packet 1 frames start a sample
+static inline bool isSampleStart(const GloveFrame &frame)
+{
+	return !(frame.flags & GLOVE_FRAME_RAW) && frame.length >= GLOVE_DESCRIPTOR_LEN && (frame.data[1] & 0x03) == 1;
+}
+
+
+GloveRecordingWriter::GloveRecordingWriter() : fd(-1), writeError(0), chunkSize(0), interval(0), fileOffset(0),
+											   sampleCount(0), lastTime(0)
+{
+}
+
+GloveRecordingWriter::~GloveRecordingWriter()
+{
+	close();
+}
+
+
+bool GloveRecordingWriter::open(const char* path, uint64_t timeOrigin, uint32_t chunkSize, uint64_t interval)
+{
+	close();
+
+	fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	// record time offsets are 32 bit
+	this->chunkSize = chunkSize;
+	this->interval = interval < 0xFFFFFFFF ? interval : 0xFFFFFFFF;
+	writeError = 0;
+	sampleCount = 0;
+	lastTime = 0;
+	chunk.clear();
+	chunk.reserve(chunkSize + GLOVE_RECORD_HEADER_LEN + 255 + sizeof(GloveChunkHeader));
+	memset(&chunkHeader, 0, sizeof(chunkHeader));
+	index.clear();
+
+	GloveRecordingHeader header;
+	header.magic = GLOVE_RECORDING_MAGIC;
+	header.version = GLOVE_RECORDING_VERSION;
+	header.headerLength = sizeof(header);
+	header.timeOrigin = timeOrigin;
+	if (!writeAll(&header, sizeof(header)))
+	{
+		int err = errno;
+		::close(fd);
+		fd = -1;
+		errno = err;
+		return false;
+	}
+	fileOffset = sizeof(header);
+	return true;
+}
+
+bool GloveRecordingWriter::write(const GloveFrame &frame)
+{
+	if (fd < 0 || writeError)
+	{
+		return false;
+	}
+
+	uint64_t time = frame.hostTime > lastTime ? frame.hostTime : lastTime;
+	lastTime = time;
+
+	if (chunkHeader.recordCount > 0 && time - chunkHeader.firstTime >= interval && !flush())
+	{
+		return false;
+	}
+
+	if (chunkHeader.recordCount == 0)
+	{
+		chunk.resize(sizeof(GloveChunkHeader));
+		chunkHeader.magic = GLOVE_CHUNK_MAGIC;
+		chunkHeader.nodeMask = 0;
+		chunkHeader.firstTime = time;
+		chunkHeader.firstSample = sampleCount;
+	}
+
+	uint8_t recordHeader[GLOVE_RECORD_HEADER_LEN];
+	uint32_t timeOffset = (uint32_t)(time - chunkHeader.firstTime);
+	memcpy(recordHeader, &timeOffset, sizeof(timeOffset));
+	recordHeader[4] = frame.flags;
+	recordHeader[5] = frame.length;
+	chunk.insert(chunk.end(), recordHeader, recordHeader + sizeof(recordHeader));
+	chunk.insert(chunk.end(), frame.data, frame.data + frame.length);
+
+	++chunkHeader.recordCount;
+	chunkHeader.lastTime = time;
+	if (!(frame.flags & GLOVE_FRAME_RAW) && frame.length >= GLOVE_DESCRIPTOR_LEN)
+	{
+		chunkHeader.nodeMask |= 1 << (frame.data[0] >> 4);
+	}
+	if (isSampleStart(frame))
+	{
+		++sampleCount;
+	}
+	chunkHeader.endSample = sampleCount;
+
+	if (chunk.size() >= chunkSize)
+	{
+		return flush();
+	}
+	return true;
+}
+
+bool GloveRecordingWriter::flush()
+{
+	if (fd < 0 || chunkHeader.recordCount == 0)
+	{
+		return !writeError;
+	}
+
+	chunkHeader.dataLength = chunk.size() - sizeof(GloveChunkHeader);
+	memcpy(chunk.data(), &chunkHeader, sizeof(chunkHeader));
+	if (!writeAll(chunk.data(), chunk.size()))
+	{
+		return false;
+	}
+
+	GloveChunkIndex entry;
+	entry.offset = fileOffset;
+	entry.header = chunkHeader;
+	index.push_back(entry);
+
+	fileOffset += chunk.size();
+	chunk.clear();
+	chunkHeader.recordCount = 0;
+	return true;
+}
+
+bool GloveRecordingWriter::close()
+{
+	if (fd < 0)
+	{
+		return true;
+	}
+
+	bool ok = flush();
+	if (ok)
+	{
+		GloveRecordingFooter footer;
+		footer.indexOffset = fileOffset;
+		footer.chunkCount = index.size();
+		footer.magic = GLOVE_INDEX_MAGIC;
+		ok = writeAll(index.data(), index.size() * sizeof(GloveChunkIndex)) && writeAll(&footer, sizeof(footer));
+	}
+
+	if (::close(fd) != 0 && ok)
+	{
+		writeError = errno;
+		ok = false;
+	}
+	fd = -1;
+	return ok;
+}
+
+void GloveRecordingWriter::frameCallback(const GloveFrame &frame, void* context)
+{
+	((GloveRecordingWriter*)context)->write(frame);
+}
+
+
+bool GloveRecordingWriter::writeAll(const void* data, size_t len)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	while (len > 0)
+	{
+		ssize_t n = ::write(fd, bytes, len);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			writeError = errno;
+			return false;
+		}
+		bytes += n;
+		len -= n;
+	}
+	return true;
+}
+
+
+GloveRecordingReader::GloveRecordingReader() : fd(-1), data(0), size(0), recovered(false)
+{
+	memset(&header, 0, sizeof(header));
+}
+
+GloveRecordingReader::~GloveRecordingReader()
+{
+	close();
+}
+
+
+bool GloveRecordingReader::open(const char* path)
+{
+	close();
+
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		int err = errno;
+		close();
+		errno = err;
+		return false;
+	}
+	size = st.st_size;
+
+	if (size < sizeof(header))
+	{
+		close();
+		errno = EINVAL;
+		return false;
+	}
+
+	void* map = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+	{
+		int err = errno;
+		close();
+		errno = err;
+		return false;
+	}
+	data = (const uint8_t*)map;
+
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != GLOVE_RECORDING_MAGIC || header.version != GLOVE_RECORDING_VERSION ||
+		header.headerLength < sizeof(header) || header.headerLength > size)
+	{
+		close();
+		errno = EINVAL;
+		return false;
+	}
+
+	recovered = !loadIndex();
+	if (recovered)
+	{
+		rebuildIndex();
+	}
+	return true;
+}
+
+void GloveRecordingReader::close()
+{
+	if (data)
+	{
+		munmap((void*)data, size);
+		data = 0;
+	}
+	if (fd >= 0)
+	{
+		::close(fd);
+		fd = -1;
+	}
+	size = 0;
+	recovered = false;
+	index.clear();
+}
+
+
+uint64_t GloveRecordingReader::startTime() const
+{
+	return index.empty() ? 0 : index.front().header.firstTime;
+}
+
+uint64_t GloveRecordingReader::endTime() const
+{
+	return index.empty() ? 0 : index.back().header.lastTime;
+}
+
+
+GloveRecordingReader::Cursor GloveRecordingReader::begin() const
+{
+	return chunkBegin(0);
+}
+
+GloveRecordingReader::Cursor GloveRecordingReader::seek(uint64_t hostTime) const
+{
+	// first chunk that ends at or after hostTime
+	std::vector<GloveChunkIndex>::const_iterator it =
+		std::lower_bound(index.begin(), index.end(), hostTime,
+						 [](const GloveChunkIndex &entry, uint64_t time) { return entry.header.lastTime < time; });
+	if (it == index.end())
+	{
+		Cursor cursor = chunkBegin(index.size() - 1);
+		cursor.remaining = 0;
+		return cursor;
+	}
+
+	Cursor cursor = chunkBegin(it - index.begin());
+	Cursor nextCursor = cursor;
+	GloveFrame frame;
+	while (next(nextCursor, frame) && frame.hostTime < hostTime)
+	{
+		cursor = nextCursor;
+	}
+	return cursor;
+}
+
+GloveRecordingReader::Cursor GloveRecordingReader::seekSample(uint64_t sample) const
+{
+	std::vector<GloveChunkIndex>::const_iterator it =
+		std::lower_bound(index.begin(), index.end(), sample,
+						 [](const GloveChunkIndex &entry, uint64_t n) { return entry.header.endSample <= n; });
+	if (it == index.end())
+	{
+		Cursor cursor = chunkBegin(index.size() - 1);
+		cursor.remaining = 0;
+		return cursor;
+	}
+
+	uint64_t n = it->header.firstSample;
+	Cursor cursor = chunkBegin(it - index.begin());
+	Cursor nextCursor = cursor;
+	GloveFrame frame;
+	while (next(nextCursor, frame))
+	{
+		if (isSampleStart(frame) && n++ >= sample)
+		{
+			break;
+		}
+		cursor = nextCursor;
+	}
+	return cursor;
+}
+
+bool GloveRecordingReader::next(Cursor &cursor, GloveFrame &frame) const
+{
+	while (1)
+	{
+		while (cursor.remaining == 0)
+		{
+			if (cursor.chunk + 1 >= index.size())
+			{
+				return false;
+			}
+			cursor = chunkBegin(cursor.chunk + 1);
+		}
+
+		const GloveChunkIndex &entry = index[cursor.chunk];
+		uint64_t end = entry.offset + sizeof(GloveChunkHeader) + entry.header.dataLength;
+		if (cursor.offset + GLOVE_RECORD_HEADER_LEN > end ||
+			cursor.offset + GLOVE_RECORD_HEADER_LEN + data[cursor.offset + 5] > end)
+		{
+			// truncated chunk, continue with the next one
+			cursor.remaining = 0;
+			continue;
+		}
+
+		uint32_t timeOffset;
+		memcpy(&timeOffset, data + cursor.offset, sizeof(timeOffset));
+		frame.hostTime = entry.header.firstTime + timeOffset;
+		frame.flags = data[cursor.offset + 4];
+		frame.length = data[cursor.offset + 5];
+		frame.data = data + cursor.offset + GLOVE_RECORD_HEADER_LEN;
+
+		cursor.offset += GLOVE_RECORD_HEADER_LEN + frame.length;
+		--cursor.remaining;
+		return true;
+	}
+}
+
+
+bool GloveRecordingReader::loadIndex()
+{
+	GloveRecordingFooter footer;
+	if (size < header.headerLength + sizeof(footer))
+	{
+		return false;
+	}
+	memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+
+	if (footer.magic != GLOVE_INDEX_MAGIC || footer.indexOffset < header.headerLength ||
+		footer.indexOffset + (uint64_t)footer.chunkCount * sizeof(GloveChunkIndex) + sizeof(footer) != size)
+	{
+		return false;
+	}
+
+	index.resize(footer.chunkCount);
+	memcpy(index.data(), data + footer.indexOffset, index.size() * sizeof(GloveChunkIndex));
+
+	for (size_t i = 0; i < index.size(); ++i)
+	{
+		const GloveChunkIndex &entry = index[i];
+		if (entry.header.magic != GLOVE_CHUNK_MAGIC ||
+			entry.offset + sizeof(GloveChunkHeader) + entry.header.dataLength > footer.indexOffset)
+		{
+			index.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+void GloveRecordingReader::rebuildIndex()
+{
+	// walk the chunk headers, a partially written chunk at the end is dropped
+	index.clear();
+	uint64_t pos = header.headerLength;
+	while (pos + sizeof(GloveChunkHeader) <= size)
+	{
+		GloveChunkIndex entry;
+		entry.offset = pos;
+		memcpy(&entry.header, data + pos, sizeof(entry.header));
+		if (entry.header.magic != GLOVE_CHUNK_MAGIC || pos + sizeof(GloveChunkHeader) + entry.header.dataLength > size)
+		{
+			break;
+		}
+		index.push_back(entry);
+		pos += sizeof(GloveChunkHeader) + entry.header.dataLength;
+	}
+}
+
+GloveRecordingReader::Cursor GloveRecordingReader::chunkBegin(size_t chunk) const
+{
+	Cursor cursor;
+	cursor.chunk = chunk;
+	cursor.offset = 0;
+	cursor.remaining = 0;
+	if (chunk < index.size())
+	{
+		cursor.offset = index[chunk].offset + sizeof(GloveChunkHeader);
+		cursor.remaining = index[chunk].header.recordCount;
+	}
+	return cursor;
+}
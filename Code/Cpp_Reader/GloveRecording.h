@@ -0,0 +1,190 @@
+/*
+ * GloveRecording.h
+ *
+ * Append-only binary session file (.glr) holding the frames received from the
+ * base station together with their host time stamps.
+ *
+ * File structure (little endian)
+ *******************************************************************************
+ * file header    'GLRC', version, header length, time origin
+ * chunk 0        chunk header (time range, node mask, sample range) + records
+ * chunk 1        ...
+ * ...
+ * chunk index    one GloveChunkIndex per chunk
+ * footer         index offset, chunk count, 'GIDX'
+ *******************************************************************************
+ * record:        time offset to the chunk's first time (4 bytes, us) | flags | length | data
+ *
+ * A chunk is written with a single write() once it is full or old enough, so a
+ * crash loses at most the last chunk. Index and footer are only written by
+ * close(); without them the reader rebuilds the index from the chunk headers.
+ *
+ * The sample number counts the packet 1 frames (one per node and sample) since
+ * the start of the recording, it extends the 2 bit sample ID of the descriptor.
+ */
+
+
+#ifndef GLOVERECORDING_H_
+#define GLOVERECORDING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "GloveDecoder.h"
+
+
+#define GLOVE_RECORDING_MAGIC		0x43524C47		// "GLRC"
+#define GLOVE_CHUNK_MAGIC			0x4B484347		// "GCHK"
+#define GLOVE_INDEX_MAGIC			0x58444947		// "GIDX"
+#define GLOVE_RECORDING_VERSION		1
+
+#define GLOVE_RECORD_HEADER_LEN		6
+
+#define GLOVE_CHUNK_DEFAULT_SIZE		(64 * 1024)
+#define GLOVE_CHUNK_DEFAULT_INTERVAL	1000000		// us
+
+
+struct GloveRecordingHeader
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t headerLength;
+	uint64_t timeOrigin;		// host time of the start of the session, time 0 of the CSV export
+};
+
+struct GloveChunkHeader
+{
+	uint32_t magic;
+	uint32_t dataLength;		// bytes of records following the header
+	uint32_t recordCount;
+	uint16_t nodeMask;			// bit n set: chunk holds frames of node n
+	uint16_t reserved;
+	uint64_t firstTime;			// host time of the first and last record
+	uint64_t lastTime;
+	uint64_t firstSample;		// sample number of the first packet 1 frame and one past the last one
+	uint64_t endSample;			// (equal if the chunk holds no packet 1 frame)
+};
+
+struct GloveChunkIndex
+{
+	uint64_t offset;			// file offset of the chunk header
+	GloveChunkHeader header;
+};
+
+struct GloveRecordingFooter
+{
+	uint64_t indexOffset;
+	uint32_t chunkCount;
+	uint32_t magic;
+};
+
+
+class GloveRecordingWriter
+{
+public:
+	GloveRecordingWriter();
+	~GloveRecordingWriter();
+
+	// A chunk is written once it holds chunkSize bytes or spans interval us.
+	// Returns false (errno set) if the file can't be created.
+	bool open(const char* path, uint64_t timeOrigin, uint32_t chunkSize = GLOVE_CHUNK_DEFAULT_SIZE,
+			  uint64_t interval = GLOVE_CHUNK_DEFAULT_INTERVAL);
+
+	// host times must not decrease, earlier times are stored as the last time
+	bool write(const GloveFrame &frame);
+
+	// writes the current chunk
+	bool flush();
+
+	// writes the current chunk, index and footer
+	bool close();
+
+	bool isOpen() const { return fd >= 0; }
+
+	// true once a write failed, errno of the failure is kept in error()
+	bool failed() const { return writeError != 0; }
+	int error() const { return writeError; }
+
+	// GloveDecoder::FrameCallback, context is the writer
+	static void frameCallback(const GloveFrame &frame, void* context);
+
+private:
+	int fd;
+	int writeError;
+	uint32_t chunkSize;
+	uint64_t interval;
+	uint64_t fileOffset;
+	uint64_t sampleCount;
+	uint64_t lastTime;
+
+	std::vector<uint8_t> chunk;		// chunk header + records
+	GloveChunkHeader chunkHeader;
+	std::vector<GloveChunkIndex> index;
+
+	GloveRecordingWriter(const GloveRecordingWriter&);
+	GloveRecordingWriter& operator=(const GloveRecordingWriter&);
+
+	bool writeAll(const void* data, size_t len);
+};
+
+
+class GloveRecordingReader
+{
+public:
+	// position of the next record to read
+	struct Cursor
+	{
+		size_t chunk;
+		uint64_t offset;
+		uint32_t remaining;		// records left in the chunk
+	};
+
+	GloveRecordingReader();
+	~GloveRecordingReader();
+
+	// maps the file and loads the index. Returns false (errno set) if it isn't a recording
+	bool open(const char* path);
+	void close();
+
+	// true if the footer was missing (e.g. after a crash) and the index was rebuilt
+	bool isRecovered() const { return recovered; }
+
+	uint64_t timeOrigin() const { return header.timeOrigin; }
+	uint64_t startTime() const;
+	uint64_t endTime() const;
+	uint64_t fileSize() const { return size; }
+
+	size_t chunkCount() const { return index.size(); }
+	const GloveChunkIndex& chunk(size_t i) const { return index[i]; }
+
+	Cursor begin() const;
+
+	// first record with host time >= hostTime, O(log n) over the chunks
+	Cursor seek(uint64_t hostTime) const;
+
+	// first packet 1 frame of the given sample number or later
+	Cursor seekSample(uint64_t sample) const;
+
+	// returns false at the end of the recording. frame.data points into the mapped file
+	bool next(Cursor &cursor, GloveFrame &frame) const;
+
+private:
+	int fd;
+	const uint8_t* data;
+	uint64_t size;
+	bool recovered;
+	GloveRecordingHeader header;
+	std::vector<GloveChunkIndex> index;
+
+	GloveRecordingReader(const GloveRecordingReader&);
+	GloveRecordingReader& operator=(const GloveRecordingReader&);
+
+	bool loadIndex();
+	void rebuildIndex();
+	Cursor chunkBegin(size_t chunk) const;
+};
+
+
+#endif /* GLOVERECORDING_H_ */
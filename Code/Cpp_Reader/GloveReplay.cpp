@@ -0,0 +1,127 @@
+/*
+ * GloveReplay.cpp
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "GloveReplay.h"
+
+
+static uint64_t monotonicUs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+GloveReplay::GloveReplay(const GloveRecordingReader &reader) : reader(reader), speed(1)
+{
+	start(reader.begin());
+}
+
+void GloveReplay::start(GloveRecordingReader::Cursor cursor, uint64_t endTime)
+{
+	this->cursor = cursor;
+	this->endTime = endTime;
+	inFrame = false;
+	frameOffset = 0;
+	readTime = 0;
+	started = false;
+	finished = false;
+	firstTime = 0;
+	wallStart = 0;
+	memset(&replayStats, 0, sizeof(replayStats));
+}
+
+void GloveReplay::pace(uint64_t hostTime)
+{
+	if (replayStats.reads++ == 0)
+	{
+		firstTime = hostTime;
+		wallStart = monotonicUs();
+		return;
+	}
+	if (speed <= 0)
+	{
+		return;
+	}
+
+	uint64_t due = wallStart + (uint64_t)((hostTime - firstTime) / speed);
+	uint64_t now = monotonicUs();
+	if (now < due)
+	{
+		struct timespec ts;
+		ts.tv_sec = due / 1000000;
+		ts.tv_nsec = (due % 1000000) * 1000;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR)
+		{
+		}
+	}
+	else if (now - due > replayStats.maxLate)
+	{
+		replayStats.maxLate = now - due;
+	}
+}
+
+size_t GloveReplay::read(uint8_t* dest, size_t maxLen, uint64_t &hostTime)
+{
+	static const uint8_t sync[GLOVE_SYNC_LEN] = { GLOVE_SYNC_BYTE_1, GLOVE_SYNC_BYTE_2 };
+
+	size_t len = 0;
+	while (len < maxLen && !finished)
+	{
+		if (!inFrame)
+		{
+			GloveRecordingReader::Cursor next = cursor;
+			GloveFrame nextFrame;
+			if (!reader.next(next, nextFrame) || nextFrame.hostTime >= endTime)
+			{
+				finished = true;
+				break;
+			}
+			if (!started || nextFrame.hostTime != readTime)
+			{
+				// the frame belongs to the next read
+				if (len > 0)
+				{
+					break;
+				}
+				pace(nextFrame.hostTime);
+				readTime = nextFrame.hostTime;
+				started = true;
+			}
+			cursor = next;
+			frame = nextFrame;
+			inFrame = true;
+			frameOffset = 0;
+		}
+
+		size_t syncLen = frame.flags & GLOVE_FRAME_SYNC ? GLOVE_SYNC_LEN : 0;
+		if (frameOffset < syncLen)
+		{
+			size_t n = syncLen - frameOffset < maxLen - len ? syncLen - frameOffset : maxLen - len;
+			memcpy(dest + len, sync + frameOffset, n);
+			len += n;
+			frameOffset += n;
+		}
+		if (frameOffset >= syncLen)
+		{
+			size_t offset = frameOffset - syncLen;
+			size_t n = frame.length - offset < maxLen - len ? frame.length - offset : maxLen - len;
+			memcpy(dest + len, frame.data + offset, n);
+			len += n;
+			frameOffset += n;
+			if (offset + n >= frame.length)
+			{
+				inFrame = false;
+			}
+		}
+	}
+
+	replayStats.bytes += len;
+	hostTime = readTime;
+	return len;
+}
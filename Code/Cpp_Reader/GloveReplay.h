@@ -0,0 +1,78 @@
+/*
+ * GloveReplay.h
+ *
+ * Plays a session file back as the byte stream it was recorded from. The
+ * frames are written back with their sync bytes, skipped bytes included, so
+ * the stream is byte for byte the one the decoder received. Frames with the
+ * same host time came from one read() of the serial port and are handed out
+ * together, at the pace they were received (speed 1), N times faster or as
+ * fast as the consumer takes them (speed 0). The bytes are copied straight
+ * from the mapped file into the consumer's buffer, e.g. the ring buffer of a
+ * GloveDecoder.
+ */
+
+
+#ifndef GLOVEREPLAY_H_
+#define GLOVEREPLAY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "GloveRecording.h"
+
+
+struct GloveReplayStats
+{
+	uint64_t reads;				// original reads played back
+	uint64_t bytes;
+	uint64_t maxLate;			// us a read was handed out after its time, at most (paced playback)
+};
+
+
+class GloveReplay
+{
+public:
+	// the reader must stay open while the replay is used
+	explicit GloveReplay(const GloveRecordingReader &reader);
+
+	// 1 = real time, N = N times faster, 0 = unthrottled
+	void setSpeed(double speed) { this->speed = speed; }
+
+	// starts (over) at cursor and ends before the first frame at or after endTime
+	void start(GloveRecordingReader::Cursor cursor, uint64_t endTime = UINT64_MAX);
+
+	// Copies up to maxLen bytes of the next read to dest, after waiting for its time when paced. A
+	// read longer than maxLen is continued with the next call. hostTime is the recorded time of
+	// the read. Returns the number of bytes, 0 at the end.
+	size_t read(uint8_t* dest, size_t maxLen, uint64_t &hostTime);
+
+	bool isFinished() const { return finished; }
+
+	const GloveReplayStats& stats() const { return replayStats; }
+
+private:
+	const GloveRecordingReader &reader;
+	double speed;
+	GloveRecordingReader::Cursor cursor;
+	uint64_t endTime;
+
+	GloveFrame frame;			// frame being copied
+	bool inFrame;
+	size_t frameOffset;			// bytes of sync + data copied already
+	uint64_t readTime;			// host time of the current read
+	bool started;
+	bool finished;
+
+	uint64_t firstTime;			// host time of the first read and wall time it was handed out at
+	uint64_t wallStart;
+
+	GloveReplayStats replayStats;
+
+	GloveReplay(const GloveReplay&);
+	GloveReplay& operator=(const GloveReplay&);
+
+	void pace(uint64_t hostTime);
+};
+
+
+#endif /* GLOVEREPLAY_H_ */
@@ -0,0 +1,306 @@
+/*
+ * GloveShm.cpp
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "GloveShm.h"
+
+
+static_assert(sizeof(GloveShmSample) == 48, "GloveShmSample is part of the segment format");
+static_assert(sizeof(GloveShmHeader) == 64, "GloveShmHeader is part of the segment format");
+static_assert(sizeof(GloveShmSlot) == 64, "one slot per cache line");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the segment is shared by processes");
+
+
+static uint64_t monotonicUs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void glove_shmToSample(const GloveShmSample &record, GloveSample &sample)
+{
+	sample.hostTime = record.hostTime;
+	sample.sampleTime = record.sampleTime;
+	sample.nodeId = record.nodeId;
+	sample.deviceId = record.deviceId;
+	sample.mode = record.mode;
+	sample.sampleId = record.sampleId;
+	sample.sensorId = record.sensorId;
+	sample.flags = record.flags;
+	memcpy(sample.quat, record.quat, sizeof(sample.quat));
+	memcpy(sample.linAcc, record.linAcc, sizeof(sample.linAcc));
+}
+
+
+GloveShmPublisher::GloveShmPublisher() : header(0), slots(0), size(0)
+{
+	name[0] = 0;
+}
+
+GloveShmPublisher::~GloveShmPublisher()
+{
+	close();
+}
+
+bool GloveShmPublisher::create(const char* name, size_t slotCount)
+{
+	close();
+	if (strlen(name) >= sizeof(this->name) || slotCount < 2)
+	{
+		errno = EINVAL;
+		return false;
+	}
+
+	// a new segment instead of reusing the old one: its readers keep their mapping and see it closed
+	shm_unlink(name);
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0)
+	{
+		return false;
+	}
+	size_t size = sizeof(GloveShmHeader) + slotCount * sizeof(GloveShmSlot);
+	void* map = MAP_FAILED;
+	if (ftruncate(fd, size) == 0)
+	{
+		map = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	int error = errno;
+	::close(fd);
+	if (map == MAP_FAILED)
+	{
+		shm_unlink(name);
+		errno = error;
+		return false;
+	}
+
+	// the pages come zeroed: every slot has sequence 0, which no sample ever has
+	header = (GloveShmHeader*)map;
+	slots = (GloveShmSlot*)((uint8_t*)map + sizeof(GloveShmHeader));
+	this->size = size;
+	strcpy(this->name, name);
+
+	header->version = GLOVE_SHM_VERSION;
+	header->slotCount = slotCount;
+	header->startTime = monotonicUs();
+	header->publisherPid = getpid();
+	header->head.store(0, std::memory_order_relaxed);
+	header->closed.store(0, std::memory_order_relaxed);
+	// readers check the magic last
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = GLOVE_SHM_MAGIC;
+	return true;
+}
+
+void GloveShmPublisher::close()
+{
+	if (header)
+	{
+		header->closed.store(1, std::memory_order_release);
+		munmap(header, size);
+		shm_unlink(name);
+		header = 0;
+		slots = 0;
+	}
+}
+
+void GloveShmPublisher::publish(const GloveSample &sample)
+{
+	uint64_t index = header->head.load(std::memory_order_relaxed);
+	GloveShmSlot &slot = slots[index % header->slotCount];
+
+	// readers still copying the sample a ring back see the mark change
+	slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	GloveShmSample &record = slot.record;
+	record.hostTime = sample.hostTime;
+	record.sampleTime = sample.sampleTime;
+	record.nodeId = sample.nodeId;
+	record.deviceId = sample.deviceId;
+	record.mode = sample.mode;
+	record.sampleId = sample.sampleId;
+	record.sensorId = sample.sensorId;
+	record.flags = sample.flags;
+	record.reserved = 0;
+	memcpy(record.quat, sample.quat, sizeof(record.quat));
+	memcpy(record.linAcc, sample.linAcc, sizeof(record.linAcc));
+	record.reserved2 = 0;
+	record.publishTime = monotonicUs();
+
+	slot.sequence.store(2 * index + 2, std::memory_order_release);
+	header->head.store(index + 1, std::memory_order_release);
+}
+
+uint64_t GloveShmPublisher::samples() const
+{
+	return header ? header->head.load(std::memory_order_relaxed) : 0;
+}
+
+void GloveShmPublisher::sampleCallback(const GloveSample &sample, void* context)
+{
+	((GloveShmPublisher*)context)->publish(sample);
+}
+
+
+GloveShmSubscriber::GloveShmSubscriber() : header(0), slots(0), size(0)
+{
+}
+
+GloveShmSubscriber::~GloveShmSubscriber()
+{
+	close();
+}
+
+bool GloveShmSubscriber::open(const char* name)
+{
+	close();
+	int fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat st;
+	void* map = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(GloveShmHeader))
+	{
+		map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	else
+	{
+		errno = EINVAL;
+	}
+	int error = errno;
+	::close(fd);
+	if (map == MAP_FAILED)
+	{
+		errno = error;
+		return false;
+	}
+
+	const GloveShmHeader* mapped = (const GloveShmHeader*)map;
+	bool valid = mapped->magic == GLOVE_SHM_MAGIC;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	valid = valid && mapped->version == GLOVE_SHM_VERSION && mapped->slotCount >= 2 &&
+			sizeof(GloveShmHeader) + mapped->slotCount * sizeof(GloveShmSlot) <= (size_t)st.st_size;
+	if (!valid)
+	{
+		munmap(map, st.st_size);
+		errno = EINVAL;
+		return false;
+	}
+
+	header = mapped;
+	slots = (const GloveShmSlot*)((const uint8_t*)map + sizeof(GloveShmHeader));
+	size = st.st_size;
+	return true;
+}
+
+void GloveShmSubscriber::close()
+{
+	if (header)
+	{
+		munmap((void*)header, size);
+		header = 0;
+		slots = 0;
+	}
+}
+
+void GloveShmSubscriber::attach(GloveShmReader &reader) const
+{
+	reader.cursor = header->head.load(std::memory_order_acquire);
+	reader.samples = 0;
+	reader.overruns = 0;
+}
+
+bool GloveShmSubscriber::read(GloveShmReader &reader, GloveShmSample &record) const
+{
+	uint64_t slotCount = header->slotCount;
+	while (1)
+	{
+		uint64_t published = header->head.load(std::memory_order_acquire);
+		if (reader.cursor >= published)
+		{
+			return false;
+		}
+		if (published - reader.cursor >= slotCount)
+		{
+			// the publisher took the reader's slot already: continue half a ring behind it
+			uint64_t next = published - slotCount / 2;
+			reader.overruns += next - reader.cursor;
+			reader.cursor = next;
+		}
+
+		const GloveShmSlot &slot = slots[reader.cursor % slotCount];
+		uint64_t sequence = 2 * reader.cursor + 2;
+		if (slot.sequence.load(std::memory_order_acquire) == sequence)
+		{
+			memcpy(&record, &slot.record, sizeof(record));
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.sequence.load(std::memory_order_relaxed) == sequence)
+			{
+				++reader.cursor;
+				++reader.samples;
+				return true;
+			}
+		}
+
+		// overwritten while it was copied, what record got is garbage
+		++reader.overruns;
+		++reader.cursor;
+	}
+}
+
+bool GloveShmSubscriber::wait(const GloveShmReader &reader, uint32_t timeout_us, uint32_t spin_us) const
+{
+	uint64_t start = monotonicUs();
+	uint64_t now = start;
+	while (1)
+	{
+		if (reader.cursor < header->head.load(std::memory_order_acquire))
+		{
+			return true;
+		}
+		if (isClosed() || now - start >= timeout_us)
+		{
+			return false;
+		}
+		if (now - start < spin_us)
+		{
+			// keeps the latency of a reader that is on time below the scheduler's
+			sched_yield();
+		}
+		else
+		{
+			struct timespec ts = { 0, 50000 };
+			nanosleep(&ts, 0);
+		}
+		now = monotonicUs();
+	}
+}
+
+bool GloveShmSubscriber::isClosed() const
+{
+	return header->closed.load(std::memory_order_acquire) != 0;
+}
+
+uint64_t GloveShmSubscriber::samples() const
+{
+	return header->head.load(std::memory_order_acquire);
+}
+
+pid_t GloveShmSubscriber::publisherPid() const
+{
+	return header->publisherPid;
+}
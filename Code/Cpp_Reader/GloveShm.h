@@ -0,0 +1,163 @@
+/*
+ * GloveShm.h
+ *
+ * Sample bus in POSIX shared memory for consumers on the same machine
+ * (recorder, display, gesture model): one ingest process decodes the stream
+ * and writes every sample into a ring of fixed-layout records
+ * (GloveShmSample), any number of processes map it read-only and follow with
+ * a cursor of their own. Reading a sample is a few loads from the mapping, no
+ * system call; only a reader that has caught up sleeps (GloveShmSubscriber::wait).
+ *
+ * Like GloveChunkRing, each slot is a seqlock: the publisher marks the slot
+ * odd before it writes the record and even once it is complete, readers copy
+ * the record and check the mark before and after. A reader that falls a whole
+ * ring behind loses the samples it missed (overruns) and continues half a
+ * ring behind the publisher, the publisher never waits for a reader.
+ *
+ * Segment (native byte order, shared by processes of one machine)
+ *******************************************************************************
+ * header         magic 'GSHM', version, slot count, publisher PID, start time,
+ *                head (samples published), closed flag          64 bytes
+ * slot 0         sequence (2 * sample + 1 while written, 2 * sample + 2 after),
+ *                GloveShmSample                                 64 bytes
+ * slot 1         ...
+ *******************************************************************************
+ * All times are us of CLOCK_MONOTONIC, which all processes share.
+ */
+
+
+#ifndef GLOVESHM_H_
+#define GLOVESHM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+
+#include "GloveDecoder.h"
+
+
+#define GLOVE_SHM_MAGIC				0x4D485347		// "GSHM"
+#define GLOVE_SHM_VERSION			1
+#define GLOVE_SHM_DEFAULT_NAME		"/glove"
+#define GLOVE_SHM_SLOTS				65536			// samples, 15 s of 6 glove v2 in mode 1
+
+
+// one decoded sample, the layout is part of the segment format
+struct GloveShmSample
+{
+	uint64_t hostTime;			// read() of the bytes that completed the sample returned (GloveSample::hostTime)
+	uint64_t sampleTime;		// GloveSample::sampleTime
+	uint64_t publishTime;		// the sample was written to the ring
+	uint8_t nodeId;
+	uint8_t deviceId;
+	uint8_t mode;
+	uint8_t sampleId;
+	uint8_t sensorId;
+	uint8_t flags;				// GLOVE_SAMPLE_HAS_W, GLOVE_SAMPLE_HAS_LINACC
+	uint16_t reserved;
+	int16_t quat[4];			// raw Q14 W, X, Y, Z
+	int16_t linAcc[3];			// raw, 1 m/s^2 = 100 LSB
+	uint16_t reserved2;
+};
+
+void glove_shmToSample(const GloveShmSample &record, GloveSample &sample);
+
+
+struct GloveShmHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t slotCount;
+	uint64_t startTime;					// creation of the segment
+	int32_t publisherPid;
+	uint32_t reserved;
+	std::atomic<uint64_t> head;			// samples published
+	std::atomic<uint32_t> closed;
+	uint8_t padding[20];
+};
+
+struct GloveShmSlot
+{
+	std::atomic<uint64_t> sequence;		// 2 * sample + 1 while it is written, 2 * sample + 2 once published
+	GloveShmSample record;
+	uint8_t padding[8];
+};
+
+
+// cursor of one consumer, used by one thread only
+struct GloveShmReader
+{
+	uint64_t cursor;			// next sample to read
+	uint64_t samples;
+	uint64_t overruns;			// samples lost because the publisher overtook the reader
+};
+
+
+class GloveShmPublisher
+{
+public:
+	GloveShmPublisher();
+	~GloveShmPublisher();
+
+	// creates the segment (replacing one of the same name, readers of the old one see it closed)
+	bool create(const char* name = GLOVE_SHM_DEFAULT_NAME, size_t slotCount = GLOVE_SHM_SLOTS);
+	// marks the segment closed and removes the name, mapped readers can still read it
+	void close();
+
+	void publish(const GloveSample &sample);
+
+	uint64_t samples() const;
+
+	// sample callback of GloveDecoder, context is the publisher
+	static void sampleCallback(const GloveSample &sample, void* context);
+
+private:
+	GloveShmHeader* header;
+	GloveShmSlot* slots;
+	size_t size;
+	char name[64];
+
+	GloveShmPublisher(const GloveShmPublisher&);
+	GloveShmPublisher& operator=(const GloveShmPublisher&);
+};
+
+
+class GloveShmSubscriber
+{
+public:
+	GloveShmSubscriber();
+	~GloveShmSubscriber();
+
+	// maps the segment read-only, false if it does not exist or is not a sample bus
+	bool open(const char* name = GLOVE_SHM_DEFAULT_NAME);
+	void close();
+	bool isOpen() const { return header != 0; }
+
+	// reads from the next published sample on
+	void attach(GloveShmReader &reader) const;
+
+	// Copies the reader's next sample to record. Returns false if there is none.
+	bool read(GloveShmReader &reader, GloveShmSample &record) const;
+
+	// Waits up to timeout_us for a sample the reader has not read: spins for spin_us first, then
+	// sleeps in steps of 50 us. Returns false on timeout and once the segment is closed and read.
+	bool wait(const GloveShmReader &reader, uint32_t timeout_us, uint32_t spin_us = 20) const;
+
+	// the publisher closed the segment (or a new one replaced it)
+	bool isClosed() const;
+	uint64_t samples() const;
+	pid_t publisherPid() const;
+
+private:
+	const GloveShmHeader* header;
+	const GloveShmSlot* slots;
+	size_t size;
+
+	GloveShmSubscriber(const GloveShmSubscriber&);
+	GloveShmSubscriber& operator=(const GloveShmSubscriber&);
+};
+
+
+#endif /* GLOVESHM_H_ */
@@ -0,0 +1,554 @@
+/*
+ * GloveSimulator.cpp
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "GloveDecoder.h"
+#include "GloveEncoder.h"
+#include "GloveSimulator.h"
+
+
+// xorshift32, the same seed gives the same stream
+static double xorshift(uint32_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state / 4294967296.0;
+}
+
+// telemetry counts stop at their maximum like on the base station
+static void saturatingAdd(uint16_t &count, uint32_t n)
+{
+	count = count + n < 0xFFFF ? count + n : 0xFFFF;
+}
+
+static int16_t toQ14(double value)
+{
+	return (int16_t)lrint(value * GLOVE_QUAT_SCALE);
+}
+
+// slow rotation about a wandering axis, different for every node and sensor
+static void simulateSensor(uint8_t nodeId, uint8_t sensorId, uint64_t time, GloveSample &sample)
+{
+	double t = time / 1e6;
+	double angle = 2 * M_PI * (0.2 + 0.05 * sensorId) * t + nodeId;
+	double axisAngle = 0.3 * t + sensorId;
+	double ax = sin(axisAngle);
+	double ay = cos(axisAngle);
+	double az = 0.5;
+	double norm = sqrt(ax * ax + ay * ay + az * az);
+	double s = sin(angle / 2) / norm;
+
+	sample.quat[0] = toQ14(cos(angle / 2));
+	sample.quat[1] = toQ14(ax * s);
+	sample.quat[2] = toQ14(ay * s);
+	sample.quat[3] = toQ14(az * s);
+
+	double phase = 2 * M_PI * 1.3 * t + sensorId;
+	sample.linAcc[0] = (int16_t)lrint(300 * sin(phase));
+	sample.linAcc[1] = (int16_t)lrint(200 * cos(phase));
+	sample.linAcc[2] = (int16_t)lrint(100 * sin(2 * phase));
+}
+
+
+GloveSimConfig GloveSimulator::defaultConfig()
+{
+	GloveSimConfig config;
+	config.nodeCount[DEVICE_SINGLE_NODE] = 0;
+	config.nodeCount[DEVICE_GLOVE_V1] = 0;
+	config.nodeCount[DEVICE_GLOVE_V2] = 2;
+	config.mode = MODE_QUAT;
+	config.lossRate = 0;
+	config.reorderRate = 0;
+	config.baudrate = 500000;
+	config.usb = false;
+	config.radioTimeScale = 1;
+	config.star = false;
+	config.timeStamps = true;
+	config.clockDrift = 50;
+	config.telemetryPeriod = 1000;
+	config.samplePeriod = 10000;
+	config.seed = 1;
+	return config;
+}
+
+
+GloveSimulator::GloveSimulator(const GloveSimConfig &config) : config(config), currentNode(0), currentMode(config.mode),
+															   now(0), serialFree(0), emptyRound(0), random(config.seed ? config.seed : 1),
+															   telemetryTime(0), holding(false)
+{
+	memset(&simStats, 0, sizeof(simStats));
+
+	// the clocks take their own random numbers, a seed gives the same streams with and without time stamps
+	uint32_t clockRandom = random ^ 0x5EED71CC;
+	baseClockRate = 1 + (2 * xorshift(clockRandom) - 1) * config.clockDrift * 1e-6;
+	baseClockOffset = (uint32_t)(xorshift(clockRandom) * 4294967296.0);
+
+	// node IDs in the order single nodes, glove v1, glove v2 (the order of NRF_address), star: node ID = pipe
+	size_t maxNodes = config.star ? GLOVE_SIM_STAR_PIPES : GLOVE_SIM_MAX_NODES;
+	for (uint8_t deviceId = DEVICE_SINGLE_NODE; deviceId <= DEVICE_GLOVE_V2; ++deviceId)
+	{
+		for (uint8_t i = 0; i < config.nodeCount[deviceId] && nodes.size() < maxNodes; ++i)
+		{
+			Node node;
+			node.nodeId = nodes.size();
+			node.deviceId = deviceId;
+			node.mode = glove_getPacketCount(currentMode, deviceId) > 0 ? currentMode : (uint8_t)MODE_QUAT;
+			node.sampleId = 0;
+			// nodes are started at different times
+			node.nextSample = (uint64_t)(nextRandom() * config.samplePeriod);
+			node.clockRate = 1 + (2 * xorshift(clockRandom) - 1) * config.clockDrift * 1e-6;
+			node.clockOffset = (uint64_t)(xorshift(clockRandom) * 65536 * GLOVE_TICK_US);
+			node.txEnd = 0;
+			node.nextAttempt = 0;
+			node.retries = 0;
+			node.txLost = false;
+			memset(&node.link, 0, sizeof(node.link));
+			node.link.nodeId = node.nodeId;
+			node.link.deviceId = deviceId;
+			nodes.push_back(node);
+		}
+	}
+}
+
+
+void GloveSimulator::run(uint64_t until, std::vector<uint8_t> &out)
+{
+	if (nodes.empty())
+	{
+		now = until;
+	}
+	while (now < until)
+	{
+		if (config.star)
+		{
+			starStep();
+		}
+		else
+		{
+			poll();
+		}
+	}
+
+	while (!serial.empty() && serial.front().doneTime <= until)
+	{
+		out.insert(out.end(), serial.front().data.begin(), serial.front().data.end());
+		serial.pop_front();
+	}
+}
+
+void GloveSimulator::setMode(uint8_t mode)
+{
+	if (mode < GLOVE_MODE_COUNT)
+	{
+		currentMode = mode;
+	}
+}
+
+
+double GloveSimulator::nextRandom()
+{
+	return xorshift(random);
+}
+
+void GloveSimulator::sample(Node &node)
+{
+	uint64_t sampleTime = node.nextSample;
+	// modeIsValid() of the firmware: a node keeps its mode if it does not support the new one
+	if (glove_getPacketCount(currentMode, node.deviceId) > 0 && node.mode != currentMode)
+	{
+		node.mode = currentMode;
+		node.delta.reset();
+	}
+
+	GloveSample sensors[GLOVE_MAX_SENSORS];
+	memset(sensors, 0, sizeof(sensors));
+	uint8_t sensorCount = glove_getSensorCount(node.mode, node.deviceId);
+	for (uint8_t i = 0; i < sensorCount; ++i)
+	{
+		simulateSensor(node.nodeId, i, sampleTime, sensors[i]);
+		if (node.deviceId != DEVICE_SINGLE_NODE && sensors[i].quat[0] < 0)
+		{
+			// W is dropped, BNO_Read_Quaternion_Compressed() sends the equivalent quaternion with W >= 0
+			sensors[i].quat[0] = -sensors[i].quat[0];
+			sensors[i].quat[1] = -sensors[i].quat[1];
+			sensors[i].quat[2] = -sensors[i].quat[2];
+			sensors[i].quat[3] = -sensors[i].quat[3];
+		}
+	}
+
+	uint32_t readTime = GLOVE_SIM_READ_QUAT_US + (glove_modeHasLinAcc(node.mode) ? GLOVE_SIM_READ_LINACC_US : 0);
+
+	GloveDescriptor desc;
+	desc.nodeId = node.nodeId;
+	desc.deviceId = node.deviceId;
+	desc.mode = node.mode;
+	desc.sampleId = node.sampleId;
+	desc.time = 0;
+	if (config.timeStamps && node.deviceId != DEVICE_SINGLE_NODE && glove_modeHasTick(node.mode))
+	{
+		desc.time = GLOVE_TIME_TICK;
+		desc.tick = (uint16_t)((uint64_t)(sampleTime * node.clockRate + node.clockOffset) / GLOVE_TICK_US);
+	}
+
+	if (glove_isDeltaMode(node.mode))
+	{
+		uint8_t data[GLOVE_DELTA_MAX_PACKETS][GLOVE_DESCRIPTOR_LEN + GLOVE_PAYLOAD_MAX_LEN];
+		uint8_t lengths[GLOVE_DELTA_MAX_PACKETS];
+		int count = node.delta.encode(desc, sensors, data[0], lengths);
+		for (int i = 0; i < count; ++i)
+		{
+			// header byte 1: first sensor | sensor count << 3, after the tick in packet 1
+			Packet packet;
+			uint8_t header = data[i][GLOVE_DESCRIPTOR_LEN + (i == 0 ? glove_timeLen(desc) : 0) + 1];
+			packet.readyTime = sampleTime + ((header & 0x07) + (header >> 3)) * readTime;
+
+			uint8_t* out = packet.data;
+			if (i == 0)
+			{
+				*out++ = GLOVE_SYNC_BYTE_1;
+				*out++ = GLOVE_SYNC_BYTE_2;
+			}
+			memcpy(out, data[i], lengths[i]);
+			packet.length = (out - packet.data) + lengths[i];
+			node.pending.push_back(packet);
+		}
+	}
+
+	uint8_t packetCount = glove_isDeltaMode(node.mode) ? 0 : glove_getPacketCount(node.mode, node.deviceId);
+	for (desc.packetId = 1; desc.packetId <= packetCount; ++desc.packetId)
+	{
+		GlovePacketLayout layout;
+		glove_getPacketLayout(desc.mode, desc.deviceId, desc.packetId, layout, desc.time & GLOVE_TIME_TICK);
+
+		// written to the ack FIFO once its last sensor has been read
+		Packet packet;
+		uint8_t sensorsRead = layout.firstSensor + layout.numSamples + layout.splitQuat;
+		packet.readyTime = sampleTime + sensorsRead * readTime;
+
+		uint8_t* data = packet.data;
+		if (desc.packetId == 1)
+		{
+			*data++ = GLOVE_SYNC_BYTE_1;
+			*data++ = GLOVE_SYNC_BYTE_2;
+		}
+		packet.length = (data - packet.data) + glove_encodePacket(desc, sensors, data);
+		node.pending.push_back(packet);
+	}
+
+	// the firmware waits for the rest of the sample period, unless reading took longer
+	uint64_t sampleEnd = sampleTime + sensorCount * readTime;
+	node.nextSample = sampleTime + config.samplePeriod > sampleEnd ? sampleTime + config.samplePeriod : sampleEnd;
+	node.sampleId = (node.sampleId + 1) & 0x03;
+}
+
+void GloveSimulator::updateFifo(Node &node)
+{
+	while (node.nextSample <= now)
+	{
+		sample(node);
+	}
+	while (!node.pending.empty() && node.pending.front().readyTime <= now)
+	{
+		if (node.fifo.size() < GLOVE_SIM_FIFO_LEN)
+		{
+			node.fifo.push_back(node.pending.front());
+		}
+		else
+		{
+			// the firmware drops the packet, delta mode restarts with absolute values
+			++simStats.fifoOverflows;
+			node.delta.reset();
+		}
+		node.pending.pop_front();
+	}
+}
+
+void GloveSimulator::receive(Packet &packet)
+{
+	if (config.timeStamps)
+	{
+		uint8_t data[GLOVE_PAYLOAD_MAX_LEN];
+		memcpy(data, packet.data, packet.length);
+		packet.length = glove_stampPacket(data, packet.length, (uint32_t)(now * baseClockRate) + baseClockOffset, packet.data);
+	}
+}
+
+void GloveSimulator::writeSerial(const Packet &packet)
+{
+	queueSerial(packet.data, packet.length);
+	++simStats.packets;
+	simStats.bytes += packet.length;
+}
+
+void GloveSimulator::queueSerial(const uint8_t* data, uint8_t length)
+{
+	// pc.write() is retried until the previous transfer completed
+	uint64_t start = now;
+	if ((config.baudrate > 0 || config.usb) && serialFree > now)
+	{
+		simStats.serialWaitTime += serialFree - now;
+		start = serialFree;
+		if (!config.star)
+		{
+			// polls stop meanwhile, in the star topology the radio goes on
+			now = serialFree;
+		}
+	}
+	serialFree = start;
+	if (config.usb)
+	{
+		serialFree += (uint64_t)(length + GLOVE_SIM_USB_PACKET_LEN - 1) / GLOVE_SIM_USB_PACKET_LEN * GLOVE_SIM_USB_PACKET_US;
+	}
+	else if (config.baudrate > 0)
+	{
+		// 8N1: 10 bits per byte
+		serialFree += (uint64_t)length * 10 * 1000000 / config.baudrate;
+	}
+
+	SerialChunk chunk;
+	chunk.doneTime = serialFree;
+	chunk.data.assign(data, data + length);
+	serial.push_back(chunk);
+}
+
+void GloveSimulator::pollDone(Node &node, bool ack, uint32_t pollTime)
+{
+	// same counts as LinkTelemetry::pollDone() of the base station
+	uint32_t rtt = (uint32_t)(pollTime * config.radioTimeScale);
+	uint8_t bin = rtt / GLOVE_TELEMETRY_RTT_BIN_US;
+	saturatingAdd(node.link.polls, 1);
+	saturatingAdd(node.link.maxTry, ack ? 0 : 1);
+	saturatingAdd(node.link.rtt[bin < GLOVE_TELEMETRY_RTT_BINS ? bin : GLOVE_TELEMETRY_RTT_BINS - 1], 1);
+	if (rtt > node.link.rttMax)
+	{
+		node.link.rttMax = rtt < 0xFFFF ? rtt : 0xFFFF;
+	}
+}
+
+void GloveSimulator::writeTelemetry()
+{
+	uint32_t period = (uint32_t)((now - telemetryTime) / 1000);
+	telemetryTime = now;
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		GloveTelemetry &link = nodes[i].link;
+		link.period = period < 0xFFFF ? period : 0xFFFF;
+
+		uint8_t frame[GLOVE_SYNC_LEN + GLOVE_DESCRIPTOR_LEN + GLOVE_TELEMETRY_LEN];
+		GloveDescriptor desc;
+		desc.nodeId = link.nodeId;
+		desc.deviceId = link.deviceId;
+		desc.mode = GLOVE_MODE_TELEMETRY;
+		desc.sampleId = simStats.telemetryFrames & 0x03;
+		desc.packetId = 1;
+		desc.time = 0;
+		frame[0] = GLOVE_SYNC_BYTE_1;
+		frame[1] = GLOVE_SYNC_BYTE_2;
+		glove_writeDescriptor(frame + GLOVE_SYNC_LEN, desc);
+		glove_writeTelemetry(link, frame + GLOVE_SYNC_LEN + GLOVE_DESCRIPTOR_LEN);
+		queueSerial(frame, sizeof(frame));
+		++simStats.telemetryFrames;
+		simStats.bytes += sizeof(frame);
+
+		uint8_t nodeId = link.nodeId, deviceId = link.deviceId;
+		memset(&link, 0, sizeof(link));
+		link.nodeId = nodeId;
+		link.deviceId = deviceId;
+	}
+}
+
+void GloveSimulator::poll()
+{
+	if (config.telemetryPeriod && now - telemetryTime >= config.telemetryPeriod * 1000ULL)
+	{
+		writeTelemetry();
+	}
+
+	Node &node = nodes[currentNode];
+	updateFifo(node);
+	++simStats.polls;
+
+	if (node.fifo.empty())
+	{
+		// empty ack, select next node
+		++simStats.emptyPolls;
+		pollDone(node, true, GLOVE_SIM_POLL_US);
+		advance(GLOVE_SIM_POLL_US);
+		currentNode = (currentNode + 1) % nodes.size();
+		if (config.radioTimeScale <= 0 && ++emptyRound >= nodes.size())
+		{
+			skipToNextPacket();
+		}
+		return;
+	}
+	emptyRound = 0;
+
+	Packet packet = node.fifo.front();
+	node.fifo.pop_front();
+
+	if (nextRandom() < config.lossRate)
+	{
+		// maxTry after one retry, the node drops the payload with the next poll
+		++simStats.lostPackets;
+		pollDone(node, false, 2 * GLOVE_SIM_POLL_US + GLOVE_SIM_RETRY_US);
+		advance(2 * GLOVE_SIM_POLL_US + GLOVE_SIM_RETRY_US);
+		currentNode = (currentNode + 1) % nodes.size();
+		return;
+	}
+
+	pollDone(node, true, GLOVE_SIM_POLL_US + packet.length * GLOVE_SIM_POLL_BYTE_US);
+	saturatingAdd(node.link.payloads, 1);
+	advance(GLOVE_SIM_POLL_US + packet.length * GLOVE_SIM_POLL_BYTE_US);
+	receive(packet);
+
+	if (!holding && nextRandom() < config.reorderRate)
+	{
+		held = packet;
+		holding = true;
+		++simStats.reorderedPackets;
+		return;
+	}
+
+	writeSerial(packet);
+	if (holding)
+	{
+		writeSerial(held);
+		holding = false;
+	}
+}
+
+void GloveSimulator::advance(uint32_t pollTime)
+{
+	now += (uint64_t)(pollTime * config.radioTimeScale);
+}
+
+void GloveSimulator::skipToNextPacket()
+{
+	// ideal radio: all nodes were polled without data, nothing happens until the next packet is ready
+	uint64_t next = UINT64_MAX;
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		const Node &node = nodes[i];
+		uint64_t ready = node.pending.empty() ? node.nextSample : node.pending.front().readyTime;
+		if (ready < next)
+		{
+			next = ready;
+		}
+	}
+	if (next > now)
+	{
+		now = next;
+	}
+	emptyRound = 0;
+}
+
+
+void GloveSimulator::starStep()
+{
+	// next event: a transmission ends, a node may start one or samples / gets a packet ready
+	uint64_t next = UINT64_MAX;
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		Node &node = nodes[i];
+		updateFifo(node);
+		uint64_t event;
+		if (node.txEnd)
+		{
+			event = node.txEnd;
+		}
+		else if (!node.fifo.empty())
+		{
+			event = node.nextAttempt > now ? node.nextAttempt : now;
+		}
+		else
+		{
+			event = node.pending.empty() ? node.nextSample : node.pending.front().readyTime;
+		}
+		if (event < next)
+		{
+			next = event;
+		}
+	}
+	if (next > now)
+	{
+		now = next;
+	}
+
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		updateFifo(nodes[i]);
+		if (nodes[i].txEnd && nodes[i].txEnd <= now)
+		{
+			endTransmission(nodes[i]);
+		}
+	}
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		Node &node = nodes[i];
+		if (!node.txEnd && !node.fifo.empty() && node.nextAttempt <= now)
+		{
+			startTransmission(node);
+		}
+	}
+}
+
+void GloveSimulator::startTransmission(Node &node)
+{
+	++simStats.polls;
+	uint32_t airTime = GLOVE_SIM_STAR_TX_US(node.fifo.front().length) + GLOVE_SIM_STAR_ACK_US;
+	// at least 1 us, txEnd = 0 means idle
+	node.txEnd = now + 1 + (uint64_t)(airTime * config.radioTimeScale);
+	node.txLost = nextRandom() < config.lossRate;
+
+	// no carrier sense: a transmission in progress and this one garble each other
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		Node &other = nodes[i];
+		if (&other != &node && other.txEnd > now)
+		{
+			if (!other.txLost)
+			{
+				++simStats.collisions;
+				other.txLost = true;
+			}
+			if (!node.txLost)
+			{
+				++simStats.collisions;
+				node.txLost = true;
+			}
+		}
+	}
+}
+
+void GloveSimulator::endTransmission(Node &node)
+{
+	node.txEnd = 0;
+	if (!node.txLost)
+	{
+		receive(node.fifo.front());
+		writeSerial(node.fifo.front());
+		node.fifo.pop_front();
+		node.retries = 0;
+		node.nextAttempt = now;
+		return;
+	}
+
+	if (node.retries < GLOVE_SIM_STAR_RETRIES)
+	{
+		++node.retries;
+		++simStats.retransmissions;
+		node.nextAttempt = now + (uint64_t)(GLOVE_SIM_STAR_ARD_US(node.nodeId) * config.radioTimeScale);
+		return;
+	}
+
+	// MAX_RT: sendPendingPackets() flushes the TX FIFO, delta mode restarts with absolute values
+	simStats.lostPackets += node.fifo.size();
+	node.fifo.clear();
+	node.delta.reset();
+	node.retries = 0;
+	node.nextAttempt = now;
+}
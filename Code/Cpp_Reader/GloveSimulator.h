@@ -0,0 +1,198 @@
+/*
+ * GloveSimulator.h
+ *
+ * Model of the base station and its nodes, producing the byte stream the
+ * base station writes to the serial port (Code/BaseStation/main.cpp).
+ *
+ * The simulation runs in virtual time (us). Every node samples its IMUs every
+ * samplePeriod and writes its packets to the ack payload FIFO of its nRF
+ * (3 entries, further packets are dropped) as they become ready. The base
+ * station polls the nodes round robin: it stays with a node as long as it
+ * answers with a payload, moves on after an empty ack or a failed transmission
+ * (maxTry), and forwards every payload to the serial port, waiting for the
+ * previous serial write to complete. The serial port is either the UART of the
+ * ST-Link (10 bits per byte) or the native USB CDC link (HOST_LINK_USB), which
+ * sends every write as 64 byte full speed bulk packets.
+ *
+ * With star set (RADIO_STAR of the base station) there are no polls: every
+ * node sends its FIFO on its own to its RX pipe, a packet takes the air time of
+ * the packet and its ack. Transmissions of two nodes that overlap are both
+ * lost, a lost transmission is repeated after the node's auto retransmit delay
+ * and after GLOVE_SIM_STAR_RETRIES the node drops its FIFO (MAX_RT). The radio
+ * does not wait for the serial port, the base station queues the payloads.
+ *
+ * With timeStamps set the gloves send their tick (GLOVE_TIME_TICK) and the
+ * base station inserts its receive time, every clock off by up to clockDrift.
+ *
+ * With telemetryPeriod set the base station sends a telemetry frame per node
+ * (GLOVE_MODE_TELEMETRY) with the counts of its polls every telemetryPeriod ms
+ * (poll loop only, like TELEMETRY_PERIOD_MS of the base station).
+ *
+ * Single nodes are simulated with the packet protocol of read_glove.py (sync
+ * bytes, descriptor, full quaternion), not with the older 10/16 byte payload
+ * of Code/Node/Node/main.c.
+ */
+
+
+#ifndef GLOVESIMULATOR_H_
+#define GLOVESIMULATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <vector>
+
+#include "GloveEncoder.h"
+#include "GloveProtocol.h"
+
+
+#define GLOVE_SIM_MAX_NODES			16		// 4 bit node ID
+#define GLOVE_SIM_FIFO_LEN			3		// nRF24L01+ TX FIFO (ack payloads)
+
+// timing estimates of the Nrf24l01p driver at 1 Mbps (blocking writeTXData, wait_us(1) per SPI access)
+#define GLOVE_SIM_POLL_US			250		// poll with an empty ack
+#define GLOVE_SIM_POLL_BYTE_US		12		// per byte of ack payload (air time + SPI readout)
+#define GLOVE_SIM_RETRY_US			500		// setRetries(500, 1)
+
+// star topology: at most 6 RX pipes, air time of a packet (settling, preamble, address, control field,
+// CRC) and of its ack at 1 Mbps, auto retransmit delay of pipe p (STAR_RETRY_DELAY in config.h of the nodes)
+#define GLOVE_SIM_STAR_PIPES		6
+#define GLOVE_SIM_STAR_TX_US(len)	(130 + ((len) + 9) * 8)
+#define GLOVE_SIM_STAR_ACK_US		(130 + 9 * 8)
+#define GLOVE_SIM_STAR_ARD_US(pipe)	(250 + 750 * (pipe))
+#define GLOVE_SIM_STAR_RETRIES		5
+
+// native USB: ~1 MB/s of bulk packets with one device on the bus (at most 19 per 1 ms frame)
+#define GLOVE_SIM_USB_PACKET_LEN	64
+#define GLOVE_SIM_USB_PACKET_US		64
+
+// IMU read time per sensor at SCL_CLOCK 400 kHz including BNO_MUX_Select
+#define GLOVE_SIM_READ_QUAT_US		400
+#define GLOVE_SIM_READ_LINACC_US	300
+
+
+struct GloveSimConfig
+{
+	uint8_t nodeCount[3];		// number of nodes per device ID
+	uint8_t mode;
+	double lossRate;			// probability of a failed poll (the payload is lost)
+	double reorderRate;			// probability that a payload is forwarded after the next one
+	uint32_t baudrate;			// serial port, 0 = unlimited
+	bool usb;					// native USB link instead of the UART, baudrate is ignored
+	double radioTimeScale;		// scales the poll times, 0 = ideal radio (polls take no time)
+	bool star;					// star topology instead of polls (at most GLOVE_SIM_STAR_PIPES nodes)
+	bool timeStamps;			// tick of the gloves and receive time of the base station
+	double clockDrift;			// ppm, the clocks of the nodes and the base station deviate up to this
+	uint32_t telemetryPeriod;	// ms, 0 = no telemetry frames
+	uint32_t samplePeriod;		// us
+	uint32_t seed;
+};
+
+struct GloveSimStats
+{
+	uint64_t polls;				// star: transmissions
+	uint64_t emptyPolls;
+	uint64_t packets;			// payloads written to the serial port
+	uint64_t lostPackets;		// failed polls, star: packets dropped by MAX_RT
+	uint64_t collisions;		// star: transmissions lost because another node sent at the same time
+	uint64_t retransmissions;	// star
+	uint64_t reorderedPackets;
+	uint64_t fifoOverflows;		// packets dropped because the node's ack FIFO was full
+	uint64_t telemetryFrames;	// not counted as packets
+	uint64_t bytes;
+	uint64_t serialWaitTime;	// us the base station waited for the serial port
+};
+
+
+class GloveSimulator
+{
+public:
+	GloveSimulator(const GloveSimConfig &config);
+
+	// config with the defaults of the base station (2 glove v2, 100 Hz, 500000 baud, no loss)
+	static GloveSimConfig defaultConfig();
+
+	// Simulates up to virtual time 'until' and appends the bytes whose serial
+	// transmission completed by then to out.
+	void run(uint64_t until, std::vector<uint8_t> &out);
+
+	// like pressing the user button: nodes switch to this mode with their next poll
+	void setMode(uint8_t mode);
+	uint8_t mode() const { return currentMode; }
+
+	uint64_t time() const { return now; }
+	size_t nodeCount() const { return nodes.size(); }
+	const GloveSimStats& stats() const { return simStats; }
+
+private:
+	struct Packet
+	{
+		uint64_t readyTime;
+		uint8_t length;
+		uint8_t data[GLOVE_PAYLOAD_MAX_LEN + GLOVE_RX_TIME_LEN];
+	};
+
+	struct Node
+	{
+		uint8_t nodeId;
+		uint8_t deviceId;
+		uint8_t mode;
+		uint8_t sampleId;
+		uint64_t nextSample;
+		double clockRate;				// node clock us per simulated us
+		uint64_t clockOffset;
+		GloveDeltaEncoder delta;
+		std::deque<Packet> pending;		// sampled, not yet written to the ack FIFO
+		std::deque<Packet> fifo;
+
+		// star topology
+		uint64_t txEnd;					// transmission of fifo.front() incl. ack ends, 0 = idle
+		uint64_t nextAttempt;			// after the auto retransmit delay
+		uint8_t retries;
+		bool txLost;
+		GloveTelemetry link;			// poll counts since the last telemetry frame
+	};
+
+	struct SerialChunk
+	{
+		uint64_t doneTime;
+		std::vector<uint8_t> data;
+	};
+
+	GloveSimConfig config;
+	std::vector<Node> nodes;
+	size_t currentNode;
+	uint8_t currentMode;
+	uint64_t now;
+	uint64_t serialFree;		// time the last serial write completes
+	size_t emptyRound;			// consecutive empty polls
+	uint32_t random;
+	double baseClockRate;
+	uint32_t baseClockOffset;
+
+	uint64_t telemetryTime;		// last telemetry frames
+	bool holding;				// payload held back for reordering
+	Packet held;
+	std::deque<SerialChunk> serial;		// written, not yet transmitted completely
+
+	GloveSimStats simStats;
+
+	double nextRandom();
+	void sample(Node &node);
+	void updateFifo(Node &node);
+	void receive(Packet &packet);
+	void writeSerial(const Packet &packet);
+	void queueSerial(const uint8_t* data, uint8_t length);
+	void pollDone(Node &node, bool ack, uint32_t pollTime);
+	void writeTelemetry();
+	void advance(uint32_t pollTime);
+	void skipToNextPacket();
+	void poll();
+	void starStep();
+	void startTransmission(Node &node);
+	void endTransmission(Node &node);
+};
+
+
+#endif /* GLOVESIMULATOR_H_ */
@@ -0,0 +1,265 @@
+/*
+ * GloveStore.cpp
+ */
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "GloveStore.h"
+#include "QuatKernel.h"
+
+
+const char* const glove_storeColumnNames[STORE_COLUMN_COUNT] = { "qx", "qy", "qz", "qw", "ax", "ay", "az" };
+
+
+static size_t pageAlign(size_t bytes)
+{
+	static const size_t page = sysconf(_SC_PAGESIZE);
+	return (bytes + page - 1) / page * page;
+}
+
+
+GloveSessionStore::GloveSessionStore(size_t capacity) : capacity(capacity), originSet(false), origin(0), sampleCount(0),
+														droppedCount(0), batchFlags(0), batchLen(0),
+														batchStreams(GLOVE_STORE_BATCH_LEN), batchTimes(GLOVE_STORE_BATCH_LEN),
+														raw(GLOVE_STORE_BATCH_LEN * 7), rows(GLOVE_STORE_BATCH_LEN * 7)
+{
+	timeBytes = pageAlign(capacity * sizeof(int64_t));
+	columnBytes = pageAlign(capacity * sizeof(float));
+	memset(streams, 0, sizeof(streams));
+}
+
+GloveSessionStore::~GloveSessionStore()
+{
+	for (uint8_t n = 0; n < GLOVE_STORE_NODES; ++n)
+	{
+		for (uint8_t s = 0; s < GLOVE_MAX_SENSORS; ++s)
+		{
+			if (streams[n][s].base)
+			{
+				munmap(streams[n][s].base, timeBytes + STORE_COLUMN_COUNT * columnBytes);
+			}
+		}
+	}
+}
+
+
+void GloveSessionStore::setTimeOrigin(uint64_t sampleTime)
+{
+	origin = sampleTime;
+	originSet = true;
+}
+
+GloveSessionStore::Stream* GloveSessionStore::stream(uint8_t nodeId, uint8_t sensorId)
+{
+	if (nodeId >= GLOVE_STORE_NODES || sensorId >= GLOVE_MAX_SENSORS)
+	{
+		return 0;
+	}
+	Stream &stream = streams[nodeId][sensorId];
+	if (!stream.base && !reserve(stream))
+	{
+		return 0;
+	}
+	return &stream;
+}
+
+bool GloveSessionStore::reserve(Stream &stream)
+{
+	// address space only, pages are committed by commit()
+	void* base = mmap(0, timeBytes + STORE_COLUMN_COUNT * columnBytes, PROT_NONE,
+					  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (base == MAP_FAILED)
+	{
+		return false;
+	}
+	stream.base = (uint8_t*)base;
+	stream.count = 0;
+	stream.committed = 0;
+	stream.time = (int64_t*)base;
+	for (int c = 0; c < STORE_COLUMN_COUNT; ++c)
+	{
+		stream.columns[c] = (float*)(stream.base + timeBytes + c * columnBytes);
+	}
+	return true;
+}
+
+bool GloveSessionStore::commit(Stream &stream)
+{
+	if (stream.committed >= capacity)
+	{
+		return false;
+	}
+	size_t next = std::min(stream.committed + GLOVE_STORE_CHUNK, capacity);
+
+	// from the page holding the first new sample on, each column on its own
+	size_t from = stream.committed * sizeof(int64_t) / pageAlign(1) * pageAlign(1);
+	if (mprotect(stream.base + from, pageAlign(next * sizeof(int64_t)) - from, PROT_READ | PROT_WRITE) != 0)
+	{
+		return false;
+	}
+	from = stream.committed * sizeof(float) / pageAlign(1) * pageAlign(1);
+	for (int c = 0; c < STORE_COLUMN_COUNT; ++c)
+	{
+		if (mprotect((uint8_t*)stream.columns[c] + from, pageAlign(next * sizeof(float)) - from, PROT_READ | PROT_WRITE) != 0)
+		{
+			return false;
+		}
+	}
+	stream.committed = next;
+	return true;
+}
+
+
+void GloveSessionStore::append(const GloveSample &sample)
+{
+	if (!originSet)
+	{
+		setTimeOrigin(sample.sampleTime);
+	}
+	Stream* target = stream(sample.nodeId, sample.sensorId);
+	if (!target)
+	{
+		++droppedCount;
+		return;
+	}
+
+	// lin. acc. columns like GloveCsvWriter: zero for a split sample that misses them
+	uint8_t flags = sample.flags & GLOVE_SAMPLE_HAS_W;
+	if (glove_modeHasLinAcc(sample.mode))
+	{
+		flags |= GLOVE_SAMPLE_HAS_LINACC;
+	}
+	if (batchLen > 0 && flags != batchFlags)
+	{
+		storeBatch();
+	}
+	batchFlags = flags;
+
+	size_t i = batchLen++;
+	batchStreams[i] = target;
+	batchTimes[i] = (int64_t)(sample.sampleTime - origin);
+
+	int16_t* dest = &raw[i * glove_kernelSampleLen(flags)];
+	if (flags & GLOVE_SAMPLE_HAS_W)
+	{
+		*dest++ = sample.quat[0];
+	}
+	dest[0] = sample.quat[1];
+	dest[1] = sample.quat[2];
+	dest[2] = sample.quat[3];
+	if (flags & GLOVE_SAMPLE_HAS_LINACC)
+	{
+		dest[3] = sample.linAcc[0];
+		dest[4] = sample.linAcc[1];
+		dest[5] = sample.linAcc[2];
+	}
+
+	if (batchLen == GLOVE_STORE_BATCH_LEN)
+	{
+		storeBatch();
+	}
+}
+
+void GloveSessionStore::finish()
+{
+	if (batchLen > 0)
+	{
+		storeBatch();
+	}
+}
+
+void GloveSessionStore::storeBatch()
+{
+	glove_dequantize(raw.data(), batchLen, batchFlags, rows.data());
+
+	size_t rowLen = glove_kernelRowLen(batchFlags);
+	const double* row = rows.data();
+	for (size_t i = 0; i < batchLen; ++i, row += rowLen)
+	{
+		Stream &stream = *batchStreams[i];
+		if (stream.count >= stream.committed && !commit(stream))
+		{
+			++droppedCount;
+			continue;
+		}
+		size_t k = stream.count++;
+		stream.time[k] = batchTimes[i];
+		for (size_t c = 0; c < STORE_COLUMN_COUNT; ++c)
+		{
+			stream.columns[c][k] = c < rowLen ? (float)row[c] : 0.0f;
+		}
+		++sampleCount;
+	}
+	batchLen = 0;
+}
+
+
+bool GloveSessionStore::hasStream(uint8_t nodeId, uint8_t sensorId) const
+{
+	return size(nodeId, sensorId) > 0;
+}
+
+size_t GloveSessionStore::size(uint8_t nodeId, uint8_t sensorId) const
+{
+	if (nodeId >= GLOVE_STORE_NODES || sensorId >= GLOVE_MAX_SENSORS)
+	{
+		return 0;
+	}
+	return streams[nodeId][sensorId].count;
+}
+
+GloveStoreSlice GloveSessionStore::slice(uint8_t nodeId, uint8_t sensorId, size_t begin, size_t end) const
+{
+	GloveStoreSlice slice;
+	memset(&slice, 0, sizeof(slice));
+	size_t count = size(nodeId, sensorId);
+	end = std::min(end, count);
+	if (begin >= end)
+	{
+		return slice;
+	}
+
+	const Stream &stream = streams[nodeId][sensorId];
+	slice.count = end - begin;
+	slice.time = stream.time + begin;
+	for (int c = 0; c < STORE_COLUMN_COUNT; ++c)
+	{
+		slice.columns[c] = stream.columns[c] + begin;
+	}
+	return slice;
+}
+
+size_t GloveSessionStore::lowerBound(uint8_t nodeId, uint8_t sensorId, int64_t time) const
+{
+	size_t count = size(nodeId, sensorId);
+	if (count == 0)
+	{
+		return 0;
+	}
+	// the sample times of a stream ascend, unless its node's clock jumped back (see GloveClock)
+	const int64_t* times = streams[nodeId][sensorId].time;
+	return std::lower_bound(times, times + count, time) - times;
+}
+
+size_t GloveSessionStore::memoryUsed() const
+{
+	size_t bytes = 0;
+	for (uint8_t n = 0; n < GLOVE_STORE_NODES; ++n)
+	{
+		for (uint8_t s = 0; s < GLOVE_MAX_SENSORS; ++s)
+		{
+			size_t committed = streams[n][s].committed;
+			bytes += pageAlign(committed * sizeof(int64_t)) + STORE_COLUMN_COUNT * pageAlign(committed * sizeof(float));
+		}
+	}
+	return bytes;
+}
+
+void GloveSessionStore::sampleCallback(const GloveSample &sample, void* context)
+{
+	((GloveSessionStore*)context)->append(sample);
+}
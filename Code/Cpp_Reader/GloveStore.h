@@ -0,0 +1,133 @@
+/*
+ * GloveStore.h
+ *
+ * Columnar in-memory store of a decoded session. read_glove.py keeps all
+ * samples in one float64 array of rows [ID, ts, qx, qy, qz, qw, ax, ay, az],
+ * so the trajectory of one sensor takes a scan over all of them. Here each
+ * (node, sensor) stream has its own columns: a time column (int64, us since
+ * the time origin) and the seven values of read_glove.py's row as float32,
+ * each of them contiguous. A stream's samples are a range of indices, a time
+ * range is found by binary search over its time column.
+ *
+ * The columns of a stream are reserved in address space for its capacity up
+ * front and committed in chunks of GLOVE_STORE_CHUNK samples as they fill,
+ * so appending never moves data: pointers handed out (e.g. to numpy through
+ * the buffer protocol of glovestore.cpp) stay valid while the store grows.
+ * 36 bytes per sample instead of 72.
+ */
+
+
+#ifndef GLOVESTORE_H_
+#define GLOVESTORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "GloveDecoder.h"
+
+
+#define GLOVE_STORE_NODES			16
+#define GLOVE_STORE_CHUNK			1024			// samples committed at a time (one page of a value column)
+#define GLOVE_STORE_CAPACITY		(1 << 24)		// samples per stream, 46 h at 100 Hz
+#define GLOVE_STORE_BATCH_LEN		1024
+
+
+// value columns in read_glove.py's order (after the axis remap of QuatKernel.h)
+enum GloveStoreColumn
+{
+	STORE_QX,
+	STORE_QY,
+	STORE_QZ,
+	STORE_QW,
+	STORE_AX,					// m/s^2, 0 in modes without lin. acc.
+	STORE_AY,
+	STORE_AZ,
+	STORE_COLUMN_COUNT
+};
+
+extern const char* const glove_storeColumnNames[STORE_COLUMN_COUNT];
+
+
+// samples [begin, end) of one stream, pointers into the store
+struct GloveStoreSlice
+{
+	size_t count;
+	const int64_t* time;
+	const float* columns[STORE_COLUMN_COUNT];
+};
+
+
+class GloveSessionStore
+{
+public:
+	// capacity: samples per stream, address space is reserved for it on the stream's first sample
+	explicit GloveSessionStore(size_t capacity = GLOVE_STORE_CAPACITY);
+	~GloveSessionStore();
+
+	// times are stored relative to it (default: sample time of the first sample)
+	void setTimeOrigin(uint64_t sampleTime);
+	uint64_t timeOrigin() const { return origin; }
+
+	// Samples are converted in batches with glove_dequantize(), they are visible once their batch
+	// is done: after finish() or GLOVE_STORE_BATCH_LEN further samples.
+	void append(const GloveSample &sample);
+	void finish();
+
+	bool hasStream(uint8_t nodeId, uint8_t sensorId) const;
+	size_t size(uint8_t nodeId, uint8_t sensorId) const;
+
+	// O(1), clamped to the stream's samples
+	GloveStoreSlice slice(uint8_t nodeId, uint8_t sensorId, size_t begin = 0, size_t end = SIZE_MAX) const;
+
+	// first sample of the stream at or after time (us since the time origin), O(log n)
+	size_t lowerBound(uint8_t nodeId, uint8_t sensorId, int64_t time) const;
+
+	uint64_t samples() const { return sampleCount; }
+	// samples lost because their stream was full or its memory could not be committed
+	uint64_t dropped() const { return droppedCount; }
+	// committed bytes of all columns
+	size_t memoryUsed() const;
+
+	// GloveDecoder::SampleCallback, context is the store
+	static void sampleCallback(const GloveSample &sample, void* context);
+
+private:
+	struct Stream
+	{
+		uint8_t* base;			// reservation: time column, then the value columns
+		size_t count;
+		size_t committed;		// samples the committed pages hold
+		int64_t* time;
+		float* columns[STORE_COLUMN_COUNT];
+	};
+
+	size_t capacity;
+	size_t timeBytes;			// reserved bytes of the time column and of a value column
+	size_t columnBytes;
+	Stream streams[GLOVE_STORE_NODES][GLOVE_MAX_SENSORS];
+
+	bool originSet;
+	uint64_t origin;
+	uint64_t sampleCount;
+	uint64_t droppedCount;
+
+	uint8_t batchFlags;
+	size_t batchLen;
+	std::vector<Stream*> batchStreams;
+	std::vector<int64_t> batchTimes;
+	std::vector<int16_t> raw;
+	std::vector<double> rows;
+
+	GloveSessionStore(const GloveSessionStore&);
+	GloveSessionStore& operator=(const GloveSessionStore&);
+
+	Stream* stream(uint8_t nodeId, uint8_t sensorId);
+	bool reserve(Stream &stream);
+	bool commit(Stream &stream);
+	void storeBatch();
+};
+
+
+#endif /* GLOVESTORE_H_ */
@@ -0,0 +1,365 @@
+/*
+ * GloveUdp.cpp
+ *
+ * Socket setup after old_data/Linux/UDP/server.c, which echoed text lines.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "GloveUdp.h"
+
+
+static inline void writeUInt16(uint8_t* data, uint16_t value)
+{
+	data[0] = (uint8_t)value;
+	data[1] = (uint8_t)(value >> 8);
+}
+
+static inline void writeUInt32(uint8_t* data, uint32_t value)
+{
+	writeUInt16(data, (uint16_t)value);
+	writeUInt16(data + 2, (uint16_t)(value >> 16));
+}
+
+static inline void writeUInt64(uint8_t* data, uint64_t value)
+{
+	writeUInt32(data, (uint32_t)value);
+	writeUInt32(data + 4, (uint32_t)(value >> 32));
+}
+
+static inline uint16_t readUInt16(const uint8_t* data)
+{
+	return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+static inline uint32_t readUInt32(const uint8_t* data)
+{
+	return readUInt16(data) | ((uint32_t)readUInt16(data + 2) << 16);
+}
+
+static inline uint64_t readUInt64(const uint8_t* data)
+{
+	return readUInt32(data) | ((uint64_t)readUInt32(data + 4) << 32);
+}
+
+
+void glove_udpWriteHeader(const GloveUdpHeader &header, uint8_t* data)
+{
+	writeUInt32(data, GLOVE_UDP_MAGIC);
+	writeUInt32(data + 4, header.sequence);
+	writeUInt64(data + 8, header.sendTime);
+	data[16] = GLOVE_UDP_VERSION;
+	data[17] = header.count;
+	writeUInt16(data + 18, 0);
+}
+
+bool glove_udpParseHeader(const uint8_t* data, size_t len, GloveUdpHeader &header)
+{
+	if (len < GLOVE_UDP_HEADER_LEN || readUInt32(data) != GLOVE_UDP_MAGIC || data[16] != GLOVE_UDP_VERSION)
+	{
+		return false;
+	}
+	header.sequence = readUInt32(data + 4);
+	header.sendTime = readUInt64(data + 8);
+	header.count = data[17];
+	return len >= GLOVE_UDP_HEADER_LEN + (size_t)header.count * GLOVE_UDP_SAMPLE_LEN;
+}
+
+void glove_udpWriteSample(const GloveSample &sample, uint8_t* data)
+{
+	writeUInt64(data, sample.sampleTime);
+	data[8] = sample.nodeId;
+	data[9] = sample.deviceId;
+	data[10] = sample.mode;
+	data[11] = sample.sampleId;
+	data[12] = sample.sensorId;
+	data[13] = sample.flags;
+	for (uint8_t i = 0; i < 4; ++i)
+	{
+		writeUInt16(data + 14 + 2 * i, (uint16_t)sample.quat[i]);
+	}
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		writeUInt16(data + 22 + 2 * i, (uint16_t)sample.linAcc[i]);
+	}
+}
+
+void glove_udpParseSample(const uint8_t* data, GloveSample &sample)
+{
+	sample.sampleTime = readUInt64(data);
+	sample.hostTime = sample.sampleTime;
+	sample.nodeId = data[8];
+	sample.deviceId = data[9];
+	sample.mode = data[10];
+	sample.sampleId = data[11];
+	sample.sensorId = data[12];
+	sample.flags = data[13];
+	for (uint8_t i = 0; i < 4; ++i)
+	{
+		sample.quat[i] = (int16_t)readUInt16(data + 14 + 2 * i);
+	}
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		sample.linAcc[i] = (int16_t)readUInt16(data + 22 + 2 * i);
+	}
+}
+
+bool glove_udpParseAddress(const char* text, sockaddr_in &address)
+{
+	char host[64];
+	unsigned int port = GLOVE_UDP_DEFAULT_PORT;
+	const char* colon = strchr(text, ':');
+	size_t hostLen = colon ? (size_t)(colon - text) : strlen(text);
+	if (hostLen >= sizeof(host) || (colon && (sscanf(colon + 1, "%u", &port) != 1 || port == 0 || port > 65535)))
+	{
+		return false;
+	}
+	memcpy(host, text, hostLen);
+	host[hostLen] = 0;
+
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	return inet_aton(host, &address.sin_addr) != 0;
+}
+
+static bool isMulticast(const sockaddr_in &address)
+{
+	return IN_MULTICAST(ntohl(address.sin_addr.s_addr));
+}
+
+
+GloveUdpPublisher::GloveUdpPublisher() : fd(-1), batchSize(GLOVE_UDP_MAX_SAMPLES), count(0), sequence(0)
+{
+	memset(&publisherStats, 0, sizeof(publisherStats));
+}
+
+GloveUdpPublisher::~GloveUdpPublisher()
+{
+	close();
+}
+
+bool GloveUdpPublisher::open(in_addr_t interface)
+{
+	close();
+	fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	// subscribers on this machine get the group too, it does not leave the subnet
+	unsigned char ttl = 1;
+	unsigned char loop = 1;
+	struct in_addr multicastInterface;
+	multicastInterface.s_addr = interface;
+	if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) != 0 ||
+		setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) != 0 ||
+		setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &multicastInterface, sizeof(multicastInterface)) != 0)
+	{
+		int error = errno;
+		close();
+		errno = error;
+		return false;
+	}
+	return true;
+}
+
+void GloveUdpPublisher::close()
+{
+	if (fd >= 0)
+	{
+		flush();
+		::close(fd);
+		fd = -1;
+	}
+}
+
+void GloveUdpPublisher::addDestination(const sockaddr_in &address)
+{
+	destinations.push_back(address);
+}
+
+void GloveUdpPublisher::setBatchSize(uint8_t samples)
+{
+	flush();
+	batchSize = samples == 0 ? 1 : samples > GLOVE_UDP_MAX_SAMPLES ? GLOVE_UDP_MAX_SAMPLES : samples;
+}
+
+void GloveUdpPublisher::publish(const GloveSample &sample)
+{
+	glove_udpWriteSample(sample, datagram + GLOVE_UDP_HEADER_LEN + count * GLOVE_UDP_SAMPLE_LEN);
+	++publisherStats.samples;
+	if (++count >= batchSize)
+	{
+		flush();
+	}
+}
+
+void GloveUdpPublisher::flush()
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	GloveUdpHeader header;
+	header.sequence = sequence++;
+	header.sendTime = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+	header.count = count;
+	glove_udpWriteHeader(header, datagram);
+	size_t len = GLOVE_UDP_HEADER_LEN + (size_t)count * GLOVE_UDP_SAMPLE_LEN;
+	count = 0;
+
+	for (size_t i = 0; i < destinations.size(); ++i)
+	{
+		// never wait for the network, the capture goes on
+		ssize_t n = sendto(fd, datagram, len, MSG_DONTWAIT, (const struct sockaddr*)&destinations[i], sizeof(destinations[i]));
+		if (n == (ssize_t)len)
+		{
+			++publisherStats.datagrams;
+			publisherStats.bytes += len;
+		}
+		else
+		{
+			++publisherStats.dropped;
+		}
+	}
+}
+
+void GloveUdpPublisher::sampleCallback(const GloveSample &sample, void* context)
+{
+	((GloveUdpPublisher*)context)->publish(sample);
+}
+
+
+GloveUdpSubscriber::GloveUdpSubscriber(SampleCallback callback, void* context)
+									   : callback(callback), context(context), fd(-1), started(false), expected(0), sendTime(0)
+{
+	memset(&subscriberStats, 0, sizeof(subscriberStats));
+}
+
+GloveUdpSubscriber::~GloveUdpSubscriber()
+{
+	close();
+}
+
+bool GloveUdpSubscriber::open(const sockaddr_in &address, in_addr_t interface)
+{
+	close();
+	fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	// several subscribers of a group on one machine
+	int reuse = 1;
+	int bufferSize = 1 << 20;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+	bool ok = bind(fd, (const struct sockaddr*)&address, sizeof(address)) == 0;
+	if (ok && isMulticast(address))
+	{
+		struct ip_mreq membership;
+		membership.imr_multiaddr = address.sin_addr;
+		membership.imr_interface.s_addr = interface;
+		ok = setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) == 0;
+	}
+	if (!ok)
+	{
+		int error = errno;
+		close();
+		errno = error;
+		return false;
+	}
+	started = false;
+	return true;
+}
+
+void GloveUdpSubscriber::close()
+{
+	if (fd >= 0)
+	{
+		::close(fd);
+		fd = -1;
+	}
+}
+
+bool GloveUdpSubscriber::localAddress(sockaddr_in &address) const
+{
+	socklen_t len = sizeof(address);
+	return getsockname(fd, (struct sockaddr*)&address, &len) == 0;
+}
+
+int GloveUdpSubscriber::receive(int timeout_ms)
+{
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	int ret = poll(&pfd, 1, timeout_ms);
+	if (ret < 0 && errno == EINTR)
+	{
+		return 0;
+	}
+	if (ret <= 0)
+	{
+		return ret;
+	}
+
+	ssize_t len = recv(fd, datagram, sizeof(datagram), 0);
+	if (len < 0)
+	{
+		return errno == EAGAIN || errno == EINTR ? 0 : -1;
+	}
+
+	GloveUdpHeader header;
+	if (!glove_udpParseHeader(datagram, len, header))
+	{
+		++subscriberStats.invalid;
+		return 0;
+	}
+
+	int32_t gap = (int32_t)(header.sequence - expected);
+	if (started && gap < 0 && gap > -1024)
+	{
+		// older than what arrived already, its samples are handed on anyway
+		++subscriberStats.late;
+	}
+	else
+	{
+		if (started && gap < 0)
+		{
+			++subscriberStats.restarts;
+		}
+		else if (started)
+		{
+			subscriberStats.lost += gap;
+		}
+		expected = header.sequence + 1;
+		started = true;
+	}
+	++subscriberStats.datagrams;
+	sendTime = header.sendTime;
+
+	GloveSample sample;
+	for (uint8_t i = 0; i < header.count; ++i)
+	{
+		glove_udpParseSample(datagram + GLOVE_UDP_HEADER_LEN + i * GLOVE_UDP_SAMPLE_LEN, sample);
+		callback(sample, context);
+	}
+	subscriberStats.samples += header.count;
+	return header.count;
+}
@@ -0,0 +1,164 @@
+/*
+ * GloveUdp.h
+ *
+ * Decoded samples as UDP datagrams, so several programs on a machine (or a
+ * network) share one capture instead of each opening the serial port. The
+ * publisher batches the samples of a read into datagrams of up to one
+ * Ethernet MTU and sends each of them to a multicast group and/or unicast
+ * addresses; a subscriber joins the group or listens on its port.
+ *
+ * Datagram (little endian)
+ *******************************************************************************
+ * header         magic 'GSMP', sequence, send time, version, sample count, flags
+ * sample 0       sample time, node, device, mode, sample ID, sensor, flags, quat, linAcc
+ * sample 1       ...
+ *******************************************************************************
+ * The sequence number counts the datagrams of a publisher, a gap tells the
+ * subscriber how many it lost. Times are us of the publisher's monotonic
+ * clock: on the same machine now - send time is the transfer latency.
+ * Python: struct.unpack_from('<IIQBBH', d) and '<QBBBBBB4h3h' per sample.
+ */
+
+
+#ifndef GLOVEUDP_H_
+#define GLOVEUDP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include <vector>
+
+#include "GloveDecoder.h"
+
+
+#define GLOVE_UDP_MAGIC				0x504D5347		// "GSMP"
+#define GLOVE_UDP_VERSION			1
+#define GLOVE_UDP_HEADER_LEN		20
+#define GLOVE_UDP_SAMPLE_LEN		28
+#define GLOVE_UDP_MAX_LEN			1472			// 1500 byte MTU - IP and UDP header
+#define GLOVE_UDP_MAX_SAMPLES		((GLOVE_UDP_MAX_LEN - GLOVE_UDP_HEADER_LEN) / GLOVE_UDP_SAMPLE_LEN)
+
+#define GLOVE_UDP_DEFAULT_GROUP		"239.255.71.1"	// organization-local scope
+#define GLOVE_UDP_DEFAULT_PORT		8888			// port of old_data/Linux/UDP/server.c
+
+
+struct GloveUdpHeader
+{
+	uint32_t sequence;
+	uint64_t sendTime;			// us
+	uint8_t count;				// samples that follow
+};
+
+void glove_udpWriteHeader(const GloveUdpHeader &header, uint8_t* data);
+// false if the magic, version or length do not match
+bool glove_udpParseHeader(const uint8_t* data, size_t len, GloveUdpHeader &header);
+
+void glove_udpWriteSample(const GloveSample &sample, uint8_t* data);
+// hostTime is not sent, it is set to sampleTime
+void glove_udpParseSample(const uint8_t* data, GloveSample &sample);
+
+// "a.b.c.d:port" or "a.b.c.d" (default port), false if it does not parse
+bool glove_udpParseAddress(const char* text, sockaddr_in &address);
+
+
+struct GloveUdpPublisherStats
+{
+	uint64_t samples;
+	uint64_t datagrams;
+	uint64_t bytes;
+	uint64_t dropped;			// datagrams the socket did not take (send buffer full, no route)
+};
+
+
+class GloveUdpPublisher
+{
+public:
+	GloveUdpPublisher();
+	~GloveUdpPublisher();
+
+	// interface: address of the interface for multicast (INADDR_ANY = routing table)
+	bool open(in_addr_t interface = INADDR_ANY);
+	void close();
+
+	// destinations, multicast groups are sent with TTL 1 and loopback
+	void addDestination(const sockaddr_in &address);
+
+	// samples per datagram, at most GLOVE_UDP_MAX_SAMPLES
+	void setBatchSize(uint8_t samples);
+
+	// queues the sample, a full datagram is sent right away
+	void publish(const GloveSample &sample);
+	// sends the queued samples (after each read, so batching adds no latency)
+	void flush();
+
+	const GloveUdpPublisherStats& stats() const { return publisherStats; }
+
+	// sample callback of GloveDecoder, context is the publisher
+	static void sampleCallback(const GloveSample &sample, void* context);
+
+private:
+	int fd;
+	std::vector<sockaddr_in> destinations;
+	uint8_t batchSize;
+	uint8_t count;
+	uint32_t sequence;
+	uint8_t datagram[GLOVE_UDP_MAX_LEN];
+	GloveUdpPublisherStats publisherStats;
+
+	GloveUdpPublisher(const GloveUdpPublisher&);
+	GloveUdpPublisher& operator=(const GloveUdpPublisher&);
+};
+
+
+struct GloveUdpSubscriberStats
+{
+	uint64_t samples;
+	uint64_t datagrams;
+	uint64_t lost;				// datagrams missing in the sequence
+	uint64_t late;				// datagrams older than the latest one (reordered or duplicated)
+	uint64_t invalid;			// not a sample datagram
+	uint64_t restarts;			// the sequence started over (publisher restarted)
+};
+
+
+class GloveUdpSubscriber
+{
+public:
+	typedef GloveDecoder::SampleCallback SampleCallback;
+
+	GloveUdpSubscriber(SampleCallback callback, void* context);
+	~GloveUdpSubscriber();
+
+	// listens on address: a multicast group is joined on interface, else it is the local address
+	bool open(const sockaddr_in &address, in_addr_t interface = INADDR_ANY);
+	void close();
+
+	// waits up to timeout_ms for a datagram and hands on its samples. Returns the number of
+	// samples, 0 on timeout (or a datagram that was not valid), -1 on error
+	int receive(int timeout_ms);
+
+	// address the socket is bound to (the port the kernel picked for port 0)
+	bool localAddress(sockaddr_in &address) const;
+
+	// send time of the last valid datagram
+	uint64_t lastSendTime() const { return sendTime; }
+
+	const GloveUdpSubscriberStats& stats() const { return subscriberStats; }
+
+private:
+	SampleCallback callback;
+	void* context;
+	int fd;
+	bool started;
+	uint32_t expected;			// next sequence number
+	uint64_t sendTime;
+	uint8_t datagram[GLOVE_UDP_MAX_LEN];
+	GloveUdpSubscriberStats subscriberStats;
+
+	GloveUdpSubscriber(const GloveUdpSubscriber&);
+	GloveUdpSubscriber& operator=(const GloveUdpSubscriber&);
+};
+
+
+#endif /* GLOVEUDP_H_ */
@@ -0,0 +1,127 @@
+/*
+ * GloveWorkPool.cpp
+ */
+
+#include "GloveWorkPool.h"
+
+
+// pool and deque of the worker running on this thread
+static thread_local GloveWorkPool* currentPool = 0;
+static thread_local unsigned int currentWorker = 0;
+
+
+GloveWorkPool::GloveWorkPool(unsigned int threadCount) : queued(0), pending(0), stealCount(0), nextQueue(0), stopping(false)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+	}
+	if (threadCount == 0)
+	{
+		threadCount = 1;
+	}
+	for (unsigned int i = 0; i < threadCount; ++i)
+	{
+		queues.push_back(std::unique_ptr<Queue>(new Queue()));
+	}
+	for (unsigned int i = 0; i < threadCount; ++i)
+	{
+		threads.push_back(std::thread(&GloveWorkPool::run, this, i));
+	}
+}
+
+GloveWorkPool::~GloveWorkPool()
+{
+	wait();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+	for (size_t i = 0; i < threads.size(); ++i)
+	{
+		threads[i].join();
+	}
+}
+
+
+void GloveWorkPool::submit(Task task)
+{
+	unsigned int index = currentPool == this ? currentWorker : nextQueue++ % queues.size();
+	++pending;
+	{
+		std::lock_guard<std::mutex> lock(queues[index]->mutex);
+		queues[index]->tasks.push_back(std::move(task));
+	}
+	{
+		// under the mutex, a worker can't miss it between its check and going to sleep
+		std::lock_guard<std::mutex> lock(mutex);
+		++queued;
+	}
+	workAvailable.notify_one();
+}
+
+void GloveWorkPool::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	allDone.wait(lock, [this] { return pending == 0; });
+}
+
+
+bool GloveWorkPool::take(unsigned int worker, Task &task)
+{
+	{
+		Queue &own = *queues[worker];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty())
+		{
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			--queued;
+			return true;
+		}
+	}
+	for (size_t i = 1; i < queues.size(); ++i)
+	{
+		Queue &victim = *queues[(worker + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			--queued;
+			++stealCount;
+			return true;
+		}
+	}
+	return false;
+}
+
+void GloveWorkPool::run(unsigned int worker)
+{
+	currentPool = this;
+	currentWorker = worker;
+
+	Task task;
+	while (true)
+	{
+		if (take(worker, task))
+		{
+			task();
+			task = Task();
+			if (--pending == 0)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				allDone.notify_all();
+			}
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		workAvailable.wait(lock, [this] { return queued > 0 || stopping; });
+		if (stopping && queued == 0)
+		{
+			return;
+		}
+	}
+}
@@ -0,0 +1,75 @@
+/*
+ * GloveWorkPool.h
+ *
+ * Fixed pool of worker threads for batch jobs of uneven size (e.g. the CSV
+ * files of an archive and the chunks of its large files). Each worker has its
+ * own deque: tasks submitted by a worker go to the back of its own deque and
+ * it takes them from there (newest first, the data they need is still in its
+ * cache), an idle worker steals from the front of the others' deques (oldest
+ * first, usually the biggest pieces of work). Tasks submitted from outside the
+ * pool are spread over the deques round robin.
+ */
+
+
+#ifndef GLOVEWORKPOOL_H_
+#define GLOVEWORKPOOL_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class GloveWorkPool
+{
+public:
+	typedef std::function<void()> Task;
+
+	// threads: 0 for one per CPU
+	explicit GloveWorkPool(unsigned int threads = 0);
+	// waits for all tasks
+	~GloveWorkPool();
+
+	// any thread, also from within a task
+	void submit(Task task);
+	// until all tasks submitted so far and the tasks they submitted are done, not from within a task
+	void wait();
+
+	unsigned int threadCount() const { return threads.size(); }
+	// tasks taken from another worker's deque
+	uint64_t steals() const { return stealCount; }
+
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+
+	std::mutex mutex;						// sleeping and waiting
+	std::condition_variable workAvailable;
+	std::condition_variable allDone;
+	std::atomic<uint64_t> queued;			// tasks in the deques
+	std::atomic<uint64_t> pending;			// tasks submitted and not done
+	std::atomic<uint64_t> stealCount;
+	std::atomic<unsigned int> nextQueue;
+	bool stopping;
+
+	GloveWorkPool(const GloveWorkPool&);
+	GloveWorkPool& operator=(const GloveWorkPool&);
+
+	bool take(unsigned int worker, Task &task);
+	void run(unsigned int worker);
+};
+
+
+#endif /* GLOVEWORKPOOL_H_ */
@@ -0,0 +1,536 @@
+/*
+ * QuatKernel.cpp
+ *
+ * Samples are processed in blocks: unpacked from the interleaved payload
+ * layout into int32 columns, converted column-wise (scalar, SSE2 or AVX2) and
+ * packed into output rows. All paths use the same operations in the same
+ * order as read_glove.py (x / 16384, (x*x + y*y) + z*z, sqrt(1 - sumsq),
+ * a / 100), which are exactly rounded in IEEE double precision. Fused
+ * multiply-add must not be used, it would change the rounding of sumsq.
+ *
+ * Smallest three quaternions take the same route: bit fields unpacked into
+ * int32 columns, the dropped component reconstructed and the result rounded
+ * back to Q14 with the current (round to nearest even) rounding mode, which
+ * cvtpd2dq and nearbyint() share.
+ */
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNEL_X86
+#endif
+
+#include "GloveDecoder.h"
+#include "QuatKernel.h"
+
+
+#define BLOCK_LEN	256
+
+struct SampleColumns
+{
+	int32_t w[BLOCK_LEN];
+	int32_t x[BLOCK_LEN];
+	int32_t y[BLOCK_LEN];
+	int32_t z[BLOCK_LEN];
+	int32_t ax[BLOCK_LEN];
+	int32_t ay[BLOCK_LEN];
+	int32_t az[BLOCK_LEN];
+};
+
+// output columns, already in read_glove.py's axis order
+struct RowColumns
+{
+	double qx[BLOCK_LEN];
+	double qy[BLOCK_LEN];
+	double qz[BLOCK_LEN];
+	double qw[BLOCK_LEN];
+	double ax[BLOCK_LEN];
+	double ay[BLOCK_LEN];
+	double az[BLOCK_LEN];
+};
+
+// smallest three input (components already centered) and Q14 output
+struct S3Columns
+{
+	int32_t idx[BLOCK_LEN];
+	int32_t a[BLOCK_LEN];
+	int32_t b[BLOCK_LEN];
+	int32_t c[BLOCK_LEN];
+};
+
+struct QuatColumns
+{
+	int32_t w[BLOCK_LEN];
+	int32_t x[BLOCK_LEN];
+	int32_t y[BLOCK_LEN];
+	int32_t z[BLOCK_LEN];
+};
+
+
+size_t glove_kernelSampleLen(uint8_t flags)
+{
+	return ((flags & GLOVE_SAMPLE_HAS_W) ? 4 : 3) + ((flags & GLOVE_SAMPLE_HAS_LINACC) ? 3 : 0);
+}
+
+size_t glove_kernelRowLen(uint8_t flags)
+{
+	return (flags & GLOVE_SAMPLE_HAS_LINACC) ? 7 : 4;
+}
+
+
+static void unpackColumns(const int16_t* src, size_t count, uint8_t flags, SampleColumns &cols)
+{
+	size_t stride = glove_kernelSampleLen(flags);
+	bool hasW = flags & GLOVE_SAMPLE_HAS_W;
+	bool hasLinAcc = flags & GLOVE_SAMPLE_HAS_LINACC;
+
+	for (size_t i = 0; i < count; ++i, src += stride)
+	{
+		const int16_t* s = src;
+		cols.w[i] = hasW ? *s++ : 0;
+		cols.x[i] = s[0];
+		cols.y[i] = s[1];
+		cols.z[i] = s[2];
+		if (hasLinAcc)
+		{
+			cols.ax[i] = s[3];
+			cols.ay[i] = s[4];
+			cols.az[i] = s[5];
+		}
+	}
+}
+
+static void packRows(const RowColumns &rows, size_t count, uint8_t flags, double* dst)
+{
+	if (flags & GLOVE_SAMPLE_HAS_LINACC)
+	{
+		for (size_t i = 0; i < count; ++i, dst += 7)
+		{
+			dst[0] = rows.qx[i];
+			dst[1] = rows.qy[i];
+			dst[2] = rows.qz[i];
+			dst[3] = rows.qw[i];
+			dst[4] = rows.ax[i];
+			dst[5] = rows.ay[i];
+			dst[6] = rows.az[i];
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < count; ++i, dst += 4)
+		{
+			dst[0] = rows.qx[i];
+			dst[1] = rows.qy[i];
+			dst[2] = rows.qz[i];
+			dst[3] = rows.qw[i];
+		}
+	}
+}
+
+
+static void convertScalar(const SampleColumns &cols, size_t begin, size_t count, uint8_t flags, RowColumns &rows)
+{
+	for (size_t i = begin; i < count; ++i)
+	{
+		double x = cols.x[i] / 16384.0;
+		double y = cols.y[i] / 16384.0;
+		double z = cols.z[i] / 16384.0;
+		double w;
+
+		if (flags & GLOVE_SAMPLE_HAS_W)
+		{
+			w = cols.w[i] / 16384.0;
+		}
+		else
+		{
+			// separate statements, so no compiler contracts them into a fused multiply-add
+			double xx = x * x;
+			double yy = y * y;
+			double zz = z * z;
+			double sumsq = xx + yy;
+			sumsq = sumsq + zz;
+			w = sumsq <= 1.0 ? sqrt(1.0 - sumsq) : 0.0;
+		}
+
+		rows.qx[i] = x;
+		rows.qy[i] = -z;
+		rows.qz[i] = y;
+		rows.qw[i] = w;
+
+		if (flags & GLOVE_SAMPLE_HAS_LINACC)
+		{
+			rows.ax[i] = -(cols.ax[i] / 100.0);
+			rows.ay[i] = cols.az[i] / 100.0;
+			rows.az[i] = -(cols.ay[i] / 100.0);
+		}
+	}
+}
+
+
+static void unpackS3(const uint8_t* src, size_t stride, size_t count, uint8_t bits, S3Columns &cols)
+{
+	size_t len = glove_s3Len(bits);
+	int32_t offset = (1 << (bits - 1)) - 1;
+	uint64_t mask = (1u << bits) - 1;
+
+	for (size_t i = 0; i < count; ++i, src += stride)
+	{
+		uint64_t v = 0;
+		for (size_t k = 0; k < len; ++k)
+		{
+			v |= (uint64_t)src[k] << (8 * k);
+		}
+		cols.idx[i] = (int32_t)(v & 3);
+		v >>= 2;
+		cols.a[i] = (int32_t)(v & mask) - offset;
+		v >>= bits;
+		cols.b[i] = (int32_t)(v & mask) - offset;
+		v >>= bits;
+		cols.c[i] = (int32_t)(v & mask) - offset;
+	}
+}
+
+static void packQuats(const QuatColumns &quats, size_t count, int16_t* dst)
+{
+	for (size_t i = 0; i < count; ++i, dst += 4)
+	{
+		dst[0] = (int16_t)quats.w[i];
+		dst[1] = (int16_t)quats.x[i];
+		dst[2] = (int16_t)quats.y[i];
+		dst[3] = (int16_t)quats.z[i];
+	}
+}
+
+static void convertS3Scalar(const S3Columns &cols, size_t begin, size_t count, double step, QuatColumns &quats)
+{
+	for (size_t i = begin; i < count; ++i)
+	{
+		double a = cols.a[i] * step;
+		double b = cols.b[i] * step;
+		double c = cols.c[i] * step;
+		double aa = a * a;
+		double bb = b * b;
+		double cc = c * c;
+		double sumsq = aa + bb;
+		sumsq = sumsq + cc;
+		double l = sumsq <= 1.0 ? sqrt(1.0 - sumsq) : 0.0;
+
+		int32_t idx = cols.idx[i];
+		double w = idx == 0 ? l : a;
+		double x = idx == 0 ? a : idx == 1 ? l : b;
+		double y = idx <= 1 ? b : idx == 2 ? l : c;
+		double z = idx == 3 ? l : c;
+		if (w < 0.0)
+		{
+			w = -w;
+			x = -x;
+			y = -y;
+			z = -z;
+		}
+
+		quats.w[i] = (int32_t)nearbyint(w * 16384.0);
+		quats.x[i] = (int32_t)nearbyint(x * 16384.0);
+		quats.y[i] = (int32_t)nearbyint(y * 16384.0);
+		quats.z[i] = (int32_t)nearbyint(z * 16384.0);
+	}
+}
+
+
+#ifdef KERNEL_X86
+
+__attribute__((target("sse2")))
+static size_t convertSSE2(const SampleColumns &cols, size_t count, uint8_t flags, RowColumns &rows)
+{
+	const __m128d scale = _mm_set1_pd(1.0 / 16384.0);	// power of two, same result as x / 16384
+	const __m128d accScale = _mm_set1_pd(100.0);
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d sign = _mm_set1_pd(-0.0);
+
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2)
+	{
+		__m128d x = _mm_mul_pd(_mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(cols.x + i))), scale);
+		__m128d y = _mm_mul_pd(_mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(cols.y + i))), scale);
+		__m128d z = _mm_mul_pd(_mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(cols.z + i))), scale);
+		__m128d w;
+
+		if (flags & GLOVE_SAMPLE_HAS_W)
+		{
+			w = _mm_mul_pd(_mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(cols.w + i))), scale);
+		}
+		else
+		{
+			__m128d sumsq = _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y)), _mm_mul_pd(z, z));
+			// sqrt of a negative value is NaN, masked to 0 like the clamp in the scalar path
+			__m128d valid = _mm_cmple_pd(sumsq, one);
+			w = _mm_and_pd(valid, _mm_sqrt_pd(_mm_sub_pd(one, sumsq)));
+		}
+
+		_mm_storeu_pd(rows.qx + i, x);
+		_mm_storeu_pd(rows.qy + i, _mm_xor_pd(z, sign));
+		_mm_storeu_pd(rows.qz + i, y);
+		_mm_storeu_pd(rows.qw + i, w);
+
+		if (flags & GLOVE_SAMPLE_HAS_LINACC)
+		{
+			__m128d ax = _mm_div_pd(_mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(cols.ax + i))), accScale);
+			__m128d ay = _mm_div_pd(_mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(cols.ay + i))), accScale);
+			__m128d az = _mm_div_pd(_mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(cols.az + i))), accScale);
+			_mm_storeu_pd(rows.ax + i, _mm_xor_pd(ax, sign));
+			_mm_storeu_pd(rows.ay + i, az);
+			_mm_storeu_pd(rows.az + i, _mm_xor_pd(ay, sign));
+		}
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t convertAVX2(const SampleColumns &cols, size_t count, uint8_t flags, RowColumns &rows)
+{
+	const __m256d scale = _mm256_set1_pd(1.0 / 16384.0);
+	const __m256d accScale = _mm256_set1_pd(100.0);
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d sign = _mm256_set1_pd(-0.0);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m256d x = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(cols.x + i))), scale);
+		__m256d y = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(cols.y + i))), scale);
+		__m256d z = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(cols.z + i))), scale);
+		__m256d w;
+
+		if (flags & GLOVE_SAMPLE_HAS_W)
+		{
+			w = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(cols.w + i))), scale);
+		}
+		else
+		{
+			__m256d sumsq = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)), _mm256_mul_pd(z, z));
+			__m256d valid = _mm256_cmp_pd(sumsq, one, _CMP_LE_OQ);
+			w = _mm256_and_pd(valid, _mm256_sqrt_pd(_mm256_sub_pd(one, sumsq)));
+		}
+
+		_mm256_storeu_pd(rows.qx + i, x);
+		_mm256_storeu_pd(rows.qy + i, _mm256_xor_pd(z, sign));
+		_mm256_storeu_pd(rows.qz + i, y);
+		_mm256_storeu_pd(rows.qw + i, w);
+
+		if (flags & GLOVE_SAMPLE_HAS_LINACC)
+		{
+			__m256d ax = _mm256_div_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(cols.ax + i))), accScale);
+			__m256d ay = _mm256_div_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(cols.ay + i))), accScale);
+			__m256d az = _mm256_div_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(cols.az + i))), accScale);
+			_mm256_storeu_pd(rows.ax + i, _mm256_xor_pd(ax, sign));
+			_mm256_storeu_pd(rows.ay + i, az);
+			_mm256_storeu_pd(rows.az + i, _mm256_xor_pd(ay, sign));
+		}
+	}
+	return i;
+}
+
+__attribute__((target("sse2")))
+static inline __m128d selectSSE2(__m128d mask, __m128d a, __m128d b)
+{
+	return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+__attribute__((target("sse2")))
+static size_t convertS3SSE2(const S3Columns &cols, size_t count, double step, QuatColumns &quats)
+{
+	const __m128d scale = _mm_set1_pd(step);
+	const __m128d q14 = _mm_set1_pd(16384.0);
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d sign = _mm_set1_pd(-0.0);
+
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2)
+	{
+		__m128d a = _mm_mul_pd(_mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(cols.a + i))), scale);
+		__m128d b = _mm_mul_pd(_mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(cols.b + i))), scale);
+		__m128d c = _mm_mul_pd(_mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(cols.c + i))), scale);
+		__m128d sumsq = _mm_add_pd(_mm_add_pd(_mm_mul_pd(a, a), _mm_mul_pd(b, b)), _mm_mul_pd(c, c));
+		__m128d l = _mm_and_pd(_mm_cmple_pd(sumsq, one), _mm_sqrt_pd(_mm_sub_pd(one, sumsq)));
+
+		__m128d idx = _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(cols.idx + i)));
+		__m128d is0 = _mm_cmpeq_pd(idx, zero);
+		__m128d is1 = _mm_cmpeq_pd(idx, one);
+		__m128d is2 = _mm_cmpeq_pd(idx, _mm_set1_pd(2.0));
+		__m128d is3 = _mm_cmpeq_pd(idx, _mm_set1_pd(3.0));
+
+		__m128d w = selectSSE2(is0, l, a);
+		__m128d x = selectSSE2(is0, a, selectSSE2(is1, l, b));
+		__m128d y = selectSSE2(_mm_or_pd(is0, is1), b, selectSSE2(is2, l, c));
+		__m128d z = selectSSE2(is3, l, c);
+
+		__m128d flip = _mm_and_pd(_mm_cmplt_pd(w, zero), sign);
+		_mm_storel_epi64((__m128i*)(quats.w + i), _mm_cvtpd_epi32(_mm_mul_pd(_mm_xor_pd(w, flip), q14)));
+		_mm_storel_epi64((__m128i*)(quats.x + i), _mm_cvtpd_epi32(_mm_mul_pd(_mm_xor_pd(x, flip), q14)));
+		_mm_storel_epi64((__m128i*)(quats.y + i), _mm_cvtpd_epi32(_mm_mul_pd(_mm_xor_pd(y, flip), q14)));
+		_mm_storel_epi64((__m128i*)(quats.z + i), _mm_cvtpd_epi32(_mm_mul_pd(_mm_xor_pd(z, flip), q14)));
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t convertS3AVX2(const S3Columns &cols, size_t count, double step, QuatColumns &quats)
+{
+	const __m256d scale = _mm256_set1_pd(step);
+	const __m256d q14 = _mm256_set1_pd(16384.0);
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d sign = _mm256_set1_pd(-0.0);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m256d a = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(cols.a + i))), scale);
+		__m256d b = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(cols.b + i))), scale);
+		__m256d c = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(cols.c + i))), scale);
+		__m256d sumsq = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b)), _mm256_mul_pd(c, c));
+		__m256d l = _mm256_and_pd(_mm256_cmp_pd(sumsq, one, _CMP_LE_OQ), _mm256_sqrt_pd(_mm256_sub_pd(one, sumsq)));
+
+		__m256d idx = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(cols.idx + i)));
+		__m256d is0 = _mm256_cmp_pd(idx, zero, _CMP_EQ_OQ);
+		__m256d is1 = _mm256_cmp_pd(idx, one, _CMP_EQ_OQ);
+		__m256d is2 = _mm256_cmp_pd(idx, _mm256_set1_pd(2.0), _CMP_EQ_OQ);
+		__m256d is3 = _mm256_cmp_pd(idx, _mm256_set1_pd(3.0), _CMP_EQ_OQ);
+
+		// blendv picks the second operand where the mask is set
+		__m256d w = _mm256_blendv_pd(a, l, is0);
+		__m256d x = _mm256_blendv_pd(_mm256_blendv_pd(b, l, is1), a, is0);
+		__m256d y = _mm256_blendv_pd(_mm256_blendv_pd(c, l, is2), b, _mm256_or_pd(is0, is1));
+		__m256d z = _mm256_blendv_pd(c, l, is3);
+
+		__m256d flip = _mm256_and_pd(_mm256_cmp_pd(w, zero, _CMP_LT_OQ), sign);
+		_mm_storeu_si128((__m128i*)(quats.w + i), _mm256_cvtpd_epi32(_mm256_mul_pd(_mm256_xor_pd(w, flip), q14)));
+		_mm_storeu_si128((__m128i*)(quats.x + i), _mm256_cvtpd_epi32(_mm256_mul_pd(_mm256_xor_pd(x, flip), q14)));
+		_mm_storeu_si128((__m128i*)(quats.y + i), _mm256_cvtpd_epi32(_mm256_mul_pd(_mm256_xor_pd(y, flip), q14)));
+		_mm_storeu_si128((__m128i*)(quats.z + i), _mm256_cvtpd_epi32(_mm256_mul_pd(_mm256_xor_pd(z, flip), q14)));
+	}
+	return i;
+}
+
+#endif /* KERNEL_X86 */
+
+
+GloveKernelPath glove_kernelPath()
+{
+#ifdef KERNEL_X86
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return KERNEL_AVX2;
+	}
+	if (__builtin_cpu_supports("sse2"))
+	{
+		return KERNEL_SSE2;
+	}
+#endif
+	return KERNEL_SCALAR;
+}
+
+const char* glove_kernelPathName(GloveKernelPath path)
+{
+	switch (path)
+	{
+		case KERNEL_SSE2:	return "sse2";
+		case KERNEL_AVX2:	return "avx2";
+		default:			return "scalar";
+	}
+}
+
+void glove_dequantizeWith(GloveKernelPath path, const int16_t* src, size_t count, uint8_t flags, double* dst)
+{
+	if (path > glove_kernelPath())
+	{
+		path = KERNEL_SCALAR;
+	}
+
+	SampleColumns cols;
+	RowColumns rows;
+	size_t sampleLen = glove_kernelSampleLen(flags);
+	size_t rowLen = glove_kernelRowLen(flags);
+
+	while (count > 0)
+	{
+		size_t n = count < BLOCK_LEN ? count : BLOCK_LEN;
+		unpackColumns(src, n, flags, cols);
+
+		size_t done = 0;
+#ifdef KERNEL_X86
+		if (path == KERNEL_AVX2)
+		{
+			done = convertAVX2(cols, n, flags, rows);
+		}
+		else if (path == KERNEL_SSE2)
+		{
+			done = convertSSE2(cols, n, flags, rows);
+		}
+#endif
+		// remainder (or everything on the scalar path)
+		convertScalar(cols, done, n, flags, rows);
+
+		packRows(rows, n, flags, dst);
+
+		src += n * sampleLen;
+		dst += n * rowLen;
+		count -= n;
+	}
+}
+
+void glove_dequantize(const int16_t* src, size_t count, uint8_t flags, double* dst)
+{
+	static const GloveKernelPath path = glove_kernelPath();
+	glove_dequantizeWith(path, src, count, flags, dst);
+}
+
+void glove_decodeS3With(GloveKernelPath path, const uint8_t* src, size_t stride, size_t count, uint8_t bits, int16_t* dst)
+{
+	if (path > glove_kernelPath())
+	{
+		path = KERNEL_SCALAR;
+	}
+
+	S3Columns cols;
+	QuatColumns quats;
+	// q = Q14 value * scale / 65536, so one step of q is 65536 / (16384 * scale)
+	double step = 4.0 / glove_s3Scale(bits);
+
+	while (count > 0)
+	{
+		size_t n = count < BLOCK_LEN ? count : BLOCK_LEN;
+		unpackS3(src, stride, n, bits, cols);
+
+		size_t done = 0;
+#ifdef KERNEL_X86
+		if (path == KERNEL_AVX2)
+		{
+			done = convertS3AVX2(cols, n, step, quats);
+		}
+		else if (path == KERNEL_SSE2)
+		{
+			done = convertS3SSE2(cols, n, step, quats);
+		}
+#endif
+		convertS3Scalar(cols, done, n, step, quats);
+
+		packQuats(quats, n, dst);
+
+		src += n * stride;
+		dst += n * 4;
+		count -= n;
+	}
+}
+
+void glove_decodeS3(const uint8_t* src, size_t stride, size_t count, uint8_t bits, int16_t* dst)
+{
+	static const GloveKernelPath path = glove_kernelPath();
+	glove_decodeS3With(path, src, stride, count, bits, dst);
+}
@@ -0,0 +1,55 @@
+/*
+ * QuatKernel.h
+ *
+ * Batch conversion of raw IMU samples (as packed in the radio payload) to the
+ * floating point rows of read_glove.py: Q14 dequantization, W reconstruction
+ * for compressed quaternions, axis remap and lin. acc. scaling in one pass.
+ *
+ * Results are bit-identical to the float64 math of read_glove.py on every
+ * path. The only difference is W of a compressed quaternion with
+ * x^2 + y^2 + z^2 > 1, which is clamped to 0 in all modes (read_glove.py only
+ * does so in quaternion mode and yields NaN in lin. acc. mode).
+ */
+
+
+#ifndef QUATKERNEL_H_
+#define QUATKERNEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+enum GloveKernelPath
+{
+	KERNEL_SCALAR,
+	KERNEL_SSE2,
+	KERNEL_AVX2
+};
+
+
+// best path supported by the CPU this runs on
+GloveKernelPath glove_kernelPath();
+const char* glove_kernelPathName(GloveKernelPath path);
+
+// src:   count samples of int16, each [W,] X, Y, Z [, linAccX, linAccY, linAccZ] depending on
+//        flags (GLOVE_SAMPLE_HAS_W, GLOVE_SAMPLE_HAS_LINACC of GloveDecoder.h)
+// dst:   count rows of double, each qx, -qz, qy, qw [, -linAccX, linAccZ, -linAccY]
+//        (read_glove.py's log.csv columns after ID and time stamp)
+void glove_dequantize(const int16_t* src, size_t count, uint8_t flags, double* dst);
+
+// same as glove_dequantize() with an explicit path (falls back to scalar if not supported)
+void glove_dequantizeWith(GloveKernelPath path, const int16_t* src, size_t count, uint8_t flags, double* dst);
+
+// number of int16 per input sample and double per output row for the given flags
+size_t glove_kernelSampleLen(uint8_t flags);
+size_t glove_kernelRowLen(uint8_t flags);
+
+// src:   count smallest three quaternions (GloveProtocol.h) of bits per component, stride bytes apart
+// dst:   count x Q14 W, X, Y, Z (the layout of GloveSample::quat), W >= 0
+// The dropped component is sqrt(1 - a^2 - b^2 - c^2) in double precision, the result is
+// rounded to Q14 (ties to even), identical on all paths.
+void glove_decodeS3(const uint8_t* src, size_t stride, size_t count, uint8_t bits, int16_t* dst);
+void glove_decodeS3With(GloveKernelPath path, const uint8_t* src, size_t stride, size_t count, uint8_t bits, int16_t* dst);
+
+
+#endif /* QUATKERNEL_H_ */
@@ -0,0 +1,196 @@
+/*
+ * SerialPort.cpp
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "SerialPort.h"
+
+
+static speed_t baudrateToSpeed(int baudrate)
+{
+	switch (baudrate)
+	{
+		case 9600:		return B9600;
+		case 19200:		return B19200;
+		case 38400:		return B38400;
+		case 57600:		return B57600;
+		case 115200:	return B115200;
+		case 230400:	return B230400;
+		case 460800:	return B460800;
+		case 500000:	return B500000;
+		case 921600:	return B921600;
+		case 1000000:	return B1000000;
+		case 2000000:	return B2000000;
+		default:		return 0;
+	}
+}
+
+
+SerialPort::SerialPort() : fd(-1)
+{
+}
+
+SerialPort::~SerialPort()
+{
+	close();
+}
+
+
+bool SerialPort::open(const char* device, int baudrate)
+{
+	close();
+
+	speed_t speed = baudrateToSpeed(baudrate);
+	if (speed == 0)
+	{
+		errno = EINVAL;
+		return false;
+	}
+
+	fd = ::open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct termios tty;
+	if (tcgetattr(fd, &tty) != 0)
+	{
+		// not a tty (e.g. a recorded file or a fifo), read it as is
+		return true;
+	}
+
+	cfmakeraw(&tty);
+	tty.c_cflag |= CLOCAL | CREAD;
+	tty.c_cflag &= ~(CSTOPB | CRTSCTS);
+	tty.c_cc[VMIN] = 0;
+	tty.c_cc[VTIME] = 0;
+	cfsetispeed(&tty, speed);
+	cfsetospeed(&tty, speed);
+
+	if (tcsetattr(fd, TCSANOW, &tty) != 0)
+	{
+		int err = errno;
+		close();
+		errno = err;
+		return false;
+	}
+	return true;
+}
+
+void SerialPort::close()
+{
+	if (fd >= 0)
+	{
+		::close(fd);
+		fd = -1;
+	}
+}
+
+ssize_t SerialPort::read(uint8_t* data, size_t len, int timeout_ms)
+{
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	int ret = poll(&pfd, 1, timeout_ms);
+	if (ret < 0 && errno == EINTR)
+	{
+		// signal (e.g. Ctrl+C), the caller checks its flags
+		return 0;
+	}
+	if (ret <= 0)
+	{
+		return ret;
+	}
+
+	ssize_t n = ::read(fd, data, len);
+	if (n < 0 && (errno == EAGAIN || errno == EINTR))
+	{
+		return 0;
+	}
+	if (n == 0 && (pfd.revents & (POLLHUP | POLLERR)))
+	{
+		// device went away (e.g. base station unplugged) or end of file
+		errno = EIO;
+		return -1;
+	}
+	return n;
+}
+
+void SerialPort::flushInput()
+{
+	tcflush(fd, TCIFLUSH);
+}
+
+
+// reads a hexadecimal sysfs attribute (idVendor, idProduct), -1 if there is none
+static long readSysfsId(const std::string &path)
+{
+	FILE* file = fopen(path.c_str(), "r");
+	if (!file)
+	{
+		return -1;
+	}
+	char text[16];
+	long id = fgets(text, sizeof(text), file) ? strtol(text, 0, 16) : -1;
+	fclose(file);
+	return id;
+}
+
+BaseStationLink findBaseStation(std::string &device, const char* sysfsTty)
+{
+	DIR* dir = opendir(sysfsTty);
+	if (!dir)
+	{
+		return LINK_NONE;
+	}
+	std::vector<std::string> names;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != 0)
+	{
+		if (strncmp(entry->d_name, "ttyACM", 6) == 0)
+		{
+			names.push_back(entry->d_name);
+		}
+	}
+	closedir(dir);
+	std::sort(names.begin(), names.end());
+
+	BaseStationLink link = LINK_NONE;
+	for (size_t i = 0; i < names.size() && link != LINK_USB; ++i)
+	{
+		// device is the USB interface, its parent the USB device
+		std::string usbDevice = std::string(sysfsTty) + "/" + names[i] + "/device/../";
+		long vendor = readSysfsId(usbDevice + "idVendor");
+		long product = readSysfsId(usbDevice + "idProduct");
+
+		if (vendor == BASE_STATION_USB_VID && product == BASE_STATION_USB_PID)
+		{
+			link = LINK_USB;
+		}
+		else if (vendor == BASE_STATION_STLINK_VID && link == LINK_NONE)
+		{
+			link = LINK_UART;
+		}
+		else
+		{
+			continue;
+		}
+		device = "/dev/" + names[i];
+	}
+	return link;
+}
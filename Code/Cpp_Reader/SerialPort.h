@@ -0,0 +1,64 @@
+/*
+ * SerialPort.h
+ *
+ * Minimal raw serial port access (Linux termios) for the base station link.
+ */
+
+
+#ifndef SERIALPORT_H_
+#define SERIALPORT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+
+
+// USB IDs of the base station link, see HOST_LINK_USB in Code/BaseStation/main.cpp
+#define BASE_STATION_USB_VID		0x1f00		// native USB CDC of the STM32F411
+#define BASE_STATION_USB_PID		0x2012
+#define BASE_STATION_STLINK_VID		0x0483		// ST-Link virtual COM port of the Nucleo
+
+
+enum BaseStationLink
+{
+	LINK_NONE,
+	LINK_UART,		// ST-Link virtual COM port, the baud rate matters
+	LINK_USB		// native USB CDC, the baud rate is ignored
+};
+
+
+class SerialPort
+{
+public:
+	SerialPort();
+	~SerialPort();
+
+	// opens the device in raw 8N1 mode. Returns false on failure (errno is set)
+	bool open(const char* device, int baudrate);
+	void close();
+	bool isOpen() const { return fd >= 0; }
+
+	// waits up to timeout_ms for data. Returns number of bytes read, 0 on timeout, -1 on error
+	ssize_t read(uint8_t* data, size_t len, int timeout_ms);
+
+	// discards data received but not read yet (like ser.reset_input_buffer())
+	void flushInput();
+
+	int fileDescriptor() const { return fd; }
+
+private:
+	int fd;
+
+	SerialPort(const SerialPort&);
+	SerialPort& operator=(const SerialPort&);
+};
+
+
+// Looks for the base station among the ttyACM devices in sysfs (idVendor, idProduct of
+// the USB device), the native USB link first. Returns the device node in device.
+BaseStationLink findBaseStation(std::string &device, const char* sysfsTty = "/sys/class/tty");
+
+
+#endif /* SERIALPORT_H_ */
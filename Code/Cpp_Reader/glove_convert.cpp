@@ -0,0 +1,688 @@
+/*
+ * glove_convert.cpp
+ *
+ * Converts between session recordings (.glr, see GloveRecording.h) and the
+ * log.csv layout of read_glove.py, and prints the chunk index of a recording.
+ *
+ * CSV rows are imported by GloveCsvImporter (see GloveCsvImport.h), the
+ * device of a node is derived from its highest sensor index unless given with
+ * -d. -j converts whole archives of log.csv files on a thread pool (see
+ * batchCsvToRecording()).
+ *
+ * -b replays log.csv files through the delta mode encoder (see benchmarkCsv()).
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "GloveCsv.h"
+#include "GloveCsvImport.h"
+#include "GloveEncoder.h"
+#include "GloveRecording.h"
+#include "GloveWorkPool.h"
+
+
+static bool hasSuffix(const char* path, const char* suffix)
+{
+	size_t len = strlen(path);
+	size_t suffixLen = strlen(suffix);
+	return len >= suffixLen && strcasecmp(path + len - suffixLen, suffix) == 0;
+}
+
+static void printStats(const GloveDecoderStats &stats)
+{
+	fprintf(stderr, "bytes: %llu, skipped: %llu, packets: %llu, samples: %llu, sync losses: %llu, incomplete split samples: %llu, "
+			"unresolved deltas: %llu\n",
+			(unsigned long long)stats.bytesReceived, (unsigned long long)stats.bytesSkipped,
+			(unsigned long long)stats.packets, (unsigned long long)stats.samples,
+			(unsigned long long)stats.syncLosses, (unsigned long long)stats.splitIncomplete,
+			(unsigned long long)stats.deltaUnresolved);
+}
+
+
+static int printInfo(const char* path, bool verbose)
+{
+	GloveRecordingReader reader;
+	if (!reader.open(path))
+	{
+		perror(path);
+		return 1;
+	}
+
+	uint64_t records = 0;
+	uint64_t samples = 0;
+	uint16_t nodeMask = 0;
+	for (size_t i = 0; i < reader.chunkCount(); ++i)
+	{
+		const GloveChunkHeader &chunk = reader.chunk(i).header;
+		records += chunk.recordCount;
+		samples += chunk.endSample - chunk.firstSample;
+		nodeMask |= chunk.nodeMask;
+	}
+
+	printf("%s: %llu bytes, %zu chunks, %llu frames, %llu samples%s\n", path, (unsigned long long)reader.fileSize(),
+		   reader.chunkCount(), (unsigned long long)records, (unsigned long long)samples,
+		   reader.isRecovered() ? " (no index, rebuilt from chunk headers)" : "");
+	printf("time: %.3f s to %.3f s, nodes:", (double)(reader.startTime() - reader.timeOrigin()) / 1e6,
+		   (double)(reader.endTime() - reader.timeOrigin()) / 1e6);
+	for (int node = 0; node < 16; ++node)
+	{
+		if (nodeMask & (1 << node))
+		{
+			printf(" %d", node);
+		}
+	}
+	putchar('\n');
+
+	if (verbose)
+	{
+		printf("%8s %12s %12s %12s %8s %6s %12s %12s\n", "chunk", "offset", "first [s]", "last [s]", "frames", "nodes",
+			   "first sample", "end sample");
+		for (size_t i = 0; i < reader.chunkCount(); ++i)
+		{
+			const GloveChunkIndex &entry = reader.chunk(i);
+			printf("%8zu %12llu %12.3f %12.3f %8u %6x %12llu %12llu\n", i, (unsigned long long)entry.offset,
+				   (double)(entry.header.firstTime - reader.timeOrigin()) / 1e6,
+				   (double)(entry.header.lastTime - reader.timeOrigin()) / 1e6, entry.header.recordCount,
+				   entry.header.nodeMask, (unsigned long long)entry.header.firstSample,
+				   (unsigned long long)entry.header.endSample);
+		}
+	}
+	return 0;
+}
+
+
+static void onSample(const GloveSample &sample, void* context)
+{
+	((GloveCsvWriter*)context)->write(sample);
+}
+
+static int recordingToCsv(const char* inPath, const char* outPath, double start, double duration)
+{
+	GloveRecordingReader reader;
+	if (!reader.open(inPath))
+	{
+		perror(inPath);
+		return 1;
+	}
+	if (reader.isRecovered())
+	{
+		fprintf(stderr, "%s: no index, rebuilt from %zu chunk headers\n", inPath, reader.chunkCount());
+	}
+
+	FILE* out = fopen(outPath, "w");
+	if (!out)
+	{
+		perror(outPath);
+		return 1;
+	}
+
+	GloveCsvWriter writer(out);
+	writer.setTimeOrigin(reader.timeOrigin());
+	GloveDecoder decoder(onSample, &writer);
+
+	uint64_t startTime = reader.timeOrigin() + (uint64_t)(start * 1e6);
+	uint64_t endTime = duration > 0 ? startTime + (uint64_t)(duration * 1e6) : UINT64_MAX;
+
+	static const uint8_t sync[GLOVE_SYNC_LEN] = { GLOVE_SYNC_BYTE_1, GLOVE_SYNC_BYTE_2 };
+	GloveRecordingReader::Cursor cursor = start > 0 ? reader.seek(startTime) : reader.begin();
+	GloveFrame frame;
+	while (reader.next(cursor, frame) && frame.hostTime < endTime)
+	{
+		if (frame.flags & GLOVE_FRAME_SYNC)
+		{
+			decoder.feed(sync, sizeof(sync), frame.hostTime);
+		}
+		decoder.feed(frame.data, frame.length, frame.hostTime);
+	}
+	decoder.flush();
+	writer.finish();
+	printStats(decoder.stats());
+
+	if (fclose(out) != 0)
+	{
+		perror(outPath);
+		return 1;
+	}
+	return 0;
+}
+
+
+// a log.csv file, parsed in chunks (one after the other or in parallel)
+struct CsvImport
+{
+	std::string inPath;
+	std::string outPath;
+	GloveCsvFile file;
+	std::vector<size_t> offsets;			// chunk boundaries
+	std::vector<GloveCsvChunk> chunks;
+	std::atomic<size_t> remaining;			// chunks still being parsed
+
+	int columns;
+	uint8_t maxSensor[16];					// highest sensor index per node
+	GloveCsvImportStats stats;
+	std::vector<uint64_t> malformedLines;	// first GLOVE_CSV_REPORT_LINES, 1 based
+	bool ok;
+};
+
+static bool openCsv(CsvImport &import, size_t chunkSize)
+{
+	if (!import.file.open(import.inPath.c_str()))
+	{
+		perror(import.inPath.c_str());
+		return false;
+	}
+	import.offsets = glove_splitCsv(import.file.data(), import.file.size(), chunkSize);
+	import.chunks.resize(import.offsets.size() - 1);
+	import.remaining = import.chunks.size();
+	return true;
+}
+
+static void parseChunk(CsvImport &import, size_t i)
+{
+	const char* data = import.file.data();
+	glove_parseCsvChunk(data + import.offsets[i], data + import.offsets[i + 1], import.chunks[i]);
+}
+
+// header and line counts of all chunks, false if there is no header
+static bool mergeChunks(CsvImport &import)
+{
+	memset(&import.stats, 0, sizeof(import.stats));
+	memset(import.maxSensor, 0, sizeof(import.maxSensor));
+	import.columns = 0;
+	import.malformedLines.clear();
+
+	uint64_t line = 1;
+	for (size_t i = 0; i < import.chunks.size(); ++i)
+	{
+		const GloveCsvChunk &chunk = import.chunks[i];
+		if (chunk.columns != 0)
+		{
+			import.columns = chunk.columns;
+		}
+		for (int node = 0; node < 16; ++node)
+		{
+			import.maxSensor[node] = std::max(import.maxSensor[node], chunk.maxSensor[node]);
+		}
+		for (size_t k = 0; k < chunk.malformedLines.size() && import.malformedLines.size() < GLOVE_CSV_REPORT_LINES; ++k)
+		{
+			import.malformedLines.push_back(line + chunk.malformedLines[k]);
+		}
+		import.stats.rows += chunk.rowLines;
+		import.stats.malformedRows += chunk.malformedRows;
+		line += chunk.lines;
+	}
+
+	if (import.columns != 4 && import.columns != 7)
+	{
+		fprintf(stderr, "%s: no \"Sensor,i,4,...\" or \"Sensor,i,7,...\" header lines\n", import.inPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+// all rows of a log.csv file in one chunk
+static bool readCsv(const char* path, CsvImport &import)
+{
+	import.inPath = path;
+	if (!openCsv(import, SIZE_MAX))
+	{
+		return false;
+	}
+	parseChunk(import, 0);
+	return mergeChunks(import);
+}
+
+static bool writeRecording(CsvImport &import, int deviceId)
+{
+	GloveRecordingWriter writer;
+	if (!writer.open(import.outPath.c_str(), 0))
+	{
+		perror(import.outPath.c_str());
+		return false;
+	}
+
+	GloveCsvImporter importer(writer, import.columns, import.maxSensor, deviceId);
+	for (size_t i = 0; i < import.chunks.size(); ++i)
+	{
+		const std::vector<GloveCsvRow> &rows = import.chunks[i].rows;
+		for (size_t k = 0; k < rows.size(); ++k)
+		{
+			importer.add(rows[k]);
+		}
+		std::vector<GloveCsvRow>().swap(import.chunks[i].rows);
+	}
+	importer.finish();
+	import.stats.ignoredRows = importer.stats().ignoredRows;
+	import.stats.frames = importer.stats().frames;
+	import.stats.droppedRows = importer.stats().droppedRows;
+
+	if (!writer.close())
+	{
+		errno = writer.error();
+		perror(import.outPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+static void printMalformedLines(FILE* out, const CsvImport &import)
+{
+	if (import.malformedLines.empty())
+	{
+		return;
+	}
+	fprintf(out, "  malformed rows at line");
+	for (size_t i = 0; i < import.malformedLines.size(); ++i)
+	{
+		fprintf(out, "%s %llu", i > 0 ? "," : "", (unsigned long long)import.malformedLines[i]);
+	}
+	fprintf(out, "%s\n", import.stats.malformedRows > import.malformedLines.size() ? ", ..." : "");
+}
+
+static int csvToRecording(const char* inPath, const char* outPath, int deviceId)
+{
+	CsvImport import;
+	import.outPath = outPath;
+	if (!readCsv(inPath, import) || !writeRecording(import, deviceId))
+	{
+		return 1;
+	}
+
+	const GloveCsvImportStats &stats = import.stats;
+	fprintf(stderr, "rows: %llu, malformed: %llu, ignored: %llu, frames: %llu, dropped (incomplete packets): %llu\n",
+			(unsigned long long)stats.rows, (unsigned long long)stats.malformedRows,
+			(unsigned long long)stats.ignoredRows, (unsigned long long)stats.frames,
+			(unsigned long long)stats.droppedRows);
+	if (stats.droppedRows > 0)
+	{
+		fprintf(stderr, "the import is lossy: rows of packets with missing sensors are not in the recording\n");
+	}
+	printMalformedLines(stderr, import);
+	return 0;
+}
+
+
+static std::string recordingPath(const char* csvPath, const char* outDir)
+{
+	std::string path = csvPath;
+	if (hasSuffix(csvPath, ".csv"))
+	{
+		path.resize(path.size() - 4);
+	}
+	if (outDir)
+	{
+		size_t slash = path.rfind('/');
+		path = std::string(outDir) + "/" + (slash == std::string::npos ? path : path.substr(slash + 1));
+	}
+	return path + ".glr";
+}
+
+// Converts log.csv files to recordings on a pool of worker threads. Each file is mapped and
+// split into line-aligned chunks of GLOVE_CSV_CHUNK_SIZE bytes that are parsed in parallel,
+// the worker finishing the last chunk of a file writes its recording (the samples of a node
+// span chunk boundaries, so this part is sequential per file). Prints a validation report of
+// every file and the throughput.
+static int batchCsvToRecording(char** paths, int count, const char* outDir, unsigned int threads, int deviceId)
+{
+	std::vector<std::unique_ptr<CsvImport>> imports;
+	for (int i = 0; i < count; ++i)
+	{
+		imports.push_back(std::unique_ptr<CsvImport>(new CsvImport()));
+		imports.back()->inPath = paths[i];
+		imports.back()->outPath = recordingPath(paths[i], outDir);
+		imports.back()->ok = false;
+	}
+
+	struct timespec begin, end;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	GloveWorkPool pool(threads);
+	for (size_t i = 0; i < imports.size(); ++i)
+	{
+		CsvImport* import = imports[i].get();
+		pool.submit([&pool, import, deviceId]
+		{
+			if (!openCsv(*import, GLOVE_CSV_CHUNK_SIZE))
+			{
+				return;
+			}
+			for (size_t c = 0; c < import->chunks.size(); ++c)
+			{
+				pool.submit([import, c, deviceId]
+				{
+					parseChunk(*import, c);
+					if (--import->remaining == 0)
+					{
+						import->ok = mergeChunks(*import) && writeRecording(*import, deviceId);
+						import->file.close();
+					}
+				});
+			}
+		});
+	}
+	pool.wait();
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) * 1e-9;
+
+	GloveCsvImportStats total;
+	memset(&total, 0, sizeof(total));
+	uint64_t bytes = 0;
+	int failed = 0;
+	for (size_t i = 0; i < imports.size(); ++i)
+	{
+		const CsvImport &import = *imports[i];
+		if (!import.ok)
+		{
+			printf("%s: failed\n", import.inPath.c_str());
+			++failed;
+			continue;
+		}
+		const GloveCsvImportStats &stats = import.stats;
+		printf("%s -> %s: rows %llu, malformed %llu, ignored %llu, frames %llu, dropped %llu\n",
+			   import.inPath.c_str(), import.outPath.c_str(), (unsigned long long)stats.rows,
+			   (unsigned long long)stats.malformedRows, (unsigned long long)stats.ignoredRows,
+			   (unsigned long long)stats.frames, (unsigned long long)stats.droppedRows);
+		printMalformedLines(stdout, import);
+
+		bytes += import.offsets.back();
+		total.rows += stats.rows;
+		total.malformedRows += stats.malformedRows;
+		total.ignoredRows += stats.ignoredRows;
+		total.frames += stats.frames;
+		total.droppedRows += stats.droppedRows;
+	}
+
+	printf("%d files (%d failed), rows %llu, malformed %llu, ignored %llu, frames %llu, dropped %llu\n", count, failed,
+		   (unsigned long long)total.rows, (unsigned long long)total.malformedRows,
+		   (unsigned long long)total.ignoredRows, (unsigned long long)total.frames,
+		   (unsigned long long)total.droppedRows);
+	if (total.droppedRows > 0)
+	{
+		printf("the import is lossy: rows of packets with missing sensors are not in the recordings\n");
+	}
+	printf("%.1f MB of CSV in %.3f s: %.1f MB/s, %u threads, %llu tasks stolen\n", bytes / 1e6, seconds,
+		   seconds > 0 ? bytes / 1e6 / seconds : 0.0, pool.threadCount(), (unsigned long long)pool.steals());
+	return failed == 0 ? 0 : 1;
+}
+
+
+// nRF24L01+ packet besides the payload: preamble, 5 byte address, packet control field, 2 byte CRC
+#define AIR_OVERHEAD_BITS	(8 + 40 + 9 + 16)
+
+struct BenchmarkResult
+{
+	uint64_t frames;
+	uint64_t bytes;		// sync + descriptor + data, as written to the ack FIFO
+};
+
+struct DeltaCheck
+{
+	GloveSample expected[GLOVE_MAX_SENSORS];	// sensors of the sample being decoded
+	uint64_t samples;
+	uint64_t mismatches;
+};
+
+static void onDeltaSample(const GloveSample &sample, void* context)
+{
+	DeltaCheck &check = *(DeltaCheck*)context;
+	const GloveSample &expected = check.expected[sample.sensorId];
+	++check.samples;
+	if (memcmp(&sample.quat[1], &expected.quat[1], 3 * sizeof(int16_t)) != 0)
+	{
+		++check.mismatches;
+	}
+}
+
+static void addFixedMode(uint8_t mode, uint8_t deviceId, BenchmarkResult &result)
+{
+	uint8_t packetCount = glove_getPacketCount(mode, deviceId);
+	for (uint8_t packetId = 1; packetId <= packetCount; ++packetId)
+	{
+		uint8_t numSamples;
+		result.bytes += (packetId == 1 ? GLOVE_SYNC_LEN : 0) + GLOVE_DESCRIPTOR_LEN + glove_getPacketLength(mode, deviceId, packetId, numSamples);
+		++result.frames;
+	}
+}
+
+static void printBenchmark(const char* name, const BenchmarkResult* results, uint64_t samples, uint64_t sensors)
+{
+	static const char* modeNames[3] = { "0 quaternion", "2 smallest three", "5 delta" };
+
+	printf("%s: %llu samples, %llu sensor values\n", name, (unsigned long long)samples, (unsigned long long)sensors);
+	printf("  %-18s %10s %12s %12s %12s %12s\n", "mode", "frames", "bytes", "on air", "bytes ratio", "air ratio");
+	double baseBytes = results[0].bytes;
+	double baseAir = results[0].bytes + results[0].frames * AIR_OVERHEAD_BITS / 8.0;
+	for (int i = 0; i < 3; ++i)
+	{
+		double air = results[i].bytes + results[i].frames * AIR_OVERHEAD_BITS / 8.0;
+		printf("  %-18s %10llu %12llu %12.0f %12.2f %12.2f\n", modeNames[i], (unsigned long long)results[i].frames,
+			   (unsigned long long)results[i].bytes, air, results[i].bytes ? baseBytes / results[i].bytes : 0.0,
+			   air > 0 ? baseAir / air : 0.0);
+	}
+}
+
+// Replays log.csv files through the encoders of mode 0, mode 2 and delta mode and compares
+// the bytes written to the ack FIFO and sent on air. Sample k of a node is the k-th row of
+// each of its sensors (read_glove.py interleaves the rows of lost packets). Delta mode is
+// decoded again and must reproduce the values of mode 0.
+static int benchmarkCsv(char** paths, int count, int deviceId)
+{
+	BenchmarkResult total[3];
+	memset(total, 0, sizeof(total));
+	uint64_t totalSamples = 0;
+	uint64_t totalSensors = 0;
+
+	DeltaCheck check;
+	memset(&check, 0, sizeof(check));
+	GloveDecoder decoder(onDeltaSample, &check);
+
+	for (int file = 0; file < count; ++file)
+	{
+		CsvImport import;
+		if (!readCsv(paths[file], import))
+		{
+			return 1;
+		}
+		const std::vector<GloveCsvRow> &rows = import.chunks[0].rows;
+
+		BenchmarkResult results[3];
+		memset(results, 0, sizeof(results));
+		uint64_t samples = 0;
+		uint64_t sensors = 0;
+
+		for (int node = 0; node < 16; ++node)
+		{
+			uint8_t device = glove_csvNodeDevice(deviceId, import.maxSensor[node]);
+			uint8_t sensorCount = glove_getSensorCount(MODE_QUAT_DELTA, device);
+			if (sensorCount == 0)
+			{
+				continue;
+			}
+
+			std::vector<GloveSample> sensorRows[GLOVE_MAX_SENSORS];
+			for (size_t i = 0; i < rows.size(); ++i)
+			{
+				if ((rows[i].id >> 4) == node && (rows[i].id & 0x0F) < sensorCount)
+				{
+					GloveSample sample;
+					memset(&sample, 0, sizeof(sample));
+					glove_csvRowToSample(rows[i], sample);
+					sensorRows[rows[i].id & 0x0F].push_back(sample);
+				}
+			}
+			size_t nodeSamples = SIZE_MAX;
+			for (uint8_t sensor = 0; sensor < sensorCount; ++sensor)
+			{
+				nodeSamples = sensorRows[sensor].size() < nodeSamples ? sensorRows[sensor].size() : nodeSamples;
+			}
+
+			GloveDescriptor desc;
+			desc.nodeId = node;
+			desc.deviceId = device;
+			desc.mode = MODE_QUAT_DELTA;
+			desc.sampleId = 0;
+			desc.time = 0;
+			GloveDeltaEncoder encoder;
+			static const uint8_t sync[GLOVE_SYNC_LEN] = { GLOVE_SYNC_BYTE_1, GLOVE_SYNC_BYTE_2 };
+
+			for (size_t k = 0; k < nodeSamples; ++k)
+			{
+				GloveSample sample[GLOVE_MAX_SENSORS];
+				for (uint8_t sensor = 0; sensor < sensorCount; ++sensor)
+				{
+					sample[sensor] = sensorRows[sensor][k];
+				}
+
+				addFixedMode(MODE_QUAT, device, results[0]);
+				addFixedMode(MODE_QUAT_S3, device, results[1]);
+
+				uint8_t packets[GLOVE_DELTA_MAX_PACKETS][GLOVE_DESCRIPTOR_LEN + GLOVE_PAYLOAD_MAX_LEN];
+				uint8_t lengths[GLOVE_DELTA_MAX_PACKETS];
+				int packetCount = encoder.encode(desc, sample, packets[0], lengths);
+				for (int i = 0; i < packetCount; ++i)
+				{
+					if (i == 0)
+					{
+						// the decoder takes the previous sample's last packet once these arrive
+						decoder.feed(sync, sizeof(sync), 0);
+						memcpy(check.expected, sample, sizeof(check.expected));
+					}
+					decoder.feed(packets[i], lengths[i], 0);
+					results[2].bytes += (i == 0 ? GLOVE_SYNC_LEN : 0) + lengths[i];
+					++results[2].frames;
+				}
+			}
+			samples += nodeSamples;
+			sensors += nodeSamples * sensorCount;
+		}
+
+		printBenchmark(paths[file], results, samples, sensors);
+		for (int i = 0; i < 3; ++i)
+		{
+			total[i].frames += results[i].frames;
+			total[i].bytes += results[i].bytes;
+		}
+		totalSamples += samples;
+		totalSensors += sensors;
+	}
+	decoder.flush();
+
+	if (count > 1)
+	{
+		printBenchmark("total", total, totalSamples, totalSensors);
+	}
+	printf("delta mode: %llu of %llu sensor values decoded, %llu differ from mode 0\n", (unsigned long long)check.samples,
+		   (unsigned long long)totalSensors, (unsigned long long)check.mismatches);
+	return check.samples == totalSensors && check.mismatches == 0 ? 0 : 1;
+}
+
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [-s seconds] [-t seconds] <recording.glr> <log.csv>\n", name);
+	fprintf(stderr, "       %s [-d device] <log.csv> <recording.glr>\n", name);
+	fprintf(stderr, "       %s -i [-v] <recording.glr>\n", name);
+	fprintf(stderr, "       %s -j threads [-o dir] [-d device] <log.csv>...\n", name);
+	fprintf(stderr, "       %s -b [-d device] <log.csv>...\n", name);
+	fprintf(stderr, "  -s seconds  start the CSV export at this time of the session\n");
+	fprintf(stderr, "  -t seconds  export only this duration\n");
+	fprintf(stderr, "  -d device   device ID of all nodes (0 single node, 1 glove v1, 2 glove v2),\n");
+	fprintf(stderr, "              default: derived from the highest sensor index of a node\n");
+	fprintf(stderr, "  -j threads  convert all files to .glr on this many threads (0: one per CPU)\n");
+	fprintf(stderr, "  -o dir      directory of the .glr files of -j, default: next to the CSV files\n");
+	fprintf(stderr, "  -i          print the chunk index summary of a recording, -v lists all chunks\n");
+	fprintf(stderr, "  -b          compare the packet and on-air bytes of modes 0, 2 and delta mode (gloves only)\n");
+}
+
+int main(int argc, char** argv)
+{
+	bool info = false;
+	bool benchmark = false;
+	bool verbose = false;
+	double start = 0;
+	double duration = 0;
+	int deviceId = -1;
+	int threads = -1;
+	const char* outDir = 0;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "ibvs:t:d:j:o:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'i':
+				info = true;
+				break;
+			case 'b':
+				benchmark = true;
+				break;
+			case 'v':
+				verbose = true;
+				break;
+			case 's':
+				start = atof(optarg);
+				break;
+			case 't':
+				duration = atof(optarg);
+				break;
+			case 'd':
+				deviceId = atoi(optarg);
+				if (deviceId < DEVICE_SINGLE_NODE || deviceId > DEVICE_GLOVE_V2)
+				{
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'j':
+				threads = atoi(optarg);
+				if (threads < 0)
+				{
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'o':
+				outDir = optarg;
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (info && optind < argc)
+	{
+		return printInfo(argv[optind], verbose);
+	}
+	if (benchmark && optind < argc)
+	{
+		return benchmarkCsv(argv + optind, argc - optind, deviceId);
+	}
+	if (threads >= 0 && optind < argc)
+	{
+		return batchCsvToRecording(argv + optind, argc - optind, outDir, threads, deviceId);
+	}
+	if (optind + 2 != argc)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	const char* inPath = argv[optind];
+	const char* outPath = argv[optind + 1];
+	if (hasSuffix(inPath, ".csv"))
+	{
+		return csvToRecording(inPath, outPath, deviceId);
+	}
+	return recordingToCsv(inPath, outPath, start, duration);
+}
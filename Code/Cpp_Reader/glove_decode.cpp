@@ -0,0 +1,463 @@
+/*
+ * glove_decode.cpp
+ *
+ * Command line front end of GloveDecoder: decodes the base station stream from
+ * a serial port or a recorded byte stream and prints the samples in the row
+ * layout of read_glove.py's log.csv. With -b, a recorded stream is decoded
+ * repeatedly from memory to measure decoder throughput, -k compares the
+ * scalar and SIMD paths of the dequantization, smallest three and hand kinematics kernels. Without a device (or
+ * with "auto"), the base station is looked up by its USB IDs, over the native
+ * USB link or the ST-Link virtual COM port. Live streams are read by a
+ * thread of their own (GloveIngest), the decoder and the recorder consume
+ * them independently, so neither printing nor a slow disk holds up the port.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "GloveCsv.h"
+#include "GloveDecoder.h"
+#include "GloveIngest.h"
+#include "GloveKinematics.h"
+#include "GloveRecording.h"
+#include "QuatKernel.h"
+#include "SerialPort.h"
+
+
+static volatile sig_atomic_t running = 1;
+
+
+static void onSignal(int)
+{
+	running = 0;
+}
+
+static uint64_t monotonicUs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+struct SampleSink
+{
+	GloveCsvWriter* writer;
+	uint64_t checksum;
+};
+
+static void onSample(const GloveSample &sample, void* context)
+{
+	SampleSink* sink = (SampleSink*)context;
+	sink->checksum += sample.quat[1] + sample.sensorId;
+	if (sink->writer)
+	{
+		sink->writer->write(sample);
+	}
+}
+
+
+static void printStats(const GloveDecoder &decoder)
+{
+	const GloveDecoderStats &stats = decoder.stats();
+	fprintf(stderr, "bytes: %llu, skipped: %llu, packets: %llu, samples: %llu, sync losses: %llu, packet resyncs: %llu, "
+			"incomplete split samples: %llu, unresolved deltas: %llu\n",
+			(unsigned long long)stats.bytesReceived, (unsigned long long)stats.bytesSkipped,
+			(unsigned long long)stats.packets, (unsigned long long)stats.samples,
+			(unsigned long long)stats.syncLosses, (unsigned long long)stats.packetResyncs,
+			(unsigned long long)stats.splitIncomplete, (unsigned long long)stats.deltaUnresolved);
+
+	const GloveClockStats &clock = decoder.clock().stats();
+	if (clock.ticks || clock.rxTimes)
+	{
+		fprintf(stderr, "time stamps: ticks: %llu, receive times: %llu, tick jumps: %llu\n",
+				(unsigned long long)clock.ticks, (unsigned long long)clock.rxTimes, (unsigned long long)clock.tickJumps);
+	}
+
+	for (uint8_t nodeId = 0; nodeId < 16; ++nodeId)
+	{
+		const GloveSequenceStats &sequence = decoder.sequenceStats(nodeId);
+		if (sequence.sets == 0)
+		{
+			continue;
+		}
+		fprintf(stderr, "node %u: sample sets: %llu, partial: %llu (missing sensors: %llu), lost packets: %llu, lost samples: %llu, "
+				"duplicates: %llu, reordered: %llu\n",
+				nodeId, (unsigned long long)sequence.sets, (unsigned long long)sequence.partialSets,
+				(unsigned long long)sequence.missingSensors, (unsigned long long)sequence.lostPackets,
+				(unsigned long long)sequence.lostSamples, (unsigned long long)sequence.duplicates,
+				(unsigned long long)sequence.reordered);
+	}
+
+	for (uint8_t nodeId = 0; nodeId < 16; ++nodeId)
+	{
+		const GloveLinkStats &link = decoder.linkStats(nodeId);
+		if (link.frames == 0)
+		{
+			continue;
+		}
+		fprintf(stderr, "link node %u: %.1f s, polls: %llu, payloads: %llu (%.1f %%), max. tries: %llu, "
+				"round trip p50/p99/max: %u/%u/%u us\n",
+				nodeId, link.time / 1e3, (unsigned long long)link.polls, (unsigned long long)link.payloads,
+				link.polls ? 100.0 * link.payloads / link.polls : 0.0,
+				(unsigned long long)link.maxTry,
+				glove_rttPercentile(link, 0.5), glove_rttPercentile(link, 0.99), link.rttMax);
+	}
+}
+
+static bool readFile(const char* path, std::vector<uint8_t> &data)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		return false;
+	}
+	uint8_t chunk[1 << 16];
+	size_t n;
+	while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+	{
+		data.insert(data.end(), chunk, chunk + n);
+	}
+	fclose(file);
+	return true;
+}
+
+static int runBenchmark(const char* path, int iterations)
+{
+	std::vector<uint8_t> data;
+	if (!readFile(path, data) || data.empty())
+	{
+		fprintf(stderr, "could not read recorded stream %s\n", path);
+		return 1;
+	}
+
+	SampleSink sink = { 0, 0 };
+	GloveDecoder decoder(onSample, &sink);
+	uint64_t packets = 0;
+
+	uint64_t start = monotonicUs();
+	for (int i = 0; i < iterations; ++i)
+	{
+		decoder.reset();
+		// feed in chunks similar to serial reads
+		for (size_t pos = 0; pos < data.size(); pos += 4096)
+		{
+			size_t len = data.size() - pos < 4096 ? data.size() - pos : 4096;
+			decoder.feed(&data[pos], len);
+		}
+		decoder.flush();
+		packets += decoder.stats().packets;
+	}
+	double seconds = (monotonicUs() - start) / 1e6;
+
+	printStats(decoder);
+	printf("%d x %zu bytes in %.3f s: %.0f packets/s, %.1f MB/s (checksum %llu)\n",
+		   iterations, data.size(), seconds, packets / seconds,
+		   (double)data.size() * iterations / seconds / 1e6, (unsigned long long)sink.checksum);
+	return 0;
+}
+
+static int runKernelBenchmark(int iterations)
+{
+	// random compressed quaternions + lin. acc., a few with x^2 + y^2 + z^2 > 1
+	const size_t count = 1 << 20;
+	const uint8_t flags = GLOVE_SAMPLE_HAS_LINACC;
+	std::vector<int16_t> raw(count * 6);
+	uint32_t seed = 12345;
+	for (size_t i = 0; i < raw.size(); ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		raw[i] = (int16_t)((int32_t)(seed >> 8) % 16385);
+	}
+
+	std::vector<double> reference(count * 7);
+	std::vector<double> rows(count * 7);
+	glove_dequantizeWith(KERNEL_SCALAR, raw.data(), count, flags, reference.data());
+
+	for (int path = KERNEL_SCALAR; path <= glove_kernelPath(); ++path)
+	{
+		uint64_t start = monotonicUs();
+		for (int i = 0; i < iterations; ++i)
+		{
+			glove_dequantizeWith((GloveKernelPath)path, raw.data(), count, flags, rows.data());
+		}
+		double seconds = (monotonicUs() - start) / 1e6;
+
+		bool identical = memcmp(rows.data(), reference.data(), rows.size() * sizeof(double)) == 0;
+		printf("%-6s %.1f M samples/s, %s\n", glove_kernelPathName((GloveKernelPath)path),
+			   (double)count * iterations / seconds / 1e6, identical ? "identical to scalar" : "MISMATCH");
+	}
+
+	// random smallest three quaternions of both bit depths (the random bytes cover the
+	// sumsq > 1 clamp as well)
+	const uint8_t s3Bits[2] = { GLOVE_S3_BITS, GLOVE_S3_FINE_BITS };
+	std::vector<uint8_t> packed(count * GLOVE_S3_FINE_LEN);
+	for (size_t i = 0; i < packed.size(); ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		packed[i] = (uint8_t)(seed >> 16);
+	}
+	std::vector<int16_t> s3Reference(count * 4);
+	std::vector<int16_t> quats(count * 4);
+
+	for (int b = 0; b < 2; ++b)
+	{
+		size_t len = glove_s3Len(s3Bits[b]);
+		glove_decodeS3With(KERNEL_SCALAR, packed.data(), len, count, s3Bits[b], s3Reference.data());
+
+		for (int path = KERNEL_SCALAR; path <= glove_kernelPath(); ++path)
+		{
+			uint64_t start = monotonicUs();
+			for (int i = 0; i < iterations; ++i)
+			{
+				glove_decodeS3With((GloveKernelPath)path, packed.data(), len, count, s3Bits[b], quats.data());
+			}
+			double seconds = (monotonicUs() - start) / 1e6;
+
+			bool identical = memcmp(quats.data(), s3Reference.data(), quats.size() * sizeof(int16_t)) == 0;
+			printf("%-6s s3 %d bit %.1f M quats/s, %s\n", glove_kernelPathName((GloveKernelPath)path), s3Bits[b],
+				   (double)count * iterations / seconds / 1e6, identical ? "identical to scalar" : "MISMATCH");
+		}
+	}
+
+	// hand poses from random (not normalized) quaternions of all 7 sensors
+	const size_t frameCount = count / 8;
+	std::vector<float> frames(frameCount * GLOVE_HAND_FRAME_LEN);
+	for (size_t i = 0; i < frames.size(); ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		frames[i] = (int16_t)(seed >> 16) * (1.0f / 16384.0f);
+	}
+	GloveHandModel model;
+	glove_defaultHandModel(DEVICE_GLOVE_V2, model);
+	std::vector<float> poseReference(frameCount * GLOVE_HAND_POSE_LEN);
+	std::vector<float> poses(frameCount * GLOVE_HAND_POSE_LEN);
+	glove_handKinematicsWith(KERNEL_SCALAR, model, frames.data(), frameCount, poseReference.data());
+
+	for (int path = KERNEL_SCALAR; path <= glove_kernelPath(); ++path)
+	{
+		uint64_t start = monotonicUs();
+		for (int i = 0; i < iterations; ++i)
+		{
+			glove_handKinematicsWith((GloveKernelPath)path, model, frames.data(), frameCount, poses.data());
+		}
+		double seconds = (monotonicUs() - start) / 1e6;
+
+		bool identical = memcmp(poses.data(), poseReference.data(), poses.size() * sizeof(float)) == 0;
+		printf("%-6s hand %.1f M frames/s, %s\n", glove_kernelPathName((GloveKernelPath)path),
+			   (double)frameCount * iterations / seconds / 1e6, identical ? "identical to scalar" : "MISMATCH");
+	}
+	return 0;
+}
+
+// copies the chunks of a consumer straight into the ring buffer of its decoder until the ring is
+// closed and read or active is cleared
+static void consumeChunks(GloveChunkRing &ring, GloveChunkReader &reader, GloveDecoder &decoder,
+						  const volatile sig_atomic_t &active)
+{
+	while (active && (ring.wait(reader, 100) || !ring.isClosed()))
+	{
+		size_t maxLen;
+		uint8_t* dest = decoder.writePointer(maxLen);
+		uint64_t hostTime;
+		size_t n = ring.read(reader, dest, maxLen, hostTime);
+		if (n > 0)
+		{
+			decoder.commit(n, hostTime);
+		}
+	}
+}
+
+static void ignoreSample(const GloveSample&, void*)
+{
+}
+
+// recorder consumer: frames of its own decoder to the session file
+static void recordChunks(GloveChunkRing* ring, GloveChunkReader* reader, GloveRecordingWriter* recording)
+{
+	static const volatile sig_atomic_t untilClosed = 1;
+	GloveDecoder decoder(ignoreSample, 0);
+	decoder.setFrameCallback(GloveRecordingWriter::frameCallback, recording);
+	consumeChunks(*ring, *reader, decoder, untilClosed);
+	decoder.flush();
+}
+
+static int runStream(const char* path, int baudrate, bool printRows, const char* recordPath)
+{
+	uint64_t startTime = monotonicUs();
+	GloveCsvWriter writer(stdout);
+	SampleSink sink = { printRows ? &writer : 0, 0 };
+	GloveDecoder decoder(onSample, &sink);
+
+	GloveRecordingWriter recording;
+	if (recordPath && !recording.open(recordPath, startTime))
+	{
+		perror(recordPath);
+		return 1;
+	}
+
+	int ret = 0;
+	struct stat st;
+	if (stat(path, &st) == 0 && S_ISREG(st.st_mode))
+	{
+		if (recordPath)
+		{
+			decoder.setFrameCallback(GloveRecordingWriter::frameCallback, &recording);
+		}
+
+		// recorded stream, no time information available
+		std::vector<uint8_t> data;
+		if (!readFile(path, data))
+		{
+			perror(path);
+			return 1;
+		}
+		decoder.feed(data.data(), data.size(), startTime);
+	}
+	else
+	{
+		SerialPort port;
+		if (!port.open(path, baudrate))
+		{
+			perror(path);
+			return 1;
+		}
+		port.flushInput();
+
+		signal(SIGINT, onSignal);
+		signal(SIGTERM, onSignal);
+
+		// the consumers attach before the capture starts, they see every chunk
+		GloveChunkRing ring;
+		GloveIngest ingest(ring);
+		GloveChunkReader decodeReader;
+		GloveChunkReader recordReader;
+		ring.attach(decodeReader);
+		ring.attach(recordReader);
+		ingest.start(port);
+
+		std::thread recorder;
+		if (recordPath)
+		{
+			recorder = std::thread(recordChunks, &ring, &recordReader, &recording);
+		}
+
+		consumeChunks(ring, decodeReader, decoder, running);
+
+		// the consumers read what was captured up to here
+		ingest.stop();
+		volatile sig_atomic_t untilClosed = 1;
+		consumeChunks(ring, decodeReader, decoder, untilClosed);
+		if (recorder.joinable())
+		{
+			recorder.join();
+		}
+		if (ingest.stats().error)
+		{
+			errno = ingest.stats().error;
+			perror("read");
+		}
+
+		double seconds = (monotonicUs() - startTime) / 1e6;
+		fprintf(stderr, "%.1f s: %.1f kB/s, %.0f packets/s, overruns: decoder %llu, recorder %llu of %llu chunks\n", seconds,
+				decoder.stats().bytesReceived / seconds / 1e3, decoder.stats().packets / seconds,
+				(unsigned long long)decodeReader.overruns, (unsigned long long)(recordPath ? recordReader.overruns : 0),
+				(unsigned long long)ring.chunks());
+	}
+	decoder.flush();
+	writer.finish();
+	printStats(decoder);
+
+	if (recordPath && !recording.close())
+	{
+		errno = recording.error();
+		perror(recordPath);
+		ret = 1;
+	}
+	return ret;
+}
+
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [-c] [-w recording.glr] [-r baudrate] [-b iterations] [serial device | recorded stream | auto]\n", name);
+	fprintf(stderr, "       %s -k iterations\n", name);
+	fprintf(stderr, "  -c             print samples as read_glove.py CSV rows\n");
+	fprintf(stderr, "  -w file        record the received frames to a session file (see glove_convert)\n");
+	fprintf(stderr, "  -r baudrate    serial baud rate (default 500000, ignored on the native USB link)\n");
+	fprintf(stderr, "  -b iterations  decode a recorded stream from memory and report throughput\n");
+	fprintf(stderr, "  -k iterations  benchmark the dequantization, smallest three and hand kinematics kernel paths against each other\n");
+}
+
+int main(int argc, char** argv)
+{
+	bool printRows = false;
+	int baudrate = 500000;
+	int iterations = 0;
+	int kernelIterations = 0;
+	const char* recordPath = 0;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "cw:r:b:k:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'c':
+				printRows = true;
+				break;
+			case 'w':
+				recordPath = optarg;
+				break;
+			case 'r':
+				baudrate = atoi(optarg);
+				break;
+			case 'b':
+				iterations = atoi(optarg);
+				break;
+			case 'k':
+				kernelIterations = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (kernelIterations > 0)
+	{
+		return runKernelBenchmark(kernelIterations);
+	}
+	if (optind + 1 < argc || (iterations > 0 && optind >= argc))
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (iterations > 0)
+	{
+		return runBenchmark(argv[optind], iterations);
+	}
+
+	const char* path = optind < argc ? argv[optind] : "auto";
+	std::string device;
+	if (strcmp(path, "auto") == 0)
+	{
+		BaseStationLink link = findBaseStation(device);
+		if (link == LINK_NONE)
+		{
+			fprintf(stderr, "no base station found (USB %04x:%04x or ST-Link)\n", BASE_STATION_USB_VID, BASE_STATION_USB_PID);
+			return 1;
+		}
+		path = device.c_str();
+		fprintf(stderr, "base station on %s (%s)\n", path, link == LINK_USB ? "native USB" : "ST-Link UART");
+	}
+	return runStream(path, baudrate, printRows, recordPath);
+}
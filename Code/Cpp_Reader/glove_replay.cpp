@@ -0,0 +1,368 @@
+/*
+ * glove_replay.cpp
+ *
+ * Plays a session file (.glr) back as the byte stream of the base station
+ * (GloveReplay): into a decoder in this process, to a pseudo terminal like
+ * glove_sim (so glove_decode and read_glove.py read it as a live base
+ * station) or to a file. Paced in real time, N times faster (-x N) or
+ * unthrottled (-x 0), repeated with -n; in the decoder the unthrottled
+ * playback measures the decoder throughput on recorded data. -k adds the hand
+ * poses of the gloves (GloveKinematics), -p prints them.
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "GloveCsv.h"
+#include "GloveDecoder.h"
+#include "GloveKinematics.h"
+#include "GloveRecording.h"
+#include "GloveReplay.h"
+
+
+static volatile sig_atomic_t running = 1;
+
+
+static void onSignal(int)
+{
+	running = 0;
+}
+
+static uint64_t monotonicUs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+// opens a pty master, the slave is kept open (raw mode) so the master never sees a hangup
+static int openPty(const char* link, int &slave)
+{
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+	{
+		return -1;
+	}
+	const char* name = ptsname(master);
+	slave = open(name, O_RDWR | O_NOCTTY);
+	if (slave < 0)
+	{
+		return -1;
+	}
+
+	struct termios tty;
+	if (tcgetattr(slave, &tty) == 0)
+	{
+		cfmakeraw(&tty);
+		tcsetattr(slave, TCSANOW, &tty);
+	}
+
+	unlink(link);
+	if (symlink(name, link) != 0)
+	{
+		perror(link);
+	}
+	fprintf(stderr, "base station stream on %s, linked to %s\n", name, link);
+	return master;
+}
+
+// returns the number of bytes written, a non-blocking pty drops what its buffer can't take
+static size_t writeOutput(int fd, const uint8_t* data, size_t len)
+{
+	size_t written = 0;
+	while (written < len)
+	{
+		ssize_t n = write(fd, data + written, len - written);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+		written += n;
+	}
+	return written;
+}
+
+
+struct SampleSink
+{
+	GloveCsvWriter* writer;
+	uint64_t checksum;
+};
+
+static void onSample(const GloveSample &sample, void* context)
+{
+	SampleSink* sink = (SampleSink*)context;
+	sink->checksum += sample.quat[1] + sample.sensorId;
+	if (sink->writer)
+	{
+		sink->writer->write(sample);
+	}
+}
+
+// node, time in ms since the time origin, sensor mask, joint rotations (W, X, Y, Z), fingertips (m)
+static void onPose(const GloveHandPose &pose, void* context)
+{
+	uint64_t origin = *(const uint64_t*)context;
+	printf("%u,%lld,%u", pose.nodeId, (long long)(pose.sampleTime - origin) / 1000, pose.sensorMask);
+	for (int s = 0; s < GLOVE_HAND_SENSORS; ++s)
+	{
+		printf(",%.4f,%.4f,%.4f,%.4f", pose.joint[s][0], pose.joint[s][1], pose.joint[s][2], pose.joint[s][3]);
+	}
+	for (int f = 0; f < GLOVE_HAND_FINGERS; ++f)
+	{
+		printf(",%.4f,%.4f,%.4f", pose.tip[f][0], pose.tip[f][1], pose.tip[f][2]);
+	}
+	printf("\n");
+}
+
+static void printStats(const GloveDecoderStats &stats)
+{
+	fprintf(stderr, "bytes: %llu, skipped: %llu, packets: %llu, samples: %llu, sync losses: %llu, packet resyncs: %llu\n",
+			(unsigned long long)stats.bytesReceived, (unsigned long long)stats.bytesSkipped,
+			(unsigned long long)stats.packets, (unsigned long long)stats.samples,
+			(unsigned long long)stats.syncLosses, (unsigned long long)stats.packetResyncs);
+}
+
+static void printReplay(const GloveReplay &replay, int iterations, double seconds)
+{
+	const GloveReplayStats &stats = replay.stats();
+	fprintf(stderr, "%d x %llu reads, %llu bytes in %.3f s: %.0f reads/s, %.1f MB/s, max. late: %llu us\n",
+			iterations, (unsigned long long)stats.reads, (unsigned long long)stats.bytes, seconds,
+			stats.reads * iterations / seconds, (double)stats.bytes * iterations / seconds / 1e6,
+			(unsigned long long)stats.maxLate);
+}
+
+
+// plays the recording into a decoder, straight into its ring buffer
+static int replayToDecoder(const GloveRecordingReader &reader, GloveReplay &replay, GloveRecordingReader::Cursor cursor,
+						   uint64_t endTime, int iterations, bool printRows, bool kinematics, bool printPoses,
+						   double speed)
+{
+	GloveCsvWriter writer(stdout);
+	writer.setTimeOrigin(reader.timeOrigin());
+	SampleSink sink = { printRows ? &writer : 0, 0 };
+	GloveDecoder decoder(onSample, &sink);
+
+	uint64_t origin = reader.timeOrigin();
+	GloveHandKinematics hand(printPoses ? onPose : 0, &origin);
+	if (kinematics)
+	{
+		decoder.setSampleSetCallback(GloveHandKinematics::sampleSetCallback, &hand);
+	}
+
+	uint64_t start = monotonicUs();
+	int i;
+	for (i = 0; i < iterations && running; ++i)
+	{
+		decoder.reset();
+		replay.start(cursor, endTime);
+		while (running)
+		{
+			size_t maxLen;
+			uint8_t* dest = decoder.writePointer(maxLen);
+			uint64_t hostTime;
+			size_t n = replay.read(dest, maxLen, hostTime);
+			if (n == 0)
+			{
+				break;
+			}
+			decoder.commit(n, hostTime);
+			if (speed > 0)
+			{
+				// paced: poses as they come instead of per batch
+				hand.finish();
+			}
+		}
+		decoder.flush();
+		hand.finish();
+	}
+	double seconds = (monotonicUs() - start) / 1e6;
+
+	writer.finish();
+	printStats(decoder.stats());
+	printReplay(replay, i, seconds);
+	if (kinematics)
+	{
+		fprintf(stderr, "hand poses: %llu, %.0f/s\n", (unsigned long long)hand.poses(), hand.poses() / seconds);
+	}
+	fprintf(stderr, "checksum %llu\n", (unsigned long long)sink.checksum);
+	return 0;
+}
+
+// plays the recording to a pty or file
+static int replayToOutput(GloveReplay &replay, GloveRecordingReader::Cursor cursor, uint64_t endTime, int iterations,
+						  int fd)
+{
+	uint8_t chunk[4096];
+	uint64_t droppedBytes = 0;
+	uint64_t start = monotonicUs();
+	int i;
+	for (i = 0; i < iterations && running; ++i)
+	{
+		replay.start(cursor, endTime);
+		while (running)
+		{
+			uint64_t hostTime;
+			size_t n = replay.read(chunk, sizeof(chunk), hostTime);
+			if (n == 0)
+			{
+				break;
+			}
+			droppedBytes += n - writeOutput(fd, chunk, n);
+		}
+	}
+	printReplay(replay, i, (monotonicUs() - start) / 1e6);
+	fprintf(stderr, "bytes not read: %llu\n", (unsigned long long)droppedBytes);
+	return 0;
+}
+
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [-x speed] [-s seconds] [-t seconds] [-n iterations] [-c | -k [-p] | -o file | -L link] <recording.glr>\n", name);
+	fprintf(stderr, "  -x speed       recorded time per real time (default 1, 0 = unthrottled)\n");
+	fprintf(stderr, "  -s seconds     start at this time of the session\n");
+	fprintf(stderr, "  -t seconds     play only this duration\n");
+	fprintf(stderr, "  -n iterations  play the recording repeatedly (default 1)\n");
+	fprintf(stderr, "  -c             print the decoded samples as read_glove.py CSV rows\n");
+	fprintf(stderr, "  -k             compute the hand poses of the gloves, -p prints them as CSV rows (node, ms, sensor mask,\n");
+	fprintf(stderr, "                 W, X, Y, Z of the wrist, palm and finger joints, x, y, z of the fingertips)\n");
+	fprintf(stderr, "  -o file        write the byte stream to a file (- for stdout) instead of decoding it\n");
+	fprintf(stderr, "  -L link        write the byte stream to a pty linked to link instead of decoding it\n");
+}
+
+int main(int argc, char** argv)
+{
+	double speed = 1;
+	double start = 0;
+	double duration = 0;
+	int iterations = 1;
+	bool printRows = false;
+	bool kinematics = false;
+	bool printPoses = false;
+	const char* outPath = 0;
+	const char* link = 0;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "x:s:t:n:ckpo:L:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'x':
+				speed = atof(optarg);
+				break;
+			case 's':
+				start = atof(optarg);
+				break;
+			case 't':
+				duration = atof(optarg);
+				break;
+			case 'n':
+				iterations = atoi(optarg);
+				break;
+			case 'c':
+				printRows = true;
+				break;
+			case 'k':
+				kinematics = true;
+				break;
+			case 'p':
+				kinematics = true;
+				printPoses = true;
+				break;
+			case 'o':
+				outPath = optarg;
+				break;
+			case 'L':
+				link = optarg;
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind + 1 != argc || speed < 0 || iterations < 1 || (outPath && link) || ((printRows || kinematics) && (outPath || link)) || (printRows && printPoses))
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	const char* path = argv[optind];
+	GloveRecordingReader reader;
+	if (!reader.open(path))
+	{
+		perror(path);
+		return 1;
+	}
+	if (reader.isRecovered())
+	{
+		fprintf(stderr, "%s: no index, rebuilt from %zu chunk headers\n", path, reader.chunkCount());
+	}
+
+	uint64_t startTime = reader.timeOrigin() + (uint64_t)(start * 1e6);
+	uint64_t endTime = duration > 0 ? startTime + (uint64_t)(duration * 1e6) : UINT64_MAX;
+	GloveRecordingReader::Cursor cursor = start > 0 ? reader.seek(startTime) : reader.begin();
+	GloveReplay replay(reader);
+	replay.setSpeed(speed);
+
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+
+	if (!outPath && !link)
+	{
+		return replayToDecoder(reader, replay, cursor, endTime, iterations, printRows, kinematics, printPoses, speed);
+	}
+
+	int fd;
+	int slave = -1;
+	if (outPath)
+	{
+		fd = strcmp(outPath, "-") == 0 ? STDOUT_FILENO : open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+	else
+	{
+		fd = openPty(link, slave);
+		if (fd >= 0 && speed > 0)
+		{
+			// like the real UART: bytes nobody reads are lost instead of stalling the playback
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		}
+	}
+	if (fd < 0)
+	{
+		perror(outPath ? outPath : "pty");
+		return 1;
+	}
+
+	int ret = replayToOutput(replay, cursor, endTime, iterations, fd);
+
+	if (fd != STDOUT_FILENO)
+	{
+		close(fd);
+	}
+	if (slave >= 0)
+	{
+		close(slave);
+	}
+	if (link)
+	{
+		unlink(link);
+	}
+	return ret;
+}
@@ -0,0 +1,381 @@
+/*
+ * glove_shm.cpp
+ *
+ * Shared memory sample bus (GloveShm.h) for consumers on the same machine.
+ * Without -l it is the ingest process: it reads the base station like
+ * glove_decode (capture thread, auto detection), decodes the stream and
+ * publishes every sample to the segment. With -l it follows the segment as a
+ * consumer and prints the latency from the serial read to the consumer (and
+ * with -c the samples as read_glove.py CSV rows), -b measures the bus between
+ * two processes without a base station.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "GloveCsv.h"
+#include "GloveDecoder.h"
+#include "GloveIngest.h"
+#include "GloveShm.h"
+#include "SerialPort.h"
+
+
+static volatile sig_atomic_t running = 1;
+
+
+static void onSignal(int)
+{
+	running = 0;
+}
+
+static uint64_t monotonicUs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t percentile(std::vector<uint32_t> &values, double p)
+{
+	if (values.empty())
+	{
+		return 0;
+	}
+	size_t i = (size_t)(p * (values.size() - 1));
+	std::nth_element(values.begin(), values.begin() + i, values.end());
+	return values[i];
+}
+
+static void printLatency(const char* name, std::vector<uint32_t> &latencies)
+{
+	uint32_t max = latencies.empty() ? 0 : *std::max_element(latencies.begin(), latencies.end());
+	fprintf(stderr, "%s p50/p99/p99.9/max: %u/%u/%u/%u us\n", name, percentile(latencies, 0.5),
+			percentile(latencies, 0.99), percentile(latencies, 0.999), max);
+}
+
+
+static int runIngest(const char* path, int baudrate, const char* name, size_t slotCount)
+{
+	SerialPort port;
+	if (!port.open(path, baudrate))
+	{
+		perror(path);
+		return 1;
+	}
+	port.flushInput();
+
+	GloveShmPublisher publisher;
+	if (!publisher.create(name, slotCount))
+	{
+		perror(name);
+		return 1;
+	}
+	fprintf(stderr, "publishing to %s (%zu samples)\n", name, slotCount);
+
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+
+	uint64_t startTime = monotonicUs();
+	GloveDecoder decoder(GloveShmPublisher::sampleCallback, &publisher);
+	GloveChunkRing ring;
+	GloveIngest ingest(ring);
+	GloveChunkReader reader;
+	ring.attach(reader);
+	ingest.start(port);
+
+	while (running && (ring.wait(reader, 100) || !ring.isClosed()))
+	{
+		size_t maxLen;
+		uint8_t* dest = decoder.writePointer(maxLen);
+		uint64_t hostTime;
+		size_t n = ring.read(reader, dest, maxLen, hostTime);
+		if (n > 0)
+		{
+			decoder.commit(n, hostTime);
+		}
+	}
+	ingest.stop();
+	decoder.flush();
+	if (ingest.stats().error)
+	{
+		errno = ingest.stats().error;
+		perror("read");
+	}
+
+	double seconds = (monotonicUs() - startTime) / 1e6;
+	fprintf(stderr, "%.1f s: samples: %llu (%.0f/s), decoder: bytes: %llu, skipped: %llu, packets: %llu, overruns: %llu of %llu chunks\n",
+			seconds, (unsigned long long)publisher.samples(), publisher.samples() / seconds,
+			(unsigned long long)decoder.stats().bytesReceived, (unsigned long long)decoder.stats().bytesSkipped,
+			(unsigned long long)decoder.stats().packets, (unsigned long long)reader.overruns,
+			(unsigned long long)ring.chunks());
+	publisher.close();
+	return 0;
+}
+
+
+static int runConsumer(const char* name, bool printRows, uint32_t spin_us)
+{
+	GloveShmSubscriber subscriber;
+	if (!subscriber.open(name))
+	{
+		perror(name);
+		return 1;
+	}
+	fprintf(stderr, "following %s of PID %d\n", name, (int)subscriber.publisherPid());
+
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+
+	GloveCsvWriter writer(stdout);
+	GloveShmReader reader;
+	subscriber.attach(reader);
+	std::vector<uint32_t> readLatencies;
+	std::vector<uint32_t> publishLatencies;
+	GloveShmSample record;
+	GloveSample sample;
+	while (running && (subscriber.wait(reader, 100000, spin_us) || !subscriber.isClosed()))
+	{
+		while (subscriber.read(reader, record))
+		{
+			uint64_t now = monotonicUs();
+			readLatencies.push_back((uint32_t)(now - record.hostTime));
+			publishLatencies.push_back((uint32_t)(now - record.publishTime));
+			if (printRows)
+			{
+				glove_shmToSample(record, sample);
+				writer.write(sample);
+			}
+		}
+	}
+	writer.finish();
+
+	fprintf(stderr, "samples: %llu, overruns: %llu%s\n", (unsigned long long)reader.samples,
+			(unsigned long long)reader.overruns, subscriber.isClosed() ? ", closed by the publisher" : "");
+	printLatency("serial read -> consumer", readLatencies);
+	printLatency("publish -> consumer    ", publishLatencies);
+	return 0;
+}
+
+
+// consumer process of the benchmark: reads until the segment is closed
+static int benchmarkConsumer(const char* name, int ready)
+{
+	GloveShmSubscriber subscriber;
+	if (!subscriber.open(name))
+	{
+		perror(name);
+		return 1;
+	}
+	GloveShmReader reader;
+	subscriber.attach(reader);
+	write(ready, "", 1);
+
+	std::vector<uint32_t> latencies;
+	latencies.reserve(1 << 24);
+	GloveShmSample record;
+	uint64_t checksum = 0;
+	uint64_t start = 0;
+	uint64_t end = 0;
+	while (subscriber.wait(reader, 1000000, 200))
+	{
+		while (subscriber.read(reader, record))
+		{
+			end = monotonicUs();
+			start = start ? start : end;
+			latencies.push_back((uint32_t)(end - record.hostTime));
+			checksum += record.quat[1];
+		}
+	}
+
+	double seconds = (end - start) / 1e6;
+	fprintf(stderr, "  consumer: samples: %llu (%.2f M/s), overruns: %llu (checksum %llu)\n  ",
+			(unsigned long long)reader.samples, seconds > 0 ? reader.samples / seconds / 1e6 : 0.0,
+			(unsigned long long)reader.overruns, (unsigned long long)checksum);
+	printLatency("publish -> consumer", latencies);
+	return 0;
+}
+
+// publishes batches of batchSize samples for the given time, one every periodUs (0 = flat out),
+// to a consumer in a process of its own
+static int runBenchmarkPass(const char* title, double seconds, uint8_t batchSize, uint64_t periodUs)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "/glove_bench_%d", (int)getpid());
+	GloveShmPublisher publisher;
+	if (!publisher.create(name))
+	{
+		perror(name);
+		return 1;
+	}
+
+	int ready[2];
+	if (pipe(ready) != 0)
+	{
+		perror("pipe");
+		return 1;
+	}
+	fflush(stderr);
+	pid_t child = fork();
+	if (child == 0)
+	{
+		::close(ready[0]);
+		_exit(benchmarkConsumer(name, ready[1]));
+	}
+	::close(ready[1]);
+	char c;
+	if (child < 0 || ::read(ready[0], &c, 1) != 1)
+	{
+		perror("consumer");
+		return 1;
+	}
+	::close(ready[0]);
+
+	GloveSample sample;
+	memset(&sample, 0, sizeof(sample));
+	sample.mode = 6;
+	sample.flags = GLOVE_SAMPLE_HAS_W | GLOVE_SAMPLE_HAS_LINACC;
+	sample.quat[0] = 16384;
+
+	uint64_t start = monotonicUs();
+	uint64_t end = start + (uint64_t)(seconds * 1e6);
+	uint64_t next = start;
+	for (uint64_t now = start; now < end; now = monotonicUs())
+	{
+		if (periodUs)
+		{
+			if (now < next)
+			{
+				struct timespec ts = { 0, (long)(next - now) * 1000 };
+				nanosleep(&ts, 0);
+				continue;
+			}
+			next += periodUs;
+		}
+		// the samples of one read, as if it returned now
+		for (uint8_t i = 0; i < batchSize; ++i)
+		{
+			sample.hostTime = now;
+			sample.sampleTime = now;
+			sample.sensorId = i % GLOVE_MAX_SENSORS;
+			sample.quat[1] = (int16_t)now;
+			publisher.publish(sample);
+		}
+	}
+	uint64_t published = publisher.samples();
+	double elapsed = (monotonicUs() - start) / 1e6;
+	publisher.close();
+
+	fprintf(stderr, "%s: %zu samples per batch, published %llu samples (%.2f M/s)\n", title, (size_t)batchSize,
+			(unsigned long long)published, published / elapsed / 1e6);
+	int status;
+	waitpid(child, &status, 0);
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+static int runBenchmark(double seconds)
+{
+	// paced like the native USB link (one read per ms with the samples of 6 glove v2)
+	if (runBenchmarkPass("1 kHz", seconds, 6, 1000) != 0)
+	{
+		return 1;
+	}
+	// flat out: what the consumer can take
+	return runBenchmarkPass("flat out", seconds, 64, 0);
+}
+
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [-s name] [-N samples] [-r baudrate] [serial device | auto]\n", name);
+	fprintf(stderr, "       %s -l [-s name] [-p us] [-c]\n", name);
+	fprintf(stderr, "       %s -b seconds\n", name);
+	fprintf(stderr, "  -s name        shared memory segment (default %s)\n", GLOVE_SHM_DEFAULT_NAME);
+	fprintf(stderr, "  -N samples     ring size (default %d)\n", GLOVE_SHM_SLOTS);
+	fprintf(stderr, "  -r baudrate    serial baud rate (default 500000, ignored on the native USB link)\n");
+	fprintf(stderr, "  -l             follow the segment and print the latency from the serial read\n");
+	fprintf(stderr, "  -p us          with -l, poll this long before sleeping when caught up (default 20)\n");
+	fprintf(stderr, "  -c             with -l, print the samples as read_glove.py CSV rows\n");
+	fprintf(stderr, "  -b seconds     benchmark the bus between two processes\n");
+}
+
+int main(int argc, char** argv)
+{
+	const char* name = GLOVE_SHM_DEFAULT_NAME;
+	long slotCount = GLOVE_SHM_SLOTS;
+	int baudrate = 500000;
+	bool consume = false;
+	bool printRows = false;
+	uint32_t spin_us = 20;
+	double benchmarkSeconds = 0;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "s:N:r:lp:cb:")) != -1)
+	{
+		switch (opt)
+		{
+			case 's':
+				name = optarg;
+				break;
+			case 'N':
+				slotCount = atol(optarg);
+				break;
+			case 'r':
+				baudrate = atoi(optarg);
+				break;
+			case 'l':
+				consume = true;
+				break;
+			case 'p':
+				spin_us = (uint32_t)atol(optarg);
+				break;
+			case 'c':
+				printRows = true;
+				break;
+			case 'b':
+				benchmarkSeconds = atof(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (slotCount < 2 || optind + 1 < argc)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (benchmarkSeconds > 0)
+	{
+		return runBenchmark(benchmarkSeconds);
+	}
+	if (consume)
+	{
+		return runConsumer(name, printRows, spin_us);
+	}
+
+	const char* path = optind < argc ? argv[optind] : "auto";
+	std::string device;
+	if (strcmp(path, "auto") == 0)
+	{
+		BaseStationLink link = findBaseStation(device);
+		if (link == LINK_NONE)
+		{
+			fprintf(stderr, "no base station found (USB %04x:%04x or ST-Link)\n", BASE_STATION_USB_VID, BASE_STATION_USB_PID);
+			return 1;
+		}
+		path = device.c_str();
+		fprintf(stderr, "base station on %s (%s)\n", path, link == LINK_USB ? "native USB" : "ST-Link UART");
+	}
+	return runIngest(path, baudrate, name, slotCount);
+}
@@ -0,0 +1,311 @@
+/*
+ * glove_sim.cpp
+ *
+ * Stand-in for the Nucleo base station: runs GloveSimulator and writes its
+ * serial stream to a pseudo terminal (or a file), so glove_decode and
+ * read_glove.py can be tested without radios. The simulation is deterministic
+ * for a given seed; with -x 0 it runs as fast as the output is consumed.
+ * SIGUSR1 switches to the next mode like the user button of the base station.
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "GloveSimulator.h"
+
+
+static volatile sig_atomic_t running = 1;
+static volatile sig_atomic_t toggleMode = 0;
+
+
+static void onSignal(int)
+{
+	running = 0;
+}
+
+static void onUser1(int)
+{
+	toggleMode = 1;
+}
+
+static uint64_t monotonicUs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+// opens a pty master, the slave is kept open (raw mode) so the master never sees a hangup
+static int openPty(const char* link, int &slave)
+{
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+	{
+		return -1;
+	}
+	const char* name = ptsname(master);
+	slave = open(name, O_RDWR | O_NOCTTY);
+	if (slave < 0)
+	{
+		return -1;
+	}
+
+	struct termios tty;
+	if (tcgetattr(slave, &tty) == 0)
+	{
+		cfmakeraw(&tty);
+		tcsetattr(slave, TCSANOW, &tty);
+	}
+
+	if (link)
+	{
+		unlink(link);
+		if (symlink(name, link) != 0)
+		{
+			perror(link);
+		}
+	}
+	fprintf(stderr, "base station stream on %s%s%s\n", name, link ? ", linked to " : "", link ? link : "");
+	return master;
+}
+
+// returns the number of bytes written, a non-blocking pty drops what its buffer can't take
+static size_t writeOutput(int fd, const uint8_t* data, size_t len)
+{
+	size_t written = 0;
+	while (written < len)
+	{
+		ssize_t n = write(fd, data + written, len - written);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+		written += n;
+	}
+	return written;
+}
+
+static bool parseNodeCounts(const char* text, GloveSimConfig &config)
+{
+	unsigned int single, v1, v2;
+	if (sscanf(text, "%u,%u,%u", &single, &v1, &v2) != 3 || single + v1 + v2 > GLOVE_SIM_MAX_NODES)
+	{
+		return false;
+	}
+	config.nodeCount[DEVICE_SINGLE_NODE] = single;
+	config.nodeCount[DEVICE_GLOVE_V1] = v1;
+	config.nodeCount[DEVICE_GLOVE_V2] = v2;
+	return true;
+}
+
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [-n single,v1,v2] [-m mode] [-l loss] [-R reorder] [-x rate] [-B baudrate] [-U] [-S]\n", name);
+	fprintf(stderr, "       %*s [-T] [-D ppm] [-M ms] [-A scale] [-p period] [-s seed] [-t seconds] [-o file | -L link]\n", (int)strlen(name), "");
+	fprintf(stderr, "  -n counts     number of single nodes, glove v1 and glove v2 (default 0,0,2, at most 16)\n");
+	fprintf(stderr, "  -m mode       0 quaternion, 1 quaternion + lin. acc., 2 smallest three 10 bit,\n");
+	fprintf(stderr, "                3 smallest three 12 bit, 4 smallest three 10 bit + lin. acc.,\n");
+	fprintf(stderr, "                5 quaternion residuals (delta, gloves only) (default 0)\n");
+	fprintf(stderr, "  -l loss       probability of a failed poll (default 0)\n");
+	fprintf(stderr, "  -R reorder    probability of a payload being forwarded after the next one (default 0)\n");
+	fprintf(stderr, "  -x rate       simulated time per real time (default 1, 0 = as fast as possible)\n");
+	fprintf(stderr, "  -B baudrate   serial port of the simulated base station (default 500000, 0 = unlimited)\n");
+	fprintf(stderr, "  -U            native USB link (64 byte bulk packets, full speed) instead of the UART\n");
+	fprintf(stderr, "  -S            star topology: the nodes send on their own, no polls (at most 6 nodes)\n");
+	fprintf(stderr, "  -T            no time stamps (tick of the gloves, receive time of the base station)\n");
+	fprintf(stderr, "  -D ppm        clock deviation of the nodes and the base station, at most (default 50)\n");
+	fprintf(stderr, "  -M ms         telemetry frame per node every ms, poll loop only (default 1000, 0 = off)\n");
+	fprintf(stderr, "  -A scale      scales the radio timing (default 1 = 1 Mbps, 0 = ideal radio)\n");
+	fprintf(stderr, "  -p period     sample period of the nodes in us (default 10000)\n");
+	fprintf(stderr, "  -s seed       random seed for loss, reordering and start times (default 1)\n");
+	fprintf(stderr, "  -t seconds    stop after this simulated time\n");
+	fprintf(stderr, "  -o file       write the stream to a file (- for stdout) instead of a pty\n");
+	fprintf(stderr, "  -L link       create a symlink to the pty\n");
+}
+
+int main(int argc, char** argv)
+{
+	GloveSimConfig config = GloveSimulator::defaultConfig();
+	double rate = 1;
+	double duration = 0;
+	const char* outPath = 0;
+	const char* link = 0;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:m:l:R:x:B:USTD:M:A:p:s:t:o:L:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'n':
+				if (!parseNodeCounts(optarg, config))
+				{
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'm':
+				config.mode = atoi(optarg);
+				if (config.mode >= GLOVE_MODE_COUNT)
+				{
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'l':
+				config.lossRate = atof(optarg);
+				break;
+			case 'R':
+				config.reorderRate = atof(optarg);
+				break;
+			case 'x':
+				rate = atof(optarg);
+				break;
+			case 'B':
+				config.baudrate = atoi(optarg);
+				break;
+			case 'U':
+				config.usb = true;
+				break;
+			case 'S':
+				config.star = true;
+				break;
+			case 'T':
+				config.timeStamps = false;
+				break;
+			case 'D':
+				config.clockDrift = atof(optarg);
+				break;
+			case 'M':
+				config.telemetryPeriod = atoi(optarg);
+				break;
+			case 'A':
+				config.radioTimeScale = atof(optarg);
+				break;
+			case 'p':
+				config.samplePeriod = atoi(optarg);
+				break;
+			case 's':
+				config.seed = strtoul(optarg, 0, 0);
+				break;
+			case 't':
+				duration = atof(optarg);
+				break;
+			case 'o':
+				outPath = optarg;
+				break;
+			case 'L':
+				link = optarg;
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind != argc || config.samplePeriod == 0 || rate < 0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	int fd;
+	int slave = -1;
+	if (outPath)
+	{
+		fd = strcmp(outPath, "-") == 0 ? STDOUT_FILENO : open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+	else
+	{
+		fd = openPty(link, slave);
+		if (fd >= 0 && rate > 0)
+		{
+			// like the real UART: bytes nobody reads are lost instead of stalling the base station
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		}
+	}
+	if (fd < 0)
+	{
+		perror(outPath ? outPath : "pty");
+		return 1;
+	}
+
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+	signal(SIGUSR1, onUser1);
+
+	GloveSimulator sim(config);
+	uint64_t endTime = duration > 0 ? (uint64_t)(duration * 1e6) : UINT64_MAX;
+	uint64_t droppedBytes = 0;
+	std::vector<uint8_t> out;
+
+	uint64_t start = monotonicUs();
+	while (running && sim.time() < endTime)
+	{
+		if (toggleMode)
+		{
+			toggleMode = 0;
+			sim.setMode((sim.mode() + 1) % GLOVE_MODE_COUNT);
+			fprintf(stderr, "mode %u\n", sim.mode());
+		}
+
+		uint64_t target;
+		if (rate > 0)
+		{
+			// 1 ms steps of real time
+			usleep(1000);
+			target = (uint64_t)((monotonicUs() - start) * rate);
+		}
+		else
+		{
+			target = sim.time() + 100000;
+		}
+		if (target > endTime)
+		{
+			target = endTime;
+		}
+
+		out.clear();
+		sim.run(target, out);
+		droppedBytes += out.size() - writeOutput(fd, out.data(), out.size());
+	}
+
+	const GloveSimStats &stats = sim.stats();
+	fprintf(stderr, "%.3f s simulated, %zu nodes: polls: %llu, empty: %llu, packets: %llu, lost: %llu, reordered: %llu, "
+			"FIFO overflows: %llu, collisions: %llu, retransmissions: %llu, telemetry frames: %llu, bytes: %llu, "
+			"serial wait: %.3f s, bytes not read: %llu\n",
+			sim.time() / 1e6, sim.nodeCount(), (unsigned long long)stats.polls, (unsigned long long)stats.emptyPolls,
+			(unsigned long long)stats.packets, (unsigned long long)stats.lostPackets,
+			(unsigned long long)stats.reorderedPackets, (unsigned long long)stats.fifoOverflows,
+			(unsigned long long)stats.collisions, (unsigned long long)stats.retransmissions,
+			(unsigned long long)stats.telemetryFrames, (unsigned long long)stats.bytes, stats.serialWaitTime / 1e6, (unsigned long long)droppedBytes);
+
+	if (fd != STDOUT_FILENO)
+	{
+		close(fd);
+	}
+	if (slave >= 0)
+	{
+		close(slave);
+	}
+	if (link)
+	{
+		unlink(link);
+	}
+	return 0;
+}
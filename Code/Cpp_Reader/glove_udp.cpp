@@ -0,0 +1,412 @@
+/*
+ * glove_udp.cpp
+ *
+ * UDP fan-out of the decoded samples, the binary successor of
+ * old_data/Linux/UDP/server.c. It reads the base station like glove_decode
+ * (capture thread, auto detection) and publishes every sample with
+ * GloveUdpPublisher to a multicast group and/or unicast addresses, one batch
+ * per serial read. With -l it subscribes instead and prints the loss
+ * statistics (and with -c the samples as read_glove.py CSV rows), -b
+ * measures the throughput and added latency of the datagrams over loopback.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "GloveCsv.h"
+#include "GloveDecoder.h"
+#include "GloveIngest.h"
+#include "GloveUdp.h"
+#include "SerialPort.h"
+
+
+static volatile sig_atomic_t running = 1;
+
+
+static void onSignal(int)
+{
+	running = 0;
+}
+
+static uint64_t monotonicUs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void printPublisherStats(const GloveUdpPublisher &publisher, double seconds)
+{
+	const GloveUdpPublisherStats &stats = publisher.stats();
+	fprintf(stderr, "%.1f s: samples: %llu, datagrams: %llu (%.0f/s, %.1f samples each), %.1f kB/s, dropped: %llu\n",
+			seconds, (unsigned long long)stats.samples, (unsigned long long)stats.datagrams,
+			stats.datagrams / seconds, stats.datagrams ? (double)stats.samples / stats.datagrams : 0.0,
+			stats.bytes / seconds / 1e3, (unsigned long long)stats.dropped);
+}
+
+static void printSubscriberStats(const GloveUdpSubscriber &subscriber)
+{
+	const GloveUdpSubscriberStats &stats = subscriber.stats();
+	fprintf(stderr, "samples: %llu, datagrams: %llu, lost: %llu, late: %llu, invalid: %llu, restarts: %llu\n",
+			(unsigned long long)stats.samples, (unsigned long long)stats.datagrams, (unsigned long long)stats.lost,
+			(unsigned long long)stats.late, (unsigned long long)stats.invalid, (unsigned long long)stats.restarts);
+}
+
+
+static int runServer(const char* path, int baudrate, GloveUdpPublisher &publisher)
+{
+	SerialPort port;
+	if (!port.open(path, baudrate))
+	{
+		perror(path);
+		return 1;
+	}
+	port.flushInput();
+
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+
+	uint64_t startTime = monotonicUs();
+	GloveDecoder decoder(GloveUdpPublisher::sampleCallback, &publisher);
+	GloveChunkRing ring;
+	GloveIngest ingest(ring);
+	GloveChunkReader reader;
+	ring.attach(reader);
+	ingest.start(port);
+
+	while (running && (ring.wait(reader, 100) || !ring.isClosed()))
+	{
+		size_t maxLen;
+		uint8_t* dest = decoder.writePointer(maxLen);
+		uint64_t hostTime;
+		size_t n = ring.read(reader, dest, maxLen, hostTime);
+		if (n > 0)
+		{
+			decoder.commit(n, hostTime);
+			// one datagram per read (or more if it held more than a datagram of samples)
+			publisher.flush();
+		}
+	}
+	ingest.stop();
+	decoder.flush();
+	publisher.flush();
+	if (ingest.stats().error)
+	{
+		errno = ingest.stats().error;
+		perror("read");
+	}
+
+	printPublisherStats(publisher, (monotonicUs() - startTime) / 1e6);
+	fprintf(stderr, "decoder: bytes: %llu, skipped: %llu, packets: %llu, overruns: %llu of %llu chunks\n",
+			(unsigned long long)decoder.stats().bytesReceived, (unsigned long long)decoder.stats().bytesSkipped,
+			(unsigned long long)decoder.stats().packets, (unsigned long long)reader.overruns,
+			(unsigned long long)ring.chunks());
+	return 0;
+}
+
+
+static void onSample(const GloveSample &sample, void* context)
+{
+	GloveCsvWriter* writer = (GloveCsvWriter*)context;
+	if (writer)
+	{
+		writer->write(sample);
+	}
+}
+
+static int runListener(const sockaddr_in &address, in_addr_t interface, bool printRows)
+{
+	GloveCsvWriter writer(stdout);
+	GloveUdpSubscriber subscriber(onSample, printRows ? &writer : 0);
+	if (!subscriber.open(address, interface))
+	{
+		perror("listen");
+		return 1;
+	}
+
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+
+	int ret = 0;
+	while (running)
+	{
+		if (subscriber.receive(100) < 0)
+		{
+			perror("receive");
+			ret = 1;
+			break;
+		}
+	}
+	writer.finish();
+	printSubscriberStats(subscriber);
+	return ret;
+}
+
+
+struct LatencySink
+{
+	std::vector<uint32_t> latencies;	// us per datagram
+	uint64_t checksum;
+};
+
+static void onBenchmarkSample(const GloveSample &sample, void* context)
+{
+	((LatencySink*)context)->checksum += sample.quat[1] + sample.sensorId;
+}
+
+// publishes batches of batchSize samples for the given time, one every periodUs (0 = flat out)
+static void publishSamples(GloveUdpPublisher* publisher, uint8_t batchSize, double seconds, uint64_t periodUs,
+						   std::atomic<bool>* done)
+{
+	GloveSample sample;
+	memset(&sample, 0, sizeof(sample));
+	sample.mode = 6;
+	sample.flags = GLOVE_SAMPLE_HAS_W | GLOVE_SAMPLE_HAS_LINACC;
+	sample.quat[0] = 16384;
+
+	uint64_t start = monotonicUs();
+	uint64_t end = start + (uint64_t)(seconds * 1e6);
+	uint64_t next = start;
+	for (uint64_t now = start; now < end; now = monotonicUs())
+	{
+		if (periodUs)
+		{
+			if (now < next)
+			{
+				struct timespec ts = { 0, (long)(next - now) * 1000 };
+				nanosleep(&ts, 0);
+				continue;
+			}
+			next += periodUs;
+		}
+		for (uint8_t i = 0; i < batchSize; ++i)
+		{
+			sample.sampleTime = now;
+			sample.sensorId = i % GLOVE_MAX_SENSORS;
+			sample.sampleId = (uint8_t)(sample.sampleId + (sample.sensorId == 0));
+			sample.quat[1] = (int16_t)now;
+			publisher->publish(sample);
+		}
+		publisher->flush();
+	}
+	done->store(true, std::memory_order_release);
+}
+
+static uint32_t percentile(std::vector<uint32_t> &values, double p)
+{
+	if (values.empty())
+	{
+		return 0;
+	}
+	size_t i = (size_t)(p * (values.size() - 1));
+	std::nth_element(values.begin(), values.begin() + i, values.end());
+	return values[i];
+}
+
+static int runBenchmarkPass(const char* name, uint8_t batchSize, double seconds, uint64_t periodUs)
+{
+	// a port of its own so a running server does not interfere
+	sockaddr_in address;
+	glove_udpParseAddress("127.0.0.1", address);
+	address.sin_port = 0;
+
+	LatencySink sink;
+	sink.checksum = 0;
+	GloveUdpSubscriber subscriber(onBenchmarkSample, &sink);
+	GloveUdpPublisher publisher;
+	if (!subscriber.open(address) || !publisher.open())
+	{
+		perror("socket");
+		return 1;
+	}
+	// the kernel picked the port at bind()
+	if (!subscriber.localAddress(address))
+	{
+		perror("getsockname");
+		return 1;
+	}
+	publisher.addDestination(address);
+	publisher.setBatchSize(batchSize);
+
+	std::atomic<bool> done(false);
+	uint64_t start = monotonicUs();
+	std::thread sender(publishSamples, &publisher, batchSize, seconds, periodUs, &done);
+	while (1)
+	{
+		int n = subscriber.receive(done.load(std::memory_order_acquire) ? 10 : 100);
+		if (n > 0)
+		{
+			sink.latencies.push_back((uint32_t)(monotonicUs() - subscriber.lastSendTime()));
+		}
+		else if (n < 0 || done.load(std::memory_order_acquire))
+		{
+			break;
+		}
+	}
+	sender.join();
+	double elapsed = (monotonicUs() - start) / 1e6;
+
+	const GloveUdpSubscriberStats &stats = subscriber.stats();
+	uint64_t sent = publisher.stats().datagrams + publisher.stats().dropped;
+	printf("%-8s %2u samples/datagram: %.0f datagrams/s, %.2f M samples/s, lost %.2f %% (%llu dropped by the sender), "
+		   "latency p50/p99/max: %u/%u/%u us\n",
+		   name, batchSize, stats.datagrams / elapsed, stats.samples / elapsed / 1e6,
+		   sent ? 100.0 * (sent - stats.datagrams) / sent : 0.0, (unsigned long long)publisher.stats().dropped,
+		   percentile(sink.latencies, 0.5), percentile(sink.latencies, 0.99),
+		   sink.latencies.empty() ? 0 : *std::max_element(sink.latencies.begin(), sink.latencies.end()));
+	return 0;
+}
+
+static int runBenchmark(double seconds, uint8_t batchSize)
+{
+	// flat out: what the loopback and the subscriber can take
+	uint8_t sizes[3] = { 1, 6, GLOVE_UDP_MAX_SAMPLES };
+	for (int i = 0; i < 3; ++i)
+	{
+		if (runBenchmarkPass("flat out", sizes[i], seconds, 0) != 0)
+		{
+			return 1;
+		}
+	}
+	// paced like the native USB link (one read per ms): the latency the fan-out adds
+	return runBenchmarkPass("1 kHz", batchSize, seconds, 1000);
+}
+
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [-g group[:port]] [-u host:port] [-I interface] [-n samples] [-r baudrate] [serial device | auto]\n", name);
+	fprintf(stderr, "       %s -l address[:port] [-I interface] [-c]\n", name);
+	fprintf(stderr, "       %s -b seconds [-n samples]\n", name);
+	fprintf(stderr, "  -g group[:port]   publish to a multicast group (default %s:%d without -g and -u)\n",
+			GLOVE_UDP_DEFAULT_GROUP, GLOVE_UDP_DEFAULT_PORT);
+	fprintf(stderr, "  -u host:port      publish to a unicast address, e.g. 127.0.0.1:%d (repeatable)\n", GLOVE_UDP_DEFAULT_PORT);
+	fprintf(stderr, "  -I interface      address of the interface for multicast (default: routing table)\n");
+	fprintf(stderr, "  -n samples        samples per datagram, at most %d (default %d)\n", (int)GLOVE_UDP_MAX_SAMPLES,
+			(int)GLOVE_UDP_MAX_SAMPLES);
+	fprintf(stderr, "  -r baudrate       serial baud rate (default 500000, ignored on the native USB link)\n");
+	fprintf(stderr, "  -l address[:port] subscribe to a group (or listen on a local address) and print the loss statistics\n");
+	fprintf(stderr, "  -c                with -l, print the samples as read_glove.py CSV rows\n");
+	fprintf(stderr, "  -b seconds        loopback benchmark: datagrams/s and latency\n");
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<sockaddr_in> destinations;
+	in_addr_t interface = INADDR_ANY;
+	int batchSize = GLOVE_UDP_MAX_SAMPLES;
+	int baudrate = 500000;
+	const char* listenAddress = 0;
+	bool printRows = false;
+	double benchmarkSeconds = 0;
+
+	int opt;
+	sockaddr_in address;
+	struct in_addr interfaceAddress;
+	while ((opt = getopt(argc, argv, "g:u:I:n:r:l:cb:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'g':
+			case 'u':
+				if (!glove_udpParseAddress(optarg, address))
+				{
+					fprintf(stderr, "invalid address %s\n", optarg);
+					return 1;
+				}
+				destinations.push_back(address);
+				break;
+			case 'I':
+				if (inet_aton(optarg, &interfaceAddress) == 0)
+				{
+					fprintf(stderr, "invalid interface address %s\n", optarg);
+					return 1;
+				}
+				interface = interfaceAddress.s_addr;
+				break;
+			case 'n':
+				batchSize = atoi(optarg);
+				break;
+			case 'r':
+				baudrate = atoi(optarg);
+				break;
+			case 'l':
+				listenAddress = optarg;
+				break;
+			case 'c':
+				printRows = true;
+				break;
+			case 'b':
+				benchmarkSeconds = atof(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (batchSize < 1 || batchSize > (int)GLOVE_UDP_MAX_SAMPLES || optind + 1 < argc)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (benchmarkSeconds > 0)
+	{
+		return runBenchmark(benchmarkSeconds, (uint8_t)batchSize);
+	}
+
+	if (listenAddress)
+	{
+		if (!glove_udpParseAddress(listenAddress, address))
+		{
+			fprintf(stderr, "invalid address %s\n", listenAddress);
+			return 1;
+		}
+		return runListener(address, interface, printRows);
+	}
+
+	if (destinations.empty())
+	{
+		glove_udpParseAddress(GLOVE_UDP_DEFAULT_GROUP, address);
+		destinations.push_back(address);
+	}
+	GloveUdpPublisher publisher;
+	if (!publisher.open(interface))
+	{
+		perror("socket");
+		return 1;
+	}
+	publisher.setBatchSize((uint8_t)batchSize);
+	for (size_t i = 0; i < destinations.size(); ++i)
+	{
+		publisher.addDestination(destinations[i]);
+		fprintf(stderr, "publishing to %s:%u\n", inet_ntoa(destinations[i].sin_addr), ntohs(destinations[i].sin_port));
+	}
+
+	const char* path = optind < argc ? argv[optind] : "auto";
+	std::string device;
+	if (strcmp(path, "auto") == 0)
+	{
+		BaseStationLink link = findBaseStation(device);
+		if (link == LINK_NONE)
+		{
+			fprintf(stderr, "no base station found (USB %04x:%04x or ST-Link)\n", BASE_STATION_USB_VID, BASE_STATION_USB_PID);
+			return 1;
+		}
+		path = device.c_str();
+		fprintf(stderr, "base station on %s (%s)\n", path, link == LINK_USB ? "native USB" : "ST-Link UART");
+	}
+	return runServer(path, baudrate, publisher);
+}
@@ -0,0 +1,330 @@
+/*
+ * glovestore.cpp
+ *
+ * Python module around GloveSessionStore: decodes a session file (.glr) into
+ * the columnar store and hands out its columns through the buffer protocol,
+ * so numpy uses them without a copy:
+ *
+ *   import glovestore, numpy as np
+ *   session = glovestore.Session('session.glr')
+ *   session.streams()                      # [(node, sensor), ...]
+ *   begin, end = session.range(0, 3, 10.0, 20.0)
+ *   qw = np.asarray(session.column(0, 3, 'qw', begin, end))   # float32, no copy
+ *   t = np.asarray(session.column(0, 3, 't', begin, end))     # int64, us
+ *
+ * A column keeps its session alive, the data does not move while it exists.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <string.h>
+
+#include "GloveRecording.h"
+#include "GloveStore.h"
+
+
+struct SessionObject
+{
+	PyObject_HEAD
+	GloveSessionStore* store;
+};
+
+struct ColumnObject
+{
+	PyObject_HEAD
+	PyObject* session;		// owner of the data
+	void* data;
+	Py_ssize_t count;
+	Py_ssize_t itemSize;
+	const char* format;		// "f" or "q"
+	Py_ssize_t shape;
+};
+
+static PyTypeObject SessionType;
+static PyTypeObject ColumnType;
+
+
+static void Column_dealloc(ColumnObject* self)
+{
+	Py_XDECREF(self->session);
+	Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int Column_getbuffer(ColumnObject* self, Py_buffer* view, int flags)
+{
+	if (flags & PyBUF_WRITABLE)
+	{
+		PyErr_SetString(PyExc_BufferError, "glovestore columns are read-only");
+		return -1;
+	}
+	view->obj = (PyObject*)self;
+	Py_INCREF(self);
+	view->buf = self->data;
+	view->len = self->count * self->itemSize;
+	view->readonly = 1;
+	view->itemsize = self->itemSize;
+	view->format = (flags & PyBUF_FORMAT) ? (char*)self->format : 0;
+	view->ndim = 1;
+	self->shape = self->count;
+	view->shape = (flags & PyBUF_ND) ? &self->shape : 0;
+	view->strides = (flags & PyBUF_STRIDES) ? &view->itemsize : 0;
+	view->suboffsets = 0;
+	view->internal = 0;
+	return 0;
+}
+
+static Py_ssize_t Column_length(ColumnObject* self)
+{
+	return self->count;
+}
+
+static PyBufferProcs Column_buffer = { (getbufferproc)Column_getbuffer, 0 };
+static PySequenceMethods Column_sequence = { (lenfunc)Column_length, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+
+static PyObject* Session_new(PyTypeObject* type, PyObject*, PyObject*)
+{
+	SessionObject* self = (SessionObject*)type->tp_alloc(type, 0);
+	if (self)
+	{
+		self->store = new GloveSessionStore();
+	}
+	return (PyObject*)self;
+}
+
+static int Session_init(SessionObject* self, PyObject* args, PyObject*)
+{
+	const char* path;
+	if (!PyArg_ParseTuple(args, "s", &path))
+	{
+		return -1;
+	}
+
+	GloveRecordingReader reader;
+	if (!reader.open(path))
+	{
+		PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+		return -1;
+	}
+
+	// columns handed out point into the store, it is only ever filled once
+	GloveSessionStore* store = self->store;
+	if (store->samples() > 0)
+	{
+		PyErr_SetString(PyExc_RuntimeError, "the session is loaded already");
+		return -1;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	// time 0 of the CSV export
+	store->setTimeOrigin(reader.timeOrigin());
+	GloveDecoder decoder(GloveSessionStore::sampleCallback, store);
+	static const uint8_t sync[GLOVE_SYNC_LEN] = { GLOVE_SYNC_BYTE_1, GLOVE_SYNC_BYTE_2 };
+	GloveRecordingReader::Cursor cursor = reader.begin();
+	GloveFrame frame;
+	while (reader.next(cursor, frame))
+	{
+		if (frame.flags & GLOVE_FRAME_SYNC)
+		{
+			decoder.feed(sync, sizeof(sync), frame.hostTime);
+		}
+		decoder.feed(frame.data, frame.length, frame.hostTime);
+	}
+	decoder.flush();
+	store->finish();
+	Py_END_ALLOW_THREADS
+	return 0;
+}
+
+static void Session_dealloc(SessionObject* self)
+{
+	delete self->store;
+	Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static bool checkStream(unsigned int node, unsigned int sensor)
+{
+	if (node >= GLOVE_STORE_NODES || sensor >= GLOVE_MAX_SENSORS)
+	{
+		PyErr_Format(PyExc_IndexError, "no stream node %u, sensor %u", node, sensor);
+		return false;
+	}
+	return true;
+}
+
+static PyObject* Session_streams(SessionObject* self, PyObject*)
+{
+	PyObject* list = PyList_New(0);
+	for (uint8_t node = 0; list && node < GLOVE_STORE_NODES; ++node)
+	{
+		for (uint8_t sensor = 0; sensor < GLOVE_MAX_SENSORS; ++sensor)
+		{
+			if (self->store->hasStream(node, sensor))
+			{
+				PyObject* item = Py_BuildValue("(II)", node, sensor);
+				if (!item || PyList_Append(list, item) != 0)
+				{
+					Py_XDECREF(item);
+					Py_DECREF(list);
+					return 0;
+				}
+				Py_DECREF(item);
+			}
+		}
+	}
+	return list;
+}
+
+static PyObject* Session_size(SessionObject* self, PyObject* args)
+{
+	unsigned int node, sensor;
+	if (!PyArg_ParseTuple(args, "II", &node, &sensor) || !checkStream(node, sensor))
+	{
+		return 0;
+	}
+	return PyLong_FromSize_t(self->store->size(node, sensor));
+}
+
+static PyObject* Session_range(SessionObject* self, PyObject* args)
+{
+	unsigned int node, sensor;
+	double start, end;
+	if (!PyArg_ParseTuple(args, "IIdd", &node, &sensor, &start, &end) || !checkStream(node, sensor))
+	{
+		return 0;
+	}
+	size_t begin = self->store->lowerBound(node, sensor, (int64_t)(start * 1e6));
+	size_t stop = self->store->lowerBound(node, sensor, (int64_t)(end * 1e6));
+	return Py_BuildValue("(nn)", (Py_ssize_t)begin, (Py_ssize_t)stop);
+}
+
+static PyObject* Session_column(SessionObject* self, PyObject* args)
+{
+	unsigned int node, sensor;
+	const char* name;
+	Py_ssize_t begin = 0;
+	Py_ssize_t end = PY_SSIZE_T_MAX;
+	if (!PyArg_ParseTuple(args, "IIs|nn", &node, &sensor, &name, &begin, &end) || !checkStream(node, sensor))
+	{
+		return 0;
+	}
+	if (begin < 0 || end < 0)
+	{
+		PyErr_SetString(PyExc_IndexError, "negative index");
+		return 0;
+	}
+
+	// -1: time column
+	int index = strcmp(name, "t") == 0 ? -1 : STORE_COLUMN_COUNT;
+	for (int c = 0; c < STORE_COLUMN_COUNT && index == STORE_COLUMN_COUNT; ++c)
+	{
+		if (strcmp(name, glove_storeColumnNames[c]) == 0)
+		{
+			index = c;
+		}
+	}
+	if (index == STORE_COLUMN_COUNT)
+	{
+		PyErr_Format(PyExc_KeyError, "no column '%s' (t, qx, qy, qz, qw, ax, ay, az)", name);
+		return 0;
+	}
+
+	// an empty slice has no pointers, its buffer still needs one
+	static int64_t empty;
+	GloveStoreSlice slice = self->store->slice(node, sensor, begin, end);
+	const void* data = index < 0 ? (const void*)slice.time : (const void*)slice.columns[index];
+	if (slice.count == 0)
+	{
+		data = &empty;
+	}
+	const char* format = index < 0 ? "q" : "f";
+	Py_ssize_t itemSize = index < 0 ? sizeof(int64_t) : sizeof(float);
+
+	ColumnObject* column = PyObject_New(ColumnObject, &ColumnType);
+	if (!column)
+	{
+		return 0;
+	}
+	Py_INCREF(self);
+	column->session = (PyObject*)self;
+	column->data = (void*)data;
+	column->count = slice.count;
+	column->itemSize = itemSize;
+	column->format = format;
+	column->shape = slice.count;
+	return (PyObject*)column;
+}
+
+static PyObject* Session_getNbytes(SessionObject* self, void*)
+{
+	return PyLong_FromSize_t(self->store->memoryUsed());
+}
+
+static PyObject* Session_getSamples(SessionObject* self, void*)
+{
+	return PyLong_FromUnsignedLongLong(self->store->samples());
+}
+
+static PyMethodDef Session_methods[] =
+{
+	{ "streams", (PyCFunction)Session_streams, METH_NOARGS, "streams() -> [(node, sensor), ...] with samples" },
+	{ "size", (PyCFunction)Session_size, METH_VARARGS, "size(node, sensor) -> samples of the stream" },
+	{ "range", (PyCFunction)Session_range, METH_VARARGS,
+	  "range(node, sensor, start, end) -> (begin, end) indices of the samples in [start, end) s" },
+	{ "column", (PyCFunction)Session_column, METH_VARARGS,
+	  "column(node, sensor, name[, begin, end]) -> buffer of t (int64 us) or qx, qy, qz, qw, ax, ay, az (float32)" },
+	{ 0, 0, 0, 0 }
+};
+
+static PyGetSetDef Session_getset[] =
+{
+	{ "nbytes", (getter)Session_getNbytes, 0, "committed bytes of all columns", 0 },
+	{ "samples", (getter)Session_getSamples, 0, "samples in the store", 0 },
+	{ 0, 0, 0, 0, 0 }
+};
+
+
+static PyModuleDef glovestoreModule =
+{
+	PyModuleDef_HEAD_INIT, "glovestore", "Columnar store of decoded glove sessions", -1, 0, 0, 0, 0, 0
+};
+
+PyMODINIT_FUNC PyInit_glovestore()
+{
+	ColumnType.tp_name = "glovestore.Column";
+	ColumnType.tp_basicsize = sizeof(ColumnObject);
+	ColumnType.tp_dealloc = (destructor)Column_dealloc;
+	ColumnType.tp_flags = Py_TPFLAGS_DEFAULT;
+	ColumnType.tp_doc = "read-only column of a stream, use np.asarray()";
+	ColumnType.tp_as_buffer = &Column_buffer;
+	ColumnType.tp_as_sequence = &Column_sequence;
+
+	SessionType.tp_name = "glovestore.Session";
+	SessionType.tp_basicsize = sizeof(SessionObject);
+	SessionType.tp_dealloc = (destructor)Session_dealloc;
+	SessionType.tp_flags = Py_TPFLAGS_DEFAULT;
+	SessionType.tp_doc = "Session(path): decoded session file, one column set per (node, sensor)";
+	SessionType.tp_methods = Session_methods;
+	SessionType.tp_getset = Session_getset;
+	SessionType.tp_init = (initproc)Session_init;
+	SessionType.tp_new = Session_new;
+
+	if (PyType_Ready(&ColumnType) < 0 || PyType_Ready(&SessionType) < 0)
+	{
+		return 0;
+	}
+	PyObject* module = PyModule_Create(&glovestoreModule);
+	if (!module)
+	{
+		return 0;
+	}
+	Py_INCREF(&SessionType);
+	if (PyModule_AddObject(module, "Session", (PyObject*)&SessionType) != 0)
+	{
+		Py_DECREF(&SessionType);
+		Py_DECREF(module);
+		return 0;
+	}
+	return module;
+}
@@ -0,0 +1,1051 @@
+/*
+ * glove_test.cpp
+ *
+ * Tests of the session files, the CSV import and the decoder, run by ctest (see CMakeLists.txt):
+ *
+ *   glove_test session_roundtrip       frames written and read back, chunk index
+ *   glove_test session_seek            seek() and seekSample() against a linear scan
+ *   glove_test session_truncated       index rebuilt after a crash at any point
+ *   glove_test csv_roundtrip log.csv   CSV -> session file -> CSV, no made-up rows
+ *   glove_test decoder_stream mode     encoder stream with lost, duplicated and reordered packets
+ *   glove_test decoder_sim mode        glove_sim stream with loss and reordering, packet counts, clock
+ *   glove_test clock_recorded          sample times of a recorded stream read at once
+ *
+ * Files are written to the current directory (the build directory under ctest).
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "GloveCsv.h"
+#include "GloveCsvImport.h"
+#include "GloveDecoder.h"
+#include "GloveRecording.h"
+#include "GloveSimulator.h"
+
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+#define REQUIRE(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); ++failures; return; } } while (0)
+
+
+struct TestFrame
+{
+	uint64_t hostTime;
+	uint8_t flags;
+	std::vector<uint8_t> data;
+};
+
+// 3 nodes with 2 packets per sample, some frames with the time of the one before and some raw bytes
+static std::vector<TestFrame> makeFrames(unsigned int samples)
+{
+	std::vector<TestFrame> frames;
+	uint32_t random = 12345;
+	uint64_t time = 1000000;
+	for (unsigned int s = 0; s < samples; ++s)
+	{
+		for (uint8_t node = 0; node < 3; ++node)
+		{
+			for (uint8_t packetId = 1; packetId <= 2; ++packetId)
+			{
+				random = random * 1103515245 + 12345;
+				TestFrame frame;
+				time += (random >> 16) % 5 == 0 ? 0 : 1000 + (random >> 16) % 700;
+				frame.hostTime = time;
+				frame.flags = packetId == 1 ? GLOVE_FRAME_SYNC : 0;
+				frame.data.resize(GLOVE_DESCRIPTOR_LEN + (random >> 8) % (GLOVE_PAYLOAD_MAX_LEN - 1));
+				frame.data[0] = (node << 4) | DEVICE_GLOVE_V2;
+				frame.data[1] = ((s & 0x03) << 2) | packetId;
+				for (size_t i = GLOVE_DESCRIPTOR_LEN; i < frame.data.size(); ++i)
+				{
+					frame.data[i] = (uint8_t)(random >> (i % 24));
+				}
+				frames.push_back(frame);
+			}
+		}
+		if (s % 50 == 49)
+		{
+			TestFrame raw;
+			raw.hostTime = time;
+			raw.flags = GLOVE_FRAME_RAW;
+			raw.data.assign(7, 0xAB);
+			frames.push_back(raw);
+		}
+	}
+	return frames;
+}
+
+static bool writeSession(const char* path, const std::vector<TestFrame> &frames, uint32_t chunkSize)
+{
+	GloveRecordingWriter writer;
+	if (!writer.open(path, frames.front().hostTime, chunkSize, 20000))
+	{
+		perror(path);
+		return false;
+	}
+	for (size_t i = 0; i < frames.size(); ++i)
+	{
+		GloveFrame frame;
+		frame.hostTime = frames[i].hostTime;
+		frame.flags = frames[i].flags;
+		frame.length = frames[i].data.size();
+		frame.data = frames[i].data.data();
+		writer.write(frame);
+	}
+	return writer.close();
+}
+
+static bool sameFrame(const GloveFrame &frame, const TestFrame &expected)
+{
+	return frame.hostTime == expected.hostTime && frame.flags == expected.flags && frame.length == expected.data.size() &&
+		   memcmp(frame.data, expected.data.data(), frame.length) == 0;
+}
+
+// frames from the cursor to the end match frames[first...], returns how many were read
+static size_t checkFrames(const GloveRecordingReader &reader, GloveRecordingReader::Cursor cursor,
+						  const std::vector<TestFrame> &frames, size_t first)
+{
+	size_t count = 0;
+	GloveFrame frame;
+	while (reader.next(cursor, frame))
+	{
+		if (first + count >= frames.size() || !sameFrame(frame, frames[first + count]))
+		{
+			fprintf(stderr, "frame %zu differs\n", first + count);
+			++failures;
+			return count;
+		}
+		++count;
+	}
+	return count;
+}
+
+static std::vector<uint8_t> readFile(const char* path)
+{
+	std::vector<uint8_t> bytes;
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		perror(path);
+		return bytes;
+	}
+	uint8_t buffer[65536];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		bytes.insert(bytes.end(), buffer, buffer + n);
+	}
+	fclose(file);
+	return bytes;
+}
+
+static bool writeFile(const char* path, const uint8_t* data, size_t len)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		perror(path);
+		return false;
+	}
+	bool ok = fwrite(data, 1, len, file) == len;
+	return fclose(file) == 0 && ok;
+}
+
+
+static void testSessionRoundtrip()
+{
+	const char* path = "session_roundtrip.glr";
+	std::vector<TestFrame> frames = makeFrames(2000);
+	REQUIRE(writeSession(path, frames, 4096));
+
+	GloveRecordingReader reader;
+	REQUIRE(reader.open(path));
+	CHECK(!reader.isRecovered());
+	CHECK(reader.timeOrigin() == frames.front().hostTime);
+	CHECK(reader.startTime() == frames.front().hostTime);
+	CHECK(reader.endTime() == frames.back().hostTime);
+	CHECK(reader.chunkCount() > 10);
+	CHECK(checkFrames(reader, reader.begin(), frames, 0) == frames.size());
+
+	// chunks cover the frames in order, sample numbers continue from chunk to chunk
+	size_t first = 0;
+	uint64_t sample = 0;
+	for (size_t i = 0; i < reader.chunkCount(); ++i)
+	{
+		const GloveChunkHeader &header = reader.chunk(i).header;
+		REQUIRE(header.magic == GLOVE_CHUNK_MAGIC && header.recordCount > 0);
+		REQUIRE(first + header.recordCount <= frames.size());
+		CHECK(header.firstTime == frames[first].hostTime);
+		CHECK(header.lastTime == frames[first + header.recordCount - 1].hostTime);
+		CHECK(header.lastTime - header.firstTime < 20000 || header.recordCount == 1);
+		CHECK(header.firstSample == sample);
+
+		uint16_t nodeMask = 0;
+		for (size_t k = first; k < first + header.recordCount; ++k)
+		{
+			if (!(frames[k].flags & GLOVE_FRAME_RAW))
+			{
+				nodeMask |= 1 << (frames[k].data[0] >> 4);
+				sample += (frames[k].data[1] & 0x03) == 1;
+			}
+		}
+		CHECK(header.nodeMask == nodeMask);
+		CHECK(header.endSample == sample);
+		first += header.recordCount;
+	}
+	CHECK(first == frames.size());
+	CHECK(sample == 2000 * 3);
+}
+
+static void testSessionSeek()
+{
+	const char* path = "session_seek.glr";
+	std::vector<TestFrame> frames = makeFrames(500);
+	REQUIRE(writeSession(path, frames, 1024));
+
+	GloveRecordingReader reader;
+	REQUIRE(reader.open(path));
+	REQUIRE(reader.chunkCount() > 10);
+
+	// every time stamp, the ones in between and the ones outside the recording
+	std::vector<uint64_t> times;
+	for (size_t i = 0; i < frames.size(); ++i)
+	{
+		times.push_back(frames[i].hostTime);
+		times.push_back(frames[i].hostTime + 1);
+		times.push_back(frames[i].hostTime - 1);
+	}
+	times.push_back(0);
+	times.push_back(UINT64_MAX);
+
+	for (size_t i = 0; i < times.size(); ++i)
+	{
+		size_t expected = 0;
+		while (expected < frames.size() && frames[expected].hostTime < times[i])
+		{
+			++expected;
+		}
+		size_t count = checkFrames(reader, reader.seek(times[i]), frames, expected);
+		if (count != frames.size() - expected)
+		{
+			fprintf(stderr, "seek(%llu): %zu frames, expected %zu\n", (unsigned long long)times[i], count,
+					frames.size() - expected);
+			++failures;
+			return;
+		}
+	}
+
+	std::vector<size_t> sampleStarts;
+	for (size_t i = 0; i < frames.size(); ++i)
+	{
+		if (!(frames[i].flags & GLOVE_FRAME_RAW) && (frames[i].data[1] & 0x03) == 1)
+		{
+			sampleStarts.push_back(i);
+		}
+	}
+	for (uint64_t sample = 0; sample <= sampleStarts.size() + 1; ++sample)
+	{
+		size_t expected = sample < sampleStarts.size() ? sampleStarts[sample] : frames.size();
+		size_t count = checkFrames(reader, reader.seekSample(sample), frames, expected);
+		if (count != frames.size() - expected)
+		{
+			fprintf(stderr, "seekSample(%llu): %zu frames, expected %zu\n", (unsigned long long)sample, count,
+					frames.size() - expected);
+			++failures;
+			return;
+		}
+	}
+}
+
+static void testSessionTruncated()
+{
+	const char* path = "session_truncated.glr";
+	const char* cutPath = "session_truncated_cut.glr";
+	std::vector<TestFrame> frames = makeFrames(300);
+	REQUIRE(writeSession(path, frames, 2048));
+
+	std::vector<uint8_t> bytes = readFile(path);
+	std::vector<GloveChunkIndex> chunks;
+	{
+		GloveRecordingReader reader;
+		REQUIRE(reader.open(path));
+		REQUIRE(!reader.isRecovered());
+		for (size_t i = 0; i < reader.chunkCount(); ++i)
+		{
+			chunks.push_back(reader.chunk(i));
+		}
+	}
+	REQUIRE(chunks.size() > 3);
+
+	// crash at any point: a prefix of the file, the chunks written completely are recovered
+	std::vector<size_t> cuts;
+	cuts.push_back(bytes.size() - 1);
+	cuts.push_back(bytes.size() - sizeof(GloveRecordingFooter));
+	for (size_t i = 0; i < chunks.size(); ++i)
+	{
+		uint64_t end = chunks[i].offset + sizeof(GloveChunkHeader) + chunks[i].header.dataLength;
+		cuts.push_back(chunks[i].offset);
+		cuts.push_back(chunks[i].offset + sizeof(GloveChunkHeader) / 2);
+		cuts.push_back(chunks[i].offset + sizeof(GloveChunkHeader) + 1);
+		cuts.push_back((chunks[i].offset + end) / 2);
+		cuts.push_back(end - 1);
+		cuts.push_back(end);
+	}
+	for (size_t k = 0; k < cuts.size(); ++k)
+	{
+		size_t cut = cuts[k];
+		REQUIRE(writeFile(cutPath, bytes.data(), cut));
+
+		size_t expected = 0;
+		for (size_t i = 0; i < chunks.size(); ++i)
+		{
+			if (chunks[i].offset + sizeof(GloveChunkHeader) + chunks[i].header.dataLength <= cut)
+			{
+				expected += chunks[i].header.recordCount;
+			}
+		}
+
+		GloveRecordingReader reader;
+		REQUIRE(reader.open(cutPath));
+		CHECK(reader.isRecovered());
+		size_t count = checkFrames(reader, reader.begin(), frames, 0);
+		if (count != expected)
+		{
+			fprintf(stderr, "cut at %zu: %zu frames, expected %zu\n", cut, count, expected);
+			++failures;
+		}
+	}
+
+	// no header: not a recording
+	{
+		REQUIRE(writeFile(cutPath, bytes.data(), sizeof(GloveRecordingHeader) - 1));
+		GloveRecordingReader reader;
+		CHECK(!reader.open(cutPath));
+	}
+
+	// damaged footer: all chunks are still there
+	{
+		std::vector<uint8_t> damaged = bytes;
+		damaged[damaged.size() - 1] ^= 0xFF;
+		REQUIRE(writeFile(cutPath, damaged.data(), damaged.size()));
+		GloveRecordingReader reader;
+		REQUIRE(reader.open(cutPath));
+		CHECK(reader.isRecovered());
+		CHECK(reader.chunkCount() == chunks.size());
+		CHECK(checkFrames(reader, reader.begin(), frames, 0) == frames.size());
+	}
+}
+
+
+static bool parseCsvFile(const char* path, std::string &text, GloveCsvChunk &chunk)
+{
+	std::vector<uint8_t> bytes = readFile(path);
+	text.assign(bytes.begin(), bytes.end());
+	if (text.empty())
+	{
+		return false;
+	}
+	glove_parseCsvChunk(text.data(), text.data() + text.size(), chunk);
+	return true;
+}
+
+static void onSample(const GloveSample &sample, void* context)
+{
+	((GloveCsvWriter*)context)->write(sample);
+}
+
+// rotation between the quaternions of two rows (q and -q are the same), degrees
+static double rotationAngle(const GloveCsvRow &a, const GloveCsvRow &b)
+{
+	double dot = 0, normA = 0, normB = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		dot += a.values[i] * b.values[i];
+		normA += a.values[i] * a.values[i];
+		normB += b.values[i] * b.values[i];
+	}
+	double cosHalf = fabs(dot) / sqrt(normA * normB);
+	return 2.0 * acos(cosHalf < 1.0 ? cosHalf : 1.0) * 180.0 / M_PI;
+}
+
+static void testCsvRoundtrip(const char* csvPath)
+{
+	const char* path = "csv_roundtrip.glr";
+	const char* outPath = "csv_roundtrip.csv";
+
+	std::string text;
+	GloveCsvChunk in;
+	REQUIRE(parseCsvFile(csvPath, text, in));
+	REQUIRE(in.columns == 4 || in.columns == 7);
+	REQUIRE(!in.rows.empty());
+
+	GloveCsvImportStats stats;
+	{
+		GloveRecordingWriter writer;
+		REQUIRE(writer.open(path, 0));
+		GloveCsvImporter importer(writer, in.columns, in.maxSensor);
+		for (size_t i = 0; i < in.rows.size(); ++i)
+		{
+			importer.add(in.rows[i]);
+		}
+		importer.finish();
+		stats = importer.stats();
+		REQUIRE(writer.close());
+	}
+
+	{
+		GloveRecordingReader reader;
+		REQUIRE(reader.open(path));
+		FILE* out = fopen(outPath, "w");
+		REQUIRE(out);
+		GloveCsvWriter writer(out);
+		writer.setTimeOrigin(reader.timeOrigin());
+		GloveDecoder decoder(onSample, &writer);
+
+		static const uint8_t sync[GLOVE_SYNC_LEN] = { GLOVE_SYNC_BYTE_1, GLOVE_SYNC_BYTE_2 };
+		GloveRecordingReader::Cursor cursor = reader.begin();
+		GloveFrame frame;
+		while (reader.next(cursor, frame))
+		{
+			if (frame.flags & GLOVE_FRAME_SYNC)
+			{
+				decoder.feed(sync, sizeof(sync), frame.hostTime);
+			}
+			decoder.feed(frame.data, frame.length, frame.hostTime);
+		}
+		decoder.flush();
+		writer.finish();
+		REQUIRE(fclose(out) == 0);
+		CHECK(decoder.stats().syncLosses == 0);
+	}
+
+	std::string outText;
+	GloveCsvChunk exported;
+	REQUIRE(parseCsvFile(outPath, outText, exported));
+	CHECK(exported.columns == in.columns);
+	CHECK(exported.malformedRows == 0);
+
+	// every row is written or counted as dropped or ignored
+	CHECK(exported.rows.size() + stats.droppedRows + stats.ignoredRows == in.rows.size());
+
+	// The exported rows of each ID are a subsequence of the file's rows: same rotation (W >= 0 now,
+	// rebuilt from X, Y, Z unless the node is a single node), same linear acceleration, time stamp
+	// of the first row of their sweep. A row that wasn't recorded has no match.
+	size_t negated = 0;
+	for (unsigned int id = 0; id < 256; ++id)
+	{
+		bool hasW = in.maxSensor[id >> 4] == 0;
+		double tolerance = hasW ? 0.02 : 2.0;
+		size_t next = 0;
+		for (size_t i = 0; i < exported.rows.size(); ++i)
+		{
+			const GloveCsvRow &row = exported.rows[i];
+			if (row.id != id)
+			{
+				continue;
+			}
+			CHECK(row.values[3] >= 0);
+
+			bool found = false;
+			for (; next < in.rows.size() && !found; ++next)
+			{
+				const GloveCsvRow &original = in.rows[next];
+				if (original.id != id || original.time < row.time || rotationAngle(original, row) > tolerance)
+				{
+					continue;
+				}
+				found = true;
+				for (int k = 4; k < row.columns; ++k)
+				{
+					found &= fabs(original.values[k] - row.values[k]) < 0.0051;
+				}
+				negated += found && original.values[3] < 0;
+			}
+			if (!found)
+			{
+				fprintf(stderr, "%s: exported row %zu (ID %u, %llu ms) is not in the file\n", csvPath, i, id,
+						(unsigned long long)row.time);
+				++failures;
+				return;
+			}
+		}
+	}
+	printf("%s: %zu rows, %zu exported (%zu with W < 0 negated), %llu dropped\n", csvPath, in.rows.size(),
+		   exported.rows.size(), negated, (unsigned long long)stats.droppedRows);
+}
+
+
+// sample n of a sensor: a rotation of about 3.6 degrees per sample (W >= 0 on the gloves, which
+// drop its sign) and a lin. acc., different for every node and sensor
+static void makeSensor(uint8_t nodeId, uint8_t deviceId, uint8_t sensorId, unsigned int n, GloveSample &sample)
+{
+	memset(&sample, 0, sizeof(sample));
+	double t = n * 0.01;
+	double angle = 2 * M_PI * (1.0 + 0.1 * sensorId) * t + nodeId;
+	double axisAngle = 0.5 * t + sensorId;
+	double ax = sin(axisAngle), ay = cos(axisAngle), az = 0.5;
+	double s = sin(angle / 2) / sqrt(ax * ax + ay * ay + az * az);
+	double q[4] = { cos(angle / 2), ax * s, ay * s, az * s };
+	double sign = deviceId != DEVICE_SINGLE_NODE && q[0] < 0 ? -1 : 1;
+	for (int i = 0; i < 4; ++i)
+	{
+		sample.quat[i] = (int16_t)lrint(sign * q[i] * GLOVE_QUAT_SCALE);
+	}
+	sample.linAcc[0] = (int16_t)lrint(300 * sin(2 * M_PI * 1.3 * t + sensorId));
+	sample.linAcc[1] = (int16_t)lrint(200 * cos(2 * M_PI * 1.3 * t + sensorId));
+	sample.linAcc[2] = (int16_t)(n * 7 + nodeId * 100 + sensorId);
+}
+
+struct StreamNode
+{
+	uint8_t nodeId;
+	uint8_t deviceId;
+	uint8_t sensorCount;
+	GloveDeltaEncoder delta;
+	GloveSequenceStats expected;			// sets, lostPackets, lostSamples, duplicates, reordered
+	std::vector<bool> complete;				// per sample: all its packets are in the stream, in delta mode in order
+};
+
+struct DecodedSample
+{
+	GloveSample sample;
+	size_t node;
+};
+
+struct DecodedStream
+{
+	std::vector<DecodedSample> samples;
+	std::vector<GloveSampleSet> sets;
+	StreamNode* nodes;
+	size_t nodeCount;
+};
+
+static void onDecodedSample(const GloveSample &sample, void* context)
+{
+	DecodedStream* stream = (DecodedStream*)context;
+	for (size_t i = 0; i < stream->nodeCount; ++i)
+	{
+		if (stream->nodes[i].nodeId == sample.nodeId)
+		{
+			DecodedSample decoded = { sample, i };
+			stream->samples.push_back(decoded);
+		}
+	}
+}
+
+static void onDecodedSet(const GloveSampleSet &set, void* context)
+{
+	((DecodedStream*)context)->sets.push_back(set);
+}
+
+// The packets of one sample of a node, packet 1 with sync bytes, gloves with their tick
+static std::vector<std::vector<uint8_t> > encodeSample(StreamNode &node, uint8_t mode, unsigned int n)
+{
+	GloveSample sensors[GLOVE_MAX_SENSORS];
+	memset(sensors, 0, sizeof(sensors));
+	for (uint8_t i = 0; i < node.sensorCount; ++i)
+	{
+		makeSensor(node.nodeId, node.deviceId, i, n, sensors[i]);
+	}
+
+	GloveDescriptor desc;
+	memset(&desc, 0, sizeof(desc));
+	desc.nodeId = node.nodeId;
+	desc.deviceId = node.deviceId;
+	desc.mode = mode;
+	desc.sampleId = n & 0x03;
+	if (node.deviceId != DEVICE_SINGLE_NODE && glove_modeHasTick(mode))
+	{
+		desc.time = GLOVE_TIME_TICK;
+		desc.tick = (uint16_t)(n * 10000 / GLOVE_TICK_US);
+	}
+
+	std::vector<std::vector<uint8_t> > packets;
+	uint8_t data[GLOVE_DELTA_MAX_PACKETS][GLOVE_DESCRIPTOR_LEN + GLOVE_PAYLOAD_MAX_LEN];
+	uint8_t lengths[GLOVE_DELTA_MAX_PACKETS];
+	int count;
+	if (glove_isDeltaMode(mode))
+	{
+		count = node.delta.encode(desc, sensors, data[0], lengths);
+	}
+	else
+	{
+		count = glove_getPacketCount(mode, node.deviceId);
+		for (desc.packetId = 1; desc.packetId <= count; ++desc.packetId)
+		{
+			lengths[desc.packetId - 1] = (uint8_t)glove_encodePacket(desc, sensors, data[desc.packetId - 1]);
+		}
+	}
+	for (int i = 0; i < count; ++i)
+	{
+		std::vector<uint8_t> packet;
+		if (i == 0)
+		{
+			packet.push_back(GLOVE_SYNC_BYTE_1);
+			packet.push_back(GLOVE_SYNC_BYTE_2);
+		}
+		packet.insert(packet.end(), data[i], data[i] + lengths[i]);
+		packets.push_back(packet);
+	}
+	return packets;
+}
+
+// Stream of a single node, a glove v1 and a glove v2 (those that have the mode), the nodes
+// taking turns per sample. The last packet of a node's sample is lost every 11th sample,
+// sent twice every 13th and sent after packet 1 of the next sample every 17th.
+static std::vector<uint8_t> makeStream(uint8_t mode, unsigned int samples, std::vector<StreamNode> &nodes)
+{
+	static const uint8_t devices[] = { DEVICE_SINGLE_NODE, DEVICE_GLOVE_V1, DEVICE_GLOVE_V2 };
+	nodes.clear();
+	nodes.reserve(3);
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		if (glove_getPacketCount(mode, devices[i]) > 0)
+		{
+			nodes.push_back(StreamNode());
+			StreamNode &node = nodes.back();
+			node.nodeId = (uint8_t)(i * 2 + 1);
+			node.deviceId = devices[i];
+			node.sensorCount = glove_getSensorCount(mode, devices[i]);
+			node.expected = GloveSequenceStats();
+			node.complete.assign(samples, true);
+		}
+	}
+
+	std::vector<uint8_t> stream;
+	std::vector<std::vector<uint8_t> > held(nodes.size());
+	for (unsigned int n = 0; n < samples; ++n)
+	{
+		for (size_t k = 0; k < nodes.size(); ++k)
+		{
+			StreamNode &node = nodes[k];
+			std::vector<std::vector<uint8_t> > packets = encodeSample(node, mode, n);
+			if (n % 11 == 5)
+			{
+				packets.pop_back();
+				node.complete[n] = false;
+				if (packets.empty())
+				{
+					// noticed from the sample ID of the next sample
+					node.expected.lostSamples += n + 1 < samples ? 1 : 0;
+				}
+				else
+				{
+					++node.expected.sets;
+					node.expected.lostPackets += glove_isDeltaMode(mode) ? 0 : 1;
+				}
+			}
+			else
+			{
+				++node.expected.sets;
+				if (n % 13 == 7)
+				{
+					packets.push_back(packets.back());
+					++node.expected.duplicates;
+				}
+				else if (n % 17 == 3 && packets.size() > 1 && n + 1 < samples && (n + 1) % 11 != 5)
+				{
+					held[k] = packets.back();
+					packets.pop_back();
+					++node.expected.reordered;
+					// the next sample's deltas may arrive before their reference
+					node.complete[n] = !glove_isDeltaMode(mode);
+				}
+			}
+
+			for (size_t i = 0; i < packets.size(); ++i)
+			{
+				stream.insert(stream.end(), packets[i].begin(), packets[i].end());
+				if (i == 0 && !held[k].empty() && n % 17 == 4)
+				{
+					stream.insert(stream.end(), held[k].begin(), held[k].end());
+					held[k].clear();
+				}
+			}
+		}
+	}
+	return stream;
+}
+
+// angle between two quaternions (q and -q are the same), degrees
+static double quatAngle(const int16_t* a, const int16_t* b)
+{
+	double dot = 0, normA = 0, normB = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		dot += (double)a[i] * b[i];
+		normA += (double)a[i] * a[i];
+		normB += (double)b[i] * b[i];
+	}
+	double cosHalf = fabs(dot) / sqrt(normA * normB);
+	return 2.0 * acos(cosHalf < 1.0 ? cosHalf : 1.0) * 180.0 / M_PI;
+}
+
+// sample n of the node that the decoded sample matches, -1 if none near the last one
+static long matchSample(const StreamNode &node, const GloveSample &sample, long last, double tolerance)
+{
+	for (long n = last - 3; n <= last + 5; ++n)
+	{
+		if (n < 0)
+		{
+			continue;
+		}
+		GloveSample expected;
+		makeSensor(node.nodeId, node.deviceId, sample.sensorId, (unsigned int)n, expected);
+		bool match = sample.flags & GLOVE_SAMPLE_HAS_W ? quatAngle(sample.quat, expected.quat) <= tolerance
+													   : memcmp(&sample.quat[1], &expected.quat[1], 3 * sizeof(int16_t)) == 0;
+		if (match && sample.flags & GLOVE_SAMPLE_HAS_LINACC)
+		{
+			match = memcmp(sample.linAcc, expected.linAcc, sizeof(expected.linAcc)) == 0;
+		}
+		if (match)
+		{
+			return n;
+		}
+	}
+	return -1;
+}
+
+static bool sameSamples(const std::vector<DecodedSample> &a, const std::vector<DecodedSample> &b)
+{
+	if (a.size() != b.size())
+	{
+		return false;
+	}
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		const GloveSample &x = a[i].sample;
+		const GloveSample &y = b[i].sample;
+		if (x.nodeId != y.nodeId || x.sensorId != y.sensorId || x.sampleId != y.sampleId || x.flags != y.flags ||
+			x.sampleTime != y.sampleTime || memcmp(x.quat, y.quat, sizeof(x.quat)) != 0 ||
+			memcmp(x.linAcc, y.linAcc, sizeof(x.linAcc)) != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Encoder stream of one mode with lost, duplicated and reordered packets, decoded at once and
+// in chunks of 1 to 256 bytes: same samples, every sample one that was sent, every sample whose
+// packets all arrived complete, the sequence statistics as made.
+static void testDecoderStream(uint8_t mode)
+{
+	const unsigned int samples = 600;
+	std::vector<StreamNode> nodes;
+	std::vector<uint8_t> stream = makeStream(mode, samples, nodes);
+	REQUIRE(!nodes.empty());
+
+	DecodedStream whole = { std::vector<DecodedSample>(), std::vector<GloveSampleSet>(), nodes.data(), nodes.size() };
+	{
+		GloveDecoder decoder(onDecodedSample, &whole);
+		decoder.setSampleSetCallback(onDecodedSet, &whole);
+		decoder.feed(stream.data(), stream.size(), 1000000);
+		decoder.flush();
+		CHECK(decoder.stats().syncLosses == 0);
+		CHECK(decoder.stats().bytesSkipped == 0);
+	}
+
+	DecodedStream chunked = { std::vector<DecodedSample>(), std::vector<GloveSampleSet>(), nodes.data(), nodes.size() };
+	GloveDecoder decoder(onDecodedSample, &chunked);
+	decoder.setSampleSetCallback(onDecodedSet, &chunked);
+	// read as the bytes arrive at 500000 baud
+	uint32_t random = 4711;
+	for (size_t pos = 0; pos < stream.size();)
+	{
+		random = random * 1103515245 + 12345;
+		size_t len = std::min<size_t>(1 + (random >> 16) % 256, stream.size() - pos);
+		decoder.feed(&stream[pos], len, 1000000 + (pos + len) * 20);
+		pos += len;
+	}
+	decoder.flush();
+
+	const GloveDecoderStats &stats = decoder.stats();
+	CHECK(stats.syncLosses == 0);
+	CHECK(stats.bytesSkipped == 0);
+	CHECK(stats.bytesReceived == stream.size());
+	CHECK(stats.samples == chunked.samples.size());
+
+	// sample times aside (other host times), the same samples as decoded at once
+	for (size_t i = 0; i < whole.samples.size(); ++i)
+	{
+		whole.samples[i].sample.sampleTime = 0;
+	}
+	std::vector<DecodedSample> untimed = chunked.samples;
+	for (size_t i = 0; i < untimed.size(); ++i)
+	{
+		untimed[i].sample.sampleTime = 0;
+	}
+	CHECK(sameSamples(whole.samples, untimed));
+	CHECK(whole.sets.size() == chunked.sets.size());
+
+	double tolerance = glove_modeS3Bits(mode) ? 0.5 : 0.05;
+	for (size_t k = 0; k < nodes.size(); ++k)
+	{
+		const StreamNode &node = nodes[k];
+		std::vector<uint8_t> sensors(samples * GLOVE_MAX_SENSORS, 0);
+		long last = 0;
+		size_t wrong = 0;
+		for (size_t i = 0; i < chunked.samples.size(); ++i)
+		{
+			if (chunked.samples[i].node != k)
+			{
+				continue;
+			}
+			const GloveSample &sample = chunked.samples[i].sample;
+			long n = matchSample(node, sample, last, tolerance);
+			if (n < 0 || n >= (long)samples || sample.sensorId >= node.sensorCount)
+			{
+				++wrong;
+				continue;
+			}
+			last = n;
+			++sensors[n * GLOVE_MAX_SENSORS + sample.sensorId];
+		}
+		CHECK(wrong == 0);
+
+		// delta mode loses the samples after a lost packet up to the sensor's next key frame
+		size_t incomplete = 0;
+		bool resolved[GLOVE_MAX_SENSORS];
+		std::fill(resolved, resolved + GLOVE_MAX_SENSORS, true);
+		for (unsigned int n = 0; n < samples; ++n)
+		{
+			for (uint8_t s = 0; s < node.sensorCount; ++s)
+			{
+				resolved[s] = resolved[s] || !glove_isDeltaMode(mode) || ((n + s) & (GLOVE_DELTA_KEYFRAME_INTERVAL - 1)) == 0;
+				uint8_t count = sensors[n * GLOVE_MAX_SENSORS + s];
+				CHECK(count <= 1);
+				incomplete += node.complete[n] && resolved[s] && count != 1;
+				resolved[s] = resolved[s] && node.complete[n];
+			}
+		}
+		CHECK(incomplete == 0);
+
+		const GloveSequenceStats &sequence = decoder.sequenceStats(node.nodeId);
+		printf("mode %u, node %u (device %u): %llu sets (%llu partial), %llu lost packets, %llu lost samples, "
+			   "%llu duplicates, %llu reordered\n", mode, node.nodeId, node.deviceId,
+			   (unsigned long long)sequence.sets, (unsigned long long)sequence.partialSets,
+			   (unsigned long long)sequence.lostPackets, (unsigned long long)sequence.lostSamples,
+			   (unsigned long long)sequence.duplicates, (unsigned long long)sequence.reordered);
+		CHECK(sequence.sets == node.expected.sets);
+		CHECK(sequence.lostPackets == node.expected.lostPackets);
+		CHECK(sequence.lostSamples == node.expected.lostSamples);
+		CHECK(sequence.duplicates == node.expected.duplicates);
+		CHECK(sequence.reordered == node.expected.reordered);
+	}
+}
+
+// glove_sim's stream of one mode with lost and reordered payloads, read every 1 ms with 0 to 3 ms
+// of host latency: the packet counts of the simulator and the decoder agree, and the sample
+// times from the gloves' ticks are multiples of 10 ms apart within the jitter of their clocks.
+static void onFirstSensor(const GloveSample &sample, void* context)
+{
+	if (sample.sensorId == 0)
+	{
+		((std::vector<GloveSample>*)context)->push_back(sample);
+	}
+}
+
+static void testDecoderSim(uint8_t mode)
+{
+	GloveSimConfig config = GloveSimulator::defaultConfig();
+	config.nodeCount[DEVICE_SINGLE_NODE] = 1;
+	config.nodeCount[DEVICE_GLOVE_V1] = 1;
+	config.mode = mode;
+	config.lossRate = 0.02;
+	config.reorderRate = 0.02;
+	config.seed = 7 + mode;
+	GloveSimulator sim(config);
+
+	std::vector<GloveSample> samples;
+	GloveDecoder decoder(onFirstSensor, &samples);
+	std::vector<uint8_t> chunk;
+	uint64_t bytes = 0;
+	for (uint64_t time = 1000; time <= 20000000; time += 1000)
+	{
+		chunk.clear();
+		sim.run(time, chunk);
+		decoder.feed(chunk.data(), chunk.size(), 5000000 + time + time * 7 % 3000);
+		bytes += chunk.size();
+	}
+	decoder.flush();
+
+	const GloveSimStats &simStats = sim.stats();
+	const GloveDecoderStats &stats = decoder.stats();
+	uint64_t duplicates = 0, reordered = 0;
+	for (size_t node = 0; node < sim.nodeCount(); ++node)
+	{
+		duplicates += decoder.sequenceStats((uint8_t)node).duplicates;
+		reordered += decoder.sequenceStats((uint8_t)node).reordered;
+	}
+	printf("mode %u: %llu packets (%llu lost, %llu reordered), decoded %llu packets, %llu reordered\n", mode,
+		   (unsigned long long)simStats.packets, (unsigned long long)simStats.lostPackets,
+		   (unsigned long long)simStats.reorderedPackets, (unsigned long long)stats.packets,
+		   (unsigned long long)reordered);
+	CHECK(stats.syncLosses == 0);
+	CHECK(stats.bytesReceived == bytes);
+	CHECK(stats.telemetryFrames == simStats.telemetryFrames);
+	CHECK(simStats.lostPackets > 0 && simStats.reorderedPackets > 0);
+	// but the packets still on the serial line at the end
+	CHECK(stats.packets <= simStats.packets && stats.packets + GLOVE_SIM_FIFO_LEN >= simStats.packets);
+	CHECK(duplicates == 0);
+	CHECK(reordered <= simStats.reorderedPackets);
+	CHECK(decoder.clock().stats().tickJumps == 0);
+
+	// deviation of the sample times from the sample period grid (samples get lost or overtaken)
+	for (size_t node = 0; node < sim.nodeCount() && glove_modeHasTick(mode); ++node)
+	{
+		double sum = 0, sumSquares = 0;
+		size_t count = 0;
+		const GloveSample* previous = NULL;
+		for (size_t i = 0; i < samples.size(); ++i)
+		{
+			const GloveSample &sample = samples[i];
+			if (sample.nodeId != node)
+			{
+				continue;
+			}
+			if (previous && sample.deviceId != DEVICE_SINGLE_NODE)
+			{
+				double interval = (double)(int64_t)(sample.sampleTime - previous->sampleTime);
+				double error = interval - config.samplePeriod * floor(interval / config.samplePeriod + 0.5);
+				sum += error;
+				sumSquares += error * error;
+				++count;
+			}
+			previous = &sample;
+		}
+		if (!previous || previous->deviceId == DEVICE_SINGLE_NODE)
+		{
+			continue;
+		}
+		CHECK(count > 1000);
+		double mean = sum / count;
+		double deviation = sqrt(sumSquares / count - mean * mean);
+		printf("node %zu: %zu intervals, %.1f us mean error, %.1f us standard deviation\n", node, count, mean, deviation);
+		CHECK(fabs(mean) < 20);
+		CHECK(deviation < 200);
+	}
+}
+
+struct NodeTimes
+{
+	std::vector<uint64_t> times[GLOVE_SIM_MAX_NODES];
+};
+
+static void onSampleTime(const GloveSample &sample, void* context)
+{
+	if (sample.sensorId == 0)
+	{
+		((NodeTimes*)context)->times[sample.nodeId & 0x0F].push_back(sample.sampleTime);
+	}
+}
+
+// A stream with time stamps written to a file and decoded like glove_decode does: all bytes at
+// the same host time. The sample times come from the stream's clocks, 10 ms apart.
+static void testClockRecorded()
+{
+	const char* path = "clock_recorded.bin";
+	const unsigned int seconds = 20;
+
+	GloveSimConfig config = GloveSimulator::defaultConfig();
+	config.nodeCount[DEVICE_GLOVE_V1] = 1;
+	config.clockDrift = 100;
+	GloveSimulator sim(config);
+	std::vector<uint8_t> stream;
+	sim.run((uint64_t)seconds * 1000000, stream);
+	REQUIRE(writeFile(path, stream.data(), stream.size()));
+
+	std::vector<uint8_t> data = readFile(path);
+	REQUIRE(data.size() == stream.size());
+	NodeTimes nodeTimes;
+	GloveDecoder decoder(onSampleTime, &nodeTimes);
+	const uint64_t startTime = 1000000000;
+	for (size_t pos = 0; pos < data.size(); pos += 4096)
+	{
+		decoder.feed(&data[pos], std::min<size_t>(4096, data.size() - pos), startTime);
+	}
+	decoder.flush();
+	CHECK(decoder.stats().syncLosses == 0);
+	CHECK(decoder.clock().stats().tickJumps == 0);
+
+	for (size_t node = 0; node < sim.nodeCount(); ++node)
+	{
+		const std::vector<uint64_t> &times = nodeTimes.times[node];
+		REQUIRE(times.size() > seconds * 95);
+		CHECK(times.front() >= startTime - config.samplePeriod && times.front() <= startTime + config.samplePeriod);
+		int64_t minInterval = INT64_MAX, maxInterval = 0;
+		for (size_t i = 1; i < times.size(); ++i)
+		{
+			int64_t interval = (int64_t)(times[i] - times[i - 1]);
+			minInterval = std::min(minInterval, interval);
+			maxInterval = std::max(maxInterval, interval);
+		}
+		printf("node %zu: %zu samples, %lld to %lld us apart\n", node, times.size(), (long long)minInterval,
+			   (long long)maxInterval);
+		CHECK(minInterval >= 9900 && maxInterval <= 10100);
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s session_roundtrip|session_seek|session_truncated|csv_roundtrip log.csv|decoder_stream mode|decoder_sim mode|clock_recorded\n", argv[0]);
+		return 2;
+	}
+
+	std::string test = argv[1];
+	if (test == "session_roundtrip")
+	{
+		testSessionRoundtrip();
+	}
+	else if (test == "session_seek")
+	{
+		testSessionSeek();
+	}
+	else if (test == "session_truncated")
+	{
+		testSessionTruncated();
+	}
+	else if (test == "csv_roundtrip" && argc > 2)
+	{
+		testCsvRoundtrip(argv[2]);
+	}
+	else if (test == "decoder_stream" && argc > 2)
+	{
+		testDecoderStream((uint8_t)atoi(argv[2]));
+	}
+	else if (test == "decoder_sim" && argc > 2)
+	{
+		testDecoderSim((uint8_t)atoi(argv[2]));
+	}
+	else if (test == "clock_recorded")
+	{
+		testClockRecorded();
+	}
+	else
+	{
+		fprintf(stderr, "unknown test %s\n", argv[1]);
+		return 2;
+	}
+
+	if (failures > 0)
+	{
+		fprintf(stderr, "%s: %d checks failed\n", argv[1], failures);
+		return 1;
+	}
+	printf("%s: passed\n", argv[1]);
+	return 0;
+}
@@ -10,6 +10,7 @@
 
 #include "BNO055.h"
 #include "i2cmaster.h"
+#include "twi_queue.h"
 
 
 
@@ -146,6 +147,8 @@ void BNO_Init(void)
 	// Pause after setting operating mode
 	_delay_ms(100);
 	
+	twi_initQueue(BNO_MUX_Select);
+	
 	PORTC &= ~(_BV(7));	//Turns OFF LED in Port C pin 7
 }
 
@@ -370,6 +373,157 @@ void BNO_Read_Acc_Mag_Gyr(uint8_t id, uint8_t* buffer)
 
 
 
+// quaternion (8 bytes) and linear acceleration (6 bytes) of each sensor, read by the TWI interrupt
+TWI_Job BNO_jobs[MAX_IMU_COUNT];
+uint8_t BNO_raw[MAX_IMU_COUNT][14];
+uint8_t BNO_jobs_until[MAX_IMU_COUNT];	// sensor is read when this many jobs are done
+
+void BNO_Start_Read_All(uint8_t withLinAcc)
+{
+	uint8_t count = 0;
+	
+	for (uint8_t i = 0; i < MAX_IMU_COUNT; ++i)
+	{
+		if (!BNO_is_available(i))
+		{
+			continue;
+		}
+		BNO_jobs[count].channel = i;
+		BNO_jobs[count].address = BNO055_ADDRESS;
+		BNO_jobs[count].reg = BNO055_QUATERNION_DATA_W_LSB_ADDR;
+		BNO_jobs[count].length = withLinAcc ? 14 : 8;
+		BNO_jobs[count].dest = BNO_raw[i];
+		BNO_jobs_until[i] = ++count;
+	}
+	
+	// previous reads are finished, all sensors were waited for
+	twi_startJobs(BNO_jobs, count);
+}
+
+// wait until sensor id is read, return its quaternion with w >= 0
+union QuatBuffer* BNO_Wait_Quaternion(uint8_t id)
+{
+	while (twi_jobsDone() < BNO_jobs_until[id])
+	{
+		_delay_us(1);
+	}
+	
+	union QuatBuffer* buf = (union QuatBuffer*)BNO_raw[id];
+	
+	// q and -q are the same rotation, w is not sent
+	if (buf->vec[0] < 0)
+	{
+		buf->vec[0] *= -1;
+		buf->vec[1] *= -1;
+		buf->vec[2] *= -1;
+		buf->vec[3] *= -1;
+	}
+	return buf;
+}
+
+void BNO_Get_Quaternion_Compressed(uint8_t id, uint8_t* buffer)
+{
+	if (!BNO_is_available(id))
+	{
+		return;
+	}
+	union QuatBuffer* buf = BNO_Wait_Quaternion(id);
+	
+	for (uint8_t i = 0; i < 6; ++i)
+	{
+		buffer[i] = buf->buffer[i + 2];
+	}
+}
+
+void BNO_Get_Quaternion_LinAcc_Compressed(uint8_t id, uint8_t* buffer_quat, uint8_t* buffer_linAcc)
+{
+	if (!BNO_is_available(id))
+	{
+		return;
+	}
+	union QuatBuffer* buf = BNO_Wait_Quaternion(id);
+	
+	for (uint8_t i = 0; i < 6; ++i)
+	{
+		buffer_quat[i] = buf->buffer[i + 2];
+		buffer_linAcc[i] = BNO_raw[id][i + 8];
+	}
+}
+
+void BNO_Get_Quaternion_S3(uint8_t id, uint8_t* buffer, uint8_t bits)
+{
+	if (!BNO_is_available(id))
+	{
+		return;
+	}
+	union QuatBuffer* buf = BNO_Wait_Quaternion(id);
+	
+	// largest component, q and -q are the same rotation, so it is always positive
+	uint8_t largest = 0;
+	int16_t largestAbs = buf->vec[0] < 0 ? -buf->vec[0] : buf->vec[0];
+	for (uint8_t i = 1; i < 4; ++i)
+	{
+		int16_t value = buf->vec[i] < 0 ? -buf->vec[i] : buf->vec[i];
+		if (value > largestAbs)
+		{
+			largest = i;
+			largestAbs = value;
+		}
+	}
+	int8_t negate = buf->vec[largest] < 0;
+	
+	int16_t maxValue = (1 << (bits - 1)) - 1;
+	int32_t scale = bits == BNO_S3_FINE_BITS ? BNO_S3_FINE_SCALE : BNO_S3_SCALE;
+	
+	// bit stream, LSB first
+	uint32_t bitBuffer = largest;
+	uint8_t bitCount = 2;
+	for (uint8_t i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+		{
+			continue;
+		}
+		int16_t value = negate ? -buf->vec[i] : buf->vec[i];
+		int16_t q = (int16_t)((value * scale + 0x8000) >> 16);
+		if (q > maxValue)
+		{
+			q = maxValue;
+		}
+		else if (q < -maxValue)
+		{
+			q = -maxValue;
+		}
+		bitBuffer |= (uint32_t)(uint16_t)(q + maxValue) << bitCount;
+		bitCount += bits;
+		while (bitCount >= 8)
+		{
+			*buffer++ = (uint8_t)bitBuffer;
+			bitBuffer >>= 8;
+			bitCount -= 8;
+		}
+	}
+	if (bitCount > 0)
+	{
+		*buffer = (uint8_t)bitBuffer;
+	}
+}
+
+void BNO_Get_Quaternion_LinAcc_S3(uint8_t id, uint8_t* buffer_quat, uint8_t bits, uint8_t* buffer_linAcc)
+{
+	if (!BNO_is_available(id))
+	{
+		return;
+	}
+	BNO_Get_Quaternion_S3(id, buffer_quat, bits);
+	
+	for (uint8_t i = 0; i < 6; ++i)
+	{
+		buffer_linAcc[i] = BNO_raw[id][i + 8];
+	}
+}
+
+
 void BNO_MUX_Select(uint8_t sen_channel)
 {
 	switch (sen_channel)
@@ -177,6 +177,25 @@ void BNO_Read_Quaternion_LinAcc(uint8_t id, uint8_t* buffer);
 void BNO_Read_Quaternion_LinAcc_Compressed(uint8_t id, uint8_t* buffer_quat, uint8_t* buffer_linAcc);
 void BNO_Read_Acc_Mag_Gyr(uint8_t id, uint8_t* buffer);
 
+// asynchronous reads (TWI interrupt): start reading all available sensors, then get each one when it is done
+void BNO_Start_Read_All(uint8_t withLinAcc);
+void BNO_Get_Quaternion_Compressed(uint8_t id, uint8_t* buffer);
+void BNO_Get_Quaternion_LinAcc_Compressed(uint8_t id, uint8_t* buffer_quat, uint8_t* buffer_linAcc);
+
+// Smallest three quaternion: the largest component is dropped (and made positive), the other three
+// lie within +-1/sqrt(2) and are quantized to 10 bit (4 bytes) or 12 bit (5 bytes). Bits, LSB first:
+// index of the dropped component (2 bit, 0 = W ... 3 = Z), then the other three in W, X, Y, Z order,
+// each q + 2^(bits-1) - 1 with q = round(Q14 value * BNO_S3_SCALE / 65536)
+#define BNO_S3_BITS			10
+#define BNO_S3_LEN			4
+#define BNO_S3_SCALE		2891		// (2^9 - 1) * 65536 / (16384 / sqrt(2))
+#define BNO_S3_FINE_BITS	12
+#define BNO_S3_FINE_LEN		5
+#define BNO_S3_FINE_SCALE	11580		// (2^11 - 1) * 65536 / (16384 / sqrt(2))
+
+void BNO_Get_Quaternion_S3(uint8_t id, uint8_t* buffer, uint8_t bits);
+void BNO_Get_Quaternion_LinAcc_S3(uint8_t id, uint8_t* buffer_quat, uint8_t bits, uint8_t* buffer_linAcc);
+
 void BNO_MUX_Select(uint8_t sen_channel);
 
 union QuatBuffer
@@ -19,15 +19,52 @@
 #define PAYLOAD_LEN			20
 #define PAYLOAD_QUAT_LEN	10
 
+#ifndef SAMPLE_PERIOD_US
+  #define SAMPLE_PERIOD_US	10000			// sample timer period, Timer1 counts us. 5000 -> 200 Hz
+#endif
+#define SAMPLE_TICK_US		10				// unit of the sample clock sent in packet 1 (wraps after 655 ms)
+
 
 #define GLOVE_V1			0x01
 #define GLOVE_V2			0x02
 
 
+// operation modes (mode field of the data descriptor, requested by the base station)
+#define MODE_QUAT			0x00			// quaternions, W dropped
+#define MODE_QUAT_LINACC	0x01			// quaternions, W dropped + lin. acceleration
+#define MODE_QUAT_S3		0x02			// smallest three quaternions, 10 bit
+#define MODE_QUAT_S3_FINE	0x03			// smallest three quaternions, 12 bit
+#define MODE_QUAT_LINACC_S3	0x04			// smallest three quaternions, 10 bit + lin. acceleration
+#define MODE_QUAT_DELTA		0x05			// quaternions, W dropped, as prediction residuals of variable length
+#define MODE_COUNT			6
+
+// delta mode: each sensor is sent absolute at least every DELTA_KEYFRAME_INTERVAL samples (power of two), a lost
+// packet costs the receiver the residuals up to there. Keep GLOVE_DELTA_KEYFRAME_INTERVAL in
+// Code/Cpp_Reader/GloveProtocol.h (glove_sim, glove_convert) the same
+#ifndef DELTA_KEYFRAME_INTERVAL
+  #define DELTA_KEYFRAME_INTERVAL	8
+#endif
+#if DELTA_KEYFRAME_INTERVAL & (DELTA_KEYFRAME_INTERVAL - 1)
+  #error DELTA_KEYFRAME_INTERVAL must be a power of two
+#endif
+
+
 #define NODE_ID				0x01			// must be unique for each node/device
 #define DEVICE_ID			GLOVE_V1		// this device's type/version: 0x00 -> standard node; 0x01 -> glove v1; 0x02 -> glove v2
 
 
+// radio topology, see RADIO_STAR in Code/BaseStation/main.cpp: 0 -> the base station polls this node (PRX, the packets
+// go out as ack payloads), 1 -> star: this node sends on its own (PTX) to RX pipe STAR_PIPE of the base station
+#ifndef RADIO_STAR
+  #define RADIO_STAR		0
+#endif
+#define STAR_PIPE			(NODE_ID - 1)	// 0 - 5, unique per node
+#define STAR_RETRIES		5				// retransmissions, then the packets in the TX FIFO are dropped
+// auto retransmit delay in us: the steps are longer than a 32 byte packet + ack (660 us), so the retries of
+// two nodes whose packets collided do not overlap again
+#define STAR_RETRY_DELAY	(250 + 750 * STAR_PIPE)
+
+
 #if DEVICE_ID == GLOVE_V1
   #define MAX_IMU_COUNT		6
 #elif DEVICE_ID == GLOVE_V2
@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "config.h"
 
@@ -38,9 +39,21 @@ uint8_t BS_broadcast_address[5] = {0xBA, 0x5E, 0xCA, 0x57, 0x3D};
 
 uint8_t payload_RX[PAYLOAD_MAX_LEN];
 
-uint8_t payload_TX1[PAYLOAD_MAX_LEN];
-uint8_t payload_TX2[PAYLOAD_MAX_LEN];
-uint8_t payload_TX3[PAYLOAD_MAX_LEN];
+// double buffered packets: a sample is assembled in one set while the packets of the previous one still wait for the base station
+uint8_t payload_TX[2][3][PAYLOAD_MAX_LEN];
+
+// packets not written to the nRF yet because its TX FIFO was full, oldest first
+uint8_t* payload_TX_pending[6];
+uint8_t payload_TX_pending_len[6];
+uint8_t payload_TX_pending_count = 0;
+uint8_t payload_TX_dropped = 0;		// pending packets overwritten by a newer sample
+
+#if RADIO_STAR
+// star topology: RX pipe 0 of the base station, the last byte + STAR_PIPE is this node's pipe
+uint8_t BS_star_address[5] = {0xBA, 0x5E, 0x57, 0xA2, 0xC1};
+uint8_t payload_TX_lost = 0;			// MAX_RT: the base station did not acknowledge, the TX FIFO was dropped
+uint8_t starModeReceived = 0;			// an ack payload (mode) was read into payload_RX
+#endif
 
 
 uint8_t payload_TX_broadcast[3] = { 0x70, 0xBA, 0x5E};
@@ -175,6 +188,48 @@ ISR(INT6_vect)
 
 
 
+// sample timer, see main()
+volatile uint8_t sampleTicks = 0;		// samples started by the compare interrupt
+volatile uint8_t sampleBusy = 0;		// set until main has assembled the packets of the started sample
+volatile uint8_t sampleOverruns = 0;	// compare interrupts skipped because the previous sample was not done
+volatile uint16_t sampleClock = 0;		// SAMPLE_TICK_US units, advanced by every compare interrupt
+volatile uint16_t sampleStart = 0;		// sampleClock when the current sample was started
+uint8_t sampleLinAcc = 0;				// read linear acceleration too (see modeHasLinAcc())
+
+ISR(TIMER1_COMPA_vect)
+{
+	sampleClock += SAMPLE_PERIOD_US / SAMPLE_TICK_US;
+	if (sampleBusy)
+	{
+		++sampleOverruns;
+		return;
+	}
+	
+	// start reading the sensors right at the tick for a constant sampling time, main assembles the packets meanwhile
+	BNO_Start_Read_All(sampleLinAcc);
+	sampleStart = sampleClock;
+	sampleBusy = 1;
+	++sampleTicks;
+}
+
+
+
+// delta mode: reference samples of each sensor, see process_quat_delta()
+int16_t deltaPrev[MAX_IMU_COUNT][3];
+int16_t deltaPrev2[MAX_IMU_COUNT][3];
+uint8_t deltaDepth[MAX_IMU_COUNT];		// number of reference samples, 0 -> send absolute
+
+void resetDelta()
+{
+	memset(deltaDepth, 0, sizeof(deltaDepth));
+}
+
+// mode 2 fits all sensors into a single packet only without the tick
+uint8_t modeHasTick(uint8_t mode)
+{
+	return mode != MODE_QUAT_S3;
+}
+
 void initPackets(uint8_t mode, uint8_t sensorId)
 {
 	// Packet structure
@@ -182,6 +237,7 @@ void initPackets(uint8_t mode, uint8_t sensorId)
 	// first two bytes of first packet (packet ID = 1) are synchronization bytes
 	// packet 1:  2 sync bytes      2 data descriptor bytes    data
 	//            0xAB 0xCD         0x.. 0x..                  0x.....................
+	//            the tick of the sample clock (2 bytes, LSB first) precedes the data if bit 3 of the first descriptor byte is set
 	// packet 2:  no sync bytes     2 data descriptor bytes    data
 	//                              0x.. 0x..                  0x.....................
 	// packet 3:  no sync bytes     2 data descriptor bytes    data
@@ -191,6 +247,7 @@ void initPackets(uint8_t mode, uint8_t sensorId)
 	// Data descriptor structure
 	//**********************************************************************************************************************************************************************************************************
 	// Node ID						4 bit					former ID1, equals this device's address. Not really required, can be resolved in base station by device address
+	// Tick flag					1 bit					packet 1 only: the tick of the sample clock follows the descriptor (see writeSampleTick())
 	// (IMU ID)						3 bit [NOT USED]		former ID2. Which IMU of this device, e.g. thumb or index. Not used, not every IMU sample has an ID field anymore.
 	// Device ID					3 bit					is this device a single node, glove v1, or glove v2? May be important, difference is the amount
 	//														of different sensors and data alignment in the sent packets. Fixed Node ID could resolve this.
@@ -202,109 +259,361 @@ void initPackets(uint8_t mode, uint8_t sensorId)
 	//**********************************************************************************************************************************************************************************************************
 	
 	
-	// synchronization bytes in first packet
-	payload_TX1[0] = 0xAB;
-	payload_TX1[1] = 0xCD;
+	for (uint8_t set = 0; set < 2; ++set)
+	{
+		// synchronization bytes in first packet
+		payload_TX[set][0][0] = 0xAB;
+		payload_TX[set][0][1] = 0xCD;
+		
+		// data descriptor at start of each packet (packet 1 starts after 2 sync bytes)
+		payload_TX[set][0][2] = sensorId << 4 | (modeHasTick(mode) ? 0x08 : 0) | DEVICE_ID;
+		payload_TX[set][0][3] = mode << 5 | 0x01;
+		
+		payload_TX[set][1][0] = sensorId << 4 | DEVICE_ID;
+		payload_TX[set][1][1] = mode << 5 | 0x02;
+		
+		payload_TX[set][2][0] = sensorId << 4 | DEVICE_ID;
+		payload_TX[set][2][1] = mode << 5 | 0x03;
+	}
 	
-	// data descriptor at start of each packet (packet 1 starts after 2 sync bytes)
-	payload_TX1[2] = sensorId << 4 | DEVICE_ID;
-	payload_TX1[3] = mode << 5 | 0x01;
+	// delta mode starts with absolute values
+	resetDelta();
+}
+
+uint8_t sampleID = 0;
+uint16_t sampleNumber = 0;		// 10 bit, the sample ID are its lower 2 bits, delta mode sends the upper 8
+
+void updatePacketsSampleID(uint8_t (*packets)[PAYLOAD_MAX_LEN])
+{
+	// add 1 (i.e. 0x04 = 1 << 2) to previous sample ID and mask out overflow bits
+	sampleID = (sampleID + 0x04) & 0x0C;
+	sampleNumber = (sampleNumber + 1) & 0x3FF;
 	
-	payload_TX2[0] = sensorId << 4 | DEVICE_ID;
-	payload_TX2[1] = mode << 5 | 0x02;
+	packets[0][3] = (packets[0][3] & 0xF3) | sampleID;
+	packets[1][1] = (packets[1][1] & 0xF3) | sampleID;
+	packets[2][1] = (packets[2][1] & 0xF3) | sampleID;
+}
+
+// the host relates the samples to its clock by the tick, the base station adds the time it received the packet
+void writeSampleTick(uint8_t (*packets)[PAYLOAD_MAX_LEN])
+{
+	if (packets[0][2] & 0x08)
+	{
+		packets[0][4] = sampleStart & 0xFF;
+		packets[0][5] = sampleStart >> 8;
+	}
+}
+
+
+// write pending packets to the TX FIFO as far as the base station has taken the previous ones
+void sendPendingPackets()
+{
+#if RADIO_STAR
+	// PTX with CE high: the nRF sends its TX FIFO on its own, acknowledged by the base station
+	uint8_t rx, tx_done, max_retry;
+	uint8_t irq = nrf_getIRQStatus(&rx, &tx_done, &max_retry);
+	if (max_retry)
+	{
+		// the packets in the TX FIFO belong to this or the previous sample, drop them
+		nrf_flushTX();
+		++payload_TX_lost;
+		resetDelta();
+	}
+	if (rx)
+	{
+		// ack payload: mode requested by the base station, applied by main()
+		uint8_t rxLen, rxPipe;
+		nrf_readRXData(payload_RX, &rxLen, &rxPipe);
+		starModeReceived = rxLen > 0;
+	}
+	if (irq)
+	{
+		// clear only the flags handled here
+		SPI_Write_Byte(STATUS, irq);
+	}
+#endif
 	
-	payload_TX3[0] = sensorId << 4 | DEVICE_ID;
-	payload_TX3[1] = mode << 5 | 0x03;
+	while (payload_TX_pending_count > 0 && !nrf_TXFifoFull())
+	{
+#if RADIO_STAR
+		// not nrf_writeTXData(), it flushes the FIFO and waits for the transmission
+		SPI_Write_Bytes(W_TX_PAYLOAD, payload_TX_pending[0], payload_TX_pending_len[0]);
+#else
+		// flush RX to enable packet sending and write data
+		nrf_flushRX();
+		nrf_writeAckData(0, payload_TX_pending[0], payload_TX_pending_len[0]);
+#endif
+		
+		--payload_TX_pending_count;
+		for (uint8_t i = 0; i < payload_TX_pending_count; ++i)
+		{
+			payload_TX_pending[i] = payload_TX_pending[i + 1];
+			payload_TX_pending_len[i] = payload_TX_pending_len[i + 1];
+		}
+	}
 }
 
-void updatePacketsSampleID()
+void sendPacket(uint8_t* packet, uint8_t len)
 {
-	// add 1 (i.e. 0x04 = 1 << 2) to previous sample ID and mask out overflow bits
-	uint8_t sampleID = (payload_TX1[3] + 0x04) & 0x0C;
+	payload_TX_pending[payload_TX_pending_count] = packet;
+	payload_TX_pending_len[payload_TX_pending_count] = len;
+	++payload_TX_pending_count;
+	
+	sendPendingPackets();
+}
+
+// drop packets of a set that are still pending before it is filled with a new sample (they are two samples old)
+void dropPendingPackets(uint8_t (*packets)[PAYLOAD_MAX_LEN])
+{
+	uint8_t dropped = payload_TX_dropped;
+	uint8_t keep = 0;
+	for (uint8_t i = 0; i < payload_TX_pending_count; ++i)
+	{
+		if (payload_TX_pending[i] >= packets[0] && payload_TX_pending[i] <= packets[2])
+		{
+			++payload_TX_dropped;
+			continue;
+		}
+		payload_TX_pending[keep] = payload_TX_pending[i];
+		payload_TX_pending_len[keep] = payload_TX_pending_len[i];
+		++keep;
+	}
+	payload_TX_pending_count = keep;
 	
-	payload_TX1[3] = (payload_TX1[3] & 0xF3) | sampleID;
-	payload_TX2[1] = (payload_TX2[1] & 0xF3) | sampleID;
-	payload_TX3[1] = (payload_TX3[1] & 0xF3) | sampleID;
+	if (dropped != payload_TX_dropped)
+	{
+		// the base station misses the reference samples of the following residuals
+		resetDelta();
+	}
 }
 
 
 uint8_t modeIsValid(uint8_t mode)
 {
-	// TODO: enhance (is a bit simplified for now)
-	return mode < 2;
+	return mode < MODE_COUNT;
 }
 
+uint8_t modeHasLinAcc(uint8_t mode)
+{
+	return mode == MODE_QUAT_LINACC || mode == MODE_QUAT_LINACC_S3;
+}
 
 
-void process_quat_linAcc()
+void process_quat_linAcc(uint8_t (*packets)[PAYLOAD_MAX_LEN])
 {
 	uint8_t sensorId = 0;
+	uint8_t* payload_TX1 = packets[0];
+	uint8_t* payload_TX2 = packets[1];
+	uint8_t* payload_TX3 = packets[2];
+	
+	// the sensors are read in the background (started by the sample timer), each packet is sent as soon as its sensors are read
 	
-	// packet 1    - remember: before first packet's data, there are two sync bytes, so start data at payload_TX1 + 4
-	BNO_Read_Quaternion_LinAcc_Compressed(sensorId++, payload_TX1 + 4, payload_TX1 + 10);
-	BNO_Read_Quaternion_LinAcc_Compressed(sensorId++, payload_TX1 + 16, payload_TX1 + 22);
+	// packet 1    - remember: before first packet's data, there are two sync bytes and the tick, so start data at payload_TX1 + 6
+	BNO_Get_Quaternion_LinAcc_Compressed(sensorId++, payload_TX1 + 6, payload_TX1 + 12);
+	BNO_Get_Quaternion_LinAcc_Compressed(sensorId++, payload_TX1 + 18, payload_TX1 + 24);
 
-	// flush RX to enable packet sending and write data (glove v1: 28 bytes, glove v2: 28 bytes)
-	nrf_flushRX();
-	nrf_writeAckData(0, payload_TX1, 28);
+	// glove v1: 30 bytes, glove v2: 30 bytes
+	sendPacket(payload_TX1, 30);
 
 	
 	// packet 2 (glove v1: 26 bytes, glove v2: 32 bytes)
-	BNO_Read_Quaternion_LinAcc_Compressed(sensorId++, payload_TX2 + 2, payload_TX2 + 8);
-	BNO_Read_Quaternion_LinAcc_Compressed(sensorId++, payload_TX2 + 14, payload_TX2 + 20);
+	BNO_Get_Quaternion_LinAcc_Compressed(sensorId++, payload_TX2 + 2, payload_TX2 + 8);
+	BNO_Get_Quaternion_LinAcc_Compressed(sensorId++, payload_TX2 + 14, payload_TX2 + 20);
 	
 #if DEVICE_ID == GLOVE_V1
-	nrf_writeAckData(0, payload_TX2, 26);
+	sendPacket(payload_TX2, 26);
 	
 #elif DEVICE_ID == GLOVE_V2
 	// split 5th sensor data across TX2 and TX3 packets
-	BNO_Read_Quaternion_LinAcc_Compressed(sensorId++, payload_TX2 + 26, payload_TX3 + 2);
-	nrf_writeAckData(0, payload_TX2, 32);
+	BNO_Get_Quaternion_LinAcc_Compressed(sensorId++, payload_TX2 + 26, payload_TX3 + 2);
+	sendPacket(payload_TX2, 32);
 #endif
 	
 	
 	// packet 3 (glove v1: 26 bytes, glove v2: 32 bytes)
 #if DEVICE_ID == GLOVE_V1
-	BNO_Read_Quaternion_LinAcc_Compressed(sensorId++, payload_TX3 + 2, payload_TX3 + 8);
-	BNO_Read_Quaternion_LinAcc_Compressed(sensorId++, payload_TX3 + 14, payload_TX3 + 20);
-	nrf_writeAckData(0, payload_TX3, 26);
+	BNO_Get_Quaternion_LinAcc_Compressed(sensorId++, payload_TX3 + 2, payload_TX3 + 8);
+	BNO_Get_Quaternion_LinAcc_Compressed(sensorId++, payload_TX3 + 14, payload_TX3 + 20);
+	sendPacket(payload_TX3, 26);
 	
 #elif DEVICE_ID == GLOVE_V2
-	BNO_Read_Quaternion_LinAcc_Compressed(sensorId++, payload_TX3 + 8, payload_TX3 + 14);
-	BNO_Read_Quaternion_LinAcc_Compressed(sensorId++, payload_TX3 + 20, payload_TX3 + 26);
-	nrf_writeAckData(0, payload_TX3, 32);
+	BNO_Get_Quaternion_LinAcc_Compressed(sensorId++, payload_TX3 + 8, payload_TX3 + 14);
+	BNO_Get_Quaternion_LinAcc_Compressed(sensorId++, payload_TX3 + 20, payload_TX3 + 26);
+	sendPacket(payload_TX3, 32);
 #endif
 	
 }
 
-void process_quat()
+void process_quat(uint8_t (*packets)[PAYLOAD_MAX_LEN])
 {
 	uint8_t sensorId = 0;
+	uint8_t* payload_TX1 = packets[0];
+	uint8_t* payload_TX2 = packets[1];
 	
-	// packet 1    - remember: before first packet's data, there are two sync bytes, so start data at payload_TX1 + 4
-	BNO_Read_Quaternion_Compressed(sensorId++, payload_TX1 + 4);
-	BNO_Read_Quaternion_Compressed(sensorId++, payload_TX1 + 10);
-	BNO_Read_Quaternion_Compressed(sensorId++, payload_TX1 + 16);
+	// the sensors are read in the background (started by the sample timer), each packet is sent as soon as its sensors are read
+	
+	// packet 1    - remember: before first packet's data, there are two sync bytes and the tick, so start data at payload_TX1 + 6
+	BNO_Get_Quaternion_Compressed(sensorId++, payload_TX1 + 6);
+	BNO_Get_Quaternion_Compressed(sensorId++, payload_TX1 + 12);
+	BNO_Get_Quaternion_Compressed(sensorId++, payload_TX1 + 18);
 #if DEVICE_ID == GLOVE_V2
-	BNO_Read_Quaternion_Compressed(sensorId++, payload_TX1 + 22);
+	BNO_Get_Quaternion_Compressed(sensorId++, payload_TX1 + 24);
 #endif
 	
-	// flush RX to enable packet sending and write data (glove v1: 22 bytes, glove v2: 28 bytes)
-	nrf_flushRX();
+	// glove v1: 24 bytes, glove v2: 30 bytes
 #if DEVICE_ID == GLOVE_V1
-	nrf_writeAckData(0, payload_TX1, 22);
+	sendPacket(payload_TX1, 24);
 #elif DEVICE_ID == GLOVE_V2
-	nrf_writeAckData(0, payload_TX1, 28);
+	sendPacket(payload_TX1, 30);
 #endif
 	
 	// packet 2
-	BNO_Read_Quaternion_Compressed(sensorId++, payload_TX2 + 2);
-	BNO_Read_Quaternion_Compressed(sensorId++, payload_TX2 + 8);
-	BNO_Read_Quaternion_Compressed(sensorId++, payload_TX2 + 14);
+	BNO_Get_Quaternion_Compressed(sensorId++, payload_TX2 + 2);
+	BNO_Get_Quaternion_Compressed(sensorId++, payload_TX2 + 8);
+	BNO_Get_Quaternion_Compressed(sensorId++, payload_TX2 + 14);
 	
-	// flush RX to enable packet sending and write data (20 bytes)
-	nrf_flushRX();
-	nrf_writeAckData(0, payload_TX2, 20);
+	// 20 bytes
+	sendPacket(payload_TX2, 20);
+}
+
+void process_quat_s3(uint8_t (*packets)[PAYLOAD_MAX_LEN], uint8_t mode)
+{
+	uint8_t bits = mode == MODE_QUAT_S3_FINE ? BNO_S3_FINE_BITS : BNO_S3_BITS;
+	uint8_t quatLen = mode == MODE_QUAT_S3_FINE ? BNO_S3_FINE_LEN : BNO_S3_LEN;
+	uint8_t sampleLen = mode == MODE_QUAT_LINACC_S3 ? quatLen + 6 : quatLen;
+	
+	// samples are never split, a packet is sent as soon as the next sample does not fit anymore
+	// mode 2: 1 packet (7 x 4 bytes), mode 3: 2 packets (5 + 2 x 5 bytes), mode 4: 3 packets (2 + 3 + 2 x 10 bytes)
+	uint8_t packet = 0;
+	uint8_t len = modeHasTick(mode) ? 6 : 4;		// first packet: sync bytes + descriptor (+ tick)
+	for (uint8_t sensorId = 0; sensorId < MAX_IMU_COUNT; ++sensorId)
+	{
+		if (len + sampleLen > PAYLOAD_MAX_LEN)
+		{
+			sendPacket(packets[packet], len);
+			++packet;
+			len = 2;
+		}
+		if (mode == MODE_QUAT_LINACC_S3)
+		{
+			BNO_Get_Quaternion_LinAcc_S3(sensorId, packets[packet] + len, bits, packets[packet] + len + quatLen);
+		}
+		else
+		{
+			BNO_Get_Quaternion_S3(sensorId, packets[packet] + len, bits);
+		}
+		len += sampleLen;
+	}
+	sendPacket(packets[packet], len);
+}
+
+
+#define DELTA_HEADER_LEN	2
+#define DELTA_CODE_BITS		3
+#define DELTA_ABSOLUTE		7
+
+// bits per component for each width code, code 7: absolute value
+const uint8_t deltaWidths[8] = { 0, 2, 3, 4, 6, 8, 11, 16 };
+
+// appends bits LSB first, the buffer must be zeroed
+void writeBits(uint8_t* data, uint16_t pos, uint16_t value, uint8_t bits)
+{
+	for (uint8_t i = 0; i < bits; ++i, ++pos)
+	{
+		if (value & 1)
+		{
+			data[pos >> 3] |= 1 << (pos & 7);
+		}
+		value >>= 1;
+	}
+}
+
+// header: sample number bits 2 - 9, first sensor | sensor count << 3, then the bit stream
+void sendDeltaPacket(uint8_t* packet, uint8_t* header, uint8_t first, uint8_t end, uint16_t bits)
+{
+	header[0] = sampleNumber >> 2;
+	header[1] = first | (end - first) << 3;
+	sendPacket(packet, (header - packet) + DELTA_HEADER_LEN + (bits + 7) / 8);
+}
+
+void process_quat_delta(uint8_t (*packets)[PAYLOAD_MAX_LEN])
+{
+	// each sensor: 3 bit width code + X, Y, Z as residual of the prediction from the previous samples
+	// (or absolute), see GloveProtocol.h of the C++ reader. Sensors are never split, 1 or 2 packets
+	uint8_t packet = 0;
+	uint8_t first = 0;
+	uint8_t* header = packets[0] + 6;		// first packet: sync bytes + descriptor + tick
+	uint16_t pos = 0;
+	uint16_t capacity = (PAYLOAD_MAX_LEN - 6 - DELTA_HEADER_LEN) * 8;
+	memset(header, 0, PAYLOAD_MAX_LEN - 6);
+	
+	for (uint8_t sensorId = 0; sensorId < MAX_IMU_COUNT; ++sensorId)
+	{
+		// unavailable sensors keep zeros, like the other modes
+		uint8_t raw[6] = { 0 };
+		BNO_Get_Quaternion_Compressed(sensorId, raw);
+		
+		int16_t value[3];
+		int32_t residual[3];
+		for (uint8_t k = 0; k < 3; ++k)
+		{
+			value[k] = raw[2 * k] | raw[2 * k + 1] << 8;
+		}
+		
+		// smallest width holding the residuals, absolute at the key frames (staggered over the sensors)
+		uint8_t code = DELTA_ABSOLUTE;
+		if (deltaDepth[sensorId] && ((sampleNumber + sensorId) & (DELTA_KEYFRAME_INTERVAL - 1)))
+		{
+			int32_t magnitude = 0;
+			uint8_t zero = 1;
+			for (uint8_t k = 0; k < 3; ++k)
+			{
+				int32_t prediction = deltaPrev[sensorId][k];
+				if (deltaDepth[sensorId] > 1)
+				{
+					prediction = 2 * prediction - deltaPrev2[sensorId][k];
+				}
+				residual[k] = value[k] - prediction;
+				int32_t m = residual[k] < 0 ? -residual[k] - 1 : residual[k];
+				magnitude = m > magnitude ? m : magnitude;
+				zero &= residual[k] == 0;
+			}
+			code = 0;
+			if (!zero)
+			{
+				code = 1;
+				while (code < DELTA_ABSOLUTE && magnitude >= (1L << (deltaWidths[code] - 1)))
+				{
+					++code;
+				}
+			}
+		}
+		uint8_t width = deltaWidths[code];
+		
+		if (pos + DELTA_CODE_BITS + 3 * width > capacity)
+		{
+			// send the full packet right away, continue in the next one
+			sendDeltaPacket(packets[packet], header, first, sensorId, pos);
+			++packet;
+			header = packets[packet] + 2;
+			pos = 0;
+			capacity = (PAYLOAD_MAX_LEN - 2 - DELTA_HEADER_LEN) * 8;
+			memset(header, 0, PAYLOAD_MAX_LEN - 2);
+			first = sensorId;
+		}
+		
+		uint8_t* bits = header + DELTA_HEADER_LEN;
+		writeBits(bits, pos, code, DELTA_CODE_BITS);
+		pos += DELTA_CODE_BITS;
+		for (uint8_t k = 0; k < 3; ++k, pos += width)
+		{
+			writeBits(bits, pos, code == DELTA_ABSOLUTE ? (uint16_t)value[k] : (uint16_t)residual[k], width);
+			deltaPrev2[sensorId][k] = deltaPrev[sensorId][k];
+			deltaPrev[sensorId][k] = value[k];
+		}
+		deltaDepth[sensorId] = code == DELTA_ABSOLUTE ? 1 : 2;
+	}
+	sendDeltaPacket(packets[packet], header, first, MAX_IMU_COUNT, pos);
 }
 
 
@@ -398,8 +707,8 @@ int main(void)
 	uint8_t sessionId = 0;
 	
 	// operation mode
-	// default: quaternion only, mode = 1 -> quaternion + lin. acceleration
-	uint8_t mode = 0;
+	// default: quaternion only, see MODE_... in config.h
+	uint8_t mode = MODE_QUAT;
 	initPackets(mode, sensorId);
 	
 	
@@ -408,6 +717,10 @@ int main(void)
 	PORTC |= _BV(7);	//Turns ON LED in Port C pin 7
 	_delay_ms(200);
 	
+#if RADIO_STAR
+	// star topology: no pairing, the node ID selects the RX pipe of the base station
+	sensorId = STAR_PIPE;
+#else
 	uint8_t doReceive = 1;
 	
 	nrf_flushAll();
@@ -456,6 +769,7 @@ int main(void)
 			}
 		}
 	}
+#endif
 	
 	
 	initPackets(mode, sensorId);
@@ -477,49 +791,85 @@ int main(void)
 	
 	
 	
+#if RADIO_STAR
+	// PTX to the own RX pipe of the base station, the auto retransmit delay differs per node
+	BS_star_address[4] += STAR_PIPE;
+	nrf_openDynamicTXPipe(BS_star_address, 1, 0);
+	nrf_setRetries(STAR_RETRY_DELAY, STAR_RETRIES);
+	nrf_setModeTX();
+	
+	nrf_flushAll();
+	nrf_resetIRQFlags();
+	
+	// CE stays high, the nRF sends whenever its TX FIFO is not empty
+	nrf_startListening();
+#else
 	BS_data_address[4] = sensorId;
 	nrf_openDynamicTXPipe(BS_data_address, 1, 0);
 	
 	nrf_flushAll();
 	
 	nrf_startListening();
+#endif
 	
-	// timer
-	TCCR1B |= _BV(CS11);
-	
-	// reset timer
+	// sample timer: Timer1 counts us (F_CPU / 8) and is cleared on compare match with OCR1A (CTC mode),
+	// the compare interrupt starts reading the sensors every SAMPLE_PERIOD_US
+	sampleLinAcc = modeHasLinAcc(mode);
+	OCR1A = SAMPLE_PERIOD_US - 1;
 	TCNT1 = 0;
+	TCCR1B |= _BV(WGM12) | _BV(CS11);
+	TIMSK1 |= _BV(OCIE1A);
 	
+	// enable global interrupts for the sample timer and the TWI reads (twi_queue.c)
+	sei();
 	
+	uint8_t ticks = 0;
+	uint8_t set = 0;
 	
 	// Endless Loop
 	while (1)
 	{
+		// wait for the next sample, meanwhile write the packets of the previous one as the base station takes them
+		while (sampleTicks == ticks)
+		{
+			sendPendingPackets();
+			_delay_us(1);
+		}
+		ticks = sampleTicks;
+		
+		// assemble this sample in the other set of packets, increase sample ID to indicate next sample is processed and sent
+		set ^= 1;
+		dropPendingPackets(payload_TX[set]);
+		updatePacketsSampleID(payload_TX[set]);
+		writeSampleTick(payload_TX[set]);
 		
-		if (mode == 1)
+		if (mode == MODE_QUAT_LINACC)
 		{
 			// process quaternions + linear acceleration
-			process_quat_linAcc();
+			process_quat_linAcc(payload_TX[set]);
 		}
-		else
+		else if (mode == MODE_QUAT_DELTA)
 		{
-			// default: only process quaternions
-			process_quat();
+			// quaternions as residuals of variable length
+			process_quat_delta(payload_TX[set]);
 		}
-		
-		// TODO: maybe just delay the amount of us left (10000 - TCNT1), ensure TCNT1 < 10000
-		// wait until 10 ms have passed (to keep sampling time of ~100 Hz)
-		while (TCNT1 < 10000)
+		else if (mode >= MODE_QUAT_S3)
 		{
-			_delay_us(1);
+			// smallest three quaternions (+ linear acceleration)
+			process_quat_s3(payload_TX[set], mode);
+		}
+		else
+		{
+			// default: only process quaternions
+			process_quat(payload_TX[set]);
 		}
 		
-		// increase sample ID to indicate next sample is processed and sent
-		updatePacketsSampleID();
-		
-		// reset timer
-		TCNT1 = 0;
-		
+		uint8_t received = 0;
+#if RADIO_STAR
+		// the ack payloads of the base station are read by sendPendingPackets()
+		received = starModeReceived;
+		starModeReceived = 0;
+#else
 		rxLen = 0;
 		if (nrf_getIRQStatus(&rx, &tx_done, &max_retry))
 		{
@@ -536,19 +886,26 @@ int main(void)
 				}
 				
 				// nrf_startListening();
-				
-				// check payload and change mode if required
-				uint8_t newMode = payload_RX[0];
-				if (newMode != mode && modeIsValid(newMode))
-				{
-					mode = newMode;
-					initPackets(mode, sensorId);
-				}
+				received = 1;
 			}
 			if (tx_done)
 			{
 				// last ack packet was received by PTX
 			}
 		}
+#endif
+		
+		// check payload and change mode if required
+		uint8_t newMode = payload_RX[0];
+		if (received && newMode != mode && modeIsValid(newMode))
+		{
+			mode = newMode;
+			sampleLinAcc = modeHasLinAcc(mode);
+			payload_TX_pending_count = 0;
+			initPackets(mode, sensorId);
+		}
+		
+		// the next compare interrupt may start reading the sensors again
+		sampleBusy = 0;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,145 @@
+/*
+ * twi_queue.c
+ *
+ * TWI master state machine driven by TWI_vect, see twi_queue.h.
+ * Per job: START, SLA+W, register, repeated START, SLA+R, data bytes (ACK,
+ * NACK for the last one), STOP. The next job is started right from the
+ * interrupt, only the STOP condition (one SCL period) is waited for, as the
+ * multiplexer must not be switched while the bus is in use.
+ */ 
+
+#include "config.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <compat/twi.h>
+
+#include "twi_queue.h"
+
+
+#define TWI_CONTINUE	((1 << TWINT) | (1 << TWEN) | (1 << TWIE))
+
+
+static void (*twi_select)(uint8_t channel);
+
+static TWI_Job* twi_jobs;
+static uint8_t twi_count;
+static volatile uint8_t twi_index;
+static volatile uint8_t twi_failed;
+static uint8_t twi_byte;
+
+
+static void twi_startJob(void)
+{
+	twi_select(twi_jobs[twi_index].channel);
+	
+	// send START condition, TWI_vect follows
+	TWCR = TWI_CONTINUE | (1 << TWSTA);
+}
+
+static void twi_finishJob(uint8_t failed)
+{
+	twi_failed += failed;
+	
+	// send STOP condition with the interrupt disabled and wait until the bus is released
+	TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
+	while (TWCR & (1 << TWSTO));
+	
+	if (++twi_index < twi_count)
+	{
+		twi_startJob();
+	}
+}
+
+
+void twi_initQueue(void (*selectChannel)(uint8_t channel))
+{
+	twi_select = selectChannel;
+	twi_count = 0;
+	twi_index = 0;
+}
+
+uint8_t twi_startJobs(TWI_Job* jobs, uint8_t count)
+{
+	if (twi_isBusy())
+	{
+		return 0;
+	}
+	
+	twi_jobs = jobs;
+	twi_count = count;
+	twi_index = 0;
+	twi_failed = 0;
+	
+	if (count > 0)
+	{
+		twi_startJob();
+	}
+	return 1;
+}
+
+uint8_t twi_jobsDone(void)
+{
+	return twi_index;
+}
+
+uint8_t twi_isBusy(void)
+{
+	return twi_index < twi_count;
+}
+
+uint8_t twi_failedJobs(void)
+{
+	return twi_failed;
+}
+
+
+ISR(TWI_vect)
+{
+	TWI_Job* job = &twi_jobs[twi_index];
+	
+	switch (TW_STATUS)
+	{
+		case TW_START:
+			// send device address, write mode
+			TWDR = job->address | TW_WRITE;
+			TWCR = TWI_CONTINUE;
+			break;
+		
+		case TW_MT_SLA_ACK:
+			// set register pointer
+			TWDR = job->reg;
+			TWCR = TWI_CONTINUE;
+			break;
+		
+		case TW_MT_DATA_ACK:
+			// repeated START to switch to read mode
+			TWCR = TWI_CONTINUE | (1 << TWSTA);
+			break;
+		
+		case TW_REP_START:
+			TWDR = job->address | TW_READ;
+			TWCR = TWI_CONTINUE;
+			break;
+		
+		case TW_MR_SLA_ACK:
+			// acknowledge all but the last byte
+			twi_byte = 0;
+			TWCR = job->length > 1 ? TWI_CONTINUE | (1 << TWEA) : TWI_CONTINUE;
+			break;
+		
+		case TW_MR_DATA_ACK:
+			job->dest[twi_byte++] = TWDR;
+			TWCR = twi_byte + 1 < job->length ? TWI_CONTINUE | (1 << TWEA) : TWI_CONTINUE;
+			break;
+		
+		case TW_MR_DATA_NACK:
+			job->dest[twi_byte] = TWDR;
+			twi_finishJob(0);
+			break;
+		
+		default:
+			// no acknowledge (device busy or missing), bus error, arbitration lost
+			twi_finishJob(1);
+			break;
+	}
+}
@@ -0,0 +1,41 @@
+/*
+ * twi_queue.h
+ *
+ * Interrupt driven TWI reads: a list of jobs (multiplexer channel, register,
+ * length, destination) is worked off back to back by the TWI interrupt, so the
+ * CPU can assemble and send packets while the bytes are on the bus.
+ * Uses the bit rate set by i2c_init(), global interrupts must be enabled.
+ */ 
+
+
+#ifndef TWI_QUEUE_H_
+#define TWI_QUEUE_H_
+
+#include <stdint.h>
+
+
+typedef struct
+{
+	uint8_t channel;		// multiplexer channel, passed to the select function before the job starts
+	uint8_t address;		// device address (write), e.g. BNO055_ADDRESS
+	uint8_t reg;			// first register to read
+	uint8_t length;			// number of bytes to read (> 0)
+	uint8_t* dest;
+} TWI_Job;
+
+
+// selectChannel switches the multiplexer, it is called from the interrupt
+void twi_initQueue(void (*selectChannel)(uint8_t channel));
+
+// start working off jobs[0 .. count-1], the jobs must stay valid until done. Returns 0 if the queue is still busy
+uint8_t twi_startJobs(TWI_Job* jobs, uint8_t count);
+
+// number of jobs finished (read or failed) since the last twi_startJobs()
+uint8_t twi_jobsDone(void);
+uint8_t twi_isBusy(void);
+
+// number of jobs that failed (no acknowledge, bus error) since the last twi_startJobs()
+uint8_t twi_failedJobs(void);
+
+
+#endif /* TWI_QUEUE_H_ */
@@ -9,6 +9,7 @@
 #include <inttypes.h>
 #include <compat/twi.h>
 
+#include "config.h"
 #include "i2cmaster.h"
 
 
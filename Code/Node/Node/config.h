@@ -25,5 +25,16 @@
 #define NODE_ID		0x01
 #define IMU_ID		0x01
 
+// radio topology, see RADIO_STAR in Code/BaseStation/main.cpp: 0 -> polled by the base station,
+// 1 -> star: the node sends each sample on its own (PTX) to RX pipe STAR_PIPE of the base station
+#ifndef RADIO_STAR
+  #define RADIO_STAR	0
+#endif
+#define STAR_PIPE		(NODE_ID - 1)	// 0 - 5, unique per node
+#define STAR_RETRIES	5				// retransmissions, then the sample is dropped
+// auto retransmit delay in us: the steps are longer than a 32 byte packet + ack (660 us), so the retries of
+// two nodes whose packets collided do not overlap again
+#define STAR_RETRY_DELAY	(250 + 750 * STAR_PIPE)
+
 
 #endif /* CONFIG_H_ */
\ No newline at end of file
@@ -35,6 +35,14 @@ uint8_t payload_RX[PAYLOAD_MAX_LEN];
 
 uint8_t quatPacket[30];
 
+#if RADIO_STAR
+// star topology: RX pipe 0 of the base station, the last byte + STAR_PIPE is this node's pipe
+uint8_t BS_star_address[NRF_ADDR_LEN] = {0xBA, 0x5E, 0x57, 0xA2, 0xC1};
+
+// sync bytes, data descriptor (node ID, single node / mode, sample ID, packet 1) and the sample
+uint8_t starPacket[4 + 14] = {0xAB, 0xCD, STAR_PIPE << 4, 0x01};
+#endif
+
 
 //Function Prototypes
 void AVR_Init(void);
@@ -190,6 +198,20 @@ int main(void)
 	// Disable global interrupt
 	cli();
 
+#if RADIO_STAR
+	// PTX to the own RX pipe of the base station, the auto retransmit delay differs per node
+	BS_star_address[NRF_ADDR_LEN - 1] += STAR_PIPE;
+	nrf_openDynamicTXPipe(BS_star_address, 1, 0);
+	nrf_setRetries(STAR_RETRY_DELAY, STAR_RETRIES);
+	nrf_setModeTX();
+	nrf_maskIRQ(1, 1, 1);
+	
+	nrf_flushRX();
+	nrf_flushTX();
+	nrf_resetIRQFlags();
+	
+	uint8_t sampleId = 0;
+#else
 	//Configure as receiver
 	nrf_setModeRX();
 	nrf_maskIRQ(1, 1, 1);
@@ -200,6 +222,7 @@ int main(void)
 	
 	nrf_startListening();
 	_delay_us(150);
+#endif
 	
 	uint8_t rxLen = 0;
 	uint8_t rxPipe;
@@ -215,6 +238,49 @@ int main(void)
 	//Endless Loop
 	while(1)
 	{
+#if RADIO_STAR
+		starPacket[3] = (mode << 5) | (sampleId << 2) | 0x01;
+		sampleId = (sampleId + 1) & 0x03;
+		uint8_t len = 4 + 8;
+		if (mode == 1)
+		{
+			// process quaternions + linear acceleration
+			BNO_Read_Quaternion_LinAcc(starPacket + 4);
+			len = 4 + 14;
+		}
+		else
+		{
+			// default: only process quaternions
+			BNO_Read_Quaternion(starPacket + 4);
+		}
+		
+		// returns on the acknowledge or after STAR_RETRIES retransmissions (the sample is lost)
+		nrf_writeTXData(starPacket, len);
+		
+		// the acknowledge may carry the mode requested by the base station
+		rxLen = 0;
+		nrf_getIRQStatus(&rx, &tx_done, &max_retry);
+		if (rx)
+		{
+			while (nrf_dataAvailable())
+			{
+				nrf_readRXData(payload_RX, &rxLen, &rxPipe);
+			}
+			if (rxLen > 0 && payload_RX[0] != mode && modeIsValid(payload_RX[0]))
+			{
+				mode = payload_RX[0];
+			}
+		}
+		nrf_resetIRQFlags();
+		
+		while (TCNT1 < 10000)
+		{
+			_delay_us(1);
+		}
+		
+		// reset timer
+		TCNT1 = 0;
+#else
 		if (mode == 1)
 		{
 			// process quaternions + linear acceleration
@@ -271,6 +337,7 @@ int main(void)
 				// last ack packet was received by PTX
 			}
 		}
+#endif
 	}
 }
 
@@ -97,12 +97,28 @@ def isPacketValid(mode, deviceId, packetId):
         return False
     if packetId == 0 or packetId > 3:
         return False
+    if deviceId > glove_v2_Id:
+        return False
     if deviceId == 0 and packetId > 1:
         return False
-    if mode == 1 and packetId > 2:
+    # the gloves send 2 packets in mode 0, 3 in mode 1
+    if mode == 0 and packetId > 2:
         return False
     return True
 
+# Packets have no length field or checksum and the time stamp flags took over the two header
+# bits that had to be 0, so a header alone lets false sync bytes in the data pass. A packet
+# counts once the 2 bytes after it are sync bytes or the header of a packet 2 or 3 (packet 1
+# always follows sync bytes).
+def canFollowPacket(nextBytes):
+    if nextBytes == syncBytes:
+        return True
+    deviceId = nextBytes[0] & 0x07
+    mode = nextBytes[1] >> 5
+    packetId = nextBytes[1] & 0x03
+    hasTime = nextBytes[0] & 0x08 or nextBytes[1] & 0x10
+    return packetId > 1 and not hasTime and isPacketValid(mode, deviceId, packetId)
+
 ######################################################################################
 def cubeDraw(rotM, txt):  # render & rotate a 3D Box according a 4x4 rotation matrix
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT)
@@ -248,13 +264,6 @@ try:
             # strip header data from inData
             inData = inData[2:]
             
-        if header[0] & 0x08 or header[1] & 0x10:
-            print("Received invalid packet header: Control bits invalid. Header is:")
-            print(header)
-            print("Skip to next sync point...")
-            doSync = True
-            continue
-        
         # get header data
         nodeId = header[0] >> 4
         deviceId = header[0] & 0x07
@@ -262,6 +271,32 @@ try:
         sampleId = (header[1] >> 2) & 0x03
         packetId = header[1] & 0x03
         
+        # time stamps (tick of the glove, receive time of the base station) follow the header
+        # of packet 1, they are skipped here (see GloveClock of the C++ reader)
+        timeLen = (2 if header[0] & 0x08 else 0) + (4 if header[1] & 0x10 else 0)
+        if timeLen and packetId != 1:
+            print("Received invalid packet header: Time stamp flags outside packet 1. Header is:")
+            print(header)
+            print("Skip to next sync point...")
+            doSync = True
+            continue
+        # only the gloves send a tick (not in the smallest three mode 2, which the reader skips)
+        if header[0] & 0x08 and deviceId == singleNode_Id:
+            print("Received invalid packet header: Tick from a single node. Skip to next sync point...")
+            doSync = True
+            continue
+        
+        # telemetry frames of the base station (mode 7, 26 bytes, see LinkTelemetry.h) are skipped
+        if mode == 7:
+            while len(inData) < 26 + 2:
+                inData += ser.read(100)
+            if packetId != 1 or timeLen or deviceId > glove_v2_Id or not canFollowPacket(inData[26:28]):
+                print("Received invalid telemetry frame. Skip to next sync point...")
+                doSync = True
+                continue
+            inData = inData[26:]
+            continue
+        
         # do some basic header check
         if not isPacketValid(mode, deviceId, packetId):
             print("Received invalid packet header: Mode, deviceId, or packetId invalid.")
@@ -277,12 +312,20 @@ try:
         
         packetLength, numSamples = getPacketLength(mode, deviceId, packetId)        
         
-        # ensure we already received the whole packet, otherwise wait until it arrives
-        while len(inData) < packetLength:
+        # ensure we already received the whole packet and the start of the next one, otherwise
+        # wait until it arrives
+        while len(inData) < timeLen + packetLength + 2:
             inData += ser.read(100)
         
-        packet = inData[:packetLength]
-        inData = inData[packetLength:]        
+        # the next packet has to start right after it, else it was cut short or the sync bytes
+        # were false. The packet stays in inData, the search for sync bytes starts in it
+        if not canFollowPacket(inData[timeLen + packetLength:timeLen + packetLength + 2]):
+            print("Received packet that does not end at the next one. Skip to next sync point...")
+            doSync = True
+            continue
+        
+        packet = inData[timeLen:timeLen + packetLength]
+        inData = inData[timeLen + packetLength:]        
         
         if mode == 0:
             if deviceId == singleNode_Id: